@@ -16,6 +16,7 @@
 #include "BlurEffect.hpp"
 #include "MorphEffect.hpp"
 #include "Property.hpp"
+#include "GameSnapshot.hpp"
 
 #import "ConfirmViewController.h"
 #import "ColumnBrickMap.hpp"
@@ -634,6 +635,30 @@ BeginStateMachine
                 //TestGameTime();
                 //TestEasing();
                 //TestRipple();
+                //TestNullRenderer();
+                //TestProfiler();
+                //TestLog();
+                //TestJobSystem();
+                //TestRenderQueue();
+                //TestRetainedSpriteBatches();
+                //TestSharedShadowPass();
+                //TestCulling();
+                //TestScratchSurfaces();
+                //TestQuadVertices();
+                //TestVertexStream();
+                //TestTessellationGrids();
+                //TestTextBatching();
+                //TestTransforms();
+                //TestSliceScheduler();
+                //TestPrefabPools();
+                //TestDenseGameObjects();
+                //TestStateDispatch();
+                //TestParallelUpdate();
+                //TestFixedTimestep();
+                //TestTouchDispatch();
+                //TestInputQueue();
+                //TestBoardSearch();
+                //TestGameSnapshot();
 
                 ChangeState( STATE_Initialize );
                 
@@ -810,8 +835,13 @@ BeginStateMachine
 
 
             // Display the home screen/menu after the fly-in storyboard completes.
+            // If there's a saved game to resume, go straight back to it instead.
             float duration = StoryboardMan.GetDurationMS( hCameraStoryboard ) / 1000.0f;
-            if (duration > 0)
+            if (GameSnapshot::IsPending())
+            {
+                ChangeState( STATE_NewGame );
+            }
+            else if (duration > 0)
             {
                 ChangeStateDelayed( duration, STATE_Home );
             }
@@ -1120,6 +1150,9 @@ BeginStateMachine
         
             Platform::LogAnalyticsEvent( "MSG_NewGame" );
 
+            // The ColumnController picks up a saved game when it's created.
+            bool isResuming = GameSnapshot::IsPending();
+
             // TODO: flourish sound, particles, "Go!" billboard, etc.
             g_showScore     = true;
             g_totalScore    = 0;
@@ -1163,10 +1196,15 @@ BeginStateMachine
             spriteBounds = SpriteMan.GetBounds( hSprite );
             SpriteMan.Release( hSprite );
             vec3 position(screenRect.width/2 - spriteBounds.GetWidth()/2, screenRect.width/3, 0);
-            GOMan.Create( "NewGame", "NewGame", hPlayScreenAlerts, position, NULL, 1.0f, Color::White(), true );
             LayerMan.SetVisible( hPlayScreenAlerts, true );
 
-            float delay = StoryboardMan.GetDurationMS( "NewGame" );
+            // No fanfare for a resumed game.
+            float delay = 0.0f;
+            if (!isResuming)
+            {
+                GOMan.Create( "NewGame", "NewGame", hPlayScreenAlerts, position, NULL, 1.0f, Color::White(), true );
+                delay = StoryboardMan.GetDurationMS( "NewGame" );
+            }
             ChangeStateDelayed( delay/1000.0f, STATE_Play );
 
         OnExit
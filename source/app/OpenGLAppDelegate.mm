@@ -12,6 +12,8 @@
 #import "Game.hpp"
 #import "Level.hpp"                         // for struct Level
 #import "GameState.hpp"                     // for extern Level* g_pLevel;
+#import "ScratchSurfacePool.hpp"
+#import "TessellationCache.hpp"
 #import <AVFoundation/AVAudioSession.h>
 #import "LocalyticsSession.h"
 #import <targetconditionals.h>
@@ -473,6 +475,10 @@ static OpenGLAppDelegate* s_pSharedInstance = nil;
      */
     
     RETAILMSG(ZONE_ERROR, "ERROR: applicationDidReceiveMemoryWarning !!!!!!!!!!!!!!!!!");
+
+    // Offscreen surfaces and Ripple/Morph grids that no Effect is using right now are re-created on demand.
+    Z::ScratchSurfacePool::Trim();
+    Z::TessellationCache::Trim();
 }
 
 
@@ -2,6 +2,9 @@
 #include "Camera.hpp"
 #include "Log.hpp"
 #include "Settings.hpp"
+#include "Culling.hpp"
+
+#include <math.h>
 
 
 namespace Z
@@ -170,6 +173,8 @@ Camera::UpdateViewMatrix()
     m_mView.y   = vec4( xaxis.y, yaxis.y, zaxis.y, 0.0f );
     m_mView.z   = vec4( xaxis.z, yaxis.z, zaxis.z, 0.0f );
     m_mView.w   = vec4( x,       y,       z,       1.0f );
+
+    Culling::Invalidate();
 }
 
 
@@ -200,6 +205,66 @@ Camera::UpdateProjectionMatrix()
             m_mProjection   = scale * mat4::Translate( -halfWidth, -halfHeight, -halfHeight ) * mat4::Ortho( -halfWidth, halfWidth, -halfHeight, halfHeight,  m_fNearPlane, m_fFarPlane );
             break;
     }
+
+    UpdateCullPlanes();
+    Culling::Invalidate();
+}
+
+
+
+//
+// Extract the six planes of the view volume from the projection matrix
+// (Gribb & Hartmann); a point p is inside when dot(plane, p) >= 0 for all of them.
+//
+void
+Camera::UpdateCullPlanes()
+{
+    const mat4& m = m_mProjection;
+
+    // Columns of the projection: clip.x = dot( (p, 1), colX ), etc.
+    vec4 colX( m.x.x, m.y.x, m.z.x, m.w.x );
+    vec4 colY( m.x.y, m.y.y, m.z.y, m.w.y );
+    vec4 colZ( m.x.z, m.y.z, m.z.z, m.w.z );
+    vec4 colW( m.x.w, m.y.w, m.z.w, m.w.w );
+
+    m_cullPlanes[0] = colW + colX;      // left
+    m_cullPlanes[1] = colW - colX;      // right
+    m_cullPlanes[2] = colW + colY;      // bottom
+    m_cullPlanes[3] = colW - colY;      // top
+    m_cullPlanes[4] = colW + colZ;      // near
+    m_cullPlanes[5] = colW - colZ;      // far
+
+    for (int i = 0; i < 6; ++i)
+    {
+        vec4& plane  = m_cullPlanes[i];
+        float length = sqrtf( plane.x * plane.x + plane.y * plane.y + plane.z * plane.z );
+
+        if (length > 0.0f)
+        {
+            plane.x /= length;
+            plane.y /= length;
+            plane.z /= length;
+            plane.w /= length;
+        }
+    }
+}
+
+
+
+bool
+Camera::IsVisible( const vec3& eyeCenter, float eyeRadius ) const
+{
+    for (int i = 0; i < 6; ++i)
+    {
+        const vec4& plane = m_cullPlanes[i];
+
+        if (plane.x * eyeCenter.x + plane.y * eyeCenter.y + plane.z * eyeCenter.z + plane.w < -eyeRadius)
+        {
+            return false;
+        }
+    }
+
+    return true;
 }
 
     
@@ -39,6 +39,10 @@ public:
     const vec3&     GetAheadVector      ( )     const { return (vec3&)m_mView.z;  }
     const vec3&     GetEyePt            ( )     const { return (vec3&)m_mView.w;  }
 
+    // False if a sphere in eye space (i.e. after the model-view matrix) lies
+    // entirely outside the view volume.
+    bool            IsVisible           ( const vec3& eyeCenter, float eyeRadius ) const;
+
 
     virtual IProperty*  GetProperty ( const string& name ) const;
 
@@ -47,6 +51,7 @@ protected:
     void            UpdateViewMatrix      ( );
     void            UpdateWorldMatrix     ( );
     void            UpdateProjectionMatrix( );
+    void            UpdateCullPlanes      ( );
     
 protected:
     CameraMode  m_mode;
@@ -65,6 +70,8 @@ protected:
     mat4        m_mProjection;
     mat4        m_mView;
     mat4        m_mWorld;           // World matrix (inverse of the view matrix)
+
+    vec4        m_cullPlanes[6];    // Eye-space view volume; normals point inward.
     
     
 
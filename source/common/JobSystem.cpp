@@ -0,0 +1,603 @@
+/*
+ *  JobSystem.cpp
+ *  Critters
+ *
+ *  Work-stealing job system.
+ *
+ *  Every participating thread owns a fixed-size deque guarded by an
+ *  os_unfair_lock; the critical sections are a handful of instructions, so
+ *  contention only shows up when thieves pile onto one deque.  Job records come
+ *  from a global ring, so spawning a job never allocates; if the ring comes
+ *  round to a job that hasn't run yet, the new job runs inline instead.
+ *
+ *  Idle workers spin briefly, then sleep on a condition variable until Push()
+ *  sees a sleeper and signals.
+ */
+
+#include "JobSystem.hpp"
+#include "Log.hpp"
+#include "Macros.hpp"
+#include "Metrics.hpp"
+#include "Profiler.hpp"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <unistd.h>
+
+
+namespace Z
+{
+
+
+
+#define JOB_QUEUE_MASK          (JOB_QUEUE_SIZE - 1)
+#define JOB_POOL_SIZE           4096        // Max jobs in flight across all threads; must be a power of two.
+#define JOB_POOL_MASK           (JOB_POOL_SIZE - 1)
+#define JOB_IDLE_SPINS          64
+
+
+struct Job
+{
+    JobFunction             pFunction;
+    ParallelForFunction     pRangeFunction;
+    void*                   pContext;
+    UINT32                  begin;
+    UINT32                  end;
+    JobCounter*             pCounter;
+    volatile int32_t        isBusy;         // Set from AllocateJob() until the job has run.
+};
+
+
+struct JobQueue
+{
+    os_unfair_lock  lock;
+    volatile UINT32 top;            // Thieves take from here.
+    volatile UINT32 bottom;         // The owner pushes and pops here.
+    Job*            pJobs[ JOB_QUEUE_SIZE ];
+};
+
+
+
+//
+// Static Data
+//
+bool                    JobSystem::s_isInitialized      = false;
+UINT32                  JobSystem::s_numWorkers         = 0;
+
+static JobQueue         s_queues[ JOB_MAX_WORKERS + 1 ];        // [0] belongs to the thread that called Init().
+static pthread_t        s_workerThreads[ JOB_MAX_WORKERS ];
+static volatile bool    s_isRunning                     = false;
+
+static Job              s_jobPool[ JOB_POOL_SIZE ];
+static volatile int32_t s_nextJob                       = 0;
+
+static volatile int32_t s_numQueuedJobs                 = 0;
+static volatile int32_t s_numSleepingWorkers            = 0;
+static pthread_mutex_t  s_wakeMutex                     = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t   s_wakeCondition                 = PTHREAD_COND_INITIALIZER;
+static volatile int32_t s_numWaitingThreads             = 0;     // In Wait(), with nothing to run.
+static pthread_cond_t   s_doneCondition                 = PTHREAD_COND_INITIALIZER;
+
+static pthread_key_t    s_threadIndexKey;
+static pthread_once_t   s_threadIndexKeyOnce            = PTHREAD_ONCE_INIT;
+
+static MetricCounter*   s_pJobsExecutedMetric           = Metrics::RegisterCounter( "Jobs.Executed" );
+static MetricCounter*   s_pJobsStolenMetric             = Metrics::RegisterCounter( "Jobs.Stolen"   );
+static MetricCounter*   s_pJobsInlineMetric             = Metrics::RegisterCounter( "Jobs.Inline"   );
+
+
+
+static void
+CreateThreadIndexKey()
+{
+    pthread_key_create( &s_threadIndexKey, NULL );
+}
+
+
+
+static Job*
+AllocateJob()
+{
+    int32_t index = OSAtomicIncrement32( &s_nextJob );
+    Job*    pJob  = &s_jobPool[ index & JOB_POOL_MASK ];
+
+    // The ring has lapped a job that is still pending; the caller runs this one itself.
+    if (!OSAtomicCompareAndSwap32Barrier( 0, 1, &pJob->isBusy ))
+    {
+        s_pJobsInlineMetric->Increment();
+        return NULL;
+    }
+
+    return pJob;
+}
+
+
+
+// Threads that JobSystem didn't start share queue 0 with the main thread.
+UINT32
+JobSystem::GetThreadIndex()
+{
+    pthread_once( &s_threadIndexKeyOnce, CreateThreadIndexKey );
+
+    return (UINT32)(size_t)pthread_getspecific( s_threadIndexKey );
+}
+
+
+
+RESULT
+JobSystem::Init( UINT32 numWorkers )
+{
+    RESULT rval = S_OK;
+
+    if (s_isInitialized)
+    {
+        return S_OK;
+    }
+
+    if (0 == numWorkers)
+    {
+        long numCPUs = sysconf( _SC_NPROCESSORS_ONLN );
+        numWorkers   = numCPUs > 1 ? (UINT32)numCPUs - 1 : 0;
+    }
+    numWorkers = MIN( numWorkers, JOB_MAX_WORKERS );
+
+    pthread_once( &s_threadIndexKeyOnce, CreateThreadIndexKey );
+    pthread_setspecific( s_threadIndexKey, (void*)0 );
+
+    for (UINT32 i = 0; i < ARRAY_SIZE(s_queues); ++i)
+    {
+        s_queues[i].lock    = OS_UNFAIR_LOCK_INIT;
+        s_queues[i].top     = 0;
+        s_queues[i].bottom  = 0;
+    }
+
+    s_isRunning  = true;
+    s_numWorkers = 0;
+
+    for (UINT32 i = 0; i < numWorkers; ++i)
+    {
+        if (pthread_create( &s_workerThreads[i], NULL, WorkerThreadProc, (void*)(size_t)(i + 1) ))
+        {
+            RETAILMSG(ZONE_ERROR, "ERROR: JobSystem::Init(): can't start worker %d", i);
+            break;
+        }
+        s_numWorkers++;
+    }
+
+    s_isInitialized = true;
+
+    RETAILMSG(ZONE_INFO, "JobSystem: %d worker thread(s)", s_numWorkers);
+
+    return rval;
+}
+
+
+
+RESULT
+JobSystem::Shutdown()
+{
+    RESULT rval = S_OK;
+    Job*   pJob = NULL;
+
+    if (!s_isInitialized)
+    {
+        return S_OK;
+    }
+
+    // Don't strand anything that's still queued.
+    while (GetJob( GetThreadIndex(), &pJob ))
+    {
+        Execute( pJob );
+    }
+
+    s_isRunning = false;
+
+    pthread_mutex_lock( &s_wakeMutex );
+    pthread_cond_broadcast( &s_wakeCondition );
+    pthread_mutex_unlock( &s_wakeMutex );
+
+    for (UINT32 i = 0; i < s_numWorkers; ++i)
+    {
+        pthread_join( s_workerThreads[i], NULL );
+    }
+
+    s_numWorkers    = 0;
+    s_isInitialized = false;
+
+    return rval;
+}
+
+
+
+RESULT
+JobSystem::Run( JobFunction pFunction, void* pContext, JobCounter* pCounter, JobCounter* pDependency )
+{
+    RESULT rval = S_OK;
+    Job*   pJob = NULL;
+
+    CPR(pFunction);
+
+    if (!s_isInitialized)
+    {
+        // Nothing runs asynchronously, so any dependency has already finished.
+        pFunction( pContext );
+        goto Exit;
+    }
+
+    pJob = AllocateJob();
+    if (!pJob)
+    {
+        Wait( pDependency );
+        pFunction( pContext );
+        goto Exit;
+    }
+
+    pJob->pFunction         = pFunction;
+    pJob->pRangeFunction    = NULL;
+    pJob->pContext          = pContext;
+    pJob->begin             = 0;
+    pJob->end               = 0;
+    pJob->pCounter          = pCounter;
+
+    if (pCounter)
+    {
+        OSAtomicIncrement32Barrier( &pCounter->m_count );
+    }
+
+    if (pDependency)
+    {
+        bool isDeferred = false;
+
+        os_unfair_lock_lock( &pDependency->m_lock );
+        if (pDependency->m_count > 0 && pDependency->m_numContinuations < JOB_MAX_CONTINUATIONS)
+        {
+            pDependency->m_pContinuations[ pDependency->m_numContinuations++ ] = pJob;
+            isDeferred = true;
+        }
+        os_unfair_lock_unlock( &pDependency->m_lock );
+
+        if (isDeferred)
+        {
+            goto Exit;
+        }
+
+        // No room to park the job; honor the dependency by joining it here.
+        Wait( pDependency );
+    }
+
+    CHR(Push( pJob ));
+
+Exit:
+    return rval;
+}
+
+
+
+void
+JobSystem::Wait( JobCounter* pCounter )
+{
+    Job*   pJob        = NULL;
+    UINT32 threadIndex = GetThreadIndex();
+
+    if (!pCounter)
+    {
+        return;
+    }
+
+    while (pCounter->m_count > 0)
+    {
+        bool foundJob = false;
+
+        for (UINT32 spin = 0; spin < JOB_IDLE_SPINS && !foundJob && pCounter->m_count > 0; ++spin)
+        {
+            foundJob = GetJob( threadIndex, &pJob );
+        }
+
+        if (foundJob)
+        {
+            Execute( pJob );
+            continue;
+        }
+
+        //
+        // Nothing to help with: sleep until Finish() or Push() signals, the same
+        // handshake the workers use.  Any group finishing wakes every waiter; each
+        // one rechecks its own counter.
+        //
+        pthread_mutex_lock( &s_wakeMutex );
+        OSAtomicIncrement32Barrier( &s_numWaitingThreads );
+        if (pCounter->m_count > 0 && 0 == s_numQueuedJobs)
+        {
+            pthread_cond_wait( &s_doneCondition, &s_wakeMutex );
+        }
+        OSAtomicDecrement32Barrier( &s_numWaitingThreads );
+        pthread_mutex_unlock( &s_wakeMutex );
+    }
+
+    // Finish() may still hold the lock it dropped the count under;
+    // let it release before the caller destroys the counter.
+    os_unfair_lock_lock  ( &pCounter->m_lock );
+    os_unfair_lock_unlock( &pCounter->m_lock );
+}
+
+
+
+RESULT
+JobSystem::ParallelFor( ParallelForFunction pFunction, void* pContext, UINT32 count, UINT32 grainSize, JobCounter* pCounter )
+{
+    RESULT      rval        = S_OK;
+    JobCounter  counter;
+    UINT32      numChunks   = 0;
+    UINT32      chunkSize   = 0;
+    UINT32      begin       = 0;
+    bool        isAsync     = (pCounter != NULL);
+
+    CPR(pFunction);
+
+    if (0 == count)
+    {
+        goto Exit;
+    }
+
+    grainSize = MAX( grainSize, 1 );
+    numChunks = (count + grainSize - 1) / grainSize;
+
+    // A few chunks per thread is enough for stealing to even out the load.
+    numChunks = MIN( numChunks, (s_numWorkers + 1) * 4 );
+
+    if (!s_isInitialized || 0 == s_numWorkers || (numChunks <= 1 && !isAsync))
+    {
+        pFunction( pContext, 0, count );
+        goto Exit;
+    }
+
+    chunkSize = (count + numChunks - 1) / numChunks;
+
+    if (!pCounter)
+    {
+        // Keep the first chunk for this thread.
+        pCounter = &counter;
+        begin    = chunkSize;
+    }
+
+    for (UINT32 first = begin; first < count; first += chunkSize)
+    {
+        Job* pJob = AllocateJob();
+        if (!pJob)
+        {
+            pFunction( pContext, first, MIN( first + chunkSize, count ) );
+            continue;
+        }
+
+        pJob->pFunction         = NULL;
+        pJob->pRangeFunction    = pFunction;
+        pJob->pContext          = pContext;
+        pJob->begin             = first;
+        pJob->end               = MIN( first + chunkSize, count );
+        pJob->pCounter          = pCounter;
+
+        OSAtomicIncrement32Barrier( &pCounter->m_count );
+        IGNOREHR(Push( pJob ));
+    }
+
+    if (!isAsync)
+    {
+        pFunction( pContext, 0, MIN( chunkSize, count ) );
+        Wait( &counter );
+    }
+
+Exit:
+    return rval;
+}
+
+
+
+void*
+JobSystem::WorkerThreadProc( void* pArg )
+{
+    UINT32  threadIndex = (UINT32)(size_t)pArg;
+    Job*    pJob        = NULL;
+    char    name[32];
+
+    pthread_setspecific( s_threadIndexKey, pArg );
+
+    snprintf( name, sizeof(name), "Job Worker %u", (unsigned)threadIndex );
+    Profiler::SetThreadName( name );
+
+    while (s_isRunning)
+    {
+        bool foundJob = false;
+
+        for (UINT32 spin = 0; spin < JOB_IDLE_SPINS && !foundJob; ++spin)
+        {
+            foundJob = GetJob( threadIndex, &pJob );
+        }
+
+        if (foundJob)
+        {
+            Execute( pJob );
+            continue;
+        }
+
+        //
+        // Sleep until Push() signals.  The sleeper count is raised before the
+        // queued-job count is checked, and Push() does the reverse, so one of
+        // the two always sees the other.
+        //
+        pthread_mutex_lock( &s_wakeMutex );
+        OSAtomicIncrement32Barrier( &s_numSleepingWorkers );
+        if (0 == s_numQueuedJobs && s_isRunning)
+        {
+            pthread_cond_wait( &s_wakeCondition, &s_wakeMutex );
+        }
+        OSAtomicDecrement32Barrier( &s_numSleepingWorkers );
+        pthread_mutex_unlock( &s_wakeMutex );
+    }
+
+    return NULL;
+}
+
+
+
+bool
+JobSystem::GetJob( UINT32 threadIndex, OUT Job** ppJob )
+{
+    UINT32      numQueues   = s_numWorkers + 1;
+    JobQueue*   pQueue      = &s_queues[ threadIndex ];
+    Job*        pJob        = NULL;
+
+    if (0 == s_numQueuedJobs)
+    {
+        return false;
+    }
+
+    // Newest job from our own deque first; it's the one most likely to be in cache.
+    os_unfair_lock_lock( &pQueue->lock );
+    if (pQueue->bottom != pQueue->top)
+    {
+        pQueue->bottom--;
+        pJob = pQueue->pJobs[ pQueue->bottom & JOB_QUEUE_MASK ];
+    }
+    os_unfair_lock_unlock( &pQueue->lock );
+
+    // Otherwise steal the oldest job from someone else.
+    for (UINT32 i = 1; !pJob && i < numQueues; ++i)
+    {
+        pQueue = &s_queues[ (threadIndex + i) % numQueues ];
+
+        if (pQueue->bottom == pQueue->top)
+        {
+            continue;
+        }
+
+        os_unfair_lock_lock( &pQueue->lock );
+        if (pQueue->bottom != pQueue->top)
+        {
+            pJob = pQueue->pJobs[ pQueue->top & JOB_QUEUE_MASK ];
+            pQueue->top++;
+        }
+        os_unfair_lock_unlock( &pQueue->lock );
+
+        if (pJob)
+        {
+            s_pJobsStolenMetric->Increment();
+        }
+    }
+
+    if (!pJob)
+    {
+        return false;
+    }
+
+    OSAtomicDecrement32Barrier( &s_numQueuedJobs );
+    *ppJob = pJob;
+
+    return true;
+}
+
+
+
+void
+JobSystem::Execute( Job* pJob )
+{
+    if (pJob->pRangeFunction)
+    {
+        pJob->pRangeFunction( pJob->pContext, pJob->begin, pJob->end );
+    }
+    else
+    {
+        pJob->pFunction( pJob->pContext );
+    }
+
+    s_pJobsExecutedMetric->Increment();
+
+    Finish( pJob->pCounter );
+
+    // Hand the slot back to AllocateJob().
+    OSMemoryBarrier();
+    pJob->isBusy = 0;
+}
+
+
+
+RESULT
+JobSystem::Push( Job* pJob )
+{
+    RESULT      rval    = S_OK;
+    JobQueue*   pQueue  = &s_queues[ GetThreadIndex() ];
+    bool        pushed  = false;
+
+    os_unfair_lock_lock( &pQueue->lock );
+    if (pQueue->bottom - pQueue->top < JOB_QUEUE_SIZE)
+    {
+        pQueue->pJobs[ pQueue->bottom & JOB_QUEUE_MASK ] = pJob;
+        pQueue->bottom++;
+        pushed = true;
+    }
+    os_unfair_lock_unlock( &pQueue->lock );
+
+    if (!pushed)
+    {
+        // Queue is full; running the job now is always correct, just not parallel.
+        Execute( pJob );
+        goto Exit;
+    }
+
+    OSAtomicIncrement32Barrier( &s_numQueuedJobs );
+
+    if (s_numSleepingWorkers > 0 || s_numWaitingThreads > 0)
+    {
+        pthread_mutex_lock( &s_wakeMutex );
+        pthread_cond_signal   ( &s_wakeCondition );
+        pthread_cond_broadcast( &s_doneCondition );
+        pthread_mutex_unlock( &s_wakeMutex );
+    }
+
+Exit:
+    return rval;
+}
+
+
+
+void
+JobSystem::Finish( JobCounter* pCounter )
+{
+    Job*    pContinuations[ JOB_MAX_CONTINUATIONS ];
+    UINT32  numContinuations = 0;
+    bool    isDone           = false;
+
+    if (!pCounter)
+    {
+        return;
+    }
+
+    os_unfair_lock_lock( &pCounter->m_lock );
+    if (0 == OSAtomicDecrement32Barrier( &pCounter->m_count ))
+    {
+        isDone           = true;
+        numContinuations = pCounter->m_numContinuations;
+        for (UINT32 i = 0; i < numContinuations; ++i)
+        {
+            pContinuations[i] = pCounter->m_pContinuations[i];
+        }
+        pCounter->m_numContinuations = 0;
+    }
+    os_unfair_lock_unlock( &pCounter->m_lock );
+
+    // pCounter may be gone now; only touch the copies.
+    if (isDone && s_numWaitingThreads > 0)
+    {
+        pthread_mutex_lock( &s_wakeMutex );
+        pthread_cond_broadcast( &s_doneCondition );
+        pthread_mutex_unlock( &s_wakeMutex );
+    }
+
+    for (UINT32 i = 0; i < numContinuations; ++i)
+    {
+        IGNOREHR(Push( pContinuations[i] ));
+    }
+}
+
+
+
+} // END namespace Z
@@ -0,0 +1,121 @@
+#pragma once
+
+#include "Types.hpp"
+#include "Errors.hpp"
+
+#include <libkern/OSAtomic.h>
+#include <os/lock.h>
+
+
+//
+// Work-stealing job system.
+//
+// Engine::Init() starts one worker thread per spare core when Settings.bUseJobSystem
+// is "1" (off by default).  Each thread (workers, plus the thread that called Init())
+// owns a deque of jobs: the owner pushes and pops at the bottom, idle threads steal
+// from the top of someone else's deque.
+//
+// A job is a function pointer and a context pointer.  Jobs that share a
+// JobCounter form a group; Wait() on the counter is the join, and the waiting
+// thread runs queued jobs, sleeping only once there are none left to take.  A job
+// may also be started only once another group finishes (see the pDependency
+// argument to Run()).
+//
+// Before Init(), or with zero workers, Run() executes the job inline, so
+// callers don't need a serial fallback path.
+//
+
+#define JOB_MAX_WORKERS             7
+#define JOB_QUEUE_SIZE              1024        // Per thread; must be a power of two.
+#define JOB_MAX_CONTINUATIONS       8
+
+
+namespace Z
+{
+
+
+
+typedef void (*JobFunction)          ( void* pContext );
+typedef void (*ParallelForFunction)  ( void* pContext, UINT32 begin, UINT32 end );
+
+struct Job;
+
+
+//
+// Counts the unfinished jobs in a group.
+// Must outlive every job that references it (usually a local in the forking function).
+//
+class JobCounter
+{
+public:
+    JobCounter() :
+        m_count(0),
+        m_lock(OS_UNFAIR_LOCK_INIT),
+        m_numContinuations(0)
+    {
+    }
+
+    bool    IsDone  ( ) const   { return 0 == m_count; }
+
+protected:
+    friend class JobSystem;
+
+    volatile int32_t    m_count;
+    os_unfair_lock      m_lock;
+    UINT32              m_numContinuations;
+    Job*                m_pContinuations[ JOB_MAX_CONTINUATIONS ];
+
+private:
+    JobCounter( const JobCounter& rhs );
+    JobCounter& operator=( const JobCounter& rhs );
+};
+
+
+
+class JobSystem
+{
+public:
+    // numWorkers == 0 picks one worker per CPU beyond the calling thread.
+    static  RESULT  Init                ( UINT32 numWorkers = 0 );
+    static  RESULT  Shutdown            ( );
+    static  bool    IsInitialized       ( )     { return s_isInitialized; }
+    static  UINT32  GetNumWorkers       ( )     { return s_numWorkers; }
+
+    // 0 for the thread that called Init() (and any thread JobSystem didn't start), 1 - N for the workers.
+    static  UINT32  GetThreadIndex      ( );
+
+    // Queue pFunction( pContext ).  pCounter (optional) is incremented now and
+    // decremented when the job finishes.  If pDependency is given, the job is not
+    // queued until pDependency->IsDone().
+    static  RESULT  Run                 ( JobFunction pFunction, void* pContext, JobCounter* pCounter = NULL, JobCounter* pDependency = NULL );
+
+    // Block until pCounter reaches zero, executing queued jobs meanwhile; with none
+    // to take, spins briefly and then sleeps until a job finishes or is queued.
+    static  void    Wait                ( JobCounter* pCounter );
+
+    // Call pFunction( pContext, begin, end ) over [0, count) in chunks of at least
+    // grainSize.  Without pCounter, returns once all chunks have run and the calling
+    // thread takes part; with pCounter, queues every chunk against it and returns.
+    static  RESULT  ParallelFor         ( ParallelForFunction pFunction, void* pContext, UINT32 count, UINT32 grainSize = 1, JobCounter* pCounter = NULL );
+
+protected:
+    static  void*   WorkerThreadProc    ( void* pArg );
+    static  bool    GetJob              ( UINT32 threadIndex, OUT Job** ppJob );
+    static  void    Execute             ( Job* pJob );
+    static  RESULT  Push                ( Job* pJob );
+    static  void    Finish              ( JobCounter* pCounter );
+
+protected:
+    static  bool    s_isInitialized;
+    static  UINT32  s_numWorkers;
+
+protected:
+    JobSystem();
+    JobSystem( const JobSystem& rhs );
+    JobSystem& operator=( const JobSystem& rhs );
+    virtual ~JobSystem();
+};
+
+
+
+} // END namespace Z
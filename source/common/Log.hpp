@@ -1,6 +1,7 @@
 #pragma once
 
 #include <stdio.h>
+#include <stdarg.h>
 #include <string>
 #include "Types.hpp"
 
@@ -15,18 +16,45 @@ class MSG_Object;
 
 
 
+//
+// Zones not in LOG_COMPILED_ZONES are removed at compile time, arguments and all.
+// Zones that are compiled in but disabled at runtime cost one load and one branch.
+//
+#ifdef SHIPBUILD
+    #define LOG_COMPILED_ZONES  (Z::ZONE_ERROR | Z::ZONE_WARN | Z::ZONE_INFO | Z::ZONE_ANALYTICS | Z::ZONE_PERF)
+#else
+    #define LOG_COMPILED_ZONES  (0xFFFFFFFF)
+#endif
+
+
 #define RETAILMSG(zone, format, ...)  \
-    Z::Log::Print(zone, format, ##__VA_ARGS__);
+    { if (((zone) & LOG_COMPILED_ZONES) == (zone) && Z::Log::IsZoneEnabled(zone)) Z::Log::Print(zone, format, ##__VA_ARGS__); }
 
 
 #ifdef DEBUG
     #define DEBUGMSG(zone, format, ...)  \
-        Z::Log::Print(zone, format, ##__VA_ARGS__);
+        RETAILMSG(zone, format, ##__VA_ARGS__)
 #else
     #define DEBUGMSG(zone, format, ...) 
 #endif
 
 
+//
+// When LOG_ASYNC is defined, Log::Print() formats the message into a per-thread
+// ring buffer, stamped with the caller's tick count, and returns; a background
+// thread writes the messages to the log file and the console in batches, and
+// flushes once per batch.  Messages are dropped (and counted) if a thread's ring
+// is full.
+//
+// ZONE_ERROR messages wait for the writer, so a crash right after an error does
+// not lose it - but for no more than LOG_ERROR_FLUSH_MS, since the writer may be
+// in the middle of file I/O and the caller is often the game thread.  They are
+// never dropped: if there's no room to queue one, or the thread has no ring, it
+// is written synchronously.
+//
+#define LOG_ASYNC
+
+
 
 typedef UINT32 ZONE_MASK;
 
@@ -81,7 +109,7 @@ public:
 
     static void             SetZoneMask  ( ZONE_MASK zoneMask );
     static ZONE_MASK        GetZoneMask  ( );
-    static bool             IsZoneEnabled( ZONE_MASK zoneMask );
+    static bool             IsZoneEnabled( ZONE_MASK zoneMask )    { return (s_zoneMask & zoneMask) == zoneMask; }
     static void             EnableZone   ( ZONE_MASK zoneMask );
     static void             DisableZone  ( ZONE_MASK zoneMask );
     
@@ -89,6 +117,10 @@ public:
     static void             Print( ZONE_MASK zone, IN const char* format, ... );
     static void             Print( ZONE_MASK zone, IN const std::string* format, ... );
     static void             Print( IN const char* format, ... );
+
+    // Wait for the writer to catch up; at most timeoutMS, if not 0.
+    static void             Flush( UINT32 timeoutMS = 0 );
+    static UINT32           GetNumDroppedMessages( );
     
     static void             LogStateMachineEvent( OBJECT_ID id, const string& name, MSG_Object* msg, const string& statename, const string& substatename, const string& eventmsgname, bool handled );
     static void             LogStateMachineStateChange( OBJECT_ID id, const string& name, unsigned int state, int substate );
@@ -107,12 +139,22 @@ protected:
     
     static RESULT           SetFilename( IN const string& filename );
     static void             BackupFileIfItExists( IN const string& filename );
+
+    static void             PrintV( ZONE_MASK zone, IN const char* format, va_list vargs );
+    static void             WriteLine( UINT64 tickcount, IN const char* text );
+
+    static RESULT           StartWriterThread( );
+    static void             StopWriterThread( );
+    static void*            WriterThreadProc( void* pContext );
+    static UINT32           DrainQueues( );
     
 protected:
     static bool          s_initialized;
     static std::string   s_filename;
     static FILE         *s_pFile;
     static ZONE_MASK     s_zoneMask;
+
+    static volatile bool s_writerThreadRunning;
 };
 
 
@@ -12,6 +12,9 @@
 #include <assert.h>
 #include <stdarg.h>
 #include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
 #include "Log.hpp"
 #include "Errors.hpp"
 #include "Macros.hpp"
@@ -33,6 +36,43 @@ bool         Log::s_initialized     = false;
 FILE*        Log::s_pFile           = NULL;
 std::string  Log::s_filename("");
 ZONE_MASK    Log::s_zoneMask        = ZONE_ERROR | ZONE_WARN | ZONE_INFO;
+volatile bool Log::s_writerThreadRunning = false;
+
+
+#define LOG_MAX_MESSAGE         1024    // Longer messages are truncated, queued or not.
+#define LOG_MAX_THREADS         16      // Threads beyond this log synchronously.
+#define LOG_RECORDS_PER_THREAD  256     // Must be a power of two.  About 260 KB per thread.
+#define LOG_RECORD_MASK         (LOG_RECORDS_PER_THREAD - 1)
+#define LOG_WRITER_IDLE_MS      5
+#define LOG_ERROR_FLUSH_MS      50      // Longest an error waits for the writer.
+
+struct LogRecord
+{
+    UINT32  sequence;               // Global order across threads.
+    UINT64  tickcount;
+    char    text[ LOG_MAX_MESSAGE ];
+};
+
+// Single-producer (the owning thread), single-consumer (the writer thread).
+struct LogThreadBuffer
+{
+    LogRecord           records[ LOG_RECORDS_PER_THREAD ];
+    volatile UINT32     head;       // Written only by the owning thread.
+    volatile UINT32     tail;       // Written only by the writer thread.
+    volatile int32_t    numDropped;
+};
+
+static LogThreadBuffer*     s_threadBuffers[ LOG_MAX_THREADS ];
+static volatile int32_t     s_numThreadBuffers      = 0;
+static LogThreadBuffer      s_overflowBuffer;
+static volatile int32_t     s_sequence              = 0;
+static volatile int32_t     s_totalDropped          = 0;
+static pthread_key_t        s_threadBufferKey;
+static pthread_once_t       s_threadBufferKeyOnce   = PTHREAD_ONCE_INIT;
+static pthread_t            s_writerThread;
+
+static void                 CreateThreadBufferKey() { pthread_key_create( &s_threadBufferKey, NULL ); }
+static LogThreadBuffer*     GetThreadBuffer();
 
 ZONE_MAPPING Log::ZoneMapping[] = 
 {
@@ -105,6 +145,13 @@ Log::OpenWithFilename( IN const string& filename )
 
     s_initialized = true;
 
+#ifdef LOG_ASYNC
+    if (SUCCEEDED(rval))
+    {
+        IGNOREHR(StartWriterThread());
+    }
+#endif
+
 Exit:
     return rval;
 }
@@ -155,6 +202,8 @@ Log::Close()
         Print(ZONE_INFO, "Log Closed %s\n", timestring);
     }
     
+    StopWriterThread();
+
     fflush(s_pFile);
     fclose(s_pFile);
 
@@ -224,32 +273,9 @@ Log::Print( ZONE_MASK zone, IN const std::string* format, ... )
     assert(format);
     if (zone == (s_zoneMask & zone))
     {
-        char buf[1024]; 
         va_list vargs;
         va_start(vargs, format);
-        vsprintf(buf, format->c_str(), vargs);
-        
-        if (s_pFile)
-        {
-            // For ZONE_INFO and ZONE_ERROR, print a timestamp.
-            if ( zone & (ZONE_INFO | ZONE_ERROR) )
-            {
-                char timestring[128];
-                time_t result = time(NULL);
-                strftime(timestring, sizeof(timestring), "%c", localtime(&result));
-                
-                fprintf( s_pFile, "[%s] %s\n", timestring, buf ); 
-                printf("[%s] %s\n", timestring, buf);
-            }
-            else 
-            {
-                fprintf( s_pFile, "%s\n", buf ); 
-                printf("%s\n", buf);
-            }
-            
-            fflush ( s_pFile );
-        }
-        
+        PrintV( zone, format->c_str(), vargs );
         va_end(vargs);
     }
 }
@@ -261,48 +287,304 @@ Log::Print( ZONE_MASK zone, IN const char *format, ... )
 {
     if (zone == (s_zoneMask & zone))
     {
-        char buf[1024]; 
         va_list vargs;
         va_start(vargs, format);
-        vsprintf(buf, format, vargs); 
+        PrintV( zone, format, vargs );
+        va_end(vargs);
+    }
+}
 
-        if (s_pFile)
+
+
+void
+Log::PrintV( ZONE_MASK zone, IN const char* format, va_list vargs )
+{
+    if (!s_pFile)
+    {
+        return;
+    }
+
+#ifdef LOG_ASYNC
+    if (s_writerThreadRunning)
+    {
+        LogThreadBuffer* pBuffer = GetThreadBuffer();
+
+        // Give the writer a chance to make room for an error.
+        if ((zone & ZONE_ERROR) && pBuffer != &s_overflowBuffer && pBuffer->head - pBuffer->tail >= LOG_RECORDS_PER_THREAD)
+        {
+            Flush( LOG_ERROR_FLUSH_MS );
+        }
+
+        if (pBuffer->head - pBuffer->tail < LOG_RECORDS_PER_THREAD)
+        {
+            LogRecord* pRecord = &pBuffer->records[ pBuffer->head & LOG_RECORD_MASK ];
+            pRecord->sequence  = OSAtomicIncrement32( &s_sequence );
+            pRecord->tickcount = Platform::GetTickCount();
+            vsnprintf( pRecord->text, sizeof(pRecord->text), format, vargs );
+
+            // Publish the record before advancing the write index.
+            OSMemoryBarrier();
+            pBuffer->head = pBuffer->head + 1;
+
+            if (zone & ZONE_ERROR)
+            {
+                Flush( LOG_ERROR_FLUSH_MS );
+            }
+
+            return;
+        }
+
+        if (!(zone & ZONE_ERROR))
+        {
+            // Ring is full (or this thread has none); drop rather than stall the caller.
+            OSAtomicIncrement32( pBuffer == &s_overflowBuffer ? &s_totalDropped : &pBuffer->numDropped );
+            return;
+        }
+
+        // Errors are never dropped: with nowhere to queue this one, write it now.
+        // It may land ahead of messages still queued.
+    }
+#endif
+
+    char buf[ LOG_MAX_MESSAGE ];
+    vsnprintf( buf, sizeof(buf), format, vargs );
+
+    WriteLine( Platform::GetTickCount(), buf );
+    fflush( s_pFile );
+}
+
+
+
+void
+Log::WriteLine( UINT64 tickcount, IN const char* text )
+{
+    UINT64 hours        = tickcount / (1000*60*60);
+    UINT64 minutes      = tickcount % (1000*60*60) / (1000*60);
+    UINT64 seconds      = tickcount % (1000*60)    / (1000);
+    UINT64 milliseconds = tickcount % (1000);
+
+    // An error written synchronously can race the writer thread; keep lines whole.
+    flockfile( s_pFile );
+    fprintf( s_pFile, "[%lld:%02lld:%02lld:%03lld] %s\n", hours, minutes, seconds, milliseconds, text ); 
+    funlockfile( s_pFile );
+    printf("[%lld:%02lld:%02lld:%03lld] %s\n", hours, minutes, seconds, milliseconds, text);
+}
+
+
+
+#pragma mark -
+#pragma mark Async Writer
+
+static LogThreadBuffer*
+GetThreadBuffer()
+{
+    pthread_once( &s_threadBufferKeyOnce, CreateThreadBufferKey );
+
+    LogThreadBuffer* pBuffer = (LogThreadBuffer*)pthread_getspecific( s_threadBufferKey );
+    if (pBuffer)
+    {
+        return pBuffer;
+    }
+
+    int32_t index = OSAtomicIncrement32Barrier( &s_numThreadBuffers ) - 1;
+    if (index >= LOG_MAX_THREADS)
+    {
+        // Too many threads; share one ring that always reports full.
+        pBuffer = &s_overflowBuffer;
+        pBuffer->head = LOG_RECORDS_PER_THREAD;
+    }
+    else
+    {
+        pBuffer = new LogThreadBuffer;
+        memset( pBuffer, 0, sizeof(LogThreadBuffer) );
+
+        OSMemoryBarrier();
+        s_threadBuffers[ index ] = pBuffer;
+    }
+
+    pthread_setspecific( s_threadBufferKey, pBuffer );
+
+    return pBuffer;
+}
+
+
+
+RESULT
+Log::StartWriterThread()
+{
+    RESULT      rval = S_OK;
+    int         err;
+
+    if (s_writerThreadRunning)
+    {
+        goto Exit;
+    }
+
+    s_writerThreadRunning = true;
+    OSMemoryBarrier();
+
+    err = pthread_create( &s_writerThread, NULL, WriterThreadProc, NULL );
+    if (err)
+    {
+        s_writerThreadRunning = false;
+        Print(ZONE_ERROR, "ERROR: Log::StartWriterThread(): pthread_create failed (%d); logging synchronously", err);
+        rval = E_UNEXPECTED;
+    }
+
+Exit:
+    return rval;
+}
+
+
+
+void
+Log::StopWriterThread()
+{
+    if (!s_writerThreadRunning)
+    {
+        return;
+    }
+
+    Flush();
+
+    s_writerThreadRunning = false;
+    OSMemoryBarrier();
+    pthread_join( s_writerThread, NULL );
+
+    // Anything logged while the thread was shutting down.
+    DrainQueues();
+    fflush( s_pFile );
+}
+
+
+
+void*
+Log::WriterThreadProc( void* pContext )
+{
+    while (s_writerThreadRunning)
+    {
+        if (!DrainQueues())
         {
-            /*
-            // For ZONE_INFO and ZONE_ERROR, print a timestamp.
-            if ( zone & (ZONE_INFO | ZONE_ERROR) )
+            usleep( LOG_WRITER_IDLE_MS * 1000 );
+        }
+    }
+
+    return NULL;
+}
+
+
+
+//
+// Write every published record, oldest sequence number first, then flush once.
+// Only the writer thread (or StopWriterThread after the join) calls this.
+//
+UINT32
+Log::DrainQueues()
+{
+    UINT32 numWritten = 0;
+    UINT32 numBuffers = MIN( (UINT32)s_numThreadBuffers, LOG_MAX_THREADS );
+
+    for (;;)
+    {
+        LogThreadBuffer* pNext = NULL;
+
+        for (UINT32 i = 0; i < numBuffers; ++i)
+        {
+            LogThreadBuffer* pBuffer = s_threadBuffers[i];
+            if (!pBuffer || pBuffer->tail == pBuffer->head)
             {
-                char timestring[128];
-                time_t result = time(NULL);
-                strftime(timestring, sizeof(timestring), "%c", localtime(&result));
-                
-                fprintf( s_pFile, "[%s] %s\n", timestring, buf ); 
-                printf("[%s] %s\n", timestring, buf);
+                continue;
             }
-            else 
+            OSMemoryBarrier();
+
+            const LogRecord& record = pBuffer->records[ pBuffer->tail & LOG_RECORD_MASK ];
+            if (!pNext || (int32_t)(record.sequence - pNext->records[ pNext->tail & LOG_RECORD_MASK ].sequence) < 0)
             {
-                fprintf( s_pFile, "%s\n", buf ); 
-                printf("%s\n", buf);
+                pNext = pBuffer;
             }
-            */
-            
-            UINT64 tickcount    = Platform::GetTickCount();
-            UINT64 hours        = tickcount / (1000*60*60);
-            UINT64 minutes      = tickcount % (1000*60*60) / (1000*60);
-            UINT64 seconds      = tickcount % (1000*60)    / (1000);
-            UINT64 milliseconds = tickcount % (1000);
-            
-   
-//            fprintf( s_pFile, "[%lld] %s\n", tickcount, buf ); 
-//            printf("[%lld] %s\n", tickcount, buf);
-            fprintf( s_pFile, "[%lld:%02lld:%02lld:%03lld] %s\n", hours, minutes, seconds, milliseconds, buf ); 
-            printf("[%lld:%02lld:%02lld:%03lld] %s\n", hours, minutes, seconds, milliseconds, buf);
-
-            fflush ( s_pFile );
         }
-        
-        va_end(vargs);
+
+        if (!pNext)
+        {
+            break;
+        }
+
+        const LogRecord& record = pNext->records[ pNext->tail & LOG_RECORD_MASK ];
+        WriteLine( record.tickcount, record.text );
+        numWritten++;
+
+        // Release the slot back to the producer.
+        OSMemoryBarrier();
+        pNext->tail = pNext->tail + 1;
+
+        int32_t numDropped = pNext->numDropped;
+        if (numDropped && OSAtomicCompareAndSwap32Barrier( numDropped, 0, &pNext->numDropped ))
+        {
+            char buf[64];
+            snprintf( buf, sizeof(buf), "WARNING: Log: dropped %d message(s)", (int)numDropped );
+            WriteLine( record.tickcount, buf );
+            OSAtomicAdd32( numDropped, &s_totalDropped );
+        }
+    }
+
+    if (numWritten)
+    {
+        fflush( s_pFile );
     }
+
+    return numWritten;
+}
+
+
+
+void
+Log::Flush( UINT32 timeoutMS )
+{
+    if (!s_writerThreadRunning)
+    {
+        if (s_pFile)
+        {
+            fflush( s_pFile );
+        }
+        return;
+    }
+
+    UINT32 numBuffers = MIN( (UINT32)s_numThreadBuffers, LOG_MAX_THREADS );
+    UINT64 deadline   = Platform::GetTickCount() + timeoutMS;
+
+    for (UINT32 i = 0; i < numBuffers; ++i)
+    {
+        LogThreadBuffer* pBuffer = s_threadBuffers[i];
+        while (pBuffer && pBuffer->tail != pBuffer->head && s_writerThreadRunning)
+        {
+            if (timeoutMS && Platform::GetTickCount() >= deadline)
+            {
+                // The writer is stuck in I/O; the message is queued and will get there.
+                return;
+            }
+            usleep( 1000 );
+        }
+    }
+}
+
+
+
+UINT32
+Log::GetNumDroppedMessages()
+{
+    UINT32 numDropped = s_totalDropped;
+    UINT32 numBuffers = MIN( (UINT32)s_numThreadBuffers, LOG_MAX_THREADS );
+
+    // Drops the writer hasn't reported yet; a thread's last messages may never be followed by another.
+    for (UINT32 i = 0; i < numBuffers; ++i)
+    {
+        if (s_threadBuffers[i])
+        {
+            numDropped += s_threadBuffers[i]->numDropped;
+        }
+    }
+
+    return numDropped;
 }
 
 
@@ -342,15 +624,6 @@ Log::GetZoneMask()
 
 
 
-bool
-Log::IsZoneEnabled( ZONE_MASK zone )
-{
-    return (s_zoneMask & zone) == zone ? true : false;
-}
-
-
-
-
 void
 Log::EnableZone( ZONE_MASK zone )
 {
@@ -2,6 +2,13 @@
 #include "Metrics.hpp"
 #include "Log.hpp"
 #include "Macros.hpp"
+#include "PerfTimer.hpp"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+using std::vector;
 
    
 namespace Z
@@ -80,6 +87,278 @@ Metrics::Set( METRIC_ID id, void* pValue )
 }
 
 
+#pragma mark -
+#pragma mark Registry
+
+typedef vector<MetricCounter*>      MetricCounterList;
+typedef vector<MetricGauge*>        MetricGaugeList;
+typedef vector<MetricHistogram*>    MetricHistogramList;
+
+static pthread_mutex_t      s_registryMutex     = PTHREAD_MUTEX_INITIALIZER;
+
+// Constructed on first use, so metrics may be registered during static initialization.
+static MetricCounterList&   Counters()      { static MetricCounterList   s_counters;     return s_counters;   }
+static MetricGaugeList&     Gauges()        { static MetricGaugeList     s_gauges;       return s_gauges;     }
+static MetricHistogramList& Histograms()    { static MetricHistogramList s_histograms;   return s_histograms; }
+
+static string               s_snapshotFilename;
+static UINT32               s_snapshotIntervalMS    = 0;
+static PerfTimer            s_snapshotTimer;
+static PerfTimer            s_runTimer;
+
+
+
+template<typename TYPE>
+static TYPE*
+FindOrCreate( vector<TYPE*>& list, IN const char* name )
+{
+    TYPE* pMetric = NULL;
+
+    if (!name)
+    {
+        return NULL;
+    }
+
+    pthread_mutex_lock( &s_registryMutex );
+
+    for (typename vector<TYPE*>::iterator ppMetric = list.begin(); ppMetric != list.end(); ++ppMetric)
+    {
+        if ((*ppMetric)->GetName() == name)
+        {
+            pMetric = *ppMetric;
+            break;
+        }
+    }
+
+    if (!pMetric)
+    {
+        // Metrics live for the lifetime of the process, so callers may cache the pointer.
+        pMetric = new TYPE( name );
+        list.push_back( pMetric );
+    }
+
+    pthread_mutex_unlock( &s_registryMutex );
+
+    return pMetric;
+}
+
+
+
+MetricCounter*
+Metrics::RegisterCounter( IN const char* name )
+{
+    return FindOrCreate( Counters(), name );
+}
+
+
+
+MetricGauge*
+Metrics::RegisterGauge( IN const char* name )
+{
+    return FindOrCreate( Gauges(), name );
+}
+
+
+
+MetricHistogram*
+Metrics::RegisterHistogram( IN const char* name )
+{
+    return FindOrCreate( Histograms(), name );
+}
+
+
+
+RESULT
+Metrics::StartSnapshots( IN const string& filename, UINT32 intervalMS )
+{
+    RESULT rval = S_OK;
+
+    CBR(filename != "");
+    CBR(intervalMS > 0);
+
+    s_snapshotFilename      = filename;
+    s_snapshotIntervalMS    = intervalMS;
+    s_snapshotTimer.Start();
+    s_runTimer.Start();
+
+    RETAILMSG(ZONE_PERF, "Metrics: snapshot every %d ms to \"%s\"", intervalMS, filename.c_str());
+
+Exit:
+    return rval;
+}
+
+
+
+RESULT
+Metrics::Update( )
+{
+    if (!s_snapshotIntervalMS || s_snapshotTimer.ElapsedMilliseconds() < s_snapshotIntervalMS)
+    {
+        return S_OK;
+    }
+
+    s_snapshotTimer.Start();
+
+    return WriteSnapshot();
+}
+
+
+
+RESULT
+Metrics::WriteSnapshot( )
+{
+    RESULT  rval  = S_OK;
+    FILE*   pFile = NULL;
+
+    CBR(s_snapshotFilename != "");
+
+    pFile = fopen( s_snapshotFilename.c_str(), "a" );
+    if (!pFile)
+    {
+        RETAILMSG(ZONE_ERROR, "ERROR: Metrics::WriteSnapshot(): can't open \"%s\"", s_snapshotFilename.c_str());
+        rval = E_FILE_NOT_FOUND;
+        goto Exit;
+    }
+
+    pthread_mutex_lock( &s_registryMutex );
+
+    fprintf( pFile, "t=%.1f", s_runTimer.ElapsedSeconds() );
+
+    for (MetricCounterList::iterator ppCounter = Counters().begin(); ppCounter != Counters().end(); ++ppCounter)
+    {
+        MetricCounter* pCounter = *ppCounter;
+        int64_t value = pCounter->m_value;
+        fprintf( pFile, " %s=%lld", pCounter->GetName().c_str(), (long long)(value - pCounter->m_lastSnapshot) );
+        pCounter->m_lastSnapshot = value;
+    }
+
+    for (MetricGaugeList::iterator ppGauge = Gauges().begin(); ppGauge != Gauges().end(); ++ppGauge)
+    {
+        MetricGauge* pGauge = *ppGauge;
+        fprintf( pFile, " %s=%lld", pGauge->GetName().c_str(), (long long)pGauge->Get() );
+    }
+
+    for (MetricHistogramList::iterator ppHistogram = Histograms().begin(); ppHistogram != Histograms().end(); ++ppHistogram)
+    {
+        MetricHistogram* pHistogram = *ppHistogram;
+        fprintf( pFile, " %s=[n=%d p50=%.2f p95=%.2f p99=%.2f max=%.2f]",
+                pHistogram->GetName().c_str(),
+                (int)pHistogram->GetCount(),
+                pHistogram->GetPercentile( 50 ),
+                pHistogram->GetPercentile( 95 ),
+                pHistogram->GetPercentile( 99 ),
+                pHistogram->GetMax() );
+        pHistogram->Reset();
+    }
+
+    fprintf( pFile, "\n" );
+
+    pthread_mutex_unlock( &s_registryMutex );
+
+Exit:
+    if (pFile)
+    {
+        fclose( pFile );
+    }
+
+    return rval;
+}
+
+
+
+#pragma mark -
+#pragma mark MetricGauge
+
+void
+MetricGauge::Set( INT64 value )
+{
+    int64_t oldValue;
+
+    do
+    {
+        oldValue = m_value;
+    }
+    while (!OSAtomicCompareAndSwap64( oldValue, value, &m_value ));
+}
+
+
+
+#pragma mark -
+#pragma mark MetricHistogram
+
+MetricHistogram::MetricHistogram( IN const char* name ) :
+    m_name(name)
+{
+    Reset();
+}
+
+
+
+void
+MetricHistogram::Record( double milliseconds )
+{
+    int32_t microseconds = (int32_t)(milliseconds * 1000.0);
+    if (microseconds < 0)
+    {
+        microseconds = 0;
+    }
+
+    UINT32 bucket = MIN( (UINT32)microseconds / METRIC_HISTOGRAM_BUCKET_MICROSECONDS, METRIC_HISTOGRAM_BUCKETS );
+
+    OSAtomicIncrement32( &m_buckets[ bucket ] );
+    OSAtomicIncrement32( &m_count );
+    OSAtomicAdd64( microseconds, &m_sumMicroseconds );
+
+    int32_t oldMax;
+    do
+    {
+        oldMax = m_maxMicroseconds;
+    }
+    while (microseconds > oldMax && !OSAtomicCompareAndSwap32( oldMax, microseconds, &m_maxMicroseconds ));
+}
+
+
+
+void
+MetricHistogram::Reset()
+{
+    memset( (void*)m_buckets, 0, sizeof(m_buckets) );
+    m_count             = 0;
+    m_maxMicroseconds   = 0;
+    m_sumMicroseconds   = 0;
+}
+
+
+
+double
+MetricHistogram::GetPercentile( double percentile ) const
+{
+    if (!m_count)
+    {
+        return 0.0;
+    }
+
+    int32_t target  = (int32_t)((percentile / 100.0) * m_count + 0.5);
+    int32_t seen    = 0;
+
+    target = CLAMP( target, 1, (int32_t)m_count );
+
+    for (UINT32 i = 0; i < METRIC_HISTOGRAM_BUCKETS; ++i)
+    {
+        seen += m_buckets[i];
+        if (seen >= target)
+        {
+            // Report the upper edge of the bucket, but never more than the largest sample.
+            double upperMS = ((i + 1) * METRIC_HISTOGRAM_BUCKET_MICROSECONDS) / 1000.0;
+            return MIN( upperMS, GetMax() );
+        }
+    }
+
+    // Landed in the overflow bucket.
+    return GetMax();
+}
+
+
 } // END namespace Z
 
     
\ No newline at end of file
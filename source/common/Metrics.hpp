@@ -1,6 +1,11 @@
 #pragma once
 
 #include "Types.hpp"
+#include "Errors.hpp"
+
+#include <libkern/OSAtomic.h>
+#include <string>
+using std::string;
 
 namespace Z
 {
@@ -44,11 +49,98 @@ typedef struct
 } Metric;
 
 
+
+//
+// Named, typed metrics that subsystems register at runtime.
+//
+// Registration takes a lock and is meant to happen once (in a constructor, or via a
+// function-local static).  Sampling is a single relaxed atomic op, safe from any thread.
+//
+// Metrics::Update() appends a line to the snapshot file every N ms:
+//  - Counters report the change since the previous snapshot.
+//  - Gauges report their current value.
+//  - Histograms report p50/p95/p99/max for the interval, and are then cleared.
+//
+
+class MetricCounter
+{
+public:
+    MetricCounter( IN const char* name ) : m_name(name), m_value(0), m_lastSnapshot(0)  {}
+
+    void            Increment   ( )             { OSAtomicAdd64( 1, &m_value );     }
+    void            Add         ( INT64 n )     { OSAtomicAdd64( n, &m_value );     }
+    INT64           Get         ( ) const       { return m_value;                   }
+    const string&   GetName     ( ) const       { return m_name;                    }
+
+protected:
+    friend class Metrics;
+
+    string              m_name;
+    volatile int64_t    m_value         __attribute__((aligned(8)));
+    int64_t             m_lastSnapshot;
+};
+
+
+
+class MetricGauge
+{
+public:
+    MetricGauge( IN const char* name ) : m_name(name), m_value(0)  {}
+
+    void            Set         ( INT64 value );
+    void            Add         ( INT64 delta ) { OSAtomicAdd64( delta, &m_value ); }
+    INT64           Get         ( ) const       { return m_value;                   }
+    const string&   GetName     ( ) const       { return m_name;                    }
+
+protected:
+    string              m_name;
+    volatile int64_t    m_value         __attribute__((aligned(8)));
+};
+
+
+
+// Fixed 0.25 ms buckets up to 32 ms; anything slower lands in the overflow bucket.
+#define METRIC_HISTOGRAM_BUCKETS            128
+#define METRIC_HISTOGRAM_BUCKET_MICROSECONDS 250
+
+class MetricHistogram
+{
+public:
+    MetricHistogram( IN const char* name );
+
+    void            Record          ( double milliseconds );
+    void            Reset           ( );
+
+    UINT32          GetCount        ( ) const   { return m_count; }
+    double          GetPercentile   ( double percentile ) const;     // 0..100, in ms
+    double          GetMax          ( ) const   { return m_maxMicroseconds / 1000.0; }
+    double          GetMean         ( ) const   { return m_count ? (m_sumMicroseconds / 1000.0) / m_count : 0.0; }
+    const string&   GetName         ( ) const   { return m_name; }
+
+protected:
+    string              m_name;
+    volatile int32_t    m_buckets[ METRIC_HISTOGRAM_BUCKETS + 1 ];
+    volatile int32_t    m_count;
+    volatile int32_t    m_maxMicroseconds;
+    volatile int64_t    m_sumMicroseconds __attribute__((aligned(8)));
+};
+
+
+
 class Metrics
 {
 public:
     static void* Get( METRIC_ID id );    
     static void  Set( METRIC_ID id, void* pValue );
+
+    // Returns the existing metric if one with the same name was already registered.
+    static MetricCounter*   RegisterCounter     ( IN const char* name );
+    static MetricGauge*     RegisterGauge       ( IN const char* name );
+    static MetricHistogram* RegisterHistogram   ( IN const char* name );
+
+    static RESULT           StartSnapshots      ( IN const string& filename, UINT32 intervalMS );
+    static RESULT           Update              ( );
+    static RESULT           WriteSnapshot       ( );
     
 protected:
     Metrics();
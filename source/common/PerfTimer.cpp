@@ -7,8 +7,8 @@
  *
  *
  *  This class implements a high-resolution performance timer.
- *  The class is so small that we call MACH directly, rather
- *  than going through the Platform:: abstraction layer.
+ *  It shares the Profiler's tick source (mach_absolute_time on
+ *  Apple platforms, CLOCK_MONOTONIC elsewhere).
  *
  *  Resolution is dependent on the underlying hardware/OS.
  */
@@ -16,6 +16,7 @@
 
 
 #include "PerfTimer.hpp"
+#include "Profiler.hpp"
 
 
 namespace Z
@@ -26,8 +27,6 @@ PerfTimer::PerfTimer() :
     m_startTick(0),
     m_stopTick(0)
 {
-    // Save information about the high-resolution timer (e.g. ticks per millisecond)
-    mach_timebase_info( &m_machTimebaseInfo );
 }
 
 
@@ -41,7 +40,7 @@ PerfTimer::~PerfTimer()
 void
 PerfTimer::Start()
 {
-    m_startTick = mach_absolute_time();
+    m_startTick = Profiler::GetTicks();
     m_stopTick  = 0;
 }
 
@@ -50,7 +49,7 @@ PerfTimer::Start()
 void    
 PerfTimer::Stop()
 {
-    m_stopTick = mach_absolute_time();
+    m_stopTick = Profiler::GetTicks();
 }
 
 
@@ -66,10 +65,10 @@ PerfTimer::ElapsedSeconds()
     }
     else
     {
-        elapsedTicks = mach_absolute_time() - m_startTick;
+        elapsedTicks = Profiler::GetTicks() - m_startTick;
     }
     
-    double seconds = elapsedTicks * (((double)m_machTimebaseInfo.numer/(double)m_machTimebaseInfo.denom) / 1000000000.0);
+    double seconds = Profiler::TicksToMicroseconds( (UINT64)elapsedTicks ) / 1000000.0;
     
     return seconds;
 }
@@ -86,10 +85,10 @@ PerfTimer::ElapsedMilliseconds()
     }
     else
     {
-        elapsedTicks = mach_absolute_time() - m_startTick;
+        elapsedTicks = Profiler::GetTicks() - m_startTick;
     }
     
-    double milliseconds = elapsedTicks * (((double)m_machTimebaseInfo.numer/(double)m_machTimebaseInfo.denom) / 1000000.0);
+    double milliseconds = Profiler::TicksToMicroseconds( (UINT64)elapsedTicks ) / 1000.0;
     
     return milliseconds;
 }
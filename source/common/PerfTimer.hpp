@@ -1,6 +1,5 @@
 #pragma once
 
-#include <mach/mach_time.h>
 #include "Types.hpp"
 
 
@@ -20,9 +19,8 @@ public:
     double  ElapsedMilliseconds();
     
 protected:
-    mach_timebase_info_data_t   m_machTimebaseInfo;
-    uint64_t                    m_startTick;
-    uint64_t                    m_stopTick;
+    UINT64                      m_startTick;
+    UINT64                      m_stopTick;
 };
 
 
@@ -0,0 +1,358 @@
+/*
+ *  Profiler.cpp
+ *  Critters
+ *
+ *  Hierarchical scoped CPU profiler.
+ *
+ *  Each thread that hits a PROFILE_SCOPE() lazily claims a ring buffer of
+ *  PROFILER_EVENTS_PER_THREAD events.  Only the owning thread ever writes its
+ *  buffer; the write index is published after a memory barrier, so the exporter
+ *  can read it from any thread without a lock.  The oldest events are overwritten
+ *  when a buffer wraps.
+ *
+ *  Buffers are never freed, so events from worker threads that have exited can
+ *  still be exported.
+ */
+
+#include "Profiler.hpp"
+#include "Log.hpp"
+#include "Macros.hpp"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+
+
+namespace Z
+{
+
+
+
+#define PROFILER_MAX_THREADS            16
+#define PROFILER_EVENTS_PER_THREAD      16384       // Must be a power of two.
+#define PROFILER_EVENT_MASK             (PROFILER_EVENTS_PER_THREAD - 1)
+
+
+struct ProfileThreadBuffer
+{
+    ProfileEvent*       pEvents;        // NULL for the overflow buffer.
+    volatile UINT32     head;           // Total events ever written; written only by the owning thread.
+    volatile UINT32     resetMark;      // Value of head at the last Reset().
+    UINT32              depth;
+    UINT32              threadIndex;
+    char                name[32];
+};
+
+
+
+//
+// Static Data
+//
+bool                    Profiler::s_isEnabled                   = false;
+UINT32                  Profiler::s_captureFramesRemaining      = 0;
+string                  Profiler::s_captureFilename;
+
+static ProfileThreadBuffer*     s_threadBuffers[ PROFILER_MAX_THREADS ];
+static volatile int32_t         s_numThreadBuffers              = 0;
+static ProfileThreadBuffer      s_overflowBuffer;
+static pthread_key_t            s_threadBufferKey;
+static pthread_once_t           s_threadBufferKeyOnce           = PTHREAD_ONCE_INIT;
+static UINT64                   s_baseTick                      = 0;
+
+
+
+static void
+CreateThreadBufferKey()
+{
+    pthread_key_create( &s_threadBufferKey, NULL );
+}
+
+
+
+static ProfileThreadBuffer*
+GetThreadBuffer()
+{
+    pthread_once( &s_threadBufferKeyOnce, CreateThreadBufferKey );
+
+    ProfileThreadBuffer* pBuffer = (ProfileThreadBuffer*)pthread_getspecific( s_threadBufferKey );
+    if (pBuffer)
+    {
+        return pBuffer;
+    }
+
+    int32_t index = OSAtomicIncrement32Barrier( &s_numThreadBuffers ) - 1;
+    if (index >= PROFILER_MAX_THREADS)
+    {
+        // Too many threads; this one's events are dropped.
+        pBuffer = &s_overflowBuffer;
+    }
+    else
+    {
+        pBuffer = new ProfileThreadBuffer;
+        memset( pBuffer, 0, sizeof(ProfileThreadBuffer) );
+        pBuffer->pEvents     = new ProfileEvent[ PROFILER_EVENTS_PER_THREAD ];
+        pBuffer->threadIndex = index;
+        snprintf( pBuffer->name, sizeof(pBuffer->name), index ? "Thread %d" : "Main", (int)index );
+
+        OSMemoryBarrier();
+        s_threadBuffers[ index ] = pBuffer;
+    }
+
+    pthread_setspecific( s_threadBufferKey, pBuffer );
+
+    return pBuffer;
+}
+
+
+
+void
+Profiler::Enable( bool enabled )
+{
+    if (enabled && !s_baseTick)
+    {
+        s_baseTick = GetTicks();
+    }
+
+    s_isEnabled = enabled;
+
+    RETAILMSG(ZONE_PERF, "Profiler %s", enabled ? "enabled" : "disabled");
+}
+
+
+
+RESULT
+Profiler::Capture( UINT32 numFrames, IN const string& filename )
+{
+    RESULT rval = S_OK;
+
+    CBR(numFrames > 0);
+    CBR(filename != "");
+
+    s_captureFilename           = filename;
+    s_captureFramesRemaining    = numFrames;
+
+    Reset();
+    Enable( true );
+
+Exit:
+    return rval;
+}
+
+
+
+void
+Profiler::EndFrame()
+{
+    if (!s_captureFramesRemaining)
+    {
+        return;
+    }
+
+    if (--s_captureFramesRemaining == 0)
+    {
+        Enable( false );
+        IGNOREHR(ExportChromeTrace( s_captureFilename ));
+    }
+}
+
+
+
+UINT32
+Profiler::BeginScope()
+{
+    ProfileThreadBuffer* pBuffer = GetThreadBuffer();
+
+    return pBuffer->depth++;
+}
+
+
+
+void
+Profiler::EndScope( IN const char* name, UINT64 startTick, UINT32 depth )
+{
+    UINT64 endTick = GetTicks();
+
+    ProfileThreadBuffer* pBuffer = GetThreadBuffer();
+
+    pBuffer->depth = depth;
+
+    if (!pBuffer->pEvents)
+    {
+        return;
+    }
+
+    ProfileEvent* pEvent = &pBuffer->pEvents[ pBuffer->head & PROFILER_EVENT_MASK ];
+    pEvent->name        = name;
+    pEvent->startTick   = startTick;
+    pEvent->endTick     = endTick;
+    pEvent->depth       = depth;
+
+    // Publish the event before advancing the write index.
+    OSMemoryBarrier();
+    pBuffer->head = pBuffer->head + 1;
+}
+
+
+
+void
+Profiler::SetThreadName( IN const char* name )
+{
+    ProfileThreadBuffer* pBuffer = GetThreadBuffer();
+
+    if (name && pBuffer->pEvents)
+    {
+        strncpy( pBuffer->name, name, sizeof(pBuffer->name) - 1 );
+    }
+}
+
+
+
+void
+Profiler::Reset()
+{
+    UINT32 numBuffers = MIN( (UINT32)s_numThreadBuffers, PROFILER_MAX_THREADS );
+
+    for (UINT32 i = 0; i < numBuffers; ++i)
+    {
+        ProfileThreadBuffer* pBuffer = s_threadBuffers[i];
+        if (pBuffer)
+        {
+            pBuffer->resetMark = pBuffer->head;
+        }
+    }
+
+    s_baseTick = GetTicks();
+}
+
+
+
+UINT32
+Profiler::GetNumEvents()
+{
+    UINT32 numEvents  = 0;
+    UINT32 numBuffers = MIN( (UINT32)s_numThreadBuffers, PROFILER_MAX_THREADS );
+
+    for (UINT32 i = 0; i < numBuffers; ++i)
+    {
+        ProfileThreadBuffer* pBuffer = s_threadBuffers[i];
+        if (pBuffer)
+        {
+            numEvents += MIN( pBuffer->head - pBuffer->resetMark, PROFILER_EVENTS_PER_THREAD );
+        }
+    }
+
+    return numEvents;
+}
+
+
+
+double
+Profiler::TicksToMicroseconds( UINT64 ticks )
+{
+#if defined(__APPLE__)
+    static mach_timebase_info_data_t timebaseInfo;
+    if (!timebaseInfo.denom)
+    {
+        mach_timebase_info( &timebaseInfo );
+    }
+
+    return (double)ticks * ((double)timebaseInfo.numer / (double)timebaseInfo.denom) / 1000.0;
+#else
+    return (double)ticks / 1000.0;
+#endif
+}
+
+
+
+static void
+WriteJSONString( FILE* pFile, const char* str )
+{
+    fputc( '"', pFile );
+    for (const char* p = str; p && *p; ++p)
+    {
+        if (*p == '"' || *p == '\\')
+        {
+            fputc( '\\', pFile );
+        }
+        fputc( *p, pFile );
+    }
+    fputc( '"', pFile );
+}
+
+
+
+RESULT
+Profiler::ExportChromeTrace( IN const string& filename )
+{
+    RESULT  rval        = S_OK;
+    FILE*   pFile       = NULL;
+    bool    first       = true;
+    UINT32  numEvents   = 0;
+    UINT32  numBuffers  = MIN( (UINT32)s_numThreadBuffers, PROFILER_MAX_THREADS );
+
+    pFile = fopen( filename.c_str(), "w" );
+    if (!pFile)
+    {
+        RETAILMSG(ZONE_ERROR, "ERROR: Profiler::ExportChromeTrace(): can't open \"%s\"", filename.c_str());
+        rval = E_FILE_NOT_FOUND;
+        goto Exit;
+    }
+
+    fprintf( pFile, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n" );
+
+    for (UINT32 i = 0; i < numBuffers; ++i)
+    {
+        ProfileThreadBuffer* pBuffer = s_threadBuffers[i];
+        if (!pBuffer)
+        {
+            continue;
+        }
+
+        fprintf( pFile, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":",
+                first ? "" : ",\n", (unsigned)pBuffer->threadIndex );
+        WriteJSONString( pFile, pBuffer->name );
+        fprintf( pFile, "}}" );
+        first = false;
+
+        // Snapshot the write index; anything older than one buffer's worth has been overwritten.
+        UINT32 head  = pBuffer->head;
+        OSMemoryBarrier();
+        UINT32 count = MIN( head - pBuffer->resetMark, PROFILER_EVENTS_PER_THREAD );
+
+        for (UINT32 n = head - count; n != head; ++n)
+        {
+            const ProfileEvent& event = pBuffer->pEvents[ n & PROFILER_EVENT_MASK ];
+
+            // Events recorded before the last Reset() have no meaning on this timeline.
+            if (event.startTick < s_baseTick)
+            {
+                continue;
+            }
+
+            fprintf( pFile, ",\n{\"name\":" );
+            WriteJSONString( pFile, event.name );
+            fprintf( pFile, ",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"depth\":%u}}",
+                    (unsigned)pBuffer->threadIndex,
+                    TicksToMicroseconds( event.startTick - s_baseTick ),
+                    TicksToMicroseconds( event.endTick   - event.startTick ),
+                    (unsigned)event.depth );
+            numEvents++;
+        }
+    }
+
+    fprintf( pFile, "\n]}\n" );
+
+    RETAILMSG(ZONE_PERF, "Profiler: wrote %d events from %d thread(s) to \"%s\"", numEvents, numBuffers, filename.c_str());
+
+Exit:
+    if (pFile)
+    {
+        fclose( pFile );
+    }
+
+    return rval;
+}
+
+
+
+} // END namespace Z
@@ -0,0 +1,148 @@
+#pragma once
+
+#include "Types.hpp"
+#include "Errors.hpp"
+
+#include <string>
+using std::string;
+
+#if defined(__APPLE__)
+#include <mach/mach_time.h>
+#else
+#include <time.h>
+#endif
+
+
+//
+// Hierarchical CPU profiler.
+//
+// Drop PROFILE_SCOPE("name") at the top of a block (before the first CHR/goto),
+// or PROFILE_FUNCTION() at the top of a function.  Each scope records one event
+// with its start/end ticks and nesting depth into a ring buffer owned by the
+// calling thread, so markers never take a lock.
+//
+// Profiler::ExportChromeTrace() writes the buffered events in Chrome's
+// trace-event JSON format; load the file in chrome://tracing or ui.perfetto.dev.
+//
+// Comment out ENABLE_PROFILER to compile every marker away.  When compiled in
+// but not Enable()'d, a marker costs one load and one branch.
+//
+
+#ifndef SHIPBUILD
+#define ENABLE_PROFILER
+#endif
+
+
+namespace Z
+{
+
+
+
+struct ProfileEvent
+{
+    const char* name;           // Must be a string literal (or otherwise outlive the trace).
+    UINT64      startTick;
+    UINT64      endTick;
+    UINT32      depth;
+};
+
+
+
+class Profiler
+{
+public:
+    static  void    Enable              ( bool enabled );
+    static  bool    IsEnabled           ( )     { return s_isEnabled; }
+
+    // After numFrames calls to EndFrame(), export to filename and disable.
+    static  RESULT  Capture             ( UINT32 numFrames, IN const string& filename );
+    static  void    EndFrame            ( );
+
+    static  RESULT  ExportChromeTrace   ( IN const string& filename );
+    static  void    Reset               ( );
+    static  UINT32  GetNumEvents        ( );
+    static  void    SetThreadName       ( IN const char* name );
+
+    static  inline UINT64 GetTicks      ( )
+    {
+#if defined(__APPLE__)
+        return mach_absolute_time();
+#else
+        struct timespec ts;
+        clock_gettime( CLOCK_MONOTONIC, &ts );
+        return (UINT64)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+#endif
+    }
+
+    static  double  TicksToMicroseconds ( UINT64 ticks );
+
+
+    // Used by ProfileScope; call PROFILE_SCOPE() instead.
+    static  UINT32  BeginScope          ( );
+    static  void    EndScope            ( IN const char* name, UINT64 startTick, UINT32 depth );
+
+protected:
+    static  bool    s_isEnabled;
+    static  UINT32  s_captureFramesRemaining;
+    static  string  s_captureFilename;
+
+protected:
+    Profiler();
+    Profiler(const Profiler& rhs);
+    Profiler& operator=(const Profiler& rhs);
+    virtual ~Profiler();
+};
+
+
+
+class ProfileScope
+{
+public:
+    explicit ProfileScope( const char* name ) :
+        m_name(name),
+        m_active(Profiler::IsEnabled())
+    {
+        if (m_active)
+        {
+            m_depth     = Profiler::BeginScope();
+            m_startTick = Profiler::GetTicks();
+        }
+    }
+
+    ~ProfileScope()
+    {
+        if (m_active)
+        {
+            Profiler::EndScope( m_name, m_startTick, m_depth );
+        }
+    }
+
+protected:
+    const char* m_name;
+    bool        m_active;
+    UINT32      m_depth;
+    UINT64      m_startTick;
+
+private:
+    ProfileScope(const ProfileScope& rhs);
+    ProfileScope& operator=(const ProfileScope& rhs);
+};
+
+
+
+#define PROFILE_CONCAT_INNER(a, b)  a##b
+#define PROFILE_CONCAT(a, b)        PROFILE_CONCAT_INNER(a, b)
+
+#ifdef ENABLE_PROFILER
+    #define PROFILE_SCOPE(name)     Z::ProfileScope PROFILE_CONCAT(_profileScope, __LINE__)( name )
+    #define PROFILE_FUNCTION()      PROFILE_SCOPE( __PRETTY_FUNCTION__ )
+    #define PROFILE_END_FRAME()     Z::Profiler::EndFrame()
+#else
+    #define PROFILE_SCOPE(name)
+    #define PROFILE_FUNCTION()
+    #define PROFILE_END_FRAME()
+#endif
+
+
+
+} // END namespace Z
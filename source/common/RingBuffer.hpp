@@ -0,0 +1,93 @@
+#pragma once
+
+#include "Types.hpp"
+#include "Macros.hpp"
+
+#include <libkern/OSAtomic.h>
+
+
+namespace Z
+{
+
+
+//
+// Fixed-size, single-producer / single-consumer queue.
+//
+// One thread Push()es, one other thread Pop()s, and neither ever blocks or takes a
+// lock: the producer only writes m_tail, the consumer only writes m_head, and each
+// publishes its slot with a barrier before moving its index.  The indices run
+// freely and wrap; SIZE must be a power of two.
+//
+// Push() returns false when the queue is full; the caller decides whether to drop
+// or retry.
+//
+
+template <typename T, UINT32 SIZE>
+class RingBuffer
+{
+public:
+    RingBuffer() :
+        m_head(0),
+        m_tail(0)
+    {
+        DEBUGCHK(SIZE && 0 == (SIZE & (SIZE - 1)));
+    }
+
+    // Producer only.
+    bool    Push        ( IN const T& item )
+    {
+        UINT32 tail = m_tail;
+
+        if (tail - m_head == SIZE)
+        {
+            return false;
+        }
+
+        m_items[ tail & (SIZE - 1) ] = item;
+
+        // The item, then the index that hands it over.
+        OSMemoryBarrier();
+        m_tail = tail + 1;
+
+        return true;
+    }
+
+    // Consumer only.
+    bool    Pop         ( OUT T* pItem )
+    {
+        UINT32 head = m_head;
+
+        if (head == m_tail)
+        {
+            return false;
+        }
+
+        // The index, then the item it handed over.
+        OSMemoryBarrier();
+        *pItem = m_items[ head & (SIZE - 1) ];
+
+        // Done with the slot before the producer may reuse it.
+        OSMemoryBarrier();
+        m_head = head + 1;
+
+        return true;
+    }
+
+    // A snapshot; exact only on the consumer with the producer idle.
+    UINT32  GetCount    ( ) const   { return m_tail - m_head; }
+    bool    IsEmpty     ( ) const   { return m_tail == m_head; }
+
+protected:
+    volatile UINT32     m_head;
+    BYTE                m_pad[ 64 - sizeof(UINT32) ];  // Keep the two indices off one cache line.
+    volatile UINT32     m_tail;
+    T                   m_items[ SIZE ];
+
+private:
+    RingBuffer( const RingBuffer& rhs );
+    RingBuffer& operator=( const RingBuffer& rhs );
+};
+
+
+
+} // END namespace Z
@@ -1,4 +1,5 @@
 #include "Time.hpp"
+#include "Macros.hpp"
 
 namespace Z
 {
@@ -25,7 +26,10 @@ Time::Time() :
     m_speed(1.0),
     m_startTime(0),
     m_currentTime(0),
-    m_previousTime(0)
+    m_previousTime(0),
+    m_fixedStepMS(0.0),
+    m_stepTime(0.0),
+    m_accumulatedMS(0.0)
 {
     m_previousTime = m_startTime = Platform::GetTickCount();
     m_currentTime  = 0;
@@ -54,6 +58,11 @@ Time::Resume()
 UINT64 
 Time::GetTime()
 {
+    if (m_fixedStepMS)
+    {
+        return (UINT64)m_stepTime;
+    }
+
     if (m_isPaused)
     {
         return m_currentTime * m_speed;
@@ -95,5 +104,129 @@ Time::GetSpeed( )
 
 
 
+void
+Time::SetFixedStep( double stepMS )
+{
+    if (stepMS == m_fixedStepMS)
+    {
+        return;
+    }
+
+    if (!m_fixedStepMS)
+    {
+        // Carry on from wherever the wall clock had got to.
+        m_stepTime      = (double)GetTime();
+        m_accumulatedMS = 0.0;
+    }
+    else if (!stepMS && m_speed > 0.0)
+    {
+        // And back.
+        m_currentTime   = (UINT64)(m_stepTime / m_speed);
+        m_previousTime  = Platform::GetTickCount();
+    }
+
+    m_fixedStepMS = stepMS;
+}
+
+
+
+UINT32
+Time::Accumulate()
+{
+    UINT64 current = Platform::GetTickCount();
+    UINT64 elapsed = current - m_previousTime;
+
+    m_previousTime = current;
+
+    return Accumulate( elapsed );
+}
+
+
+
+UINT32
+Time::Accumulate( UINT64 elapsedMS )
+{
+    if (!m_fixedStepMS)
+    {
+        return 0;
+    }
+
+    if (!m_isPaused)
+    {
+        m_accumulatedMS += elapsedMS * m_speed;
+    }
+
+    return (UINT32)(m_accumulatedMS / m_fixedStepMS);
+}
+
+
+
+void
+Time::Step()
+{
+    DEBUGCHK(m_fixedStepMS);
+
+    m_stepTime      += m_fixedStepMS;
+    m_accumulatedMS -= m_fixedStepMS;
+
+    if (m_accumulatedMS < 0.0)
+    {
+        m_accumulatedMS = 0.0;
+    }
+}
+
+
+
+UINT32
+Time::DropSteps( UINT32 maxSteps )
+{
+    if (!m_fixedStepMS)
+    {
+        return 0;
+    }
+
+    UINT32 owed = (UINT32)(m_accumulatedMS / m_fixedStepMS);
+
+    if (owed <= maxSteps)
+    {
+        return 0;
+    }
+
+    // The game runs slow for a frame, rather than spiralling.
+    m_accumulatedMS -= (owed - maxSteps) * m_fixedStepMS;
+
+    return owed - maxSteps;
+}
+
+
+
+float
+Time::GetAlpha()
+{
+    if (!m_fixedStepMS)
+    {
+        return 1.0f;
+    }
+
+    double alpha = m_accumulatedMS / m_fixedStepMS;
+
+    return alpha < 1.0 ? (float)alpha : 1.0f;
+}
+
+
+
+double
+Time::GetDrawTimeDouble()
+{
+    if (!m_fixedStepMS)
+    {
+        return GetTimeDouble();
+    }
+
+    return (m_stepTime + GetAlpha() * m_fixedStepMS) / 1000.0;
+}
+
+
+
 
 } // END namespace Z
@@ -7,6 +7,17 @@ namespace Z
 {
 
 
+//
+// Game time, in milliseconds since start.
+//
+// By default GetTime() follows the wall clock, scaled by SetSpeed() and stopped while
+// paused.  With a fixed step, it only moves when Step() is called: the caller feeds
+// wall-clock time in with Accumulate() and takes as many whole steps as it owes, so
+// every GetTime() caller (GameObjects, StateMachines, messages, Animations) sees the
+// same, evenly spaced times.  GetAlpha() is how far the wall clock has run past the
+// last step, for drawing in between the last two.
+//
+
 class Time
 {
 public:
@@ -21,6 +32,15 @@ public:
     double  GetTimeDouble ( );                  // Return time in seconds since start.
     void    SetSpeed      ( double speed );
     double  GetSpeed      ( );
+
+    void    SetFixedStep  ( double stepMS );    // 0 to follow the wall clock again.  Fractional, e.g. 1000.0 / 30.
+    double  GetFixedStep  ( )                   { return m_fixedStepMS; }
+    UINT32  Accumulate    ( );                  // Add the wall-clock time since the last call; return the number of steps owed.
+    UINT32  Accumulate    ( UINT64 elapsedMS );
+    void    Step          ( );                  // Advance GetTime() by one step.
+    UINT32  DropSteps     ( UINT32 maxSteps );  // Forget all but maxSteps of those owed; return how many were dropped.
+    float   GetAlpha      ( );                  // 0..1 of a step owed past GetTime(); 1 without a fixed step.
+    double  GetDrawTimeDouble ( );              // GetTimeDouble() plus the part-step owed, for drawing.
     
 protected:
     bool    m_isPaused;
@@ -28,6 +48,9 @@ protected:
     UINT64  m_startTime;
     UINT64  m_currentTime;
     UINT64  m_previousTime;
+    double  m_fixedStepMS;
+    double  m_stepTime;                         // Milliseconds; fractional, so a 33.3 ms step doesn't drift.
+    double  m_accumulatedMS;
     
 protected:
     static  Time*   s_pGlobalTime;
@@ -0,0 +1,435 @@
+/*
+ *  Transforms.cpp
+ *  Critters
+ *
+ *  Cached local and world matrices for the scene.
+ *
+ */
+
+#include "Transforms.hpp"
+#include "Metrics.hpp"
+#include "Macros.hpp"
+#include "Log.hpp"
+
+#include <math.h>
+#include <string.h>
+
+
+namespace Z
+{
+
+
+
+//
+// Static Data
+//
+bool                            Transforms::s_isEnabled         = false;
+bool                            Transforms::s_isInterpolating   = false;
+float                           Transforms::s_alpha             = 1.0f;
+
+vector<Transforms::LocalTRS>    Transforms::s_locals;
+vector<Transforms::LocalTRS>    Transforms::s_previousLocals;
+vector<mat4>                    Transforms::s_localMatrices;
+vector<mat4>                    Transforms::s_parentWorlds;
+vector<mat4>                    Transforms::s_worldMatrices;
+vector<BYTE>                    Transforms::s_flags;
+vector<TransformID>             Transforms::s_freeList;
+vector<TransformID>             Transforms::s_moved;
+vector<TransformID>             Transforms::s_workerMoved[ JOB_MAX_WORKERS + 1 ];
+
+
+
+//
+// Class Methods
+//
+void
+Transforms::Enable( bool enabled )
+{
+    s_isEnabled = enabled;
+
+    // Nothing cached under the other setting can be trusted.
+    for (UINT32 id = 0; id < s_flags.size(); ++id)
+    {
+        if (s_flags[id] & TRANSFORM_IN_USE)
+        {
+            s_flags[id] |=  TRANSFORM_LOCAL_DIRTY;
+            s_flags[id] &= ~TRANSFORM_WORLD_VALID;
+        }
+    }
+}
+
+
+
+TransformID
+Transforms::Create()
+{
+    static MetricGauge* s_pNodesMetric = Metrics::RegisterGauge( "Transforms.Nodes" );
+
+    TransformID id;
+    LocalTRS    trs;
+
+    trs.position = vec3(0,0,0);
+    trs.rotation = vec3(0,0,0);
+    trs.pivot    = vec3(0,0,0);
+    trs.scale    = 1.0f;
+
+    if (!s_freeList.empty())
+    {
+        id = s_freeList.back();
+        s_freeList.pop_back();
+
+        s_locals        [id] = trs;
+        s_previousLocals[id] = trs;
+        s_localMatrices [id] = mat4::Identity();
+        s_worldMatrices [id] = mat4::Identity();
+    }
+    else
+    {
+        id = (TransformID)s_flags.size();
+
+        s_locals.push_back        ( trs );
+        s_previousLocals.push_back( trs );
+        s_localMatrices.push_back ( mat4::Identity() );
+        s_parentWorlds.push_back  ( mat4::Identity() );
+        s_worldMatrices.push_back ( mat4::Identity() );
+        s_flags.push_back         ( 0 );
+    }
+
+    s_flags[id] = TRANSFORM_IN_USE | TRANSFORM_LOCAL_DIRTY;
+
+    if (s_isInterpolating)
+    {
+        s_flags[id] |= TRANSFORM_MOVED | TRANSFORM_NEW;
+        s_moved.push_back( id );
+    }
+    s_pNodesMetric->Set( GetNumNodes() );
+
+    return id;
+}
+
+
+
+void
+Transforms::Destroy( TransformID id )
+{
+    static MetricGauge* s_pNodesMetric = Metrics::RegisterGauge( "Transforms.Nodes" );
+
+    if (TRANSFORM_NONE == id)
+    {
+        return;
+    }
+
+    DEBUGCHK(id < s_flags.size() && (s_flags[id] & TRANSFORM_IN_USE));
+
+    s_flags[id] = 0;
+    s_freeList.push_back( id );
+    s_pNodesMetric->Set( GetNumNodes() );
+}
+
+
+
+void
+Transforms::SetLocal( TransformID id, IN const vec3& position, IN const vec3& rotation, float scale, IN const vec3& pivot )
+{
+    DEBUGCHK(id < s_flags.size() && (s_flags[id] & TRANSFORM_IN_USE));
+
+    LocalTRS& trs = s_locals[id];
+
+    if (trs.position == position &&
+        trs.rotation == rotation &&
+        trs.pivot    == pivot    &&
+        trs.scale    == scale)
+    {
+        return;
+    }
+
+    trs.position = position;
+    trs.rotation = rotation;
+    trs.pivot    = pivot;
+    trs.scale    = scale;
+
+    s_flags[id] |= TRANSFORM_LOCAL_DIRTY;
+
+    if (!s_isInterpolating)
+    {
+        return;
+    }
+
+    if (s_flags[id] & TRANSFORM_NEW)
+    {
+        // Don't slide in from wherever it was created.
+        s_previousLocals[id] = trs;
+    }
+    else if (!(s_flags[id] & TRANSFORM_MOVED))
+    {
+        UINT32 threadIndex = JobSystem::GetThreadIndex();
+
+        s_flags[id] |= TRANSFORM_MOVED;
+
+        // Nodes belong to one GameObject, so only the list needs keeping apart.
+        if (threadIndex)
+        {
+            s_workerMoved[ threadIndex ].push_back( id );
+        }
+        else
+        {
+            s_moved.push_back( id );
+        }
+    }
+}
+
+
+
+const mat4&
+Transforms::GetLocal( TransformID id )
+{
+    static MetricCounter* s_pLocalsBuiltMetric  = Metrics::RegisterCounter( "Transforms.LocalsBuilt"  );
+    static MetricCounter* s_pInterpolatedMetric = Metrics::RegisterCounter( "Transforms.Interpolated" );
+
+    DEBUGCHK(id < s_flags.size() && (s_flags[id] & TRANSFORM_IN_USE));
+
+    if (!s_isEnabled || (s_flags[id] & TRANSFORM_LOCAL_DIRTY))
+    {
+        const LocalTRS& trs = s_locals[id];
+
+        if ((s_flags[id] & TRANSFORM_MOVED) && s_alpha < 1.0f)
+        {
+            const LocalTRS& prev = s_previousLocals[id];
+
+            Compose( prev.position + (trs.position - prev.position) * s_alpha,
+                     prev.rotation + (trs.rotation - prev.rotation) * s_alpha,
+                     prev.scale    + (trs.scale    - prev.scale   ) * s_alpha,
+                     prev.pivot    + (trs.pivot    - prev.pivot   ) * s_alpha,
+                     &s_localMatrices[id] );
+
+            s_pInterpolatedMetric->Increment();
+        }
+        else
+        {
+            Compose( trs.position, trs.rotation, trs.scale, trs.pivot, &s_localMatrices[id] );
+        }
+
+        s_flags[id] &= ~(TRANSFORM_LOCAL_DIRTY | TRANSFORM_WORLD_VALID);
+        s_pLocalsBuiltMetric->Increment();
+    }
+
+    return s_localMatrices[id];
+}
+
+
+
+const mat4&
+Transforms::GetWorld( TransformID id, IN const mat4& matParentWorld )
+{
+    static MetricCounter* s_pWorldHitsMetric = Metrics::RegisterCounter( "Transforms.WorldHits" );
+
+    const mat4& local = GetLocal( id );
+
+    if ((s_flags[id] & TRANSFORM_WORLD_VALID) &&
+        !memcmp( s_parentWorlds[id].Pointer(), matParentWorld.Pointer(), sizeof(float) * 16 ))
+    {
+        s_pWorldHitsMetric->Increment();
+        return s_worldMatrices[id];
+    }
+
+    Multiply( local, matParentWorld, &s_worldMatrices[id] );
+
+    if (s_isEnabled)
+    {
+        s_parentWorlds[id]  = matParentWorld;
+        s_flags[id]        |= TRANSFORM_WORLD_VALID;
+    }
+
+    return s_worldMatrices[id];
+}
+
+
+
+void
+Transforms::EnableInterpolation( bool enabled )
+{
+    if (!enabled)
+    {
+        // Everything where it is now.
+        BeginStep();
+        SetInterpolation( 1.0f );
+    }
+
+    s_isInterpolating = enabled;
+}
+
+
+
+void
+Transforms::BeginStep()
+{
+    // What moved during the last step starts this one where it ended up.
+    for (UINT32 i = 0; i < s_moved.size(); ++i)
+    {
+        TransformID id = s_moved[i];
+
+        if (!(s_flags[id] & TRANSFORM_MOVED))
+        {
+            continue;
+        }
+
+        s_previousLocals[id]  = s_locals[id];
+        s_flags[id]          &= ~(TRANSFORM_MOVED | TRANSFORM_NEW);
+
+        if (s_alpha < 1.0f)
+        {
+            s_flags[id] |= TRANSFORM_LOCAL_DIRTY;
+        }
+    }
+
+    s_moved.clear();
+}
+
+
+
+void
+Transforms::SetInterpolation( float alpha )
+{
+    static MetricGauge* s_pMovedMetric = Metrics::RegisterGauge( "Transforms.Moved" );
+
+    alpha = MIN(MAX(alpha, 0.0f), 1.0f);
+
+    if (alpha != s_alpha)
+    {
+        for (UINT32 i = 0; i < s_moved.size(); ++i)
+        {
+            TransformID id = s_moved[i];
+
+            if (s_flags[id] & TRANSFORM_MOVED)
+            {
+                s_flags[id] |= TRANSFORM_LOCAL_DIRTY;
+            }
+        }
+
+        s_alpha = alpha;
+    }
+
+    s_pMovedMetric->Set( (INT64)s_moved.size() );
+}
+
+
+
+void
+Transforms::MergeMoved()
+{
+    for (UINT32 i = 1; i < ARRAY_SIZE(s_workerMoved); ++i)
+    {
+        s_moved.insert( s_moved.end(), s_workerMoved[i].begin(), s_workerMoved[i].end() );
+        s_workerMoved[i].clear();
+    }
+}
+
+
+
+void
+Transforms::Compose( IN const vec3& position, IN const vec3& rotation, float scale, IN const vec3& pivot, OUT mat4* pLocal )
+{
+    static MetricCounter* s_pMultipliesMetric = Metrics::RegisterCounter( "Transforms.Multiplies" );
+
+    DEBUGCHK(pLocal);
+
+    mat4& m = *pLocal;
+
+    if (!s_isEnabled)
+    {
+        // As every caller used to build it.
+        bool hasPivot = (pivot != vec3(0,0,0));
+
+        m  = hasPivot ? mat4::Translate( -pivot.x, -pivot.y, -pivot.z ) * mat4::Scale( scale ) : mat4::Scale( scale );
+        m *= mat4::RotateX  ( rotation.x );
+        m *= mat4::RotateY  ( rotation.y );
+        m *= mat4::RotateZ  ( rotation.z );
+        if (hasPivot)
+        {
+            m *= mat4::Translate( pivot.x, pivot.y, pivot.z );
+        }
+        m *= mat4::Translate( position.x, position.y, position.z );
+
+        s_pMultipliesMetric->Add( hasPivot ? 6 : 4 );
+        return;
+    }
+
+    if (0.0f == rotation.x && 0.0f == rotation.y)
+    {
+        // Scale * RotateZ, written out.
+        float radians = rotation.z * 3.14159f / 180.0f;
+        float s       = scale * sinf( radians );
+        float c       = scale * cosf( radians );
+
+        m = mat4::Identity();
+        m.x.x =  c; m.x.y = -s;
+        m.y.x =  s; m.y.y =  c;
+        m.z.z =  scale;
+    }
+    else
+    {
+        m  = mat4::RotateX( rotation.x );
+        m *= mat4::RotateY( rotation.y );
+        m *= mat4::RotateZ( rotation.z );
+
+        // Scale( scale ) * rotation; the rows' w are 0.
+        m.x *= scale;
+        m.y *= scale;
+        m.z *= scale;
+
+        s_pMultipliesMetric->Add( 2 );
+    }
+
+    // Translate( -pivot ) first, Translate( pivot + position ) last.
+    m.w.x = position.x + pivot.x - (pivot.x * m.x.x + pivot.y * m.y.x + pivot.z * m.z.x);
+    m.w.y = position.y + pivot.y - (pivot.x * m.x.y + pivot.y * m.y.y + pivot.z * m.z.y);
+    m.w.z = position.z + pivot.z - (pivot.x * m.x.z + pivot.y * m.y.z + pivot.z * m.z.z);
+    m.w.w = 1.0f;
+}
+
+
+
+void
+Transforms::Multiply( IN const mat4& a, IN const mat4& b, OUT mat4* pResult )
+{
+    static MetricCounter* s_pMultipliesMetric   = Metrics::RegisterCounter( "Transforms.Multiplies"   );
+    static MetricCounter* s_pMultiplies2DMetric = Metrics::RegisterCounter( "Transforms.Multiplies2D" );
+
+    DEBUGCHK(pResult);
+
+    if (!s_isEnabled || !Is2D( a ) || !Is2D( b ))
+    {
+        *pResult = a * b;
+        s_pMultipliesMetric->Increment();
+        return;
+    }
+
+    // Both only scale / rotate in X-Y, scale Z, and translate.
+    mat4 m;
+    m.x.x = a.x.x * b.x.x + a.x.y * b.y.x;
+    m.x.y = a.x.x * b.x.y + a.x.y * b.y.y;
+    m.y.x = a.y.x * b.x.x + a.y.y * b.y.x;
+    m.y.y = a.y.x * b.x.y + a.y.y * b.y.y;
+    m.z.z = a.z.z * b.z.z;
+    m.w.x = a.w.x * b.x.x + a.w.y * b.y.x + b.w.x;
+    m.w.y = a.w.x * b.x.y + a.w.y * b.y.y + b.w.y;
+    m.w.z = a.w.z * b.z.z + b.w.z;
+
+    *pResult = m;
+    s_pMultiplies2DMetric->Increment();
+}
+
+
+
+bool
+Transforms::Is2D( IN const mat4& m )
+{
+    return 0.0f == m.x.z && 0.0f == m.x.w &&
+           0.0f == m.y.z && 0.0f == m.y.w &&
+           0.0f == m.z.x && 0.0f == m.z.y && 0.0f == m.z.w &&
+           1.0f == m.w.w;
+}
+
+
+
+} // END namespace Z
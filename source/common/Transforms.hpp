@@ -0,0 +1,123 @@
+#pragma once
+
+#include "Types.hpp"
+#include "Vector.hpp"
+#include "Matrix.hpp"
+#include "JobSystem.hpp"
+
+#include <vector>
+using std::vector;
+
+
+namespace Z
+{
+
+
+//
+// Cached local and world matrices for GameObjects, Layers and Sprites.
+//
+// Each node keeps its local position / rotation / scale, and the matrices built
+// from them, in contiguous arrays indexed by TransformID.  The local matrix is
+// rebuilt only after SetLocal() changes something; the world matrix only when the
+// local matrix or the parent's world matrix changed since it was last composed.
+//
+// Parents aren't stored: the Draw() traversal hands each node its parent's world
+// matrix, and the node compares it with the one it last used - the same test
+// Layer::Draw() makes for culling.  So a change anywhere above a node recomposes
+// it, and everything below it, but nothing else.
+//
+// Most of the scene is flat: when a node isn't rotated about X or Y, its local
+// matrix is built directly, and composed with a 2D parent in 2D.
+//
+// With interpolation on, the simulation calls BeginStep() before each fixed step, and
+// SetInterpolation() once it's done.  Nodes that moved during the last step are then
+// drawn between where they were before it and where they are now; nodes created
+// during a step start wherever they're first put.
+//
+// Render thread only, apart from Compose(), Multiply() and SetLocal().  A GameObject
+// updated on a JobSystem worker may SetLocal() its own node: what it moves goes on
+// that thread's list, and MergeMoved() gathers those on the render thread once the
+// parallel update is done.  The reference returned by GetLocal() / GetWorld() is
+// good until the next Create().
+//
+// Off by default, rebuilding everything from full 4x4 products on every call as
+// before; enable with Settings.bCacheTransforms = "1".
+//
+
+typedef UINT32 TransformID;
+
+#define TRANSFORM_NONE      0xFFFFFFFF
+
+
+class Transforms
+{
+public:
+    static  void        Enable      ( bool enabled );
+    static  bool        IsEnabled   ( )                 { return s_isEnabled; }
+
+    static  TransformID Create      ( );
+    static  void        Destroy     ( TransformID id );
+
+    // Scale and rotate about pivot, then translate by position.
+    static  void        SetLocal    ( TransformID id, IN const vec3& position, IN const vec3& rotation, float scale, IN const vec3& pivot = vec3(0,0,0) );
+    static  const mat4& GetLocal    ( TransformID id );
+
+    // GetLocal( id ) * matParentWorld.
+    static  const mat4& GetWorld    ( TransformID id, IN const mat4& matParentWorld );
+
+    static  UINT32      GetNumNodes ( )                 { return (UINT32)(s_flags.size() - s_freeList.size()); }
+
+    static  void        EnableInterpolation ( bool enabled );
+    static  bool        IsInterpolationEnabled ( )      { return s_isInterpolating; }
+    static  void        BeginStep           ( );
+    static  void        SetInterpolation    ( float alpha );   // 0 draws the moved nodes where they were, 1 where they are.
+    static  void        MergeMoved          ( );                // After SetLocal() calls from JobSystem workers.
+
+    // Uncached versions, for transforms that aren't nodes (e.g. batched Sprites).  Thread-safe.
+    static  void        Compose     ( IN const vec3& position, IN const vec3& rotation, float scale, IN const vec3& pivot, OUT mat4* pLocal );
+    static  void        Multiply    ( IN const mat4& a, IN const mat4& b, OUT mat4* pResult );
+
+protected:
+    struct LocalTRS
+    {
+        vec3    position;
+        vec3    rotation;
+        vec3    pivot;
+        float   scale;
+    };
+
+    enum
+    {
+        TRANSFORM_IN_USE        = BIT0,
+        TRANSFORM_LOCAL_DIRTY   = BIT1,
+        TRANSFORM_WORLD_VALID   = BIT2,
+        TRANSFORM_MOVED         = BIT3,     // On s_moved.
+        TRANSFORM_NEW           = BIT4,     // Created this step.
+    };
+
+    static  bool        Is2D        ( IN const mat4& m );
+
+protected:
+    static  bool                s_isEnabled;
+    static  bool                s_isInterpolating;
+    static  float               s_alpha;
+
+    static  vector<LocalTRS>    s_locals;
+    static  vector<LocalTRS>    s_previousLocals;   // Before the current step; only read for TRANSFORM_MOVED nodes.
+    static  vector<mat4>        s_localMatrices;
+    static  vector<mat4>        s_parentWorlds;     // The matParentWorld each world matrix was composed with.
+    static  vector<mat4>        s_worldMatrices;
+    static  vector<BYTE>        s_flags;
+    static  vector<TransformID> s_freeList;
+    static  vector<TransformID> s_moved;            // May hold destroyed, or repeated, IDs.
+    static  vector<TransformID> s_workerMoved[ JOB_MAX_WORKERS + 1 ];  // Moved on each worker, by JobSystem::GetThreadIndex(); [0] is unused.
+
+private:
+    Transforms();
+    Transforms( const Transforms& rhs );
+    Transforms& operator=( const Transforms& rhs );
+};
+
+
+
+} // END namespace Z
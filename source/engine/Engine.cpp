@@ -17,6 +17,8 @@ using std::string;
 #include "DebugRenderer.hpp"
 #include "Camera.hpp"
 #include "Metrics.hpp"
+#include "Profiler.hpp"
+#include "JobSystem.hpp"
 #include "StateMachine.hpp"
 #include "LayerManager.hpp"
 #include "BehaviorManager.hpp"
@@ -35,6 +37,13 @@ using std::string;
 
 #include "OpenGLES1Renderer.hpp"
 #include "OpenGLES2Renderer.hpp"
+#include "NullRenderer.hpp"
+#include "RenderQueue.hpp"
+#include "Culling.hpp"
+#include "Transforms.hpp"
+#include "QuadList.hpp"
+#include "Displacement.hpp"
+#include "VertexStream.hpp"
 
 
 namespace Z
@@ -72,6 +81,15 @@ Accelerometer*          Engine::s_pAccelerometer        = NULL;
 SceneManager*           Engine::s_pSceneManager         = NULL;
 ParticleManager*        Engine::s_pParticleManager      = NULL;
 StoryboardManager*      Engine::s_pStoryboardManager    = NULL;
+UINT32                  Engine::s_maxCatchUpSteps       = 0;
+
+static MetricHistogram* s_pFrameTimeMetric  = Metrics::RegisterHistogram( "Engine.FrameMS"  );
+static MetricHistogram* s_pUpdateTimeMetric = Metrics::RegisterHistogram( "Engine.UpdateMS" );
+static MetricHistogram* s_pRenderTimeMetric = Metrics::RegisterHistogram( "Engine.RenderMS" );
+static MetricCounter*   s_pStepsMetric      = Metrics::RegisterCounter  ( "Engine.Steps"        );
+static MetricCounter*   s_pDroppedMetric    = Metrics::RegisterCounter  ( "Engine.DroppedSteps" );
+static PerfTimer        s_frameTimer;
+static bool             s_isFrameTimerStarted = false;     // No Engine.FrameMS sample until there's a previous frame.
 
 
 RESULT
@@ -159,6 +177,131 @@ Engine::Init()
     }
     
 
+    //
+    // Periodically append a metrics snapshot to persistent storage.
+    //
+    {
+    UINT32 snapshotIntervalMS = GlobalSettings.GetInt("/Settings.MetricsSnapshotIntervalMS");
+    if (snapshotIntervalMS && !persistantFolder.empty())
+    {
+        Metrics::StartSnapshots( persistantFolder + "/metrics.log", snapshotIntervalMS );
+    }
+    }
+
+
+    //
+    // Start the profiler, and optionally capture a trace of the first N frames.
+    //
+    if (GlobalSettings.GetBool("/Settings.bEnableProfiler"))
+    {
+        UINT32 captureFrames = GlobalSettings.GetInt("/Settings.ProfilerCaptureFrames");
+        if (captureFrames && !persistantFolder.empty())
+        {
+            Profiler::Capture( captureFrames, persistantFolder + "/trace.json" );
+        }
+        else
+        {
+            Profiler::Enable( true );
+        }
+    }
+
+
+    //
+    // Drop off-screen Sprites, GameObjects and ParticleEmitters before they're batched.
+    //
+    Culling::Enable( GlobalSettings.GetBool("/Settings.bEnableCulling") );
+
+
+    //
+    // Send Sprites, text and particles as 4-corner indexed quads, packed where they're flat.
+    //
+    QuadList::Enable( GlobalSettings.GetBool("/Settings.bUseQuadVertices",   false),
+                      GlobalSettings.GetBool("/Settings.bUsePackedVertices", false) );
+
+
+    //
+    // Stream vertices through renderer-owned buffer objects (GLES2) instead of client arrays.
+    //
+    VertexStream::Enable( GlobalSettings.GetBool("/Settings.bUseVertexStream", false) );
+
+
+    //
+    // Displace Ripple and Morph grids on the CPU, and draw them with the default shader.
+    //
+    Displacement::Enable( GlobalSettings.GetBool("/Settings.bCPUDisplacement") );
+
+
+    //
+    // Rebuild GameObject, Layer and Sprite matrices only when they, or their parents, move.
+    //
+    Transforms::Enable( GlobalSettings.GetBool("/Settings.bCacheTransforms", false) );
+
+
+    //
+    // Recycle GameObjects spawned from prefabs (e.g. bricks) rather than deleting them.
+    //
+    GOMan.EnablePooling( GlobalSettings.GetBool("/Settings.bPoolGameObjects", false) );
+
+
+    //
+    // Update GameObjects that allow it on the job system's workers, with their messages deferred.
+    //
+    GOMan.EnableParallelUpdate( GlobalSettings.GetBool("/Settings.bParallelUpdate", false) );
+
+
+    //
+    // Send StateMachine events straight to the state that handles them, and drop the rest.
+    //
+    StateMachine::EnableDispatchTables( GlobalSettings.GetBool("/Settings.bStateDispatchTables", false) );
+
+
+    //
+    // Send bricks only the touches that land on them, found through a grid over the screen.
+    //
+    TouchScreen.EnableHitIndex( GlobalSettings.GetBool("/Settings.bTouchHitIndex", false) );
+    IGNOREHR(TouchScreen.Init());
+
+
+    //
+    // Queue touches and accelerometer events from the OS; Update() delivers them.
+    //
+    {
+    bool queueInput = GlobalSettings.GetBool("/Settings.bQueueInput", false);
+
+    TouchScreen.EnableQueue       ( queueInput );
+    GetAccelerometer().EnableQueue( queueInput );
+    }
+
+
+    //
+    // Draw the frame's screen space text with one call per Font.
+    //
+    FontMan.EnableBatching( GlobalSettings.GetBool("/Settings.bBatchText", false) );
+
+
+    //
+    // Step the simulation at SimulationRateHZ, catching up at most MaxCatchUpSteps a frame,
+    // and draw whatever moved between the last two steps.  0 (the default) to step once per frame.
+    //
+    {
+    int simulationRateHZ = GlobalSettings.GetInt("/Settings.SimulationRateHZ", 0);
+
+    s_maxCatchUpSteps = MAX(1, GlobalSettings.GetInt("/Settings.MaxCatchUpSteps", 4));
+    GameTime.SetFixedStep( simulationRateHZ > 0 ? 1000.0 / MIN(simulationRateHZ, 1000) : 0.0 );
+    Transforms::EnableInterpolation( simulationRateHZ > 0 );
+    }
+
+
+    //
+    // Start the job system; NumWorkerThreads = "0" picks one worker per spare core.
+    // Off by default: jobs run inline on the calling thread.
+    //
+    if (GlobalSettings.GetBool("/Settings.bUseJobSystem", false))
+    {
+        CHR(JobSystem::Init( GlobalSettings.GetInt("/Settings.NumWorkerThreads") ));
+    }
+
+
     s_isInitialized = true;
     
 Exit:   
@@ -331,28 +474,57 @@ Engine::IsPaused( )
 RESULT
 Engine::Update( )
 {
-    RESULT rval = S_OK;
+    RESULT      rval        = S_OK;
+    PerfTimer   timer;
+    UINT32      numSteps    = 1;
+    UINT32      numDropped  = 0;
+
+    PROFILE_SCOPE("Engine::Update");
 
-    PerfTimer timer;
     timer.Start();
 
-    // Don't tick GameObjects when paused.
-    // Do update animations, particles, and sound (so that menus work).
-    if (!s_isPaused)
+    // Input that arrived since the last frame, before anything steps.
+    IGNOREHR(TouchScreen.ProcessEvents());
+    IGNOREHR(GetAccelerometer().ProcessEvents());
+
+    //
+    // With a fixed step, take however many steps the wall clock says we owe - none
+    // on some frames - and forget any beyond MaxCatchUpSteps, so one long frame
+    // doesn't make the next one longer still.
+    //
+    if (GameTime.GetFixedStep())
     {
-        CHR(GOMan.Update       ( GameTime.GetTime() ))
+        numSteps    = GameTime.Accumulate();
+        numDropped  = GameTime.DropSteps( s_maxCatchUpSteps );
+        numSteps   -= numDropped;
+
+        s_pDroppedMetric->Add( numDropped );
+    }
+
+    for (UINT32 i = 0; i < numSteps; ++i)
+    {
+        if (GameTime.GetFixedStep())
+        {
+            Transforms::BeginStep();
+            GameTime.Step();
+        }
+
+        CHR(Step( GameTime.GetTime() ));
+        s_pStepsMetric->Increment();
     }
-    
-    CHR(StoryboardMan.Update   ( GameTime.GetTime() ));
-    CHR(ParticleMan.Update     ( GameTime.GetTime() ));
-    CHR(SoundMan.Update        ( GameTime.GetTime() ));
+
+    // Render() draws in between the last two steps.
+    Transforms::SetInterpolation( GameTime.GetAlpha() );
 
     timer.Stop();
+
+    s_pUpdateTimeMetric->Record( timer.ElapsedMilliseconds() );
+    IGNOREHR(Metrics::Update());
     
     if (Log::IsZoneEnabled(ZONE_PERF | ZONE_VERBOSE))
     {
         char str[256];
-        sprintf(str, "U:%1.0f ms", timer.ElapsedMilliseconds());
+        sprintf(str, "U:%1.0f ms %d", timer.ElapsedMilliseconds(), (int)numSteps);
         DebugRender.Text(vec3(180,0,0), str, Color::Green(), 1.0f, 1.0f);
     }
     
@@ -362,20 +534,72 @@ Exit:
 
 
 
+RESULT
+Engine::Step( UINT64 timeMS )
+{
+    RESULT      rval        = S_OK;
+    RESULT      soundResult = S_OK;
+    JobCounter  particlesDone;
+
+    PROFILE_SCOPE("Engine::Step");
+
+    //
+    // Update phases, in dependency order:
+    //
+    //  1. GameObjects, then Storyboards - serial on this thread.  These run game
+    //     logic and callbacks, and deliver messages in a fixed order.
+    //  2. Particles and Sounds - independent of each other.  ParticleMan fans its
+    //     emitters out across the job workers while this thread updates Sounds,
+    //     then helps with any emitters that are left.
+    //
+
+    // Don't tick GameObjects when paused.
+    // Do update animations, particles, and sound (so that menus work).
+    if (!s_isPaused)
+    {
+        CHR(GOMan.Update       ( timeMS ))
+    }
+    
+    CHR(StoryboardMan.Update   ( timeMS ));
+
+    CHR(ParticleMan.BeginUpdate( timeMS, &particlesDone ));
+    soundResult = SoundMan.Update( timeMS );
+    JobSystem::Wait( &particlesDone );
+    CHR(ParticleMan.EndUpdate  ( ));
+    CHR(soundResult);
+
+Exit:
+    return rval;
+}
+
+
+
 RESULT
 Engine::Render( )
 {
     RESULT rval = S_OK;
     
+    PROFILE_SCOPE("Engine::Render");
+
     PerfTimer timer;
     timer.Start();
 
+    // Time from the start of the previous frame to the start of this one.
+    if (s_isFrameTimerStarted)
+    {
+        s_pFrameTimeMetric->Record( s_frameTimer.ElapsedMilliseconds() );
+    }
+    s_frameTimer.Start();
+    s_isFrameTimerStarted = true;
+
     CHR(Renderer.BeginFrame());
     CHR(Renderer.Clear( 0.0, 0.0, 0.0, 1.0 ));
     CHR(LayerMan.Draw());
     CHR(SceneMan.Draw());   // TODO: merge Scenes and Layers.
     
 
+    FontMan.BeginBatch();
+
     //
     // Total HACK
     // Render the level and score here, until we get Controls up and running.
@@ -431,6 +655,7 @@ Engine::Render( )
 #ifdef DEBUG
     CHR(DebugRender.Draw());
 #endif
+    CHR(FontMan.EndBatch());
     CHR(DebugRender.Reset());
 
 
@@ -439,6 +664,8 @@ Engine::Render( )
 
     timer.Stop();
 
+    s_pRenderTimeMetric->Record( timer.ElapsedMilliseconds() );
+
 #ifndef SHIPBUILD
     if (Log::IsZoneEnabled(ZONE_PERF | ZONE_VERBOSE))
     {
@@ -458,6 +685,8 @@ Engine::Render( )
 
     
 Exit:
+    PROFILE_END_FRAME();
+
     if (FAILED(rval))
     {
         RETAILMSG(ZONE_ERROR, "ERROR: Engine::Render(): rval = 0x%x", rval);
@@ -478,6 +707,8 @@ Engine::Shutdown( )
 
     CHR(UnloadResources());
     
+    IGNOREHR(JobSystem::Shutdown());
+
     SAFE_RELEASE(s_pRenderer);
     SAFE_RELEASE(s_pRenderContext);
     SAFE_RELEASE(s_pCamera);
@@ -581,9 +812,14 @@ Engine::GetRenderer( )
 {
     if (!s_pRenderer) 
     {
-        bool bUseOpenGLES1 = Settings::Global().GetBool("/Settings.bUseOpenGLES1");
+        bool bUseOpenGLES1    = Settings::Global().GetBool("/Settings.bUseOpenGLES1");
+        bool bUseNullRenderer = Settings::Global().GetBool("/Settings.bUseNullRenderer");
         
-        if (bUseOpenGLES1)
+        if (bUseNullRenderer)
+        {
+            s_pRenderer = NullRenderer::Create();
+        }
+        else if (bUseOpenGLES1)
         {
             s_pRenderer = OpenGLES1Renderer::Create();
         }
@@ -592,6 +828,12 @@ Engine::GetRenderer( )
             s_pRenderer = OpenGLES2Renderer::Create();
         }
 
+        // Put the state cache in front of whichever backend was chosen.
+        if (Settings::Global().GetBool("/Settings.bUseRenderQueue"))
+        {
+            s_pRenderer = RenderQueue::Create( s_pRenderer );
+        }
+
         s_pRenderer->AddRef();
     }
     
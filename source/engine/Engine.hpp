@@ -61,6 +61,8 @@ protected:
     Engine& operator=( const Engine& rhs );
     virtual ~Engine();
 
+    static  RESULT                  Step                    ( UINT64 timeMS );
+
 protected:
     static bool                     s_isInitialized;
     static bool                     s_resourcesLoaded;
@@ -78,6 +80,7 @@ protected:
     static SceneManager*            s_pSceneManager;
     static ParticleManager*         s_pParticleManager;
     static StoryboardManager*       s_pStoryboardManager;
+    static UINT32                   s_maxCatchUpSteps;
 };
 
 
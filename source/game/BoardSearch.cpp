@@ -0,0 +1,770 @@
+/*
+ *  BoardSearch.cpp
+ *  Critters
+ *
+ *  Move search over compact copies of the playing field, for autoplay and hints.
+ *
+ */
+
+#include "BoardSearch.hpp"
+#include "JobSystem.hpp"
+#include "Macros.hpp"
+#include "Log.hpp"
+
+#include <string.h>
+
+
+namespace Z
+{
+
+
+
+// Same as ColumnState's.
+const UINT8     BLOCKS_TO_EARN_VERTICAL_BOMB    = 7;
+const UINT8     CHAINS_TO_EARN_RADIAL_BOMB      = 2;
+
+// Evaluate() weights.
+const float     BOARD_PAIR_VALUE                = 10.0f;    // Per two matching bricks side by side.
+const float     BOARD_BRICK_VALUE               = -3.0f;    // Per brick on the board.
+const float     BOARD_HEIGHT_VALUE              = -20.0f;   // Per row of the tallest stack.
+const float     BOARD_NO_ROOM_VALUE             = -1000.0f; // The next column has nowhere to go.
+const float     BOARD_GAME_OVER_VALUE           = -1000000.0f;
+
+
+
+//
+// Board
+//
+Board::Board() :
+    m_width (0),
+    m_height(0)
+{
+    memset(m_cells, 0, sizeof(m_cells));
+}
+
+
+
+RESULT
+Board::Init( IN GameMap<GO_TYPE>* pMap )
+{
+    RESULT rval = S_OK;
+
+    CPREx(pMap, E_NULL_POINTER);
+    CBREx(pMap->GetWidth() <= BOARD_MAX_COLUMNS && pMap->GetHeight() <= BOARD_MAX_ROWS, E_INVALID_ARG);
+
+    Init( pMap->GetWidth(), pMap->GetHeight() );
+
+    for (UINT32 y = 0; y < m_height; ++y)
+    {
+        for (UINT32 x = 0; x < m_width; ++x)
+        {
+            SetCell( x, y, CellFromType( pMap->GetValue( x, y ) ) );
+        }
+    }
+
+Exit:
+    return rval;
+}
+
+
+
+void
+Board::Init( UINT32 width, UINT32 height )
+{
+    DEBUGCHK(width <= BOARD_MAX_COLUMNS && height <= BOARD_MAX_ROWS && height >= NUM_BRICKS_PER_COLUMN);
+
+    m_width  = (UINT8)width;
+    m_height = (UINT8)height;
+    memset(m_cells, 0, sizeof(m_cells));
+}
+
+
+
+bool
+Board::GetReach( UINT32 x, UINT32 y, OUT UINT32* pMinX, OUT UINT32* pMaxX ) const
+{
+    DEBUGCHK(pMinX && pMaxX);
+
+    if (x >= m_width || GetCell( x, y ))
+    {
+        return false;
+    }
+
+    // CollisionCheck() only looks beside the bottom brick.
+    *pMinX = x;
+    while (*pMinX > 0 && !GetCell( *pMinX - 1, y ))
+    {
+        (*pMinX)--;
+    }
+
+    *pMaxX = x;
+    while (*pMaxX + 1 < m_width && !GetCell( *pMaxX + 1, y ))
+    {
+        (*pMaxX)++;
+    }
+
+    return true;
+}
+
+
+
+void
+Board::Place( IN const BYTE* pColumn, UINT32 x, UINT32 y, IN const BoardScoring& scoring, OUT BoardOutcome* pOutcome )
+{
+    CellMask    mask;
+    UINT32      bomb        = NUM_BRICKS_PER_COLUMN;
+    UINT32      minX        = 0;
+    UINT32      minY        = 0;
+    UINT8       longestLine = 0;
+    UINT32      numLines    = 0;
+
+    DEBUGCHK(pColumn && pOutcome);
+    DEBUGCHK(x < m_width && y + NUM_BRICKS_PER_COLUMN <= m_height);
+
+    memset(pOutcome, 0, sizeof(*pOutcome));
+
+    //
+    // DropColumnToBottom(), and its points.
+    //
+    while (y > 0 && !GetCell( x, y - 1 ))
+    {
+        y--;
+        pOutcome->dropLength++;
+    }
+    pOutcome->points += (UINT32)(pOutcome->dropLength * 10 * scoring.difficultyMultiplier);
+
+    for (UINT32 i = 0; i < NUM_BRICKS_PER_COLUMN; ++i)
+    {
+        if (pColumn[i] >= BOARD_CELL_VERTICAL_BOMB)
+        {
+            bomb = i;
+            break;
+        }
+    }
+
+    //
+    // A bomb goes off as it's flung, before the column is on the map, and again as
+    // it lands.  Everything either hits is smashed; both are scored.
+    //
+    memset(mask, 0, sizeof(mask));
+
+    if (bomb < NUM_BRICKS_PER_COLUMN)
+    {
+        UINT32 numSmashed = Smash( x, y + NUM_BRICKS_PER_COLUMN - 1 - bomb, pColumn[bomb], true, &mask );
+
+        pOutcome->points     += SmashPoints( numSmashed, scoring );
+        pOutcome->numSmashed += numSmashed;
+    }
+
+    for (UINT32 i = 0; i < NUM_BRICKS_PER_COLUMN; ++i)
+    {
+        SetCell( x, y + NUM_BRICKS_PER_COLUMN - 1 - i, pColumn[i] );
+    }
+
+    if (bomb < NUM_BRICKS_PER_COLUMN)
+    {
+        UINT32 numSmashed = Smash( x, y + NUM_BRICKS_PER_COLUMN - 1 - bomb, pColumn[bomb], false, &mask );
+
+        pOutcome->points     += SmashPoints( numSmashed, scoring );
+        pOutcome->numSmashed += numSmashed;
+
+        Remove( mask, &minX, &minY );
+        Drop();
+    }
+
+    //
+    // Clear lines, and whatever lines their clearing makes, until none are left.
+    //
+    for (;;)
+    {
+        UINT32 numCleared = FindLines( &longestLine, &numLines, &mask );
+
+        if (!numCleared)
+        {
+            break;
+        }
+
+        pOutcome->points     += LinePoints( numCleared, longestLine, pOutcome->numChains, scoring );
+        pOutcome->numCleared += numCleared;
+        pOutcome->numLines   += numLines;
+
+        Remove( mask, &minX, &minY );
+
+        // An earned bomb goes in the lowest row and leftmost column the cleared bricks reached.
+        if (numCleared >= BLOCKS_TO_EARN_VERTICAL_BOMB)
+        {
+            SetCell( minX, minY, BOARD_CELL_VERTICAL_BOMB );
+        }
+        else if (pOutcome->numChains >= CHAINS_TO_EARN_RADIAL_BOMB)
+        {
+            SetCell( minX, minY, BOARD_CELL_RADIAL_BOMB );
+        }
+
+        pOutcome->numChains++;
+        Drop();
+    }
+
+    // Anything left in the top row ends the game.
+    for (UINT32 col = 0; col < m_width; ++col)
+    {
+        if (GetCell( col, m_height - 1 ))
+        {
+            pOutcome->isGameOver = true;
+            break;
+        }
+    }
+}
+
+
+
+void
+Board::Rotate( IN const BYTE* pColumn, UINT32 numRotations, OUT BYTE* pRotated )
+{
+    DEBUGCHK(pColumn && pRotated && pColumn != pRotated);
+
+    // Each RotateColumn() moves the bottom brick to the top.
+    for (UINT32 i = 0; i < NUM_BRICKS_PER_COLUMN; ++i)
+    {
+        pRotated[ (i + numRotations) % NUM_BRICKS_PER_COLUMN ] = pColumn[i];
+    }
+}
+
+
+
+BYTE
+Board::CellFromType( GO_TYPE type )
+{
+    for (UINT32 i = 0; i < BOARD_CELL_RADIAL_BOMB; ++i)
+    {
+        if ((UINT32)type & ((UINT32)GO_TYPE_USER << i))
+        {
+            return (BYTE)(BOARD_CELL_BRICK + i);
+        }
+    }
+
+    return BOARD_CELL_EMPTY;
+}
+
+
+
+GO_TYPE
+Board::TypeFromCell( BYTE cell )
+{
+    if (BOARD_CELL_EMPTY == cell || cell > BOARD_CELL_RADIAL_BOMB)
+    {
+        return (GO_TYPE)0;
+    }
+
+    return (GO_TYPE)((UINT32)GO_TYPE_USER << (cell - BOARD_CELL_BRICK));
+}
+
+
+
+//
+// SmashBricks(): mark what the bomb at (x, y) hits, and return how many bricks that is.
+//
+UINT32
+Board::Smash( UINT32 x, UINT32 y, BYTE bomb, bool wasFlung, INOUT CellMask* pMask ) const
+{
+    UINT32  numSmashed  = 0;
+    int     radius      = wasFlung ? 3 : 1;
+
+    DEBUGCHK(pMask);
+
+    switch (bomb)
+    {
+        case BOARD_CELL_VERTICAL_BOMB:
+            if (wasFlung)
+            {
+                // Both directions start in the bomb's cell; count it once.
+                numSmashed += SmashLine( x, y, 0, -1, GAME_GRID_NUM_ROWS, pMask );
+                numSmashed += SmashLine( x, y, 0,  1, GAME_GRID_NUM_ROWS, pMask );
+                if (GetCell( x, y ))
+                {
+                    numSmashed--;
+                }
+            }
+            else
+            {
+                numSmashed += SmashLine( x, y, 0, -1, 4, pMask );
+            }
+            break;
+
+        case BOARD_CELL_RADIAL_BOMB:
+            for (int dy = -radius; dy <= radius; ++dy)
+            {
+                for (int dx = -radius; dx <= radius; ++dx)
+                {
+                    UINT32 cellX = x + dx;
+                    UINT32 cellY = y + dy;
+
+                    if (dx*dx + dy*dy > radius*radius || !GetCell( cellX, cellY ))
+                    {
+                        continue;
+                    }
+
+                    (*pMask)[ cellY*BOARD_MAX_COLUMNS + cellX ] = 1;
+                    numSmashed++;
+                }
+            }
+            break;
+
+        default:
+            DEBUGCHK(0);
+    }
+
+    return numSmashed;
+}
+
+
+
+UINT32
+Board::SmashLine( UINT32 x, UINT32 y, int dx, int dy, UINT32 distance, INOUT CellMask* pMask ) const
+{
+    UINT32 numSmashed = 0;
+
+    for (; distance && x < m_width && y < m_height; --distance, x += dx, y += dy)
+    {
+        if (GetCell( x, y ))
+        {
+            (*pMask)[ y*BOARD_MAX_COLUMNS + x ] = 1;
+            numSmashed++;
+        }
+    }
+
+    return numSmashed;
+}
+
+
+
+//
+// FindContiguousBricks( 3 ): mark every brick in a line of three or more, in any of
+// the eight directions, and return how many there are.
+//
+// The game walks from every brick in every direction, so a line of N is found
+// N - 2 times each way; it reports half of that as the number of lines.  Here each
+// line is walked once, from its first brick, and counted the same.
+//
+UINT32
+Board::FindLines( OUT UINT8* pLongestLine, OUT UINT32* pNumLines, OUT CellMask* pMask ) const
+{
+    static const int directions[4][2] = { { 1, 0 }, { 0, 1 }, { 1, 1 }, { 1, -1 } };
+
+    UINT32 numBricks = 0;
+
+    DEBUGCHK(pLongestLine && pNumLines && pMask);
+
+    *pLongestLine   = 0;
+    *pNumLines      = 0;
+    memset(*pMask, 0, sizeof(*pMask));
+
+    for (UINT32 y = 0; y < m_height; ++y)
+    {
+        for (UINT32 x = 0; x < m_width; ++x)
+        {
+            BYTE cell = GetCell( x, y );
+
+            if (!cell)
+            {
+                continue;
+            }
+
+            for (UINT32 dir = 0; dir < ARRAY_SIZE(directions); ++dir)
+            {
+                int     dx      = directions[dir][0];
+                int     dy      = directions[dir][1];
+                UINT32  length  = 1;
+
+                // Only from the first brick of a line.
+                if (GetCell( x - dx, y - dy ) == cell)
+                {
+                    continue;
+                }
+
+                while (GetCell( x + length*dx, y + length*dy ) == cell)
+                {
+                    length++;
+                }
+
+                if (length < 3)
+                {
+                    continue;
+                }
+
+                *pLongestLine  = (UINT8)MAX(*pLongestLine, length);
+                *pNumLines    += length - 2;
+
+                for (UINT32 i = 0; i < length; ++i)
+                {
+                    UINT8& marked = (*pMask)[ (y + i*dy)*BOARD_MAX_COLUMNS + (x + i*dx) ];
+
+                    if (!marked)
+                    {
+                        marked = 1;
+                        numBricks++;
+                    }
+                }
+            }
+        }
+    }
+
+    return numBricks;
+}
+
+
+
+UINT32
+Board::Remove( IN const CellMask& mask, OUT UINT32* pMinX, OUT UINT32* pMinY )
+{
+    UINT32 numRemoved = 0;
+
+    *pMinX = m_width;
+    *pMinY = m_height;
+
+    for (UINT32 y = 0; y < m_height; ++y)
+    {
+        for (UINT32 x = 0; x < m_width; ++x)
+        {
+            if (mask[ y*BOARD_MAX_COLUMNS + x ])
+            {
+                SetCell( x, y, BOARD_CELL_EMPTY );
+                *pMinX = MIN(*pMinX, x);
+                *pMinY = MIN(*pMinY, y);
+                numRemoved++;
+            }
+        }
+    }
+
+    return numRemoved;
+}
+
+
+
+// DropAllBricks(): close every gap.
+void
+Board::Drop()
+{
+    for (UINT32 x = 0; x < m_width; ++x)
+    {
+        UINT32 dst = 0;
+
+        for (UINT32 src = 0; src < m_height; ++src)
+        {
+            BYTE cell = GetCell( x, src );
+
+            if (!cell)
+            {
+                continue;
+            }
+
+            if (src != dst)
+            {
+                SetCell( x, dst, cell );
+                SetCell( x, src, BOARD_CELL_EMPTY );
+            }
+            dst++;
+        }
+    }
+}
+
+
+
+// As CheckForSmashedBricks() scores them.
+UINT32
+Board::SmashPoints( UINT32 numSmashed, IN const BoardScoring& scoring )
+{
+    UINT32 brickScore;
+
+    switch (numSmashed)
+    {
+        case 0:     brickScore = 0;     break;
+        case 1:
+        case 2:
+        case 3:     brickScore = 10;    break;
+        case 4:     brickScore = 15;    break;
+        case 5:     brickScore = 30;    break;
+        case 6:     brickScore = 100;   break;
+        default:    brickScore = 200;   break;
+    }
+
+    return (UINT32)(numSmashed * brickScore * scoring.levelMultiplier * scoring.difficultyMultiplier);
+}
+
+
+
+// As UpdateScore() scores them.
+UINT32
+Board::LinePoints( UINT32 numBricks, UINT8 longestLine, UINT32 numChains, IN const BoardScoring& scoring )
+{
+    UINT32 brickScore = 0;
+    UINT32 score;
+
+    switch (longestLine)
+    {
+        case 3:     brickScore = 10;    break;
+        case 4:     brickScore = 15;    break;
+        case 5:     brickScore = 30;    break;
+        case 6:     brickScore = 100;   break;
+        default:                        break;
+    }
+
+    if (numChains > 0 && brickScore < 50)
+    {
+        brickScore = 50;
+    }
+
+    if (numBricks > 6 && brickScore < 100)
+    {
+        brickScore = 100;
+    }
+
+    score  = brickScore * numBricks + 1000 * numChains;
+    score  = (UINT32)(score * scoring.levelMultiplier);
+    score  = (UINT32)(score * scoring.difficultyMultiplier);
+
+    return score;
+}
+
+
+
+//
+// BoardSearch
+//
+BoardSearchParams::BoardSearchParams() :
+    depth           (2),
+    numSamples      (8),
+    numBrickTypes   (3),
+    seed            (1),
+    isParallel      (true)
+{
+    scoring.levelMultiplier      = 1.0f;
+    scoring.difficultyMultiplier = 1.0f;
+}
+
+
+
+RESULT
+BoardSearch::FindBestMove( IN const Board& board, IN const BYTE* pColumn, UINT32 x, UINT32 y, IN const BoardSearchParams& params, OUT BoardMove* pMove )
+{
+    RESULT  rval    = S_OK;
+    Search  search;
+    UINT32  minX;
+    UINT32  maxX;
+
+    CPREx(pColumn, E_NULL_POINTER);
+    CPREx(pMove,   E_NULL_POINTER);
+    CBREx(y + NUM_BRICKS_PER_COLUMN <= board.GetHeight(), E_INVALID_ARG);
+    CBREx(board.GetReach( x, y, &minX, &maxX ), E_NOT_FOUND);
+
+    search.pBoard   = &board;
+    search.pParams  = &params;
+    search.y        = y;
+    search.numMoves = 0;
+
+    for (UINT32 r = 0; r < 3; ++r)
+    {
+        Board::Rotate( pColumn, r, search.columns[r] );
+    }
+
+    for (UINT32 col = minX; col <= maxX; ++col)
+    {
+        for (UINT32 r = 0; r < 3; ++r)
+        {
+            BoardMove& move = search.moves[ search.numMoves++ ];
+
+            memset(&move, 0, sizeof(move));
+            move.x              = (UINT8)col;
+            move.numRotations   = (UINT8)r;
+        }
+    }
+
+    if (params.isParallel)
+    {
+        CHR(JobSystem::ParallelFor( SearchMovesJob, &search, search.numMoves ));
+    }
+    else
+    {
+        SearchMovesJob( &search, 0, search.numMoves );
+    }
+
+    // First best wins, so ties go left, then to fewer rotations.
+    *pMove = search.moves[0];
+    for (UINT32 i = 1; i < search.numMoves; ++i)
+    {
+        if (search.moves[i].value > pMove->value)
+        {
+            *pMove = search.moves[i];
+        }
+    }
+
+Exit:
+    return rval;
+}
+
+
+
+INT64
+BoardSearch::GetNumPositions()
+{
+    return GetPositionsMetric()->Get();
+}
+
+
+
+void
+BoardSearch::SearchMovesJob( void* pContext, UINT32 begin, UINT32 end )
+{
+    Search*                     pSearch     = (Search*)pContext;
+    const BoardSearchParams&    params      = *pSearch->pParams;
+    INT64                       numPositions = 0;
+
+    for (UINT32 i = begin; i < end; ++i)
+    {
+        BoardMove&      move    = pSearch->moves[i];
+        const BYTE*     pColumn = pSearch->columns[ move.numRotations ];
+        Board           board   = *pSearch->pBoard;
+        BoardOutcome    outcome;
+
+        board.Place( pColumn, move.x, pSearch->y, params.scoring, &outcome );
+        numPositions++;
+
+        move.y          = (UINT8)(pSearch->y - outcome.dropLength);
+        move.points     = outcome.points;
+        move.isGameOver = outcome.isGameOver;
+
+        if (outcome.isGameOver)
+        {
+            move.value = BOARD_GAME_OVER_VALUE + outcome.points;
+            continue;
+        }
+
+        if (params.depth < 2 || !params.numSamples)
+        {
+            move.value = outcome.points + Evaluate( board );
+            continue;
+        }
+
+        // Seeded from the move's index, not the job's, so any split gives the same samples.
+        uint32_t    random  = (uint32_t)(params.seed ^ ((i + 1) * 2654435761u));
+        float       total   = 0.0f;
+
+        for (UINT32 sample = 0; sample < params.numSamples; ++sample)
+        {
+            BYTE next[ NUM_BRICKS_PER_COLUMN ];
+
+            for (UINT32 b = 0; b < NUM_BRICKS_PER_COLUMN; ++b)
+            {
+                next[b] = Board::CellFromType( g_brickTypes[ NextRandom( &random ) % MAX(params.numBrickTypes, 1) ].goType );
+            }
+
+            total += BestReply( board, next, params, &numPositions );
+        }
+
+        move.value = outcome.points + total / params.numSamples;
+    }
+
+    GetPositionsMetric()->Add( numPositions );
+}
+
+
+
+float
+BoardSearch::BestReply( IN const Board& board, IN const BYTE* pColumn, IN const BoardSearchParams& params, INOUT INT64* pNumPositions )
+{
+    UINT32  y       = board.GetHeight() - NUM_BRICKS_PER_COLUMN;
+    float   best    = BOARD_GAME_OVER_VALUE;
+    UINT32  minX;
+    UINT32  maxX;
+
+    if (!board.GetReach( BOARD_SPAWN_COLUMN, y, &minX, &maxX ))
+    {
+        return best;
+    }
+
+    for (UINT32 r = 0; r < 3; ++r)
+    {
+        BYTE column[ NUM_BRICKS_PER_COLUMN ];
+        Board::Rotate( pColumn, r, column );
+
+        for (UINT32 x = minX; x <= maxX; ++x)
+        {
+            Board           next = board;
+            BoardOutcome    outcome;
+
+            next.Place( column, x, y, params.scoring, &outcome );
+            (*pNumPositions)++;
+
+            float value = outcome.isGameOver ? BOARD_GAME_OVER_VALUE + outcome.points : outcome.points + Evaluate( next );
+            best = MAX(best, value);
+        }
+    }
+
+    return best;
+}
+
+
+
+float
+BoardSearch::Evaluate( IN const Board& board )
+{
+    UINT32  numPairs    = 0;
+    UINT32  numBricks   = 0;
+    UINT32  maxHeight   = 0;
+    float   value;
+
+    for (UINT32 x = 0; x < board.GetWidth(); ++x)
+    {
+        for (UINT32 y = 0; y < board.GetHeight(); ++y)
+        {
+            BYTE cell = board.GetCell( x, y );
+
+            if (!cell)
+            {
+                // Bricks don't hang after Place().
+                break;
+            }
+
+            numBricks++;
+            maxHeight = MAX(maxHeight, y + 1);
+
+            // Each pair once: right, up, and both diagonals up.
+            numPairs += (board.GetCell( x + 1, y     ) == cell);
+            numPairs += (board.GetCell( x,     y + 1 ) == cell);
+            numPairs += (board.GetCell( x + 1, y + 1 ) == cell);
+            numPairs += (board.GetCell( x - 1, y + 1 ) == cell);
+        }
+    }
+
+    value = numPairs * BOARD_PAIR_VALUE + numBricks * BOARD_BRICK_VALUE + maxHeight * BOARD_HEIGHT_VALUE;
+
+    if (board.GetCell( BOARD_SPAWN_COLUMN, board.GetHeight() - NUM_BRICKS_PER_COLUMN ))
+    {
+        value += BOARD_NO_ROOM_VALUE;
+    }
+
+    return value;
+}
+
+
+
+uint32_t
+BoardSearch::NextRandom( INOUT uint32_t* pState )
+{
+    // Numerical Recipes' LCG; the high bits are the good ones.
+    *pState = *pState * 1664525 + 1013904223;
+    return *pState >> 16;
+}
+
+
+
+MetricCounter*
+BoardSearch::GetPositionsMetric()
+{
+    static MetricCounter* s_pPositionsMetric = Metrics::RegisterCounter( "BoardSearch.Positions" );
+
+    return s_pPositionsMetric;
+}
+
+
+
+} // END namespace Z
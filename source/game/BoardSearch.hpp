@@ -0,0 +1,192 @@
+#pragma once
+
+/*
+ *  BoardSearch.hpp
+ *  Critters
+ *
+ *  Move search over compact copies of the playing field, for autoplay and hints.
+ *
+ */
+
+#include "Types.hpp"
+#include "GameMap.hpp"
+#include "GameState.hpp"
+#include "Metrics.hpp"
+
+
+namespace Z
+{
+
+
+//
+// A copy of the playing field, one byte per cell, and the rules ColumnState plays by.
+//
+// Place() does what landing a column does in the game, without GameObjects, sprites
+// or storyboards: the column drops to the bottom (DropColumnToBottom), a bomb in it
+// smashes the bricks around it twice - flung, then again as it lands
+// (CheckForSmashedBricks, SmashBricks) - and lines of three or more are cleared
+// (FindContiguousBricks), scored (UpdateScore), replaced by an earned bomb and
+// dropped (DropAllBricks) until nothing more clears.  Points are what the game adds
+// to g_totalScore.
+//
+// Where the game is odd the copy is too: a line of N counts as N - 2 lines, the
+// column's first bomb from the top is the one that goes off, and bricks that a bomb
+// smashes don't detonate.  An earned bomb landing on a brick replaces it (the game
+// keeps both in one cell).
+//
+// Row 0 is the bottom.  A column is given top brick first, as hColumnBricks[].
+//
+
+#define BOARD_MAX_COLUMNS       GAME_GRID_NUM_COLUMNS
+#define BOARD_MAX_ROWS          (GAME_GRID_NUM_ROWS + 1)
+#define BOARD_SPAWN_COLUMN      3       // Where CreateColumn() puts a new column.
+
+typedef enum
+{
+    BOARD_CELL_EMPTY            = 0,
+    BOARD_CELL_BRICK            = 1,    // 1 - 7: GO_TYPE_BLUE_BRICK ... GO_TYPE_BROWN_BRICK.
+    BOARD_CELL_VERTICAL_BOMB    = 8,
+    BOARD_CELL_RADIAL_BOMB      = 9,
+} BOARD_CELL;
+
+
+// What the game multiplies points by.
+struct BoardScoring
+{
+    float   levelMultiplier;            // g_pLevel->scoreMultiplier
+    float   difficultyMultiplier;       // g_difficultyMultiplier
+};
+
+
+struct BoardOutcome
+{
+    UINT32  points;
+    UINT32  dropLength;
+    UINT32  numSmashed;
+    UINT32  numCleared;
+    UINT32  numLines;
+    UINT32  numChains;
+    bool    isGameOver;
+};
+
+
+class Board
+{
+public:
+    Board();
+
+    // A copy of the map's cell values; the map must be at rest and Update()d.
+    RESULT      Init                ( IN GameMap<GO_TYPE>* pMap );
+    void        Init                ( UINT32 width, UINT32 height );
+
+    UINT32      GetWidth            ( ) const                           { return m_width;  }
+    UINT32      GetHeight           ( ) const                           { return m_height; }
+    BYTE        GetCell             ( UINT32 x, UINT32 y ) const        { return (x < m_width && y < m_height) ? m_cells[ y*BOARD_MAX_COLUMNS + x ] : BOARD_CELL_EMPTY; }
+    void        SetCell             ( UINT32 x, UINT32 y, BYTE cell )   { DEBUGCHK(x < m_width && y < m_height); m_cells[ y*BOARD_MAX_COLUMNS + x ] = cell; }
+
+    // The columns a column can slide to from x with its bottom brick in row y (MoveColumnLeft() / Right()); false if it doesn't fit there.
+    bool        GetReach            ( UINT32 x, UINT32 y, OUT UINT32* pMinX, OUT UINT32* pMaxX ) const;
+
+    // Drop the column into column x from row y and play out everything it sets off.
+    void        Place               ( IN const BYTE* pColumn, UINT32 x, UINT32 y, IN const BoardScoring& scoring, OUT BoardOutcome* pOutcome );
+
+    // The bricks a RotateColumn() leaves, top first.
+    static void Rotate              ( IN const BYTE* pColumn, UINT32 numRotations, OUT BYTE* pRotated );
+
+    static BYTE     CellFromType    ( GO_TYPE type );
+    static GO_TYPE  TypeFromCell    ( BYTE cell );
+
+protected:
+    typedef UINT8   CellMask[ BOARD_MAX_ROWS * BOARD_MAX_COLUMNS ];
+
+    UINT32      Smash               ( UINT32 x, UINT32 y, BYTE bomb, bool wasFlung, INOUT CellMask* pMask ) const;
+    UINT32      SmashLine           ( UINT32 x, UINT32 y, int dx, int dy, UINT32 distance, INOUT CellMask* pMask ) const;
+    UINT32      FindLines           ( OUT UINT8* pLongestLine, OUT UINT32* pNumLines, OUT CellMask* pMask ) const;
+    UINT32      Remove              ( IN const CellMask& mask, OUT UINT32* pMinX, OUT UINT32* pMinY );
+    void        Drop                ( );
+
+    static UINT32   SmashPoints     ( UINT32 numSmashed, IN const BoardScoring& scoring );
+    static UINT32   LinePoints      ( UINT32 numBricks, UINT8 longestLine, UINT32 numChains, IN const BoardScoring& scoring );
+
+protected:
+    UINT8       m_width;
+    UINT8       m_height;
+    BYTE        m_cells[ BOARD_MAX_ROWS * BOARD_MAX_COLUMNS ];
+};
+
+
+
+//
+// Picks where to put a column, and which way up.
+//
+// Every column the piece can reach is tried with each of its three rotations.
+// With depth 2, each of those is followed by numSamples random next columns -
+// the game doesn't show them - and the best reply to each; the move's value is
+// its points plus the average of those.  The boards it leaves are valued by the
+// matching bricks already side by side, less the height of the stack; a move that
+// ends the game is worth less than any that doesn't.
+//
+// The first moves are searched in parallel on the JobSystem, one job each.
+// Samples come from a generator seeded from params.seed and the move's index, so
+// the same search gives the same answer however it's split.
+//
+
+struct BoardSearchParams
+{
+    UINT32          depth;              // 1 or 2.
+    UINT32          numSamples;         // Next columns tried per move, at depth 2.
+    UINT32          numBrickTypes;      // Colors the next columns come in: g_pLevel->numBrickTypes.
+    UINT32          seed;
+    bool            isParallel;
+    BoardScoring    scoring;
+
+    BoardSearchParams();
+};
+
+
+struct BoardMove
+{
+    UINT8   x;                          // Column it lands in.
+    UINT8   y;                          // Row its bottom brick lands in.
+    UINT8   numRotations;               // RotateColumn()s before dropping it.
+    UINT32  points;                     // What dropping it there scores.
+    float   value;                      // points, plus what the search expects to follow.
+    bool    isGameOver;
+};
+
+
+class BoardSearch
+{
+public:
+    // The best place for pColumn, whose bottom brick is at (x, y); E_NOT_FOUND if it can't move.
+    static  RESULT  FindBestMove    ( IN const Board& board, IN const BYTE* pColumn, UINT32 x, UINT32 y, IN const BoardSearchParams& params, OUT BoardMove* pMove );
+
+    // Boards Place()d by every search so far.
+    static  INT64   GetNumPositions ( );
+
+protected:
+    struct Search
+    {
+        const Board*                pBoard;
+        const BoardSearchParams*    pParams;
+        BYTE                        columns[3][ NUM_BRICKS_PER_COLUMN ];    // Each rotation.
+        UINT32                      y;
+        UINT32                      numMoves;
+        BoardMove                   moves[ 3 * BOARD_MAX_COLUMNS ];
+    };
+
+    static  void    SearchMovesJob  ( void* pContext, UINT32 begin, UINT32 end );
+    static  float   BestReply       ( IN const Board& board, IN const BYTE* pColumn, IN const BoardSearchParams& params, INOUT INT64* pNumPositions );
+    static  float   Evaluate        ( IN const Board& board );
+    static  uint32_t NextRandom     ( INOUT uint32_t* pState );     // Not UINT32, which is 8 bytes on arm64.
+    static  MetricCounter*  GetPositionsMetric ( );
+
+private:
+    BoardSearch();
+    BoardSearch( const BoardSearch& rhs );
+    BoardSearch& operator=( const BoardSearch& rhs );
+};
+
+
+
+} // END namespace Z
@@ -9,6 +9,7 @@
 #include "GameState.hpp"
 #include "IdleState.hpp"
 #include "GameScreens.hpp"
+#include "GameSnapshot.hpp"
 
 
 #include "test.hpp"
@@ -74,6 +75,17 @@ Game::Start()
     // Load resources
     //
     Engine::LoadResources();
+
+
+    //
+    // Find the game in progress, if the app was killed while it was paused.
+    // GameScreens and ColumnState resume it.
+    //
+    GameSnapshot::Enable( GlobalSettings.GetBool( "/Settings.bResumeGame", false ) );
+    if (GameSnapshot::IsEnabled())
+    {
+        IGNOREHR(GameSnapshot::Load());
+    }
     
 
     //
@@ -116,6 +128,9 @@ Game::Stop()
 {
     RESULT rval = S_OK;
     
+    // Let the last snapshot finish writing.
+    GameSnapshot::Wait();
+
     CHR(GOMan.Release( s_hGameState ));
 //    SAFE_RELEASE(s_pGameState);
 
@@ -0,0 +1,337 @@
+/*
+ *  GameSnapshot.cpp
+ *  Critters
+ *
+ *  Binary save of the game in play, for resuming after the app is killed.
+ *
+ */
+
+#include "GameSnapshot.hpp"
+#include "FileManager.hpp"
+#include "Metrics.hpp"
+#include "Macros.hpp"
+#include "Log.hpp"
+#include "Platform.hpp"
+
+#include <string.h>
+#include <stddef.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+
+namespace Z
+{
+
+
+
+//
+// Static Data
+//
+bool                GameSnapshot::s_isEnabled       = false;
+string              GameSnapshot::s_path;
+GameSnapshotData    GameSnapshot::s_pending;
+GameSnapshotData    GameSnapshot::s_toWrite;
+GameSnapshotData    GameSnapshot::s_written;
+bool                GameSnapshot::s_isPending       = false;
+bool                GameSnapshot::s_isWritten       = false;
+bool                GameSnapshot::s_isResuming      = false;
+PerfTimer           GameSnapshot::s_resumeTimer;
+JobCounter          GameSnapshot::s_writeCounter;
+UINT32              GameSnapshot::s_backgroundTask  = 0;
+
+
+
+//
+// Class Methods
+//
+RESULT
+GameSnapshot::Load()
+{
+    static MetricHistogram* s_pLoadTimeMetric = Metrics::RegisterHistogram( "Snapshot.LoadMS" );
+
+    RESULT                  rval    = S_OK;
+    const GameSnapshotData* pData   = NULL;
+    void*                   pMapped = MAP_FAILED;
+    int                     fd      = -1;
+    struct stat             info;
+    string                  path;
+    PerfTimer               timer;
+
+    s_resumeTimer.Start();
+    timer.Start();
+
+    CHR(GetPath( &path ));
+
+    fd = open( path.c_str(), O_RDONLY );
+    CBREx(fd >= 0, E_FILE_NOT_FOUND);
+    CBREx(0 == fstat( fd, &info ) && info.st_size == (off_t)sizeof(GameSnapshotData), E_BAD_FILE_FORMAT);
+
+    pMapped = mmap( NULL, sizeof(GameSnapshotData), PROT_READ, MAP_PRIVATE, fd, 0 );
+    CBREx(MAP_FAILED != pMapped, E_FAIL);
+    pData = (const GameSnapshotData*)pMapped;
+
+    if (GAME_SNAPSHOT_MAGIC     != pData->magic   ||
+        GAME_SNAPSHOT_VERSION   != pData->version ||
+        sizeof(GameSnapshotData) != pData->size   ||
+        Checksum( *pData )      != pData->checksum)
+    {
+        RETAILMSG(ZONE_WARN, "WARNING: GameSnapshot::Load(): \"%s\" is stale or incomplete; ignoring it.", path.c_str());
+        rval = E_BAD_FILE_FORMAT;
+        goto Exit;
+    }
+
+    memcpy(&s_pending, pData, sizeof(GameSnapshotData));
+    memcpy(&s_written, pData, sizeof(GameSnapshotData));
+    s_isPending = true;
+    s_isWritten = true;
+
+    timer.Stop();
+    s_pLoadTimeMetric->Record( timer.ElapsedMilliseconds() );
+
+    RETAILMSG(ZONE_INFO, "GameSnapshot: loaded %zu bytes in %2.3f ms: level %u, score %u",
+        sizeof(GameSnapshotData), timer.ElapsedMilliseconds(), s_pending.level + 1, s_pending.totalScore);
+
+Exit:
+    if (MAP_FAILED != pMapped)
+    {
+        munmap( pMapped, sizeof(GameSnapshotData) );
+    }
+
+    if (fd >= 0)
+    {
+        close( fd );
+    }
+
+    return rval;
+}
+
+
+
+RESULT
+GameSnapshot::TakePending( OUT GameSnapshotData* pData )
+{
+    RESULT rval = S_OK;
+
+    CPREx(pData, E_NULL_POINTER);
+    CBREx(s_isPending, E_NOT_FOUND);
+
+    memcpy(pData, &s_pending, sizeof(GameSnapshotData));
+    s_isPending  = false;
+    s_isResuming = true;
+
+Exit:
+    return rval;
+}
+
+
+
+void
+GameSnapshot::EndResume()
+{
+    static MetricHistogram* s_pResumeTimeMetric = Metrics::RegisterHistogram( "Snapshot.ResumeMS" );
+
+    if (!s_isResuming)
+    {
+        return;
+    }
+
+    s_resumeTimer.Stop();
+    s_pResumeTimeMetric->Record( s_resumeTimer.ElapsedMilliseconds() );
+    s_isResuming = false;
+
+    RETAILMSG(ZONE_INFO, "GameSnapshot: %2.2f ms from loading the snapshot to the resumed game's first frame", s_resumeTimer.ElapsedMilliseconds());
+}
+
+
+
+RESULT
+GameSnapshot::Save( IN const GameSnapshotData& data )
+{
+    static MetricGauge* s_pBytesMetric = Metrics::RegisterGauge( "Snapshot.Bytes" );
+
+    RESULT rval = S_OK;
+
+    CHR(GetPath( &s_path ));
+
+    // One write in flight at a time; the worker still reads s_toWrite.
+    Wait();
+
+    memcpy(&s_toWrite, &data, sizeof(GameSnapshotData));
+    s_toWrite.magic     = GAME_SNAPSHOT_MAGIC;
+    s_toWrite.version   = GAME_SNAPSHOT_VERSION;
+    s_toWrite.size      = sizeof(GameSnapshotData);
+    s_toWrite.checksum  = Checksum( s_toWrite );
+
+    s_pBytesMetric->Set( sizeof(GameSnapshotData) );
+
+    // Saves come on the way into the background; ask iOS for the time to finish.
+    s_backgroundTask = Platform::BeginBackgroundTask();
+
+    CHR(JobSystem::Run( WriteJob, NULL, &s_writeCounter ));
+
+Exit:
+    return rval;
+}
+
+
+
+RESULT
+GameSnapshot::Discard()
+{
+    RESULT rval = S_OK;
+    string path;
+
+    Wait();
+
+    s_isPending = false;
+    s_isWritten = false;
+
+    CHR(GetPath( &path ));
+
+    if (0 != unlink( path.c_str() ) && ENOENT != errno)
+    {
+        RETAILMSG(ZONE_ERROR, "ERROR: GameSnapshot::Discard(): can't delete \"%s\"", path.c_str());
+        rval = E_ACCESS_DENIED;
+    }
+
+Exit:
+    return rval;
+}
+
+
+
+void
+GameSnapshot::Wait()
+{
+    JobSystem::Wait( &s_writeCounter );
+}
+
+
+
+void
+GameSnapshot::WriteJob( void* pContext )
+{
+    IGNOREHR(Write());
+
+    Platform::EndBackgroundTask( s_backgroundTask );
+}
+
+
+
+RESULT
+GameSnapshot::Write()
+{
+    static MetricCounter*   s_pBytesWrittenMetric   = Metrics::RegisterCounter  ( "Snapshot.BytesWritten" );
+    static MetricHistogram* s_pWriteTimeMetric      = Metrics::RegisterHistogram( "Snapshot.WriteMS"      );
+
+    RESULT      rval            = S_OK;
+    const BYTE* pNew            = (const BYTE*)&s_toWrite;
+    const BYTE* pOld            = (const BYTE*)&s_written;
+    bool        isIncremental   = s_isWritten;
+    size_t      numWritten      = 0;
+    size_t      offset;
+    size_t      size;
+    int         fd              = -1;
+    PerfTimer   timer;
+
+    timer.Start();
+
+    // Until the new header is down, the file doesn't hold s_written.
+    s_isWritten = false;
+
+    // s_path was set by Save(), on the main thread.  Unless we know what's there, start over.
+    fd = open( s_path.c_str(), O_WRONLY | O_CREAT | (isIncremental ? 0 : O_TRUNC), 0644 );
+    CBREx(fd >= 0, E_ACCESS_DENIED);
+
+    // The blocks that changed since the last write...
+    for (offset = GAME_SNAPSHOT_HEADER_SIZE; offset < sizeof(GameSnapshotData); offset += size)
+    {
+        size = MIN(GAME_SNAPSHOT_BLOCK_SIZE - offset % GAME_SNAPSHOT_BLOCK_SIZE, sizeof(GameSnapshotData) - offset);
+
+        if (isIncremental && !memcmp(pNew + offset, pOld + offset, size))
+        {
+            continue;
+        }
+
+        CBREx(pwrite( fd, pNew + offset, size, offset ) == (ssize_t)size, E_FAIL);
+        numWritten += size;
+    }
+
+    // ...on disk before the header that vouches for them, or a crash could leave
+    // a new header in front of old blocks.
+    CBREx(0 == fsync( fd ), E_FAIL);
+    CBREx(pwrite( fd, pNew, GAME_SNAPSHOT_HEADER_SIZE, 0 ) == (ssize_t)GAME_SNAPSHOT_HEADER_SIZE, E_FAIL);
+    CBREx(0 == fsync( fd ), E_FAIL);
+    numWritten += GAME_SNAPSHOT_HEADER_SIZE;
+
+    memcpy(&s_written, &s_toWrite, sizeof(GameSnapshotData));
+    s_isWritten = true;
+
+    timer.Stop();
+    s_pBytesWrittenMetric->Add( numWritten );
+    s_pWriteTimeMetric->Record( timer.ElapsedMilliseconds() );
+
+    RETAILMSG(ZONE_INFO, "GameSnapshot: wrote %zu of %zu bytes in %2.3f ms", numWritten, sizeof(GameSnapshotData), timer.ElapsedMilliseconds());
+
+Exit:
+    if (fd >= 0)
+    {
+        close( fd );
+    }
+
+    if (FAILED(rval))
+    {
+        RETAILMSG(ZONE_ERROR, "ERROR: GameSnapshot: failed writing \"%s\"", s_path.c_str());
+    }
+
+    return rval;
+}
+
+
+
+// 32-bit FNV-1a of everything after the header.  uint32_t, not UINT32: the
+// multiply must wrap at 32 bits, and UINT32 is 64 on arm64.
+uint32_t
+GameSnapshot::Checksum( IN const GameSnapshotData& data )
+{
+    const BYTE* pBytes  = (const BYTE*)&data;
+    uint32_t    hash    = 2166136261u;
+
+    for (size_t i = GAME_SNAPSHOT_HEADER_SIZE; i < sizeof(GameSnapshotData); ++i)
+    {
+        hash ^= pBytes[i];
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
+
+
+RESULT
+GameSnapshot::GetPath( OUT string* pPath )
+{
+    RESULT rval = S_OK;
+
+    CPREx(pPath, E_NULL_POINTER);
+
+    if (s_path.empty())
+    {
+        CHR(FileMan.GetAbsolutePath( STORAGE "game.snapshot", &s_path ));
+    }
+
+    if (pPath != &s_path)
+    {
+        *pPath = s_path;
+    }
+
+Exit:
+    return rval;
+}
+
+
+
+} // END namespace Z
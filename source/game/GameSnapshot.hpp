@@ -0,0 +1,161 @@
+#pragma once
+
+/*
+ *  GameSnapshot.hpp
+ *  Critters
+ *
+ *  Binary save of the game in play, for resuming after the app is killed.
+ *
+ */
+
+#include "Types.hpp"
+#include "GameState.hpp"
+#include "BoardSearch.hpp"
+#include "JobSystem.hpp"
+#include "PerfTimer.hpp"
+
+#include <string>
+using std::string;
+
+
+namespace Z
+{
+
+
+//
+// Everything ColumnState needs to put a game back: score and level, the
+// GameMap's bricks, the column in play, how far its storyboards had run, and
+// the delayed messages it had sent itself.
+//
+// The file is GameSnapshotData as it sits in memory - fixed size, fixed-width
+// fields, no pointers - and Load() maps it in one go.  Bump GAME_SNAPSHOT_VERSION
+// whenever the layout changes; an old file is then ignored rather than misread.
+//
+// Save() copies the snapshot and returns; a JobSystem worker writes it, as an iOS
+// background task so that a save on the way into the background gets to finish.
+// Only the blocks that differ from the last snapshot written go to disk, and they
+// are synced before the header goes last.  Its checksum covers the rest, so if
+// the app is killed part way through, Load() finds a mismatch and the player
+// starts a new game instead of a garbled one.
+//
+// Off by default: ColumnState neither saves nor discards, and Game doesn't load;
+// enable with Settings.bResumeGame = "1".
+//
+
+#define GAME_SNAPSHOT_MAGIC             0x4E534343      // "CCSN"
+#define GAME_SNAPSHOT_VERSION           2
+#define GAME_SNAPSHOT_MAX_STORYBOARDS   8
+#define GAME_SNAPSHOT_MAX_MESSAGES      32
+#define GAME_SNAPSHOT_BLOCK_SIZE        64              // Unit of the incremental writes.
+
+
+struct GameSnapshotStoryboard
+{
+    uint32_t    elapsedMS;
+    uint8_t     isStarted;
+    uint8_t     pad[3];
+};
+
+
+struct GameSnapshotMessage
+{
+    uint32_t    name;                           // MSG_Name
+    int32_t     data;
+    float       delay;                          // Seconds until it was due.
+    uint8_t     hasData;
+    uint8_t     pad[3];
+};
+
+
+struct GameSnapshotData
+{
+    uint32_t                magic;
+    uint32_t                version;
+    uint32_t                size;               // sizeof(GameSnapshotData)
+    uint32_t                checksum;           // Of everything after the header.
+
+    // Score and level.
+    uint32_t                level;              // g_level
+    uint32_t                difficulty;
+    uint32_t                totalScore;
+    uint32_t                scoreToLevelUp;
+    uint32_t                numLinesCleared;
+    uint32_t                numBlocksCleared;
+    uint32_t                numChains;
+    uint32_t                gameTimeMS;         // Since g_startGameTime.
+    uint32_t                state;              // The ColumnState state to resume in.
+
+    // The GameMap, one BOARD_CELL per cell; row 0 is the bottom.
+    uint8_t                 width;
+    uint8_t                 height;
+    uint8_t                 cells[ BOARD_MAX_ROWS * BOARD_MAX_COLUMNS ];
+
+    // The column in play, top brick first.  None once it has landed.
+    uint8_t                 hasColumn;
+    uint8_t                 column[ NUM_BRICKS_PER_COLUMN ];
+    float                   columnX;            // World position of the top brick.
+    float                   columnY;
+
+    uint32_t                numStoryboards;
+    GameSnapshotStoryboard  storyboards[ GAME_SNAPSHOT_MAX_STORYBOARDS ];
+
+    uint32_t                numMessageNames;    // MSG_NUM when saved; the messages are dropped if it has changed.
+    uint32_t                numMessages;
+    GameSnapshotMessage     messages[ GAME_SNAPSHOT_MAX_MESSAGES ];
+};
+
+#define GAME_SNAPSHOT_HEADER_SIZE       (4 * sizeof(uint32_t))
+
+
+
+class GameSnapshot
+{
+public:
+    static  void    Enable          ( bool enabled )    { s_isEnabled = enabled; }
+    static  bool    IsEnabled       ( )                 { return s_isEnabled; }
+
+    // Read the saved game, if any, at startup.  It waits for TakePending().
+    static  RESULT  Load            ( );
+    static  bool    IsPending       ( )     { return s_isPending; }
+    static  RESULT  TakePending     ( OUT GameSnapshotData* pData );
+
+    // The resumed game's first frame; records how long the resume took.
+    static  void    EndResume       ( );
+
+    // Copy pData and write it in the background.
+    static  RESULT  Save            ( IN const GameSnapshotData& data );
+
+    // The game is over or abandoned: nothing to resume.
+    static  RESULT  Discard         ( );
+
+    // Until the last Save() is on disk.
+    static  void    Wait            ( );
+
+protected:
+    static  void    WriteJob        ( void* pContext );
+    static  RESULT  Write           ( );
+    static  uint32_t Checksum       ( IN const GameSnapshotData& data );
+    static  RESULT  GetPath         ( OUT string* pPath );
+
+protected:
+    static  bool                s_isEnabled;
+    static  string              s_path;
+    static  GameSnapshotData    s_pending;      // Loaded, not yet taken.
+    static  GameSnapshotData    s_toWrite;
+    static  GameSnapshotData    s_written;      // What the file holds, if s_isWritten.
+    static  bool                s_isPending;
+    static  bool                s_isWritten;
+    static  bool                s_isResuming;
+    static  PerfTimer           s_resumeTimer;  // From Load() to EndResume().
+    static  JobCounter          s_writeCounter;
+    static  UINT32              s_backgroundTask;   // Platform::BeginBackgroundTask() for the write in flight.
+
+private:
+    GameSnapshot();
+    GameSnapshot( const GameSnapshot& rhs );
+    GameSnapshot& operator=( const GameSnapshot& rhs );
+};
+
+
+
+} // END namespace Z
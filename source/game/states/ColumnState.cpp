@@ -13,6 +13,8 @@
 #include "RippleEffect.hpp" 
 #include "Achievements.hpp"
 #include "BoxedVariable.hpp"
+#include "BoardSearch.hpp"
+#include "GameSnapshot.hpp"
 
 #include <stddef.h> // for sprintf()
 
@@ -53,6 +55,8 @@ static UINT8    g_numChains               = 0;
 static INT32    g_numDroppingBricks       = 0;
 static UINT32   g_currentDropDurationMS   = 0;
 static bool     g_levelledUp              = false;    // user has levelled up, display a storyboard when done dropping blocks.
+static bool     g_isAutoplay              = false;    // Settings.bAutoplay: BoardSearch plays every column, for soak tests.
+static bool     g_showHints               = false;    // Settings.bShowHints: highlight where BoardSearch would put each column.
 
 static HGameObjectSet g_smashedBricks;
 
@@ -85,6 +89,20 @@ static HStoryboard      hDropColumnStoryboard;
 static HStoryboard      hAwesomeRippleStoryboard;
 static HStoryboard      hUpdateScoreStoryboard;
 
+// The storyboards a GameSnapshot records, in order.  The camera's are bound as they're started.
+static const struct
+{
+    HStoryboard*    pHandle;
+    bool            isBoundToCamera;
+} g_snapshotStoryboards[] =
+{
+    { &hDropColumnStoryboard,       false   },
+    { &hUpdateScoreStoryboard,      false   },
+    { &hCameraShakeStoryboard,      true    },
+    { &hCameraZoomStoryboard,       true    },
+    { &hSmashCameraShakeStoryboard, true    },
+};
+
 static HSound           hSlideLeft;
 static HSound           hSlideRight;
 static HSound           hSlideDown;
@@ -308,25 +326,30 @@ ColumnState::CreateBrickOfType( BrickType* pBrickType, WORLD_POSITION position,
 {
     RESULT      rval = S_OK;
     HGameObject handle;
-    char        brickName[MAX_NAME];
 
     CPR(pBrickType);
     CPR(pHGameObject);
     CPR(pBrickType->spriteName);
 
-    sprintf( brickName, "%s_%X", pBrickType->spriteName, (unsigned int)Platform::Random());
+    // Smashed bricks go back to their type's pool, and new ones come out of it.
+    if (PREFAB_NONE == pBrickType->prefab)
+    {
+        CHR(GOMan.CreatePrefab( pBrickType->spriteName,                 // IN:  name
+                                &pBrickType->prefab,                    // OUT: prefab
+                                pBrickType->spriteName,                 // IN:  sprite name
+                                "",                                     // IN:  mesh name
+                                "",                                     // IN:  effect name
+                                pBrickType->behaviorName,               // IN:  behavior name
+                                pBrickType->goType,                     // IN:  GO_TYPE
+                                true                                    // IN:  hasShadow
+                              ));
+    }
 
-    CHR(GOMan.Create(   brickName,                                      // IN:  name for this GameObject
+    CHR(GOMan.Spawn(    pBrickType->prefab,                             // IN:  prefab
                         &handle,                                        // OUT: handle
-                        pBrickType->spriteName,                         // IN:  sprite name
-                        "",                                             // IN:  mesh name
-                        "",                                             // IN:  effect name
-                        pBrickType->behaviorName,                       // IN:  behavior name
-                        pBrickType->goType,                             // IN:  GO_TYPE
                         position,                                       // IN:  world position
                         1.0f,                                           // IN:  opacity,
-                        Color::White(),                                 // IN:  color,
-                        true                                            // IN:  hasShadow
+                        Color::White()                                  // IN:  color,
                     ));
 
     // Add Brick to the screen (does not take a reference)
@@ -344,10 +367,10 @@ ColumnState::CreateBrickOfType( BrickType* pBrickType, WORLD_POSITION position,
 //        GameObjects.AddChild(handle, hSwirl);
 //    }
 
-    // Each brick registers for tap notifications:
-    TouchScreen.AddListener( handle, MSG_TouchBegin  );
-    TouchScreen.AddListener( handle, MSG_TouchUpdate );
-    TouchScreen.AddListener( handle, MSG_TouchEnd    );
+    // Each brick registers for taps that land on it:
+    TouchScreen.AddHitListener( handle, MSG_TouchBegin  );
+    TouchScreen.AddHitListener( handle, MSG_TouchUpdate );
+    TouchScreen.AddHitListener( handle, MSG_TouchEnd    );
     
 
     *pHGameObject = handle;
@@ -763,6 +786,392 @@ ColumnState::TimeUntilDrop()
 
 
 
+//=============================================================================
+//
+// Ask BoardSearch where the column in play should go: a copy of the map, the
+// column as it stands, and the current level's colors and scoring.
+//
+//=============================================================================
+RESULT
+ColumnState::FindBestMove( OUT BoardMove* pMove )
+{
+    RESULT              rval    = S_OK;
+    Board               board;
+    BoardSearchParams   params;
+    BYTE                column[ NUM_BRICKS_PER_COLUMN ];
+    MAP_POSITION        mapPos;
+
+    CPR(pMove);
+
+    g_pGameMap->Update();
+    CHR(board.Init( g_pGameMap ));
+
+    for (int i = 0; i < NUM_BRICKS_PER_COLUMN; ++i)
+    {
+        column[i] = Board::CellFromType( GOMan.GetType( hColumnBricks[i] ) );
+    }
+
+    g_pGameMap->WorldToMapPosition( GOMan.GetPosition( hColumnBricks[NUM_BRICKS_PER_COLUMN-1] ), &mapPos );
+
+    params.numBrickTypes                = g_pLevel->numBrickTypes;
+    params.seed                         = Platform::Random();
+    params.scoring.levelMultiplier      = g_pLevel->scoreMultiplier;
+    params.scoring.difficultyMultiplier = g_difficultyMultiplier;
+
+    CHR(BoardSearch::FindBestMove( board, column, mapPos.x, mapPos.y, params, pMove ));
+
+Exit:
+    return rval;
+}
+
+
+
+//=============================================================================
+//
+// Rotate and slide the new column to where BoardSearch would put it.
+// STATE_DropColumn then drops it to the bottom.
+//
+//=============================================================================
+void
+ColumnState::Autoplay()
+{
+    BoardMove       move;
+    MAP_POSITION    mapPos;
+
+    if (FAILED(FindBestMove( &move )))
+    {
+        return;
+    }
+
+    for (int i = 0; i < move.numRotations; ++i)
+    {
+        RotateColumn();
+    }
+
+    // Stop short if something's in the way.
+    g_pGameMap->WorldToMapPosition( GOMan.GetPosition( hColumnBricks[NUM_BRICKS_PER_COLUMN-1] ), &mapPos );
+
+    while (mapPos.x < move.x && MoveColumnRight())
+    {
+        mapPos.x++;
+    }
+
+    while (mapPos.x > move.x && MoveColumnLeft())
+    {
+        mapPos.x--;
+    }
+}
+
+
+
+//=============================================================================
+//
+// Flash a highlight where BoardSearch would land the new column.
+//
+//=============================================================================
+void
+ColumnState::ShowHint()
+{
+    BoardMove       move;
+    WORLD_POSITION  pos;
+    HGameObject     handle;
+
+    if (FAILED(FindBestMove( &move )))
+    {
+        return;
+    }
+
+    RETAILMSG(ZONE_INFO, "ColumnState: hint: column %d, %d rotations, %d points", move.x, move.numRotations, move.points);
+
+    // Centered on the middle brick, as RotateColumn() centers its swoosh.
+    g_pGameMap->MapToWorldPosition( move.x, move.y + 1, &pos, false );
+    GOMan.Create( "critters_highlight", "RotateColumnSwoosh", hPlayScreenGrid, pos, &handle, 1.0, Color::LightBlue() );
+
+    GOMan.SetScale( handle, 1.5f );
+    AABB bounds = GOMan.GetBounds(handle);
+    pos.x -= bounds.GetWidth()/2;
+    pos.y -= bounds.GetHeight()/2;
+    pos.x += COLUMN_BRICK_WIDTH/2;
+    pos.y += COLUMN_BRICK_HEIGHT/2;
+
+    GOMan.SetPosition( handle, pos );
+}
+
+
+
+//=============================================================================
+//
+// The BrickType that creates bricks of the given type; NULL if there isn't one.
+//
+//=============================================================================
+BrickType*
+ColumnState::FindBrickType( GO_TYPE type )
+{
+    for (UINT32 i = 0; i < g_numBrickTypes; ++i)
+    {
+        if (g_brickTypes[i].goType == type)
+        {
+            return &g_brickTypes[i];
+        }
+    }
+
+    for (UINT32 i = 0; i < g_numSpecialBrickTypes; ++i)
+    {
+        if (g_specialBrickTypes[i].goType == type)
+        {
+            return &g_specialBrickTypes[i];
+        }
+    }
+
+    return NULL;
+}
+
+
+
+//=============================================================================
+//
+// Save the game as it stands, so it can be resumed if the app is killed
+// while paused.  Called on MSG_PauseGame, before changing to STATE_Paused.
+//
+//=============================================================================
+RESULT
+ColumnState::SaveSnapshot()
+{
+    RESULT              rval        = S_OK;
+    Board               board;
+    MSG_Object          msgs[ GAME_SNAPSHOT_MAX_MESSAGES ];
+    GameSnapshotData    snapshot;
+    UINT32              numMsgs;
+    double              now;
+
+    // A game is in play in these; anywhere else there's nothing to resume.
+    switch (g_stateWhenUnpaused)
+    {
+        case STATE_CreateColumn:
+        case STATE_DropColumn:
+        case STATE_LandColumn:
+        case STATE_DropAllBricks:
+        case STATE_SmashBricks:
+        case STATE_CheckForCompletedLines:
+        case STATE_ShowCompletedLines:
+        case STATE_ClearCompletedLines:
+        case STATE_LevelUp:
+            break;
+
+        default:
+            goto Exit;
+    }
+
+    // Zeroed, padding and all, so unchanged blocks compare equal.
+    memset(&snapshot, 0, sizeof(snapshot));
+
+    snapshot.level              = g_level;
+    snapshot.difficulty         = g_difficulty;
+    snapshot.totalScore         = g_totalScore;
+    snapshot.scoreToLevelUp     = g_scoreToLevelUp;
+    snapshot.numLinesCleared    = g_gameNumLinesCleared;
+    snapshot.numBlocksCleared   = g_gameNumBlocksCleared;
+    snapshot.numChains          = g_gameNumChains;
+    snapshot.gameTimeMS         = (UINT32)(GameTime.GetTime() - g_startGameTime);
+
+    // The column is still in play until it lands; after that it's part of the map,
+    // and the game picks up by dropping whatever is left hanging.
+    if (STATE_CreateColumn == g_stateWhenUnpaused || STATE_DropColumn == g_stateWhenUnpaused)
+    {
+        WORLD_POSITION pos = GOMan.GetPosition( hColumnBricks[0] );
+
+        for (int i = 0; i < NUM_BRICKS_PER_COLUMN; ++i)
+        {
+            snapshot.column[i] = Board::CellFromType( GOMan.GetType( hColumnBricks[i] ) );
+        }
+
+        snapshot.hasColumn  = 1;
+        snapshot.columnX    = pos.x;
+        snapshot.columnY    = pos.y;
+        snapshot.state      = STATE_DropColumn;
+    }
+    else
+    {
+        snapshot.state      = STATE_DropAllBricks;
+    }
+
+    g_pGameMap->Update();
+    CHR(board.Init( g_pGameMap ));
+
+    snapshot.width  = (UINT8)board.GetWidth();
+    snapshot.height = (UINT8)board.GetHeight();
+    for (UINT32 y = 0; y < board.GetHeight(); ++y)
+    {
+        for (UINT32 x = 0; x < board.GetWidth(); ++x)
+        {
+            snapshot.cells[ y*BOARD_MAX_COLUMNS + x ] = board.GetCell( x, y );
+        }
+    }
+
+    for (UINT32 i = 0; i < ARRAY_SIZE(g_snapshotStoryboards); ++i)
+    {
+        HStoryboard hStoryboard = *g_snapshotStoryboards[i].pHandle;
+
+        if (!hStoryboard.IsNull() && StoryboardMan.IsStarted( hStoryboard ))
+        {
+            snapshot.storyboards[i].isStarted = 1;
+            snapshot.storyboards[i].elapsedMS = (UINT32)StoryboardMan.GetElapsedMS( hStoryboard );
+        }
+    }
+    snapshot.numStoryboards = ARRAY_SIZE(g_snapshotStoryboards);
+
+    // Pausing purged the messages scoped to our state and substate; what's left
+    // was sent to the whole StateMachine.  Timers and pointers can't be saved.
+    numMsgs = MsgRouter.GetDelayedMsgs( m_owner->GetID(), msgs, GAME_SNAPSHOT_MAX_MESSAGES );
+    now     = GameTime.GetTimeDouble();
+
+    for (UINT32 i = 0; i < numMsgs; ++i)
+    {
+        MSG_Object* pMsg = &msgs[i];
+        MSG_Data    data = pMsg->GetMsgData();
+
+        if (SCOPE_TO_STATE_MACHINE != pMsg->GetScopeRule() || pMsg->IsTimer() || data.IsPointer() || data.IsFloat())
+        {
+            continue;
+        }
+
+        GameSnapshotMessage* pSaved = &snapshot.messages[ snapshot.numMessages++ ];
+        pSaved->name    = pMsg->GetName();
+        pSaved->hasData = data.IsInt();
+        pSaved->data    = data.IsInt() ? data.GetInt() : 0;
+        pSaved->delay   = (float)MAX(0.0, pMsg->GetDeliveryTime() - now);
+    }
+    snapshot.numMessageNames = MSG_NUM;
+
+    CHR(GameSnapshot::Save( snapshot ));
+
+Exit:
+    return rval;
+}
+
+
+
+//=============================================================================
+//
+// Put back the game GameSnapshot loaded at startup, then carry on as if
+// unpausing it.
+//
+//=============================================================================
+RESULT
+ColumnState::ResumeGame()
+{
+    RESULT              rval = S_OK;
+    GameSnapshotData    snapshot;
+    WORLD_POSITION      pos;
+    HGameObject         hBrick;
+
+    CHR(GameSnapshot::TakePending( &snapshot ));
+    CBREx(snapshot.level < g_numLevels, E_INVALID_DATA);
+    CBREx(snapshot.width == g_pGameMap->GetWidth() && snapshot.height <= g_pGameMap->GetHeight(), E_INVALID_DATA);
+
+    RETAILMSG(ZONE_INFO, "ColumnState: resuming level %d, score %d", snapshot.level + 1, snapshot.totalScore);
+
+    g_level                 = snapshot.level;
+    g_pLevel                = &g_levels[ g_level ];
+    g_difficulty            = snapshot.difficulty;
+    g_totalScore            = snapshot.totalScore;
+    g_scoreToLevelUp        = snapshot.scoreToLevelUp;
+    g_gameNumLinesCleared   = snapshot.numLinesCleared;
+    g_gameNumBlocksCleared  = snapshot.numBlocksCleared;
+    g_gameNumChains         = snapshot.numChains;
+    g_startGameTime         = GameTime.GetTime() - MIN((UINT64)snapshot.gameTimeMS, GameTime.GetTime());
+    g_numDroppingBricks     = 0;
+
+    g_pGameMap->Clear();
+
+    // Landed bricks go in the grid, as STATE_LandColumn leaves them.
+    for (UINT32 y = 0; y < snapshot.height; ++y)
+    {
+        for (UINT32 x = 0; x < snapshot.width; ++x)
+        {
+            BrickType* pBrickType = FindBrickType( Board::TypeFromCell( snapshot.cells[ y*BOARD_MAX_COLUMNS + x ] ) );
+            if (!pBrickType)
+            {
+                continue;
+            }
+
+            g_pGameMap->MapToWorldPosition( x, y, &pos, false );
+            CHR(CreateBrickOfType( pBrickType, pos, &hBrick ));
+
+            g_pGameMap->AddGameObject( hBrick );
+            LayerMan.AddToLayer     ( hPlayScreenGrid,   hBrick );
+            LayerMan.RemoveFromLayer( hPlayScreenColumn, hBrick );
+            hBrick.Release();
+        }
+    }
+
+    if (snapshot.hasColumn)
+    {
+        pos = WORLD_POSITION( snapshot.columnX, snapshot.columnY, 0 );
+
+        for (int i = 0; i < NUM_BRICKS_PER_COLUMN; ++i)
+        {
+            BrickType* pBrickType = FindBrickType( Board::TypeFromCell( snapshot.column[i] ) );
+            CPREx(pBrickType, E_INVALID_DATA);
+
+            CHR(CreateBrickOfType( pBrickType, pos, &hColumnBricks[i] ));
+            pos.y -= COLUMN_BRICK_HEIGHT;
+        }
+    }
+
+    g_pGameMap->Update();
+
+    for (UINT32 i = 0; i < ARRAY_SIZE(g_snapshotStoryboards) && i < snapshot.numStoryboards; ++i)
+    {
+        HStoryboard hStoryboard = *g_snapshotStoryboards[i].pHandle;
+
+        if (hStoryboard.IsNull() || !snapshot.storyboards[i].isStarted)
+        {
+            continue;
+        }
+
+        if (g_snapshotStoryboards[i].isBoundToCamera)
+        {
+            StoryboardMan.BindTo( hStoryboard, &GameCamera );
+        }
+
+        StoryboardMan.Start( hStoryboard, snapshot.storyboards[i].elapsedMS );
+    }
+
+    // Message numbers change between builds; don't deliver the wrong ones.
+    if (MSG_NUM == snapshot.numMessageNames)
+    {
+        for (UINT32 i = 0; i < snapshot.numMessages && i < GAME_SNAPSHOT_MAX_MESSAGES; ++i)
+        {
+            const GameSnapshotMessage* pSaved = &snapshot.messages[i];
+
+            if (pSaved->name < MSG_NUM)
+            {
+                SendMsgDelayedToStateMachine( pSaved->delay, (MSG_Name)pSaved->name, pSaved->data );
+            }
+        }
+    }
+
+    SendMsgToStateMachine( MSG_UpdateScore );
+
+    g_stateWhenUnpaused = (Z::StateName)snapshot.state;
+    ChangeState( STATE_ResumeFromPause );
+
+Exit:
+    if (FAILED(rval))
+    {
+        RETAILMSG(ZONE_ERROR, "ERROR: ColumnState::ResumeGame(): snapshot doesn't fit this game; starting over");
+        if (GameSnapshot::IsEnabled())
+        {
+            IGNOREHR(GameSnapshot::Discard());
+        }
+    }
+
+    return rval;
+}
+
+
+
 //=============================================================================
 //
 // Test bottom-most brick for collision with neighbors.
@@ -1662,6 +2071,10 @@ BeginStateMachine
 //            LayerMan.AddToLayer     ( hPlayScreenGrid,   hColumnBricks[i] );
 //            LayerMan.RemoveFromLayer( hPlayScreenColumn, hColumnBricks[i] );
 //        }
+        if (GameSnapshot::IsEnabled())
+        {
+            IGNOREHR(GameSnapshot::Discard());
+        }
         ChangeState( STATE_GameOver );
 
 
@@ -1760,6 +2173,13 @@ BeginStateMachine
             }
 
             RETAILMSG(ZONE_INFO, "Pausing ColumnState; resume will change to state %d", g_stateWhenUnpaused);
+
+            // In case we're killed before the player comes back.
+            if (!g_isTutorialMode && GameSnapshot::IsEnabled())
+            {
+                IGNOREHR(SaveSnapshot());
+            }
+
             ChangeState( STATE_Paused );
         }
                 
@@ -1769,6 +2189,11 @@ BeginStateMachine
 
         RETAILMSG(ZONE_STATEMACHINE, "ColumnState: MSG_NewGame");
 
+        if (GameSnapshot::IsEnabled())
+        {
+            IGNOREHR(GameSnapshot::Discard());
+        }
+
         //
         // Reset stats.
         //
@@ -1809,6 +2234,12 @@ BeginStateMachine
 
     #pragma mark MSG_GameScreenHome
     OnMsg( MSG_GameScreenHome )
+        // The player has quit this game.
+        if (GameSnapshot::IsEnabled())
+        {
+            IGNOREHR(GameSnapshot::Discard());
+        }
+
         // Release any bricks that were in play from previous game.
         for (int i = 0; i < NUM_BRICKS_PER_COLUMN; ++i)
         {
@@ -1912,7 +2343,23 @@ BeginStateMachine
                 g_pGameMap->EnableDebugDisplay( true );
             }
 
-            ChangeState( STATE_Idle );
+            g_isAutoplay = GlobalSettings.GetBool( "/Settings.bAutoplay",  false );
+            g_showHints  = GlobalSettings.GetBool( "/Settings.bShowHints", false );
+
+            // Pick up where the player left off if the app was killed while paused.
+            // ResumeGame() changes state; if it can't, start a new game instead.
+            if (GameSnapshot::IsPending() && !g_isTutorialMode)
+            {
+                if (FAILED(ResumeGame()))
+                {
+                    ChangeState( STATE_Idle );
+                    GOMan.SendMessageFromSystem( MSG_NewGame );
+                }
+            }
+            else
+            {
+                ChangeState( STATE_Idle );
+            }
 	
 
 	///////////////////////////////////////////////////////////////
@@ -1952,6 +2399,10 @@ BeginStateMachine
             {
                 ChangeStateDelayed(1.0f, g_stateWhenUnpaused);
             }
+
+        OnFrameUpdate
+            // A resumed game is on screen.
+            GameSnapshot::EndResume();
     
     
     ///////////////////////////////////////////////////////////////
@@ -2033,6 +2484,15 @@ BeginStateMachine
             }
             else
             {
+                if (g_isAutoplay)
+                {
+                    Autoplay();
+                }
+                else if (g_showHints)
+                {
+                    ShowHint();
+                }
+
                 ChangeStateDelayed( TimeUntilDrop(), STATE_DropColumn );
             }
 
@@ -2146,7 +2606,13 @@ BeginStateMachine
             g_pGameMap->Update();
             
             // Check for collision.
-            if ( CollisionCheck() & COLLISION_BELOW )
+            if ( g_isAutoplay && !(CollisionCheck() & COLLISION_BELOW) )
+            {
+                // Autoplay() has put it where it's going.
+                DropColumnToBottom();
+                ChangeState( STATE_LandColumn );
+            }
+            else if ( CollisionCheck() & COLLISION_BELOW )
             {
 //                //
 //                // Check for GAME OVER
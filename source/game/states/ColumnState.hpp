@@ -7,6 +7,8 @@
 namespace Z
 {
 
+struct BoardMove;
+
 
 //
 // This StateMachine controls the behavior of the Column currently in-play.
@@ -47,6 +49,16 @@ private:
     void                RotateColumn        ( );
     bool                CheckForLevelUp     ( );
 
+    // Where BoardSearch would put the column in play.
+    RESULT              FindBestMove        ( OUT BoardMove* pMove );
+    void                Autoplay            ( );
+    void                ShowHint            ( );
+
+    // Save the game in play for GameSnapshot, and put a saved one back.
+    RESULT              SaveSnapshot        ( );
+    RESULT              ResumeGame          ( );
+    static BrickType*   FindBrickType       ( GO_TYPE type );
+
     float               TimeUntilDrop       ( );
 
     bool                WasColumnTouched    ( TouchEvent* pTouchEvent );
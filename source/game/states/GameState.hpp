@@ -54,6 +54,7 @@ struct BrickType
     const char*     behaviorName;
     GO_TYPE         goType;
     float           probability;
+    PrefabID        prefab;         // Created by the first brick of this type.
 };
 extern BrickType g_brickTypes[];
 extern BrickType g_specialBrickTypes[];
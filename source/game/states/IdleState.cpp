@@ -59,7 +59,7 @@ BeginStateMachine
 		OnEnter
             //RETAILMSG(ZONE_STATEMACHINE, "IdleState: STATE_Idle");
 
-        OnFrameUpdate
+        // No OnFrameUpdate, so the StateMachine's dispatch table lets idle objects skip frame updates.
 
 EndStateMachine
 }
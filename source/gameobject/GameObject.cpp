@@ -3,6 +3,8 @@
 #include "StoryboardManager.hpp"
 #include "StateMachine.hpp"
 #include "Engine.hpp"
+#include "Culling.hpp"
+#include "Transforms.hpp"
 
 namespace Z 
 {
@@ -40,6 +42,7 @@ DECLARE_PROPERTY_SET( GameObject, s_propertyTable );
 GameObject::GameObject( GO_TYPE type ) :
     m_type(type),
     m_isMarkedForDeletion(false),
+    m_isParallelUpdate(false),
     m_vWorldPosition(0,0,0),
     m_vRotation(0,0,0),
     m_fScale(1.0f),
@@ -48,7 +51,10 @@ GameObject::GameObject( GO_TYPE type ) :
     m_isVisible(true),
     m_hasShadow(false),
     m_spriteFrame(0),
-    m_pStateMachineManager(NULL)
+    m_pStateMachineManager(NULL),
+    m_transform(Transforms::Create()),
+    m_prefab(PREFAB_NONE),
+    m_row(GAMEOBJECT_ROW_NONE)
 {
     DEBUGMSG(ZONE_GAMEOBJECT | ZONE_VERBOSE, "\tnew GameObject( %4d )", m_ID);
     
@@ -91,6 +97,94 @@ GameObject::~GameObject()
 
 
     SAFE_DELETE(m_pStateMachineManager);
+
+    Transforms::Destroy( m_transform );
+}
+
+
+
+UINT32
+GameObject::Release()
+{
+    // The last reference to a pooled GameObject; GOMan may take it back rather than delete it.
+    if (PREFAB_NONE != m_prefab && 1 == m_refCount && GOMan.Recycle( this ))
+    {
+        m_refCount = 0;
+        return 0;
+    }
+
+    return Object::Release();
+}
+
+
+
+void
+GameObject::Recycle()
+{
+    //
+    // Free the children, as ~GameObject() would, but keep our own Sprite, Mesh,
+    // Effect, transform and StateMachineManager for the next life.
+    //
+    for (HGameObjectListIterator pHGameObject = m_hGameObjectChildren.begin(); pHGameObject != m_hGameObjectChildren.end(); ++pHGameObject)
+    {
+        GOMan.Release( *pHGameObject );
+    }
+
+    for (HSpriteListIterator pHSprite = m_hSpriteChildren.begin(); pHSprite != m_hSpriteChildren.end(); ++pHSprite)
+    {
+        SpriteMan.Release( *pHSprite );
+    }
+
+    for (HParticleEmitterListIterator pHParticleEmitter = m_hParticleEmitterChildren.begin(); pHParticleEmitter != m_hParticleEmitterChildren.end(); ++pHParticleEmitter)
+    {
+        Particles.Stop( *pHParticleEmitter );
+        Particles.Release( *pHParticleEmitter );
+    }
+
+    m_hGameObjectChildren.clear();
+    m_hSpriteChildren.clear();
+    m_hParticleEmitterChildren.clear();
+
+    if (m_pStateMachineManager)
+    {
+        m_pStateMachineManager->Clear();
+    }
+
+    // A new ID: delayed messages, touch listeners and slices addressed to the
+    // old one miss us, as they would have missed a deleted GameObject.
+    m_ID = ATOMIC_INCREMENT(s_nextAvailableID);
+
+    m_isMarkedForDeletion = false;
+    m_isParallelUpdate    = false;
+    m_isVisible           = true;
+    GOMan.UpdateRow( this );
+
+    SetRotation( vec3(0,0,0) );
+    SetScale   ( 1.0f );
+
+    if (!m_hSprite.IsNull())
+    {
+        SetSpriteFrame( 0 );
+    }
+}
+
+
+
+void
+GameObject::MarkForDeletion()
+{
+    m_isMarkedForDeletion = true;
+    GOMan.UpdateRow( this );
+}
+
+
+
+
+void
+GameObject::SetParallelUpdate( bool parallel )
+{
+    m_isParallelUpdate = parallel;
+    GOMan.UpdateRow( this );
 }
 
 
@@ -175,6 +269,7 @@ GameObject::SetSprite( HSprite hSprite )
         CHR(SpriteMan.AddRef( m_hSprite ));
         
         m_bounds = SpriteMan.GetBounds( m_hSprite );
+        Culling::Invalidate();
     }
 
 Exit:
@@ -228,6 +323,7 @@ GameObject::AddChild( HSprite hSprite )
         m_hSpriteChildren.push_back( hSprite );
         
         CHR(SpriteMan.AddRef( hSprite ));
+        Culling::Invalidate();
         
         // TODO: update bounding box to include children?
     }
@@ -252,6 +348,7 @@ GameObject::AddChild( HGameObject hGameObject )
         m_hGameObjectChildren.push_back( hGameObject );
         
         CHR(GOMan.AddRef( hGameObject ));
+        Culling::Invalidate();
         
         // TODO: update bounding box to include children?
     }
@@ -276,6 +373,7 @@ GameObject::AddChild( HParticleEmitter hParticleEmitter )
         m_hParticleEmitterChildren.push_back( hParticleEmitter );
         
         CHR(Particles.AddRef( hParticleEmitter ));
+        Culling::Invalidate();
         
         // TODO: update bounding box to include children?
     }
@@ -380,6 +478,7 @@ GameObject::SetStateMachineManager( StateMachineManager* pStateMachineManager )
     
     SAFE_DELETE(m_pStateMachineManager);
     m_pStateMachineManager = pStateMachineManager;
+    GOMan.UpdateRow( this );
     
 Exit:
     return rval;
@@ -405,6 +504,8 @@ GameObject::CreateStateMachineManager()
         rval = E_OUTOFMEMORY;
         goto Exit;
     }
+
+    GOMan.UpdateRow( this );
     
 Exit:
     return rval;
@@ -444,14 +545,8 @@ GameObject::Draw( const mat4& matParentWorld )
     if (Util::CompareFloats( m_fOpacity, 0.0f ))
         return rval;
 
-    mat4 world;
-    world *= mat4::Scale    ( m_fScale      );
-    world *= mat4::RotateX  ( m_vRotation.x ); 
-    world *= mat4::RotateY  ( m_vRotation.y ); 
-    world *= mat4::RotateZ  ( m_vRotation.z ); 
-    world *= mat4::Translate( m_vWorldPosition.x, m_vWorldPosition.y, m_vWorldPosition.z );
-
-    world *= matParentWorld;
+    // Recomposed only if we, or something above us, moved.
+    mat4 world = Transforms::GetWorld( m_transform, matParentWorld );
 
 
     //
@@ -515,6 +610,7 @@ GameObject::SetVisible( bool isVisible )
     RESULT rval = S_OK;
     
     m_isVisible = isVisible;
+    Culling::Invalidate();
     
 Exit:
     return rval;
@@ -528,6 +624,7 @@ GameObject::SetPosition( const vec3& vPos )
     RESULT rval = S_OK;
 
     m_vWorldPosition  = vPos;
+    Transforms::SetLocal( m_transform, m_vWorldPosition, m_vRotation, m_fScale );
     
 
     // Update bounding box
@@ -539,6 +636,7 @@ GameObject::SetPosition( const vec3& vPos )
     maxPoint.z += m_bounds.GetDepth();
     
     m_bounds = AABB(minPoint, maxPoint);
+    Culling::Invalidate();
    
 Exit:    
     return rval;
@@ -552,6 +650,8 @@ GameObject::SetRotation( const vec3& vRotationDegrees )
     RESULT rval = S_OK;
 
     m_vRotation = vRotationDegrees;
+    Transforms::SetLocal( m_transform, m_vWorldPosition, m_vRotation, m_fScale );
+    Culling::Invalidate();
 
     // TODO: update bounding box
 
@@ -567,6 +667,8 @@ GameObject::SetScale( float scale )
     RESULT rval = S_OK;
 
     m_fScale = scale;
+    Transforms::SetLocal( m_transform, m_vWorldPosition, m_vRotation, m_fScale );
+    Culling::Invalidate();
 
 
     // TODO: update bounding box
@@ -583,6 +685,8 @@ GameObject::SetOpacity( float opacity )
     RESULT rval = S_OK;
 
     m_fOpacity = CLAMP(opacity, 0.0, 1.0); 
+    Culling::Invalidate();
+    GOMan.UpdateRow( this );
 
     if (!m_hSprite.IsNull())
     {
@@ -698,13 +802,11 @@ GameObject::GetBounds( )
     }
 
     // Transform the bounding box by the GameObject's current position/scale/rotation.
+    // Not the cached node: game logic wants where it is now, not where it's drawn,
+    // and may ask from a JobSystem worker.
     // TODO: pass world matrix to GetBounds( )?
     mat4 world;
-    world *= mat4::Scale    ( m_fScale      );
-    world *= mat4::RotateX  ( m_vRotation.x ); 
-    world *= mat4::RotateY  ( m_vRotation.y ); 
-    world *= mat4::RotateZ  ( m_vRotation.z ); 
-    world *= mat4::Translate( m_vWorldPosition.x, m_vWorldPosition.y, m_vWorldPosition.z );
+    Transforms::Compose( m_vWorldPosition, m_vRotation, m_fScale, vec3(0,0,0), &world );
 
     bounds.Update( world );
 
@@ -8,6 +8,7 @@
 #include "EffectManager.hpp"
 #include "ParticleManager.hpp"
 #include "Property.hpp"
+#include "Transforms.hpp"
 
 #include <list>
 using std::list;
@@ -57,6 +58,18 @@ typedef enum
     GO_TYPE_ANY         = 0xFFFFFFFF,
 } GO_TYPE;
 
+
+//
+// A GameObjectManager prefab; see GameObjectManager::CreatePrefab().
+// PREFAB_NONE is zero, so a zero-initialized struct starts without one.
+//
+typedef UINT32 PrefabID;
+
+#define PREFAB_NONE         0
+
+// Not in GameObjectManager's packed rows; see GameObjectManager::AddRow().
+#define GAMEOBJECT_ROW_NONE 0xFFFFFFFF
+
    
 
 class GameObject : virtual public Object, public IDrawable
@@ -73,6 +86,9 @@ public:
 
     RESULT              Init        ( IN const string& name, IN const Settings* pSettings = NULL, IN const string& settingsPath = "" );
 	RESULT              Update      ( UINT64 elapsedMS );
+
+    // Spawned from a prefab: the last Release() returns us to the prefab's pool instead of deleting us.
+    virtual UINT32      Release     ( );
     
 	// IDrawable
     RESULT              SetVisible  ( bool          isVisible        );
@@ -102,8 +118,23 @@ public:
     // TODO: Push/PopBehavior( HBehavior, queue number );
     
     
-    inline void         MarkForDeletion()       { m_isMarkedForDeletion = true; }
+    void                MarkForDeletion();
     inline bool         IsMarkedForDeletion()   { return m_isMarkedForDeletion; }
+
+    // Update on a JobSystem worker, with messages deferred.  Our StateMachines may then
+    // only change this GameObject (moving it is fine; see Transforms::SetLocal()), and
+    // talk to others only through messages.
+    void                SetParallelUpdate( bool parallel );
+    inline bool         IsParallelUpdate()      { return m_isParallelUpdate; }
+
+    // Only public for GameObjectManager's prefab pools.
+    inline PrefabID     GetPrefab()             { return m_prefab; }
+    inline void         SetPrefab( PrefabID prefab ) { m_prefab = prefab; }
+    void                Recycle();
+
+    // Only public for GameObjectManager's packed rows.
+    inline UINT32       GetRow()                { return m_row; }
+    inline void         SetRow( UINT32 row )    { m_row = row; }
     
     //------------------------------------------------------------------------
     // Game Object Components
@@ -139,6 +170,7 @@ protected:
 private:
 	GO_TYPE                 m_type;
     bool                    m_isMarkedForDeletion;
+    bool                    m_isParallelUpdate;
     
     bool                    m_isVisible;
     mat4                    m_matWorld;
@@ -162,6 +194,10 @@ private:
     HParticleEmitterList    m_hParticleEmitterChildren;
 
     StateMachineManager*    m_pStateMachineManager; // TODO: create a ResourceManager for HStateMachineManagers.
+
+    TransformID             m_transform;            // Position, rotation and scale, as cached matrices.
+    PrefabID                m_prefab;               // Pool to return to when released; PREFAB_NONE to be deleted.
+    UINT32                  m_row;                  // Our row in GameObjectManager's packed arrays.
     
     
 //----------------
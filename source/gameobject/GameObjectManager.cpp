@@ -20,6 +20,10 @@
 #include "BehaviorManager.hpp"
 #include "StoryboardManager.hpp"
 #include "LayerManager.hpp"
+#include "Profiler.hpp"
+#include "JobSystem.hpp"
+
+#include <algorithm>
 
 
 // Don't delete GameObjects when their ref count goes to zero.
@@ -45,7 +49,13 @@ GameObjectManager::Instance()
 }
 
 
-GameObjectManager::GameObjectManager()
+GameObjectManager::GameObjectManager() :
+    m_pLiveGameObjectsMetric(Metrics::RegisterGauge("GOMan.Live")),
+    m_pParallelRowsMetric(Metrics::RegisterGauge("GOMan.ParallelUpdates")),
+    m_isPoolingEnabled(false),
+    m_numPooled(0),
+    m_numIterating(0),
+    m_isParallelUpdateEnabled(false)
 {
     RETAILMSG(ZONE_VERBOSE, "GameObjectManager()");
     
@@ -139,6 +149,7 @@ GameObjectManager::Add( IN GameObject* pGameObject, INOUT HGameObject* pHandle )
     
     // Also add it to our ObjectID -> GameObject map
     m_GOIDToGameObjectMap.insert( std::pair< OBJECT_ID, GameObject* >(pGameObject->GetID(), pGameObject) );
+    AddRow( pGameObject );
     
 Exit:
     return rval;
@@ -158,6 +169,7 @@ GameObjectManager::Add( IN const string& name, IN GameObject* pGameObject, INOUT
     
     // Also add it to our ObjectID -> GameObject map
     m_GOIDToGameObjectMap.insert( std::pair< OBJECT_ID, GameObject* >(pGameObject->GetID(), pGameObject) );
+    AddRow( pGameObject );
     
 Exit:
     return rval;
@@ -199,6 +211,7 @@ GameObjectManager::Remove( IN GameObject* pGameObject, IN HGameObject handle )
     if (ppGameObject != m_GOIDToGameObjectMap.end())
     {
         m_GOIDToGameObjectMap.erase( ppGameObject );
+        RemoveRow( pGameObject );
     }
     else 
     {
@@ -494,6 +507,450 @@ Exit:
 
 
 
+#pragma mark -
+#pragma mark Prefabs
+
+RESULT
+GameObjectManager::CreatePrefab(
+    IN      const   string&         name,
+    OUT             PrefabID*       pPrefab,
+    IN      const   string&         spriteName,
+    IN      const   string&         meshName,
+    IN      const   string&         effectName,
+    IN      const   string&         behaviorName,
+    IN              GO_TYPE         type,
+    IN              bool            hasShadow,
+    IN              UINT32          numPreallocated
+    )
+{
+    RESULT      rval = S_OK;
+    Prefab      prefab;
+    HSprite     hSprite;
+    HMesh       hMesh;
+    PrefabID    id;
+
+    CPREx(pPrefab, E_NULL_POINTER);
+    CBREx("" != name, E_INVALID_ARG);
+
+    for (UINT32 i = 0; i < m_prefabs.size(); ++i)
+    {
+        const Prefab& existing = m_prefabs[i];
+
+        if (existing.spriteName   == spriteName   &&
+            existing.meshName     == meshName     &&
+            existing.effectName   == effectName   &&
+            existing.behaviorName == behaviorName &&
+            existing.type         == type         &&
+            existing.hasShadow    == hasShadow)
+        {
+            *pPrefab = i + 1;
+            goto Exit;
+        }
+    }
+
+
+    //
+    // Check that what the prefab refers to exists, and resolve its Effect and
+    // StateMachines now, rather than on every Spawn().
+    //
+    if ("" != spriteName)
+    {
+        CHR(SpriteMan.Get( spriteName, &hSprite ));
+    }
+
+    if ("" != meshName)
+    {
+        CHR(MeshMan.Get( meshName, &hMesh ));
+    }
+
+    EffectMan.Get( effectName, &prefab.hEffect );
+
+    prefab.name             = name;
+    prefab.spriteName       = spriteName;
+    prefab.meshName         = meshName;
+    prefab.effectName       = effectName;
+    prefab.behaviorName     = behaviorName;
+    prefab.type             = type;
+    prefab.hasShadow        = hasShadow;
+    prefab.createIdleState  = NULL;
+    prefab.createBehavior   = NULL;
+    prefab.numBuilt         = 0;
+
+    if ("" != behaviorName)
+    {
+        prefab.createIdleState = StateMachines::Find( "IdleState"  );
+        prefab.createBehavior  = StateMachines::Find( behaviorName );
+
+        if (!prefab.createIdleState || !prefab.createBehavior)
+        {
+            RETAILMSG(ZONE_ERROR, "ERROR: GameObjectManager::CreatePrefab( \"%s\" ): no StateMachine \"%s\"", name.c_str(), behaviorName.c_str());
+            rval = E_NOT_FOUND;
+            goto Exit;
+        }
+    }
+
+    m_prefabs.push_back( prefab );
+    id = (PrefabID)m_prefabs.size();
+
+    RETAILMSG(ZONE_GAMEOBJECT, "GameObjectManager::CreatePrefab( %d, \"%s\", sprite: \"%s\", behavior: \"%s\" )",
+        id, name.c_str(), spriteName.c_str(), behaviorName.c_str());
+
+    //
+    // Fill the pool ahead of time, so the first Spawn()s don't build.
+    //
+    for (UINT32 i = 0; m_isPoolingEnabled && i < MIN(numPreallocated, GAMEOBJECT_POOL_MAX_SIZE); ++i)
+    {
+        GameObject* pGameObject = NULL;
+
+        CHR(CreateFromPrefab( id, &pGameObject ));
+        m_prefabs[ id - 1 ].pool.push_back( pGameObject );
+        m_numPooled++;
+    }
+
+    *pPrefab = id;
+
+Exit:
+    return rval;
+}
+
+
+
+RESULT
+GameObjectManager::Spawn( IN PrefabID prefabID, OUT HGameObject* pHandle, IN const vec3& position, IN float opacity, IN const Color& color )
+{
+    static MetricCounter* s_pSpawnsMetric   = Metrics::RegisterCounter( "GOMan.Spawns"   );
+    static MetricCounter* s_pPoolHitsMetric = Metrics::RegisterCounter( "GOMan.PoolHits" );
+    static MetricGauge*   s_pPooledMetric   = Metrics::RegisterGauge  ( "GOMan.Pooled"   );
+
+    RESULT                  rval                    = S_OK;
+    Prefab*                 pPrefab                 = NULL;
+    GameObject*             pGameObject             = NULL;
+    StateMachineManager*    pStateMachineManager    = NULL;
+    HGameObject             hGameObject;
+
+    CPREx(pHandle, E_NULL_POINTER);
+    CBREx(PREFAB_NONE != prefabID && prefabID <= m_prefabs.size(), E_INVALID_ARG);
+
+    pPrefab = &m_prefabs[ prefabID - 1 ];
+
+    if (!pPrefab->pool.empty())
+    {
+        pGameObject = pPrefab->pool.back();
+        pPrefab->pool.pop_back();
+        m_numPooled--;
+
+        s_pPoolHitsMetric->Increment();
+        s_pPooledMetric->Set( m_numPooled );
+    }
+    else
+    {
+        CHR(CreateFromPrefab( prefabID, &pGameObject ));
+    }
+
+    CHR(Add( pGameObject, &hGameObject ));
+
+    pGameObject->SetPosition( position );
+    pGameObject->SetOpacity ( opacity  );
+    pGameObject->SetColor   ( color    );
+
+    //
+    // As in Create(): an IdleState at the bottom of the queue, the Behavior above it.
+    // The StateMachines take the new handle, so they're the one thing built each time.
+    //
+    if (pPrefab->createBehavior)
+    {
+        pStateMachineManager = pGameObject->GetStateMachineManager();
+        CPREx(pStateMachineManager, E_UNEXPECTED);
+
+        pStateMachineManager->PushStateMachine( *pPrefab->createIdleState( hGameObject ), STATE_MACHINE_QUEUE_0, true );
+        pStateMachineManager->PushStateMachine( *pPrefab->createBehavior ( hGameObject ), STATE_MACHINE_QUEUE_0, true );
+    }
+
+    s_pSpawnsMetric->Increment();
+    *pHandle = hGameObject;
+
+Exit:
+    if (FAILED(rval))
+    {
+        RETAILMSG(ZONE_ERROR, "ERROR: GameObjectManager::Spawn( %d ) failed: 0x%x", prefabID, rval);
+    }
+
+    return rval;
+}
+
+
+
+RESULT
+GameObjectManager::CreateFromPrefab( IN PrefabID prefabID, INOUT GameObject** ppGameObject )
+{
+    static MetricCounter* s_pBuiltMetric = Metrics::RegisterCounter( "GOMan.PrefabsBuilt" );
+
+    RESULT      rval        = S_OK;
+    Prefab*     pPrefab     = &m_prefabs[ prefabID - 1 ];
+    GameObject* pGameObject = NULL;
+    HSprite     hSprite;
+    HMesh       hMesh;
+    HEffect     hEffect;
+    char        name[MAX_NAME];
+
+    pGameObject = new GameObject( pPrefab->type );
+    CPREx(pGameObject, E_OUTOFMEMORY);
+
+    // Unique for the GameObject's lifetime, not per Spawn().
+    sprintf(name, "%s_%d_%d", pPrefab->name.c_str(), (int)prefabID, (int)++pPrefab->numBuilt);
+    CHR(pGameObject->Init( name ));
+
+    SpriteMan.GetCopy  ( pPrefab->spriteName, &hSprite );
+    MeshMan.GetCopy    ( pPrefab->meshName,   &hMesh   );
+    EffectMan.Get      ( pPrefab->effectName, &hEffect );
+
+    pGameObject->SetSprite  ( hSprite );
+    pGameObject->SetMesh    ( hMesh   );
+    pGameObject->SetEffect  ( hEffect );
+    pGameObject->SetShadow  ( pPrefab->hasShadow );
+
+    SpriteMan.Release  ( hSprite );
+    MeshMan.Release    ( hMesh   );
+    EffectMan.Release  ( hEffect );
+
+    if (pPrefab->createBehavior)
+    {
+        CHR(pGameObject->CreateStateMachineManager());
+    }
+
+    pGameObject->SetPrefab( prefabID );
+    s_pBuiltMetric->Increment();
+
+    *ppGameObject = pGameObject;
+
+Exit:
+    if (FAILED(rval))
+    {
+        SAFE_DELETE(pGameObject);
+    }
+
+    return rval;
+}
+
+
+
+bool
+GameObjectManager::Recycle( IN GameObject* pGameObject )
+{
+    static MetricGauge* s_pPooledMetric = Metrics::RegisterGauge( "GOMan.Pooled" );
+
+    PrefabID prefabID = pGameObject->GetPrefab();
+    Prefab*  pPrefab  = NULL;
+
+    if (!m_isPoolingEnabled || PREFAB_NONE == prefabID || prefabID > m_prefabs.size())
+    {
+        return false;
+    }
+
+    pPrefab = &m_prefabs[ prefabID - 1 ];
+    if (pPrefab->pool.size() >= GAMEOBJECT_POOL_MAX_SIZE)
+    {
+        return false;
+    }
+
+    pGameObject->Recycle();
+
+    if (pGameObject->GetEffect() != pPrefab->hEffect)
+    {
+        pGameObject->SetEffect( pPrefab->hEffect );
+    }
+
+    pPrefab->pool.push_back( pGameObject );
+    m_numPooled++;
+    s_pPooledMetric->Set( m_numPooled );
+
+    return true;
+}
+
+
+
+void
+GameObjectManager::EnablePooling( bool enabled )
+{
+    static MetricGauge* s_pPooledMetric = Metrics::RegisterGauge( "GOMan.Pooled" );
+
+    m_isPoolingEnabled = enabled;
+
+    if (enabled)
+    {
+        return;
+    }
+
+    // Free what's pooled; from now on released GameObjects are deleted.
+    for (PrefabList::iterator pPrefab = m_prefabs.begin(); pPrefab != m_prefabs.end(); ++pPrefab)
+    {
+        for (UINT32 i = 0; i < pPrefab->pool.size(); ++i)
+        {
+            delete pPrefab->pool[i];
+        }
+
+        pPrefab->pool.clear();
+    }
+
+    m_numPooled = 0;
+    s_pPooledMetric->Set( m_numPooled );
+}
+
+
+
+UINT32
+GameObjectManager::GetNumPooled( IN PrefabID prefabID )
+{
+    if (PREFAB_NONE == prefabID || prefabID > m_prefabs.size())
+    {
+        return 0;
+    }
+
+    return (UINT32)m_prefabs[ prefabID - 1 ].pool.size();
+}
+
+
+
+#pragma mark -
+#pragma mark Rows
+
+void
+GameObjectManager::UpdateRowsJob( void* pContext, UINT32 begin, UINT32 end )
+{
+    GameObjectManager* pThis = (GameObjectManager*)pContext;
+
+    for (UINT32 i = begin; i < end; ++i)
+    {
+        pThis->m_rowStateMachines[ pThis->m_parallelRows[i] ]->Update();
+    }
+}
+
+
+
+void
+GameObjectManager::AddRow( IN GameObject* pGameObject )
+{
+    DEBUGCHK(GAMEOBJECT_ROW_NONE == pGameObject->GetRow());
+
+    pGameObject->SetRow( (UINT32)m_rowObjects.size() );
+
+    m_rowObjects.push_back      ( pGameObject );
+    m_rowTypes.push_back        ( pGameObject->GetType() );
+    m_rowOpacities.push_back    ( 0.0f );
+    m_rowFlags.push_back        ( 0 );
+    m_rowStateMachines.push_back( NULL );
+
+    UpdateRow( pGameObject );
+}
+
+
+
+void
+GameObjectManager::UpdateRow( IN GameObject* pGameObject )
+{
+    UINT32 row = pGameObject->GetRow();
+
+    if (GAMEOBJECT_ROW_NONE == row)
+    {
+        return;
+    }
+
+    DEBUGCHK(m_rowObjects[row] == pGameObject);
+
+    m_rowOpacities    [row] = pGameObject->GetOpacity();
+    m_rowFlags        [row] = (pGameObject->IsMarkedForDeletion() ? ROW_MARKED_FOR_DELETION : 0) |
+                              (pGameObject->IsParallelUpdate()    ? ROW_PARALLEL_UPDATE     : 0);
+    m_rowStateMachines[row] = pGameObject->GetStateMachineManager();
+}
+
+
+
+void
+GameObjectManager::RemoveRow( IN GameObject* pGameObject )
+{
+    UINT32 row  = pGameObject->GetRow();
+    UINT32 last = (UINT32)m_rowObjects.size() - 1;
+
+    if (GAMEOBJECT_ROW_NONE == row)
+    {
+        return;
+    }
+
+    DEBUGCHK(m_rowObjects[row] == pGameObject);
+    pGameObject->SetRow( GAMEOBJECT_ROW_NONE );
+
+    if (m_numIterating)
+    {
+        // Update() is walking the rows: leave a row that matches nothing, and remove it after.
+        m_rowObjects      [row] = NULL;
+        m_rowTypes        [row] = (GO_TYPE)0;
+        m_rowOpacities    [row] = 0.0f;
+        m_rowFlags        [row] = 0;
+        m_rowStateMachines[row] = NULL;
+
+        m_deadRows.push_back( row );
+        return;
+    }
+
+    if (row != last)
+    {
+        m_rowObjects      [row] = m_rowObjects      [last];
+        m_rowTypes        [row] = m_rowTypes        [last];
+        m_rowOpacities    [row] = m_rowOpacities    [last];
+        m_rowFlags        [row] = m_rowFlags        [last];
+        m_rowStateMachines[row] = m_rowStateMachines[last];
+
+        m_rowObjects[row]->SetRow( row );
+    }
+
+    m_rowObjects.pop_back();
+    m_rowTypes.pop_back();
+    m_rowOpacities.pop_back();
+    m_rowFlags.pop_back();
+    m_rowStateMachines.pop_back();
+}
+
+
+
+void
+GameObjectManager::CompactRows()
+{
+    if (m_deadRows.empty())
+    {
+        return;
+    }
+
+    // Highest first, so the last row is never a dead one when it's moved.
+    std::sort( m_deadRows.begin(), m_deadRows.end() );
+
+    for (UINT32 i = (UINT32)m_deadRows.size(); i-- > 0; )
+    {
+        UINT32 row  = m_deadRows[i];
+        UINT32 last = (UINT32)m_rowObjects.size() - 1;
+
+        if (row != last)
+        {
+            m_rowObjects      [row] = m_rowObjects      [last];
+            m_rowTypes        [row] = m_rowTypes        [last];
+            m_rowOpacities    [row] = m_rowOpacities    [last];
+            m_rowFlags        [row] = m_rowFlags        [last];
+            m_rowStateMachines[row] = m_rowStateMachines[last];
+
+            m_rowObjects[row]->SetRow( row );
+        }
+
+        m_rowObjects.pop_back();
+        m_rowTypes.pop_back();
+        m_rowOpacities.pop_back();
+        m_rowFlags.pop_back();
+        m_rowStateMachines.pop_back();
+    }
+
+    m_deadRows.clear();
+}
+
+
+
 #pragma mark -
 #pragma mark Operations
 
@@ -501,29 +958,67 @@ RESULT
 GameObjectManager::Update( UINT64 elapsedMS, GO_TYPE objectTypesToUpdate )
 {
     RESULT rval = S_OK;
+
+    PROFILE_SCOPE("GOMan.Update");
     
     DEBUGMSG(ZONE_GAMEOBJECT | ZONE_VERBOSE, "Updating %d Game Objects", m_resourceList.size());
     
     //
-    // Update all Game Objects
+    // Update all Game Objects.
+    // GameObject::Update() only updates its StateMachineManager, so those without one
+    // aren't touched.  GameObjects added meanwhile are first updated next frame;
+    // those removed meanwhile leave a dead row until the loop is done.
+    //
+    UINT32 numRows = (UINT32)m_rowObjects.size();
+
+    m_numIterating++;
+
+    //
+    // Parallel ones first, in chunks, with their messages held back.  The outboxes are
+    // merged and delivered once every chunk is done, so the threads can't race,
+    // and the order doesn't depend on which thread ran which chunk.
     //
-    ResourceList::iterator ppGameObject;
-    for (ppGameObject = m_resourceList.begin(); ppGameObject != m_resourceList.end(); ++ppGameObject)
+    m_parallelRows.clear();
+    for (UINT32 row = 0; row < numRows; ++row)
     {
-        GameObject* pGameObject = *ppGameObject;
-        
-        // Deleted GameObjects leave holes in the list, which are reused later.
-        // Skip over them.
-        if (!pGameObject)
+        if ((m_rowFlags[row] & ROW_PARALLEL_UPDATE) && (m_rowTypes[row] & objectTypesToUpdate) && m_rowStateMachines[row])
         {
-            continue;
-        }    
+            m_parallelRows.push_back( row );
+        }
+    }
+    m_pParallelRowsMetric->Set( m_parallelRows.size() );
+
+    if (!m_parallelRows.empty())
+    {
+        MsgRouter.BeginDeferring();
+
+        if (m_isParallelUpdateEnabled)
+        {
+            IGNOREHR(JobSystem::ParallelFor( UpdateRowsJob, this, (UINT32)m_parallelRows.size(), GAMEOBJECT_PARALLEL_GRAIN ));
+        }
+        else
+        {
+            UpdateRowsJob( this, 0, (UINT32)m_parallelRows.size() );
+        }
+
+        // Nodes the workers moved, for interpolation.
+        Transforms::MergeMoved();
+
+        MsgRouter.DeliverDeferred();
+    }
 
-        if (pGameObject->GetType() & objectTypesToUpdate)
+    //
+    // Then the rest, as they've always been.
+    //
+    for (UINT32 row = 0; row < numRows; ++row)
+    {
+        if ((m_rowTypes[row] & objectTypesToUpdate) && m_rowStateMachines[row] && !(m_rowFlags[row] & ROW_PARALLEL_UPDATE))
         {
-            pGameObject->Update( elapsedMS );
+            m_rowStateMachines[row]->Update();
         }
     }        
+    m_numIterating--;
+    CompactRows();
     
 
     //
@@ -533,39 +1028,19 @@ GameObjectManager::Update( UINT64 elapsedMS, GO_TYPE objectTypesToUpdate )
 	MsgRouter.DeliverDelayedMessages();
     
     
-    // TODO: merge this into the Update loop above,
-    // so we only traverse GameObjects ONCE per tick.
-    // Does mean that GOs marked for deletion (as the result of a msg) 
-    // won't be deleted until the next tick; is that safe?
-    
     //
-	// Destroy Game Objects that have requested it
+	// Destroy Game Objects that have requested it.
+    // Walk down, so a swap-remove only ever moves a row we've already seen.
     //
-    ppGameObject = m_resourceList.begin();
-    while ( ppGameObject != m_resourceList.end() )
+    for (UINT32 row = (UINT32)m_rowObjects.size(); row-- > 0; )
 	{
-        GameObject* pGameObject = *ppGameObject;
-        
-        // Deleted GameObjects leave holes in the list, which are reused later.
-        // Skip over them.
-        if (!pGameObject)
-        {
-            ++ppGameObject;
-            continue;
-        }
-        
-		if( pGameObject->IsMarkedForDeletion() )
+		if( row < m_rowObjects.size() && (m_rowFlags[row] & ROW_MARKED_FOR_DELETION) )
 		{
-            //DEBUGCHK( SUCCEEDED(ResourceManager<GameObject>::Remove(pGameObject)) );
-            DEBUGCHK( SUCCEEDED(Remove(pGameObject)) );
-            
-            // TODO: POTENTIALLY UNSAFE IN FUTURE! 
-            // Index into m_resourceList instead of iterate;
-            // tolerates deletion just fine. For now, we never delete from m_resourceList.
+            DEBUGCHK( SUCCEEDED(Remove(m_rowObjects[row])) );
 		}
-
-        ++ppGameObject;
 	}
+
+    m_pLiveGameObjectsMetric->Set( Count() );
     
 Exit:
     return rval;
@@ -581,22 +1056,12 @@ GameObjectManager::Draw( GO_TYPE objectTypesToDraw )
 
     DEBUGMSG(ZONE_GAMEOBJECT | ZONE_VERBOSE, "Rendering %d Game Objects", m_resourceList.size());
 
-    ResourceList::iterator ppGameObject;
-    for (ppGameObject = m_resourceList.begin(); ppGameObject != m_resourceList.end(); ++ppGameObject)
+    for (UINT32 row = 0; row < m_rowObjects.size(); ++row)
     {
-        GameObject* pGameObject = *ppGameObject;
-        
-        // Deleted GameObjects leave holes in the list, which are reused later.
-        // Skip over them.
-        if (!pGameObject)
+        // GameObject::Draw() would skip the transparent ones; don't touch them at all.
+        if ((m_rowTypes[row] & objectTypesToDraw) && !Util::CompareFloats( m_rowOpacities[row], 0.0f ))
         {
-            continue;
-        }
-        
-        
-        if (pGameObject->GetType() & objectTypesToDraw)
-        {
-            pGameObject->Draw( rootMatWorld );
+            m_rowObjects[row]->Draw( rootMatWorld );
         }
     }        
     
@@ -890,7 +1355,6 @@ RESULT
 GameObjectManager::GetList( IN GO_TYPE type, INOUT GameObjectList* pList )
 {
     RESULT               rval = S_OK;
-    ResourceListIterator ppGameObject;
     
     if (!pList)
     {
@@ -899,13 +1363,11 @@ GameObjectManager::GetList( IN GO_TYPE type, INOUT GameObjectList* pList )
         goto Exit;
     }
     
-    for( ppGameObject = m_resourceList.begin(); ppGameObject != m_resourceList.end(); ++ppGameObject )
+    for (UINT32 row = 0; row < m_rowObjects.size(); ++row)
     {
-        GameObject* pGameObject = *ppGameObject;
-        
-        if (pGameObject && pGameObject->GetType() & type)
+        if (m_rowTypes[row] & type)
         {
-            pList->push_back( pGameObject );
+            pList->push_back( m_rowObjects[row] );
         }
     }
     
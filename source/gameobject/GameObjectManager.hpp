@@ -7,16 +7,26 @@
 #include "GameObject.hpp"
 #include "Layer.hpp"
 #include "msg.hpp"
+#include "Metrics.hpp"
+#include "StateMachineFactory.hpp"
 
 #include <list>
 #include <set>
+#include <vector>
 using std::list;
 using std::set;
+using std::vector;
 
 namespace Z
 {
 
 
+// Most free GameObjects a prefab's pool will hold; any more are deleted.
+#define GAMEOBJECT_POOL_MAX_SIZE    64
+
+// GameObjects per chunk of a parallel update.
+#define GAMEOBJECT_PARALLEL_GRAIN   64
+
 
 typedef list<GameObject*>        GameObjectList;
 typedef GameObjectList::iterator GameObjectListIterator;
@@ -70,6 +80,54 @@ public:
                                         );
 
 
+    //
+    // Prefabs: a GameObject definition whose Sprite, Mesh, Effect and Behavior are
+    // looked up once.  Spawn() hands out a GameObject from the prefab's pool when
+    // one is free, and builds one when not.  When its last reference is released,
+    // the GameObject is reset and returned to the pool instead of being deleted;
+    // it comes back with a new handle and OBJECT_ID, so nothing held from its
+    // previous life can reach it.
+    //
+    // CreatePrefab() returns the existing prefab for an identical definition.
+    //
+    // Off by default, building every GameObject and deleting it on release, as
+    // GOMan.Create() does; enable with Settings.bPoolGameObjects = "1".
+    //
+    RESULT              CreatePrefab    (
+                                          IN      const   string&         name,
+                                          OUT             PrefabID*       pPrefab,
+                                          IN      const   string&         spriteName      = "",
+                                          IN      const   string&         meshName        = "",
+                                          IN      const   string&         effectName      = "",
+                                          IN      const   string&         behaviorName    = "",
+                                          IN              GO_TYPE         type            = GO_TYPE_UNKNOWN,
+                                          IN              bool            hasShadow       = false,
+                                          IN              UINT32          numPreallocated = 0
+                                        );
+
+    RESULT              Spawn           (
+                                          IN              PrefabID        prefab,
+                                          OUT             HGameObject*    pHandle,
+                                          IN      const   vec3&           position        = vec3(0,0,0),
+                                          IN              float           opacity         = 1.0f,
+                                          IN      const   Color&          color           = Color::White()
+                                        );
+
+    void                EnablePooling   ( bool enabled );
+    bool                IsPoolingEnabled( )                     { return m_isPoolingEnabled; }
+    UINT32              GetNumPooled    ( IN PrefabID prefab );
+
+    // Only for GameObject: copy the fields Update(), Draw() and GetList() test into its row.
+    void                UpdateRow       ( IN GameObject* pGameObject );
+    UINT32              GetNumRows      ( )                     { return (UINT32)m_rowObjects.size(); }
+
+    // GameObjects that opted in with GameObject::SetParallelUpdate() are updated first,
+    // in chunks on the JobSystem's workers, with MsgRouter deferring their messages.
+    // Disabled, the same chunks run on the calling thread, with the same result.
+    void                EnableParallelUpdate    ( bool enabled )    { m_isParallelUpdateEnabled = enabled; }
+    bool                IsParallelUpdateEnabled ( )                 { return m_isParallelUpdateEnabled; }
+
+
     RESULT              Update          ( UINT64 elapsedMS, GO_TYPE objectTypesToUpdate = GO_TYPE_ANY );
     
     RESULT              Draw            ( GO_TYPE objectTypesToDraw = GO_TYPE_ANY );
@@ -148,12 +206,71 @@ protected:
     virtual ~GameObjectManager();
  
     RESULT  CreateGameObject( IN Settings* pSettings, IN const string& settingsPath, INOUT GameObject** ppGameObject );
+    RESULT  CreateFromPrefab( IN PrefabID prefab, INOUT GameObject** ppGameObject );
+
+    // Only for GameObject::Release(); false if the GameObject should be deleted.
+    friend class GameObject;
+    bool    Recycle         ( IN GameObject* pGameObject );
+
+    static void UpdateRowsJob( void* pContext, UINT32 begin, UINT32 end );
+
+    void    AddRow          ( IN GameObject* pGameObject );
+    void    RemoveRow       ( IN GameObject* pGameObject );
+    void    CompactRows     ( );
     
 protected:
     typedef map< OBJECT_ID, GameObject* >   GOIDToGameObjectMap;
     typedef GOIDToGameObjectMap::iterator   GOIDToGameObjectMapIterator;
     
     GOIDToGameObjectMap m_GOIDToGameObjectMap;
+    MetricGauge*        m_pLiveGameObjectsMetric;
+    MetricGauge*        m_pParallelRowsMetric;
+
+    struct Prefab
+    {
+        string                                  name;
+        string                                  spriteName;
+        string                                  meshName;
+        string                                  effectName;
+        string                                  behaviorName;
+        GO_TYPE                                 type;
+        bool                                    hasShadow;
+
+        HEffect                                 hEffect;            // Restored on recycle.
+        StateMachines::SM_FACTORY_METHOD        createIdleState;
+        StateMachines::SM_FACTORY_METHOD        createBehavior;     // NULL for no Behavior.
+
+        vector<GameObject*>                     pool;
+        UINT32                                  numBuilt;
+    };
+    typedef vector<Prefab>                      PrefabList;
+
+    PrefabList          m_prefabs;              // PrefabID - 1
+    bool                m_isPoolingEnabled;
+    UINT32              m_numPooled;
+
+    //
+    // What the per-frame loops test, for every live GameObject, in packed arrays;
+    // the loops stream these rather than walk m_resourceList, its holes, and each
+    // GameObject.  Rows are swap-removed, and each GameObject knows its row.
+    // Transforms are already packed, by Transforms.
+    //
+    enum
+    {
+        ROW_MARKED_FOR_DELETION = BIT0,
+        ROW_PARALLEL_UPDATE     = BIT1,
+    };
+
+    vector<GameObject*>             m_rowObjects;
+    vector<GO_TYPE>                 m_rowTypes;
+    vector<float>                   m_rowOpacities;
+    vector<BYTE>                    m_rowFlags;
+    vector<StateMachineManager*>    m_rowStateMachines;
+    vector<UINT32>                  m_deadRows;             // Removed during Update(); compacted after it.
+    UINT32                          m_numIterating;
+
+    bool                            m_isParallelUpdateEnabled;
+    vector<UINT32>                  m_parallelRows;         // This frame's ROW_PARALLEL_UPDATE rows, in row order.
 };
 
 #define GOMan ((GameObjectManager&)GameObjectManager::Instance())
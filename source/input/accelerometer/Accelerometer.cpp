@@ -10,7 +10,10 @@ namespace Z
 Accelerometer*  Accelerometer::s_pDefaultAccelerometer = NULL;
 
 
-Accelerometer::Accelerometer()
+Accelerometer::Accelerometer() :
+    m_isQueueEnabled(false),
+    m_pQueueFullMetric( Metrics::RegisterCounter( "Accelerometer.QueueFull" ) ),
+    m_pCoalescedMetric( Metrics::RegisterCounter( "Accelerometer.Coalesced" ) )
 {
     DEBUGMSG(ZONE_OBJECT | ZONE_VERBOSE, "Accelerometer( %4d )", m_ID);
 }
@@ -143,10 +146,15 @@ Exit:
 
 // The native Accelerometer handler should call this method to inject AccelerometerEvents.
 // into ZEngine.
-// NOTE: these methods must be thread-safe!
+// NOTE: one thread at a time.
 RESULT
 Accelerometer::DeliverEvent( AccelerometerEvent* pAccelerometerEvent )
 {
+    if (!pAccelerometerEvent)
+    {
+        return E_NULL_POINTER;
+    }
+
     DEBUGMSG(ZONE_ACCELEROMETER, "Accelerometer::DeliverEvent( id: %d type: %d (%4.4f, %4.4f, %4.4f) )", 
         pAccelerometerEvent->id, 
         pAccelerometerEvent->type,
@@ -154,16 +162,70 @@ Accelerometer::DeliverEvent( AccelerometerEvent* pAccelerometerEvent )
         pAccelerometerEvent->vector.y,
         pAccelerometerEvent->vector.z);
     
-    return SendToListeners( pAccelerometerEvent );
+    if (!m_isQueueEnabled)
+    {
+        return SendToListeners( pAccelerometerEvent );
+    }
+
+    if (!pAccelerometerEvent->timestamp)
+    {
+        pAccelerometerEvent->timestamp = Platform::GetTickCount();
+    }
+
+    if (!m_queue.Push( *pAccelerometerEvent ))
+    {
+        m_pQueueFullMetric->Increment();
+        return E_OUTOFMEMORY;
+    }
+
+    return S_OK;
 }
 
 
 
 RESULT
-Accelerometer::SendToListeners( AccelerometerEvent* pAccelerometerEvent )
+Accelerometer::ProcessEvents( )
 {
-    // TODO: take a critical section here
+    RESULT              rval            = S_OK;
+    AccelerometerEvent  event;
+    INT32               latestVector    = -1;   // In m_pendingEvents.
+
+    m_pendingEvents.clear();
+
+    for (UINT32 i = 0; i < ACCELEROMETER_QUEUE_SIZE && m_queue.Pop( &event ); ++i)
+    {
+        if (ACCELEROMETER_EVENT_VECTOR == event.type)
+        {
+            if (latestVector >= 0)
+            {
+                m_pendingEvents[ latestVector ] = event;
+                m_pCoalescedMetric->Increment();
+                continue;
+            }
+
+            latestVector = (INT32)m_pendingEvents.size();
+        }
+        else
+        {
+            latestVector = -1;
+        }
+
+        m_pendingEvents.push_back( event );
+    }
+
+    for (UINT32 i = 0; i < m_pendingEvents.size(); ++i)
+    {
+        IGNOREHR(SendToListeners( &m_pendingEvents[i] ));
+    }
 
+    return rval;
+}
+
+
+
+RESULT
+Accelerometer::SendToListeners( AccelerometerEvent* pAccelerometerEvent )
+{
     RESULT                      rval                = S_OK;
     MSG_Name                    msg                 = MSG_AccelerometerEvent;
     MsgToListenersMapIterator   pEventListeners;
@@ -4,11 +4,15 @@
 #include "Object.hpp"
 #include "Platform.hpp"
 #include "EventSource.hpp"
+#include "Metrics.hpp"
+#include "RingBuffer.hpp"
 
 #include <set>
 #include <map>
+#include <vector>
 using std::set;
 using std::map;
+using std::vector;
 
 
 namespace Z
@@ -43,6 +47,11 @@ struct AccelerometerEvent
 // Sends MSG_AccelerometerBegin, MSG_AccelerometerUpdate, and MSG_AccelerometerEnd.  
 // Each has an associated AccelerometerEvent in msg->GetPointerData().
 //
+// Like TouchInput, DeliverEvent() only queues the event; ProcessEvents() sends it,
+// with consecutive ACCELEROMETER_EVENT_VECTORs coalesced into the latest one.
+//
+
+#define ACCELEROMETER_QUEUE_SIZE    64      // Must be a power of two.
 
 class Accelerometer : virtual public Object, public IEventSource
 {
@@ -58,9 +67,15 @@ public:
 
     // The native Accelerometer handler should call these methods to inject Accelerometeres
     // into ZEngine.
-    // NOTE: these methods must be thread-safe!
+    // NOTE: one thread at a time; E_OUTOFMEMORY if the queue is full.
     RESULT              DeliverEvent        ( AccelerometerEvent* pAccelerometerEvent    );
 
+    // Send the queued events; from the engine's thread only.
+    RESULT              ProcessEvents       ( );
+
+    void                EnableQueue         ( bool enabled )    { m_isQueueEnabled = enabled; }
+    bool                IsQueueEnabled      ( )                 { return m_isQueueEnabled; }
+
 protected:
     RESULT              SendToListeners     ( AccelerometerEvent* pAccelerometerEvent    );
 
@@ -81,6 +96,12 @@ protected:
     typedef MsgToListenersMap::iterator             MsgToListenersMapIterator;
 
     MsgToListenersMap   m_msgToListenersMap;
+
+    bool                m_isQueueEnabled;
+    RingBuffer<AccelerometerEvent, ACCELEROMETER_QUEUE_SIZE> m_queue;
+    vector<AccelerometerEvent> m_pendingEvents;
+    MetricCounter*      m_pQueueFullMetric;
+    MetricCounter*      m_pCoalescedMetric;
 };
 
 
@@ -1,5 +1,9 @@
 #include "TouchInput.hpp"
 #include "GameObjectManager.hpp"
+#include "Culling.hpp"
+#include "PerfTimer.hpp"
+
+#include <math.h>
 
 
 namespace Z
@@ -10,7 +14,24 @@ namespace Z
 TouchInput*  TouchInput::s_pDefaultTouchInput = NULL;
 
 
-TouchInput::TouchInput()
+TouchInput::TouchInput() :
+    m_isInitialized(false),
+    m_isQueueEnabled(false),
+    m_screenScaleFactor(1.0f),
+    m_worldScaleFactor(1.0f),
+    m_screenHeight(0.0f),
+    m_isHitIndexEnabled(false),
+    m_isHitIndexDirty(true),
+    m_hitIndexEpoch(0),
+    m_hitColumns(1),
+    m_hitRows(1),
+    m_hitCells(1),
+    m_pDispatchTimeMetric( Metrics::RegisterHistogram( "Touch.DispatchMS"  ) ),
+    m_pDeliveriesMetric  ( Metrics::RegisterCounter  ( "Touch.Deliveries"  ) ),
+    m_pIndexBuildsMetric ( Metrics::RegisterCounter  ( "Touch.IndexBuilds" ) ),
+    m_pQueueFullMetric   ( Metrics::RegisterCounter  ( "Touch.QueueFull"   ) ),
+    m_pCoalescedMetric   ( Metrics::RegisterCounter  ( "Touch.Coalesced"   ) ),
+    m_pEventsMetric      ( Metrics::RegisterCounter  ( "Touch.Events"      ) )
 {
     DEBUGMSG(ZONE_OBJECT | ZONE_VERBOSE, "TouchInput( %4d )", m_ID);
 }
@@ -41,6 +62,37 @@ TouchInput::GetDefaultTouchInput( )
 }
 
 
+
+RESULT
+TouchInput::Init( )
+{
+    RESULT      rval = S_OK;
+    Rectangle   screenRect;
+    Rectangle   cameraRect;
+
+    CHR(Platform::GetScreenRect      ( &screenRect ));
+    CHR(Platform::GetScreenRectCamera( &cameraRect ));
+
+    m_screenScaleFactor = Platform::GetScreenScaleFactor();
+    m_worldScaleFactor  = GlobalSettings.GetFloat("/Settings.fWorldScaleFactor", 1.0f);
+    m_screenHeight      = screenRect.height;
+
+    // The grid covers the screen in ZEngine coordinates.
+    m_hitColumns        = MAX((UINT32)1, (UINT32)ceilf( cameraRect.width  / TOUCH_GRID_CELL_SIZE ));
+    m_hitRows           = MAX((UINT32)1, (UINT32)ceilf( cameraRect.height / TOUCH_GRID_CELL_SIZE ));
+    m_hitCells.assign( m_hitColumns * m_hitRows, vector<UINT32>() );
+    m_isHitIndexDirty   = true;
+
+    m_isInitialized     = true;
+
+    RETAILMSG(ZONE_TOUCH, "TouchInput::Init(): screenScaleFactor %2.2f, worldScaleFactor %2.2f, %d x %d hit grid",
+        m_screenScaleFactor, m_worldScaleFactor, m_hitColumns, m_hitRows);
+
+Exit:
+    return rval;
+}
+
+
 /*
 // IEventSource
 RESULT
@@ -107,6 +159,27 @@ Exit:
     return rval;
 }
 
+
+
+RESULT
+TouchInput::AddHitListener( HGameObject hListener, MSG_Name msg )
+{
+    RESULT      rval    = S_OK;
+    OBJECT_ID   id      = INVALID_OBJECT_ID;
+
+    CHR(GOMan.GetObjectID( hListener, &id ));
+
+    m_msgToHitListenersMap[ msg ].insert( id );
+
+    if (MSG_TouchBegin == msg)
+    {
+        m_isHitIndexDirty = true;
+    }
+
+Exit:
+    return rval;
+}
+
 /*
 RESULT
 TouchInput::RemoveListener( HGameObject hListener )
@@ -143,10 +216,14 @@ Exit:
 RESULT
 TouchInput::RemoveListener( HGameObject hListener, MSG_Name msg )
 {
-    RESULT rval = S_OK;
+    RESULT                      rval    = S_OK;
+    OBJECT_ID                   id      = INVALID_OBJECT_ID;
+    MsgToListenersMapIterator   pEventListeners;
+
+    // Get the listener's unique OBJECT_ID.
+    CHR(GOMan.GetObjectID( hListener, &id ));
 
     // Get the list of listeners for this event.
-    MsgToListenersMapIterator pEventListeners;
     pEventListeners = m_msgToListenersMap.find( msg );
 
     if (pEventListeners != m_msgToListenersMap.end())
@@ -154,10 +231,6 @@ TouchInput::RemoveListener( HGameObject hListener, MSG_Name msg )
         // Remove the listener
         EventListenerList& listeners = pEventListeners->second;
         
-        // Get the listener's unique OBJECT_ID.
-        OBJECT_ID id = INVALID_OBJECT_ID;
-        CHR(GOMan.GetObjectID( hListener, &id ));
-          
         EventListenerListIterator ppListener;
         ppListener = find( listeners.begin(), listeners.end(), id );
         if (ppListener != listeners.end())
@@ -166,6 +239,14 @@ TouchInput::RemoveListener( HGameObject hListener, MSG_Name msg )
         }
     }
 
+    // Or the hit listener.
+    pEventListeners = m_msgToHitListenersMap.find( msg );
+
+    if (pEventListeners != m_msgToHitListenersMap.end() && pEventListeners->second.erase( id ) && MSG_TouchBegin == msg)
+    {
+        m_isHitIndexDirty = true;
+    }
+
 Exit:    
     return rval;
 }
@@ -174,14 +255,14 @@ Exit:
 
 // The native touch handler should call these methods to inject touches
 // into ZEngine.
-// NOTE: these methods must be thread-safe!
+// NOTE: one thread at a time.
 RESULT
 TouchInput::BeginTouch( TouchEvent* pTouchEvent )
 {
     DEBUGMSG(ZONE_TOUCH | ZONE_VERBOSE, "TouchInput::BeginTouch( 0x%x, %4.2f x %4.2f )", 
         pTouchEvent->id, pTouchEvent->point.x, pTouchEvent->point.y);
     
-    return SendToListeners( pTouchEvent );
+    return QueueTouch( pTouchEvent );
 }
 
 
@@ -192,7 +273,7 @@ TouchInput::UpdateTouch( TouchEvent* pTouchEvent )
     DEBUGMSG(ZONE_TOUCH | ZONE_VERBOSE, "TouchInput::UpdateTouch( 0x%x, %4.2f x %4.2f )", 
         pTouchEvent->id, pTouchEvent->point.x, pTouchEvent->point.y);
     
-    return SendToListeners( pTouchEvent );
+    return QueueTouch( pTouchEvent );
 }
 
 
@@ -203,19 +284,95 @@ TouchInput::EndTouch( TouchEvent* pTouchEvent )
     DEBUGMSG(ZONE_TOUCH | ZONE_VERBOSE, "TouchInput::EndTouch( 0x%x, %4.2f x %4.2f )", 
         pTouchEvent->id, pTouchEvent->point.x, pTouchEvent->point.y);
     
-    return SendToListeners( pTouchEvent );
+    return QueueTouch( pTouchEvent );
 }
 
 
 
 RESULT
-TouchInput::SendToListeners( TouchEvent* pTouchEvent )
+TouchInput::QueueTouch( TouchEvent* pTouchEvent )
 {
-    // TODO: take a critical section here
+    RESULT rval = S_OK;
+
+    CPREx(pTouchEvent, E_NULL_POINTER);
+
+    if (!m_isQueueEnabled)
+    {
+        rval = SendToListeners( pTouchEvent );
+        goto Exit;
+    }
+
+    if (!pTouchEvent->timestamp)
+    {
+        pTouchEvent->timestamp = Platform::GetTickCount();
+    }
+
+    if (!m_queue.Push( *pTouchEvent ))
+    {
+        // Better a dropped touch than a stalled input thread.
+        m_pQueueFullMetric->Increment();
+        rval = E_OUTOFMEMORY;
+    }
+
+Exit:
+    return rval;
+}
+
+
+
+RESULT
+TouchInput::ProcessEvents( )
+{
+    RESULT                  rval    = S_OK;
+    TouchEvent              event;
+    map<UINT32, UINT32>     latestUpdates;      // Touch id -> its MSG_TouchUpdate in m_pendingEvents, until it begins or ends again.
+
+    m_pendingEvents.clear();
+
+    // No more than a queue's worth, so a busy producer can't keep us here.
+    for (UINT32 i = 0; i < TOUCH_QUEUE_SIZE && m_queue.Pop( &event ); ++i)
+    {
+        if (TOUCH_EVENT_UPDATE == event.type)
+        {
+            map<UINT32, UINT32>::iterator pLatest = latestUpdates.find( event.id );
+
+            if (pLatest != latestUpdates.end())
+            {
+                m_pendingEvents[ pLatest->second ] = event;
+                m_pCoalescedMetric->Increment();
+                continue;
+            }
+
+            latestUpdates[ event.id ] = (UINT32)m_pendingEvents.size();
+        }
+        else
+        {
+            latestUpdates.erase( event.id );
+        }
+
+        m_pendingEvents.push_back( event );
+    }
+
+    for (UINT32 i = 0; i < m_pendingEvents.size(); ++i)
+    {
+        IGNOREHR(SendToListeners( &m_pendingEvents[i] ));
+        m_pEventsMetric->Increment();
+    }
+
+    return rval;
+}
+
 
+
+RESULT
+TouchInput::SendToListeners( TouchEvent* pTouchEvent )
+{
     RESULT                      rval                = S_OK;
     MSG_Name                    msg                 = MSG_NULL;
     MsgToListenersMapIterator   pEventListeners;
+    PerfTimer                   timer;
+
+    timer.Start();
 
     if (!pTouchEvent)
     {
@@ -223,6 +380,11 @@ TouchInput::SendToListeners( TouchEvent* pTouchEvent )
         goto Exit;
     }
 
+    if (!m_isInitialized)
+    {
+        IGNOREHR(Init());
+    }
+
 
     //
     // Convert from iOS coordinates to ZEngine coordinates.
@@ -234,32 +396,22 @@ TouchInput::SendToListeners( TouchEvent* pTouchEvent )
     {
         Point2D deviceCoords = pTouchEvent->point;
         Point2D engineCoords;
-        
-        float     worldScaleFactor;
-        float     screenScaleFactor;
-        Rectangle screenRect;
-
 
         //
         // Convert from points to pixels.
         //
-        Platform::GetScreenRect ( &screenRect );
-        screenScaleFactor = Platform::GetScreenScaleFactor(); 
-    
-        engineCoords.x = deviceCoords.x * screenScaleFactor;
-        engineCoords.y = screenRect.height - (deviceCoords.y * screenScaleFactor);
+        engineCoords.x = deviceCoords.x * m_screenScaleFactor;
+        engineCoords.y = m_screenHeight - (deviceCoords.y * m_screenScaleFactor);
     
-        worldScaleFactor = GlobalSettings.GetFloat("/Settings.fWorldScaleFactor", 1.0f); 
-        engineCoords.x    /= worldScaleFactor;
-        engineCoords.y    /= worldScaleFactor;
+        engineCoords.x    /= m_worldScaleFactor;
+        engineCoords.y    /= m_worldScaleFactor;
     
-        RETAILMSG(ZONE_TOUCH | ZONE_VERBOSE, "TouchInput: convert from device (%2.2f x %2.2f) to Zengine (%2.2f x %2.2f), screenRect %2.2f x %2.2f, screenScaleFactor %2.2f, worldScaleFactor %2.2f",
+        RETAILMSG(ZONE_TOUCH | ZONE_VERBOSE, "TouchInput: convert from device (%2.2f x %2.2f) to Zengine (%2.2f x %2.2f), screen height %2.2f, screenScaleFactor %2.2f, worldScaleFactor %2.2f",
             deviceCoords.x, deviceCoords.y,
             engineCoords.x, engineCoords.y,
-            screenRect.width,
-            screenRect.height,
-            screenScaleFactor,
-            worldScaleFactor);
+            m_screenHeight,
+            m_screenScaleFactor,
+            m_worldScaleFactor);
             
         pTouchEvent->point = engineCoords;
     }
@@ -306,15 +458,184 @@ TouchInput::SendToListeners( TouchEvent* pTouchEvent )
             }
             else
             {
+                m_pDeliveriesMetric->Increment();
                 ++ppListener;
             }
         }
     }
+
+    SendToHitListeners( msg, pTouchEvent );
+
+    timer.Stop();
+    m_pDispatchTimeMetric->Record( timer.ElapsedMilliseconds() );
     
 Exit:
     return rval;
 }
 
 
+
+//
+// Which grid cell a ZEngine coordinate falls in; off-screen coordinates fall in the edge cells.
+//
+static UINT32
+HitCell( float coordinate, UINT32 numCells )
+{
+    float cell = floorf( coordinate / TOUCH_GRID_CELL_SIZE );
+
+    if (cell < 0.0f)
+    {
+        return 0;
+    }
+
+    return cell < (float)numCells ? (UINT32)cell : numCells - 1;
+}
+
+
+
+void
+TouchInput::SendToHitListeners( MSG_Name msg, TouchEvent* pTouchEvent )
+{
+    MsgToListenersMapIterator   pHitListeners   = m_msgToHitListenersMap.find( msg );
+    vector<OBJECT_ID>           recipients;
+
+    if (pHitListeners != m_msgToHitListenersMap.end())
+    {
+        EventListenerList& listeners = pHitListeners->second;
+
+        if (!m_isHitIndexEnabled)
+        {
+            // Everyone, as before.
+            recipients.assign( listeners.begin(), listeners.end() );
+        }
+        else if (MSG_TouchBegin == msg)
+        {
+            if (m_isHitIndexDirty || m_hitIndexEpoch != Culling::GetEpoch())
+            {
+                BuildHitIndex();
+            }
+
+            UINT32                  column      = HitCell( pTouchEvent->point.x, m_hitColumns );
+            UINT32                  row         = HitCell( pTouchEvent->point.y, m_hitRows    );
+            const vector<UINT32>&   cell        = m_hitCells[ row * m_hitColumns + column ];
+            EventListenerList&      captured    = m_touchToHitListenersMap[ pTouchEvent->id ];
+
+            captured.clear();
+
+            for (UINT32 i = 0; i < cell.size(); ++i)
+            {
+                const HitEntry& entry = m_hitEntries[ cell[i] ];
+
+                if (entry.bounds.Intersects( pTouchEvent->point ))
+                {
+                    recipients.push_back( entry.id );
+                    captured.insert( entry.id );
+                }
+            }
+        }
+        else
+        {
+            // Whoever took this touch's MSG_TouchBegin.
+            TouchToListenersMap::iterator pCaptured = m_touchToHitListenersMap.find( pTouchEvent->id );
+
+            if (pCaptured != m_touchToHitListenersMap.end())
+            {
+                for (EventListenerListIterator ppListener = pCaptured->second.begin(); ppListener != pCaptured->second.end(); ++ppListener)
+                {
+                    if (listeners.count( *ppListener ))
+                    {
+                        recipients.push_back( *ppListener );
+                    }
+                }
+            }
+        }
+    }
+
+    for (UINT32 i = 0; i < recipients.size(); ++i)
+    {
+        // An earlier recipient may have removed this one, e.g. by smashing its brick.
+        if (!pHitListeners->second.count( recipients[i] ))
+        {
+            continue;
+        }
+
+        DEBUGMSG(ZONE_TOUCH | ZONE_VERBOSE, "TouchInput::SendToHitListeners(): touch: %d goid: %d",
+            pTouchEvent->type, recipients[i]);
+
+        if (FAILED(GOMan.SendMessageFromSystem( recipients[i], msg, pTouchEvent )))
+        {
+            // Object may have deleted itself without unregistering; remove it from the list.
+            pHitListeners->second.erase( recipients[i] );
+            m_isHitIndexDirty = true;
+        }
+        else
+        {
+            m_pDeliveriesMetric->Increment();
+        }
+    }
+
+    if (TOUCH_EVENT_END == pTouchEvent->type || TOUCH_EVENT_CANCEL == pTouchEvent->type)
+    {
+        m_touchToHitListenersMap.erase( pTouchEvent->id );
+    }
+}
+
+
+
+void
+TouchInput::BuildHitIndex( )
+{
+    MsgToListenersMapIterator pHitListeners = m_msgToHitListenersMap.find( MSG_TouchBegin );
+
+    for (UINT32 i = 0; i < m_hitCells.size(); ++i)
+    {
+        m_hitCells[i].clear();
+    }
+    m_hitEntries.clear();
+
+    if (pHitListeners != m_msgToHitListenersMap.end())
+    {
+        EventListenerList& listeners = pHitListeners->second;
+
+        for (EventListenerListIterator ppListener = listeners.begin(); ppListener != listeners.end(); )
+        {
+            GameObject* pGameObject = NULL;
+            HitEntry    entry;
+
+            if (FAILED(GOMan.GetGameObjectPointer( *ppListener, &pGameObject )) || !pGameObject)
+            {
+                // Deleted without unregistering.
+                listeners.erase( ppListener++ );
+                continue;
+            }
+
+            entry.id      = *ppListener;
+            entry.bounds  = pGameObject->GetBounds();
+            entry.bounds *= TOUCH_HIT_SLOP;
+            m_hitEntries.push_back( entry );
+
+            UINT32 firstColumn  = HitCell( entry.bounds.GetMin().x, m_hitColumns );
+            UINT32 lastColumn   = HitCell( entry.bounds.GetMax().x, m_hitColumns );
+            UINT32 firstRow     = HitCell( entry.bounds.GetMin().y, m_hitRows    );
+            UINT32 lastRow      = HitCell( entry.bounds.GetMax().y, m_hitRows    );
+
+            for (UINT32 row = firstRow; row <= lastRow; ++row)
+            {
+                for (UINT32 column = firstColumn; column <= lastColumn; ++column)
+                {
+                    m_hitCells[ row * m_hitColumns + column ].push_back( (UINT32)m_hitEntries.size() - 1 );
+                }
+            }
+
+            ++ppListener;
+        }
+    }
+
+    m_hitIndexEpoch     = Culling::GetEpoch();
+    m_isHitIndexDirty   = false;
+    m_pIndexBuildsMetric->Increment();
+}
+
+
 } // END namespace Z
 
@@ -4,11 +4,15 @@
 #include "Object.hpp"
 #include "Platform.hpp"
 #include "EventSource.hpp"
+#include "Metrics.hpp"
+#include "RingBuffer.hpp"
 
 #include <set>
 #include <map>
+#include <vector>
 using std::set;
 using std::map;
+using std::vector;
 
 
 namespace Z
@@ -41,9 +45,29 @@ struct TouchEvent
 // This means asynch OS notifications will be queued to the listeners and processed inline 
 // with the other game updates.
 //
+// BeginTouch(), UpdateTouch() and EndTouch() only copy the touch into a lock-free
+// queue; ProcessEvents(), from Engine::Update(), delivers them in order on the engine's
+// thread.  A touch's consecutive MSG_TouchUpdates are coalesced into the latest one.
+// Each TouchEvent keeps the timestamp it was queued with.  Off by default, delivering
+// on the calling thread as before; enable with Settings.bQueueInput = "1".
+//
 // Sends MSG_TouchBegin, MSG_TouchUpdate, and MSG_TouchEnd.  
 // Each has an associated TouchEvent in msg->GetPointerData().
 //
+// AddListener() listeners get every touch.  AddHitListener() listeners - bricks - only
+// get the touches that begin on them: MSG_TouchBegin goes to those whose bounds, grown
+// by TOUCH_HIT_SLOP as the brick states grow them, hold the touch point.  They're found
+// through a grid of TOUCH_GRID_CELL_SIZE squares over the screen, rebuilt when the
+// listeners change or Culling's epoch says something moved.  The MSG_TouchUpdates and
+// MSG_TouchEnd for that touch then go to the same listeners, wherever it ends up.
+//
+// Off by default, sending every touch to every listener; enable with
+// Settings.bTouchHitIndex = "1".
+//
+
+#define TOUCH_GRID_CELL_SIZE    64.0f
+#define TOUCH_HIT_SLOP          1.5f
+#define TOUCH_QUEUE_SIZE        256         // Must be a power of two.
 
 class TouchInput : virtual public Object, public IEventSource
 {
@@ -58,16 +82,34 @@ public:
     virtual RESULT      RemoveListener      ( HGameObject hListener, MSG_Name msg );
 //    virtual RESULT      RemoveListener      ( HGameObject hListener );
 
+    // Instead of AddListener(), not as well.  RemoveListener() removes either.
+    RESULT              AddHitListener      ( HGameObject hListener, MSG_Name msg );
+
+    // Cache the screen size and scale factors; after Settings.fWorldScaleFactor is final.
+    RESULT              Init                ( );
+
+    void                EnableHitIndex      ( bool enabled )    { m_isHitIndexEnabled = enabled; m_isHitIndexDirty = true; }
+    bool                IsHitIndexEnabled   ( )                 { return m_isHitIndexEnabled; }
+
 
     // The native touch handler should call these methods to inject touches
     // into ZEngine.
-    // NOTE: these methods must be thread-safe!
+    // NOTE: one thread at a time; E_OUTOFMEMORY if the queue is full.
     RESULT              BeginTouch          ( TouchEvent* pTouchEvent    );
     RESULT              UpdateTouch         ( TouchEvent* pTouchEvent    );
     RESULT              EndTouch            ( TouchEvent* pTouchEvent    );
 
+    // Deliver the queued touches; from the engine's thread only.
+    RESULT              ProcessEvents       ( );
+
+    void                EnableQueue         ( bool enabled )    { m_isQueueEnabled = enabled; }
+    bool                IsQueueEnabled      ( )                 { return m_isQueueEnabled; }
+
 protected:
+    RESULT              QueueTouch          ( TouchEvent* pTouchEvent    );
     RESULT              SendToListeners     ( TouchEvent* pTouchEvent    );
+    void                SendToHitListeners  ( MSG_Name msg, TouchEvent* pTouchEvent );
+    void                BuildHitIndex       ( );
 
 protected:
     TouchInput();
@@ -86,6 +128,40 @@ protected:
     typedef MsgToListenersMap::iterator             MsgToListenersMapIterator;
 
     MsgToListenersMap   m_msgToListenersMap;
+    MsgToListenersMap   m_msgToHitListenersMap;
+
+    struct HitEntry
+    {
+        OBJECT_ID       id;
+        AABB            bounds;         // Grown by TOUCH_HIT_SLOP.
+    };
+
+    typedef map<UINT32, EventListenerList>          TouchToListenersMap;
+
+    bool                m_isInitialized;
+    bool                m_isQueueEnabled;
+    RingBuffer<TouchEvent, TOUCH_QUEUE_SIZE> m_queue;
+    vector<TouchEvent>  m_pendingEvents;            // ProcessEvents()' coalesced copy of the queue.
+
+    float               m_screenScaleFactor;
+    float               m_worldScaleFactor;
+    float               m_screenHeight;             // Pixels.
+
+    bool                m_isHitIndexEnabled;
+    bool                m_isHitIndexDirty;
+    UINT32              m_hitIndexEpoch;
+    UINT32              m_hitColumns;
+    UINT32              m_hitRows;
+    vector<HitEntry>    m_hitEntries;
+    vector< vector<UINT32> > m_hitCells;            // m_hitRows x m_hitColumns; indices into m_hitEntries.
+    TouchToListenersMap m_touchToHitListenersMap;   // Who took each live touch's MSG_TouchBegin.
+
+    MetricHistogram*    m_pDispatchTimeMetric;
+    MetricCounter*      m_pDeliveriesMetric;
+    MetricCounter*      m_pIndexBuildsMetric;
+    MetricCounter*      m_pQueueFullMetric;
+    MetricCounter*      m_pCoalescedMetric;
+    MetricCounter*      m_pEventsMetric;
 };
 
 
@@ -454,9 +454,9 @@ Exit:
 
 
 RESULT
-Animation::Start( )
+Animation::Start( UINT64 startAtMS )
 { 
-    DEBUGMSG(ZONE_ANIMATION, "START Animation \"%s\"", m_name.c_str());
+    DEBUGMSG(ZONE_ANIMATION, "START Animation \"%s\" at %llu ms", m_name.c_str(), startAtMS);
 
     m_isStarted     = true;  
     m_isPaused      = false; 
@@ -465,6 +465,9 @@ Animation::Start( )
 //    m_nextKeyFrame  = 0;
     m_nextKeyFrame  = 1;
     m_startTimeMS   = GameTime.GetTime(); // TODO: defer to first Update() call???  The StateMachines have too much latency for short animations. :-(
+
+    // Update() finds the keyframes from the elapsed time, so starting late is just an earlier start time.
+    m_startTimeMS  -= MIN(startAtMS, m_startTimeMS);
     
     return S_OK;
 }
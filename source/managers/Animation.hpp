@@ -535,7 +535,7 @@ public:
 
     RESULT          CallbackOnFinished          ( ICallback& callback );
     
-    RESULT          Start                       ( );
+    RESULT          Start                       ( UINT64 startAtMS = 0 );          // Begin startAtMS into the animation, e.g. to resume it.
     RESULT          Stop                        ( );
     RESULT          Pause                       ( );
     
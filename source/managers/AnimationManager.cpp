@@ -370,7 +370,7 @@ Exit:
 
 
 RESULT
-AnimationManager::Start( IN HAnimation handle )
+AnimationManager::Start( IN HAnimation handle, UINT64 startAtMS )
 {
     RESULT rval = S_OK;
     
@@ -384,7 +384,7 @@ AnimationManager::Start( IN HAnimation handle )
     if (pAnimation)
     {
         RETAILMSG(ZONE_ANIMATION | ZONE_VERBOSE, "AnimationManager::Start( \"%s\" )", pAnimation->GetName().c_str());
-        pAnimation->Start();
+        pAnimation->Start( startAtMS );
     }
     else 
     {
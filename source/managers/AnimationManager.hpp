@@ -54,7 +54,7 @@ public:
 
     RESULT          CallbackOnFinished          ( IN HAnimation handle, ICallback& callback );
 
-    RESULT          Start                       ( IN HAnimation handle );
+    RESULT          Start                       ( IN HAnimation handle, UINT64 startAtMS = 0 );
     RESULT          Stop                        ( IN HAnimation handle );
     RESULT          Pause                       ( IN HAnimation handle );
 
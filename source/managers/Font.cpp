@@ -14,6 +14,9 @@
 
 // TEST
 #include "DebugRenderer.hpp"
+#include "Profiler.hpp"
+#include "QuadList.hpp"
+#include "Metrics.hpp"
 
 #include <string>
 using std::string;
@@ -49,9 +52,14 @@ Font::Font() :
     m_pFontChars(NULL),
     m_lineHeight(0),
     m_textureWidth(0),
-    m_textureHeight(0)
+    m_textureHeight(0),
+    m_runClock(0),
+    m_isBatching(false)
 {
     RETAILMSG(ZONE_OBJECT | ZONE_VERBOSE, "Font( %4d )", m_ID);
+
+    // GlyphRuns are handed out by pointer; never let the list move them.
+    m_runs.reserve( FONT_RUN_CACHE_SIZE );
 }
 
 
@@ -270,57 +278,50 @@ Font::GetWidth( IN const string& text )
 RESULT
 Font::Draw( IN const vec2& position, IN const string& characters, Color color, float scale, float opacity, float rotX, float rotY, float rotZ, bool worldSpace )
 {
-    RESULT      rval = S_OK;
-    const char* str;
-
-    str = characters.c_str();
-    CHR(Draw( position, str, color, scale, opacity, worldSpace ));
-
-Exit:
-    return rval;
+    return Draw( position, characters.c_str(), color, scale, opacity, rotX, rotY, rotZ, worldSpace );
 }
 
 
-//
-//
-// TODO: RenderBatch
-//
-//
-
 
 RESULT
 Font::Draw( IN const vec2& position, IN const char* pCharacters, Color color, float scale, float opacity, float rotX, float rotY, float rotZ, bool worldSpace )
 {
-    RESULT      rval = S_OK;
-    UINT32      length;
-    Vertex*     pVertices;
-    Vertex*     pQuad;
-    FontChar*   pFontChar;
-    vec2        cursorPos;
-    mat4        modelview;
-//    mat4        camera = GameCamera.GetWorldViewMatrix();
-//    mat4        camera = GameCamera.GetViewMatrix();
+    RESULT          rval = S_OK;
+
+    PROFILE_SCOPE("Font::Draw");
+    const GlyphRun* pRun = NULL;
+    mat4            transform;
+    mat4            modelview;
 
     CPR(pCharacters);
 
-    length = strlen(pCharacters);
-    if (0 == length)
+    if (0 == *pCharacters)
         return S_OK;
 
-
-    
     // Skip drawing text w/ zero opacity.
     if (Util::CompareFloats(opacity, 0.0f))
         return rval;
 
+    CHR(GetRun( pCharacters, &pRun ));
+
     //
-    // Transform the text based on scale, rotation, position.
+    // Scale, rotate, and position the text on the CPU, so that any number of strings
+    // can share one draw.  The depth, and the camera for world space text, stay in
+    // the modelview.
     //
-    modelview  = mat4::Scale( scale );
-    modelview *= mat4::RotateX( rotX );
-    modelview *= mat4::RotateY( rotY );
-    modelview *= mat4::RotateZ( rotZ );
-    modelview *= mat4::Translate( position.x, position.y, 1.0 );
+    transform  = mat4::Scale( scale );
+    transform *= mat4::RotateX( rotX );
+    transform *= mat4::RotateY( rotY );
+    transform *= mat4::RotateZ( rotZ );
+    transform *= mat4::Translate( position.x, position.y, 0.0f );
+
+    modelview  = mat4::Translate( 0.0f, 0.0f, 1.0f );
+
+    if (m_isBatching && !worldSpace)
+    {
+        AppendRun( *pRun, transform, color, opacity, &m_batchVertices );
+        goto Exit;
+    }
 
     // Is the font being drawn in world space (3D) ?
     // Otherwise, draw in screen space.
@@ -329,15 +330,93 @@ Font::Draw( IN const vec2& position, IN const char* pCharacters, Color color, fl
         modelview *= GameCamera.GetViewMatrix();
     }
 
+    m_scratchVertices.clear();
+    AppendRun( *pRun, transform, color, opacity, &m_scratchVertices );
+    CHR(Submit( m_scratchVertices, modelview ));
+
+Exit:
+    if (FAILED(rval))
+    {
+        RETAILMSG(ZONE_ERROR, "ERROR: Font::Draw(): 0x%x", rval);
+        DEBUGCHK(0);
+    }
+
+    return rval;
+}
 
-    // Allocate a vertex buffer
-    // TODO: VBOs faster?
-    pVertices = new Vertex[ length * VERTS_PER_GLYPH ];
-    CPREx(pVertices, E_OUTOFMEMORY);
-    memset(pVertices, 0, sizeof(Vertex)*length);
-    pQuad = pVertices;
+
+
+void
+Font::BeginBatch()
+{
+    m_isBatching = true;
+    m_batchVertices.clear();
+}
+
+
+
+RESULT
+Font::EndBatch()
+{
+    RESULT rval = S_OK;
+
+    m_isBatching = false;
+
+    // Everything collected was transformed in AppendRun(); only the depth is left.
+    CHR(Submit( m_batchVertices, mat4::Translate( 0.0f, 0.0f, 1.0f ) ));
+
+Exit:
+    m_batchVertices.clear();
+    return rval;
+}
+
+
+
+RESULT
+Font::GetRun( IN const char* pCharacters, OUT const GlyphRun** ppRun )
+{
+    static MetricCounter* s_pRunHitsMetric   = Metrics::RegisterCounter("Fonts.RunHits");
+    static MetricCounter* s_pRunsBuiltMetric = Metrics::RegisterCounter("Fonts.RunsBuilt");
+
+    RESULT      rval    = S_OK;
+    GlyphRun*   pRun    = NULL;
+    FontChar*   pFontChar;
+    Vertex      triangles[ VERTS_PER_GLYPH ];
+    vec2        cursorPos;
+    UINT32      glyph;
+
+    m_runClock++;
+
+    for (GlyphRunList::iterator pItem = m_runs.begin(); pItem != m_runs.end(); ++pItem)
+    {
+        if (pItem->text == pCharacters)
+        {
+            pItem->lastUsed = m_runClock;
+            *ppRun          = &(*pItem);
+
+            s_pRunHitsMetric->Increment();
+            goto Exit;
+        }
+
+        if (!pRun || pItem->lastUsed < pRun->lastUsed)
+        {
+            pRun = &(*pItem);
+        }
+    }
+
+    // A new string; take a free slot, or the one used least recently.
+    if (m_runs.size() < FONT_RUN_CACHE_SIZE)
+    {
+        m_runs.push_back( GlyphRun() );
+        pRun = &m_runs.back();
+    }
+
+    pRun->text      = pCharacters;
+    pRun->lastUsed  = m_runClock;
+    pRun->corners.resize( pRun->text.length() * VERTS_PER_QUAD );
 
     cursorPos = vec2(0,0);
+    glyph     = 0;
 
     while( *pCharacters )
     {
@@ -385,52 +464,117 @@ Font::Draw( IN const vec2& position, IN const char* pCharacters, Color color, fl
         float vStart = pFontChar->v0;
         float vEnd   = vStart + (pFontChar->height / m_textureHeight );
 
-        CHR(Util::CreateTriangleList( &rect, 1, 1, pQuad, uStart, uEnd, vStart, vEnd ));
- 
-        for (int i = 0; i < 6; ++i)
-        {
-            pQuad[i].color  = color;
-            pQuad[i].a      = (BYTE)(255 * opacity);
-        }
-        
-        
-/*
-        // TEST
-        vec3 min( pQuad[0].x, pQuad[0].y, pQuad[0].z );
-        vec3 max( pQuad[5].x, pQuad[5].y, pQuad[5].z );
-        min = modelview * min;
-        max = modelview * max;
-        AABB bounds( min, max );
-        DebugRender.Quad( bounds, Color::Green(), 0.2f );
-*/        
+        CHR(Util::CreateTriangleList( &rect, 1, 1, triangles, uStart, uEnd, vStart, vEnd ));
+        QuadList::FromTriangleList( triangles, 1, &pRun->corners[ glyph * VERTS_PER_QUAD ] );
 
         cursorPos += pFontChar->advance;
-        pQuad     += VERTS_PER_GLYPH;
+        glyph++;
         pCharacters++;
     }
-    
 
-    
+    *ppRun = pRun;
+    s_pRunsBuiltMetric->Increment();
+
+Exit:
+    if (FAILED(rval) && pRun)
+    {
+        // Don't let a half-built run be found later.
+        pRun->text.clear();
+    }
+
+    return rval;
+}
+
+
+
+void
+Font::AppendRun( IN const GlyphRun& run, IN const mat4& transform, Color color, float opacity, INOUT vector<Vertex>* pVertices )
+{
+    UINT32  first   = pVertices->size();
+    UINT32  count   = run.corners.size();
+    BYTE    alpha   = (BYTE)(255 * opacity);
+
+    // Grows to the largest frame's text, then stays; no allocation after that.
+    pVertices->resize( first + count );
+
+    for (UINT32 i = 0; i < count; ++i)
+    {
+        const Vertex&   in  = run.corners[i];
+        Vertex&         out = (*pVertices)[ first + i ];
+
+        // Glyphs are laid out at z = 0; as vec4( x, y, 0, 1 ) * transform.
+        out.x       = in.x * transform.x.x + in.y * transform.y.x + transform.w.x;
+        out.y       = in.x * transform.x.y + in.y * transform.y.y + transform.w.y;
+        out.z       = in.x * transform.x.z + in.y * transform.y.z + transform.w.z;
+        out.u0      = in.u0;
+        out.v0      = in.v0;
+        out.color   = color;
+        out.a       = alpha;
+    }
+}
+
+
+
+RESULT
+Font::Submit( IN vector<Vertex>& vertices, IN const mat4& modelview )
+{
+    static MetricCounter* s_pDrawCallsMetric = Metrics::RegisterCounter("Fonts.DrawCalls");
+
+    RESULT  rval        = S_OK;
+    UINT32  numGlyphs   = vertices.size() / VERTS_PER_QUAD;
+
+    if (0 == numGlyphs)
+        return S_OK;
+
 //    CHR(Renderer.PushEffect( m_hEffect ));
     CHR(Renderer.SetModelViewMatrix( modelview ));
     CHR(Renderer.SetTexture( 0, m_hTexture ));
-    CHR(Renderer.DrawTriangleList( pVertices, length * VERTS_PER_GLYPH ));
 
-/*
-    // TEST: 
-    DebugRender.Draw();
-*/
+    //
+    // Glyphs are flat rectangles; send them as indexed quads, 
+    // and packed when nothing would be lost.
+    //
+    if (QuadList::IsEnabled())
+    {
+        if (QuadList::IsPackingEnabled() && QuadList::CanPack( &vertices[0], vertices.size() ))
+        {
+            m_packedVertices.resize( vertices.size() );
+            QuadList::Pack( &vertices[0], vertices.size(), &m_packedVertices[0] );
 
-Exit:
-    if (FAILED(rval))
+            CHR(Renderer.DrawPackedQuadList( &m_packedVertices[0], numGlyphs ));
+        }
+        else
+        {
+            CHR(Renderer.DrawQuadList( &vertices[0], numGlyphs ));
+        }
+    }
+    else
     {
-        RETAILMSG(ZONE_ERROR, "ERROR: Font::Draw(): 0x%x", rval);
-        DEBUGCHK(0);
+        // Back to the two triangles per glyph that Util::CreateTriangleList() makes;
+        // in place, last glyph first, so no corner is overwritten before it's read.
+        vertices.resize( numGlyphs * VERTS_PER_GLYPH );
+
+        for (UINT32 glyph = numGlyphs; glyph-- > 0; )
+        {
+            Vertex  corners[ VERTS_PER_QUAD ];
+            Vertex* pTriangles = &vertices[ glyph * VERTS_PER_GLYPH ];
+
+            memcpy(corners, &vertices[ glyph * VERTS_PER_QUAD ], sizeof(corners));
+
+            pTriangles[0] = corners[0];
+            pTriangles[1] = corners[1];
+            pTriangles[2] = corners[2];
+            pTriangles[3] = corners[2];
+            pTriangles[4] = corners[1];
+            pTriangles[5] = corners[3];
+        }
+
+        CHR(Renderer.DrawTriangleList( &vertices[0], numGlyphs * VERTS_PER_GLYPH ));
     }
 
-//    CHR(Renderer.PopEffect());
-    SAFE_ARRAY_DELETE(pVertices);
+    s_pDrawCallsMetric->Increment();
 
+Exit:
     return rval;
 }
 
@@ -6,9 +6,12 @@
 #include "Settings.hpp"
 #include "TextureManager.hpp"
 #include "EffectManager.hpp"
+#include "Vertex.hpp"
 
 #include <string>
+#include <vector>
 using std::string;
+using std::vector;
 
 
 namespace Z
@@ -20,7 +23,15 @@ namespace Z
 //
 // A Font instance.
 //
+// Laid-out strings ("glyph runs") are cached, so text that doesn't change from
+// frame to frame isn't rebuilt.  Between BeginBatch() and EndBatch(), screen-space
+// text is transformed on the CPU and collected, then drawn with one call per Font.
+//
 //=============================================================================
+
+#define FONT_RUN_CACHE_SIZE     32      // Glyph runs kept per Font.
+
+
 class Font : virtual public Object
 {
 public:
@@ -31,11 +42,28 @@ public:
     RESULT          Draw                ( IN const vec2& position, IN const string& characters,  Color color = Color::White(), float scale = 1.0f, float opacity = 1.0f, float rotX = 0, float rotY = 0, float rotZ = 0, bool worldSpace = false /* TODO: custom layout function, e.g. cos, sin, circle */ );
     RESULT          Draw                ( IN const vec2& position, IN const char*   pCharacters, Color color = Color::White(), float scale = 1.0f, float opacity = 1.0f, float rotX = 0, float rotY = 0, float rotZ = 0, bool worldSpace = false /* TODO: custom layout function, e.g. cos, sin, circle */ );
 
+    // Collect Draw()s until EndBatch(); see FontManager::BeginBatch().
+    void            BeginBatch          ( );
+    RESULT          EndBatch            ( );
+
     inline float    GetHeight           ( )                             { return m_lineHeight; }
     float           GetWidth            ( IN const string& text );
 
 protected:
+    // One string, laid out at the origin: VERTS_PER_QUAD corners per glyph, color not set.
+    struct GlyphRun
+    {
+        string          text;
+        vector<Vertex>  corners;
+        UINT32          lastUsed;
+    };
+
+    typedef vector<GlyphRun> GlyphRunList;
+
     RESULT          InitFromFNTFile     ( IN const string& filename );
+    RESULT          GetRun              ( IN const char* pCharacters, OUT const GlyphRun** ppRun );
+    void            AppendRun           ( IN const GlyphRun& run, IN const mat4& transform, Color color, float opacity, INOUT vector<Vertex>* pVertices );
+    RESULT          Submit              ( IN vector<Vertex>& vertices, IN const mat4& modelview );
     
 
 protected:
@@ -58,6 +86,13 @@ protected:
     float       m_lineHeight;
     float       m_textureHeight;
     float       m_textureWidth;
+
+    GlyphRunList            m_runs;
+    UINT32                  m_runClock;
+    bool                    m_isBatching;
+    vector<Vertex>          m_batchVertices;        // Reused every frame; grows, never shrinks.
+    vector<Vertex>          m_scratchVertices;
+    vector<PackedVertex>    m_packedVertices;
 };
 
 typedef Handle<Font> HFont;
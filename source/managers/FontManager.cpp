@@ -17,6 +17,8 @@
 #include "Types.hpp"
 #include "Util.hpp"
 
+#include <algorithm>
+
 
 
 namespace Z 
@@ -36,7 +38,9 @@ FontManager::Instance()
 }
 
 
-FontManager::FontManager() 
+FontManager::FontManager() :
+    m_isBatchingEnabled(false),
+    m_isBatching(false)
 {
     RETAILMSG(ZONE_VERBOSE, "FontManager()");
     
@@ -217,6 +221,12 @@ FontManager::Draw( IN const vec2& position, IN const string& characters, IN HFon
         goto Exit;
     }
 
+    if (m_isBatching && find(m_batchedFonts.begin(), m_batchedFonts.end(), pFont) == m_batchedFonts.end())
+    {
+        pFont->BeginBatch();
+        m_batchedFonts.push_back( pFont );
+    }
+
     CHR(pFont->Draw( position, characters, color, scale, opacity, rotX, rotY, rotZ, worldSpace ));
 
 Exit:
@@ -243,6 +253,12 @@ FontManager::Draw( IN const vec2& position, IN const char* pCharacters, IN HFont
         goto Exit;
     }
 
+    if (m_isBatching && find(m_batchedFonts.begin(), m_batchedFonts.end(), pFont) == m_batchedFonts.end())
+    {
+        pFont->BeginBatch();
+        m_batchedFonts.push_back( pFont );
+    }
+
     CHR(pFont->Draw( position, pCharacters, color, scale, opacity, rotX, rotY, rotZ, worldSpace ));
 
 Exit:
@@ -251,6 +267,59 @@ Exit:
 
 
 
+void
+FontManager::BeginBatch()
+{
+    if (!m_isBatchingEnabled)
+    {
+        return;
+    }
+
+    // A batch that was never ended is dropped.
+    for (vector<Font*>::iterator ppFont = m_batchedFonts.begin(); ppFont != m_batchedFonts.end(); ++ppFont)
+    {
+        (*ppFont)->BeginBatch();
+    }
+
+    m_isBatching = true;
+}
+
+
+
+RESULT
+FontManager::EndBatch()
+{
+    RESULT rval = S_OK;
+
+    if (!m_isBatching)
+    {
+        return S_OK;
+    }
+
+    m_isBatching = false;
+
+    for (vector<Font*>::iterator ppFont = m_batchedFonts.begin(); ppFont != m_batchedFonts.end(); ++ppFont)
+    {
+        // Flush every Font, but report the first that failed.
+        RESULT hr = (*ppFont)->EndBatch();
+        if (FAILED(hr) && SUCCEEDED(rval))
+        {
+            rval = hr;
+        }
+    }
+
+    m_batchedFonts.clear();
+
+    if (FAILED(rval))
+    {
+        RETAILMSG(ZONE_ERROR, "ERROR: FontManager::EndBatch(): 0x%x", rval);
+    }
+
+    return rval;
+}
+
+
+
 float
 FontManager::GetHeight( IN HFont hFont )
 {
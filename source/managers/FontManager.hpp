@@ -33,6 +33,13 @@ public:
     float           GetWidth    ( IN HFont hFont, IN const string& text );
     float           GetHeight   ( IN const string& name );
     float           GetWidth    ( IN const string& name, IN const string& text );
+
+    // Screen space text drawn between BeginBatch() and EndBatch() is collected per Font
+    // and drawn with one call per Font, at EndBatch().  World space text is drawn at once.
+    void            BeginBatch  ( );
+    RESULT          EndBatch    ( );
+    void            EnableBatching( bool enabled )  { m_isBatchingEnabled = enabled; }
+    bool            IsBatchingEnabled( )            { return m_isBatchingEnabled; }
     
 protected:
     FontManager();
@@ -44,7 +51,11 @@ protected:
   
     
 protected:
-    HFont       m_hDefaultFont;
+    HFont           m_hDefaultFont;
+
+    bool            m_isBatchingEnabled;
+    bool            m_isBatching;
+    vector<Font*>   m_batchedFonts;
     
           
 /*
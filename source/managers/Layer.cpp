@@ -14,6 +14,9 @@
 #include "StoryboardManager.hpp"
 #include "ParticleManager.hpp"
 #include "Engine.hpp"
+#include "Profiler.hpp"
+
+#include <string.h>
 
 
 namespace Z 
@@ -49,7 +52,10 @@ Layer::Layer() :
     m_fScale(1.0f),
     m_fOpacity(1.0f),
     m_color(Color::White()),
-    m_isShadowEnabled(false)
+    m_isShadowEnabled(false),
+    m_transform(Transforms::Create()),
+    m_isContentCulled(false),
+    m_cullEpoch(0)
 {
     RETAILMSG(ZONE_OBJECT | ZONE_VERBOSE, "Layer( %4d )", m_ID);
 
@@ -62,6 +68,9 @@ Layer::~Layer()
 {
     RETAILMSG(ZONE_OBJECT | ZONE_VERBOSE, "\t~Layer( %4d )", m_ID);
     
+    // Drop the vertices SpriteMan retained for us.
+    IGNOREHR(SpriteMan.FreeBatches( this ));
+
 
     SpriteListIterator      pHSprite;
     for (pHSprite = m_spriteList.begin(); pHSprite != m_spriteList.end(); ++pHSprite)
@@ -93,6 +102,8 @@ Layer::~Layer()
     {
         EffectMan.Release(m_hEffect);
     }
+
+    Transforms::Destroy( m_transform );
 }
 
 
@@ -154,6 +165,7 @@ Layer::AddGameObject( IN const HGameObject hGameObject )
 
     // Push to back so newer items draw on top of older items.
     m_gameObjectList.push_back( hGameObject );
+    Culling::Invalidate();
 
 //    CHR(GOMan.AddRef( hGameObject ));
 
@@ -173,6 +185,7 @@ Layer::AddSprite( IN const HSprite hSprite )
 
     // Push to back so newer items draw on top of older items.
     m_spriteList.push_back( hSprite );
+    Culling::Invalidate();
 
 //    CHR(SpriteMan.AddRef( hSprite ));
 
@@ -218,6 +231,7 @@ Layer::AddParticleEmitter( IN const HParticleEmitter hParticleEmitter )
 
     // Push to back so newer items draw on top of older items.
     m_particleEmitterList.push_back( hParticleEmitter );
+    Culling::Invalidate();
 
 //    CHR(Particles.AddRef( hParticleEmitter ));
 
@@ -492,6 +506,8 @@ RESULT
 Layer::Draw( const mat4& matParentWorld )
 {
     RESULT  rval = S_OK;
+
+    PROFILE_SCOPE("Layer::Draw");
     mat4    world;
     LayerListIterator  ppHLayer;
   
@@ -502,22 +518,21 @@ Layer::Draw( const mat4& matParentWorld )
     if ( !m_isVisible || Util::CompareFloats(m_fOpacity, 0.0f))
         return rval;
 
-
     //
-    // Render optional shadow pass.
+    // Skip all our contents - Sprites, GameObject subtrees, ParticleEmitters - if
+    // they were entirely off-screen last time and nothing has moved since.
+    // Child Layers aren't positioned relative to us, so they're still visited.
     //
-    if (m_isShadowEnabled)
-    {    
-        DrawShadowPass( matParentWorld );
-    }
+    bool isContentCulled = m_isContentCulled                   &&
+                           Culling::IsEnabled()                &&
+                           m_cullEpoch == Culling::GetEpoch()  &&
+                           !memcmp( m_matCullParentWorld.Pointer(), matParentWorld.Pointer(), sizeof(float) * 16 );
 
 
     //
     // Apply an Effect, if set.
-    // TODO: if SpriteBatching is enabled, this is WASTEFUL.
-    // However, we can't know this.
-    // Move all batching into a wrapper class on top of IRenderer,
-    // and let it avoid needless Effect calls.
+    // With Settings.bUseRenderQueue this is only bound if something is
+    // actually drawn, and not at all if it's already current.
     //
     CHR(Renderer.PushEffect( m_hEffect ));
 
@@ -526,7 +541,15 @@ Layer::Draw( const mat4& matParentWorld )
     //
     CHR(Renderer.SetGlobalColor( Color(1, 1, 1, m_fOpacity) ));
 
-    CHR(DrawContents( matParentWorld ));
+    if (isContentCulled)
+    {
+        static MetricCounter* s_pLayersCulledMetric = Metrics::RegisterCounter("Culling.LayersCulled");
+        s_pLayersCulledMetric->Increment();
+    }
+    else
+    {
+        CHR(DrawContents( matParentWorld ));
+    }
 
     // Draw child Layers last.
     // Do it after our SpriteBatch so that order is maintained.
@@ -569,43 +592,14 @@ Exit:
 
 
 RESULT
-Layer::DrawShadowPass( const mat4& matParentWorld )
+Layer::DrawContents( const mat4& matParentWorld )
 {
-    RESULT  rval = S_OK;
-    static HEffect hShadowEffect;
-
-    if (hShadowEffect.IsNull())
-    {
-        CHR(EffectMan.Get( "DropShadowEffect", &hShadowEffect ));
-    }
-
+    RESULT rval  = S_OK;
 
-    if (GetNumSprites() > 0 || GetNumGameObjects() > 0)
-    {
-        CHR(Renderer.PushEffect( hShadowEffect ));
-        IGNOREHR(DrawContents( matParentWorld, true ));
-        CHR(Renderer.PopEffect());
-    }
-    
-Exit:
-    return rval;
-}
-
-
-
-RESULT
-Layer::DrawContents( const mat4& matParentWorld, bool shadowPass )
-{
-    RESULT rval = S_OK;
-    mat4   world;
-
-    world *= mat4::Scale( m_fScale );
-    world *= mat4::RotateX( m_vRotation.x ); 
-    world *= mat4::RotateY( m_vRotation.y ); 
-    world *= mat4::RotateZ( m_vRotation.z ); 
-    world *= mat4::Translate( m_vWorldPosition.x, m_vWorldPosition.y, m_vWorldPosition.z );
-
-    world *= matParentWorld;
+    PROFILE_SCOPE("Layer::DrawContents");
+    mat4   world = Transforms::GetWorld( m_transform, matParentWorld );
+    bool   drawShadows = m_isShadowEnabled && (GetNumSprites() > 0 || GetNumGameObjects() > 0);
+    static HEffect hShadowEffect;
 
 
     //
@@ -619,9 +613,20 @@ Layer::DrawContents( const mat4& matParentWorld, bool shadowPass )
 
     SpriteListIterator          ppHSprite;
     GameObjectListIterator      ppHGameObject;
-    ParticleEmitterListIterator ppHParticleEmitter;
 
-    CHR(SpriteMan.BeginBatch());
+    // Everything below reports its eye-space bounds as it's culled or batched.
+    m_cullEpoch             = Culling::GetEpoch();
+    m_matCullParentWorld    = matParentWorld;
+    Culling::BeginBounds();
+
+    if (drawShadows && hShadowEffect.IsNull() && FAILED(EffectMan.Get( "DropShadowEffect", &hShadowEffect )))
+    {
+        drawShadows = false;
+    }
+
+    // SpriteMan keeps this Layer's batches from frame to frame, and only re-transforms
+    // the ones whose Sprites moved, animated, or were added or removed.
+    CHR(SpriteMan.BeginBatch( this ));
 
     // Draw Sprites first; the Layer probably has a large opaque Sprite for a background.
     for (ppHSprite = m_spriteList.begin(); ppHSprite != m_spriteList.end(); /*++ppHSprite*/)
@@ -634,11 +639,7 @@ Layer::DrawContents( const mat4& matParentWorld, bool shadowPass )
             continue;
         }
         
-        if (shadowPass && !SpriteMan.GetShadow( hSprite ))
-        {
-            ++ppHSprite;
-            continue;
-        }
+        IGNOREHR(SpriteMan.SetShadowCasting( drawShadows && SpriteMan.GetShadow( hSprite ) ));
         
         if (FAILED(SpriteMan.DrawSprite( hSprite, world )))
         {
@@ -662,11 +663,7 @@ Layer::DrawContents( const mat4& matParentWorld, bool shadowPass )
             continue;
         }
 
-        if (shadowPass && !GOMan.GetShadow( hGameObject ))
-        {
-            ++ppHGameObject;
-            continue;
-        }
+        IGNOREHR(SpriteMan.SetShadowCasting( drawShadows && GOMan.GetShadow( hGameObject ) ));
             
         if (FAILED(GOMan.Draw( hGameObject, world )))
         {
@@ -679,10 +676,53 @@ Layer::DrawContents( const mat4& matParentWorld, bool shadowPass )
         }
     }
     
-    CHR(SpriteMan.EndBatch());  // TODO: must move batching into Renderer, not Sprites-only.
+    //
+    // Shadows come first, from the same transformed vertices as the Sprites themselves;
+    // the shadow shader applies the offset.
+    //
+    if (drawShadows)
+    {
+        IGNOREHR(SpriteMan.DrawShadows( hShadowEffect ));
 
+        // ParticleEmitters aren't batched; they draw their own shadow.
+        if (SUCCEEDED(Renderer.PushEffect( hShadowEffect )))
+        {
+            IGNOREHR(DrawParticleEmitters( world ));
+            IGNOREHR(Renderer.PopEffect());
+        }
+
+        // ParticleEmitters reset the global color.
+        IGNOREHR(Renderer.SetGlobalColor( Color(1, 1, 1, m_fOpacity) ));
+    }
+    
+    CHR(SpriteMan.EndBatch());  // TODO: must move batching into Renderer, not Sprites-only.
 
     // Draw ParticleEmitters on top of everything.
+    CHR(DrawParticleEmitters( world ));
+
+//    CHR(SpriteMan.EndBatch());
+        
+Exit:
+    m_isContentCulled = !Culling::EndBounds( &m_contentBounds ) || !Culling::IsVisible( m_contentBounds );
+
+    // Partial bounds prove nothing.
+    if (FAILED(rval))
+    {
+        m_isContentCulled = false;
+    }
+
+    return rval;
+}
+
+
+
+RESULT
+Layer::DrawParticleEmitters( const mat4& world )
+{
+    RESULT rval = S_OK;
+
+    ParticleEmitterListIterator ppHParticleEmitter;
+
     for (ppHParticleEmitter = m_particleEmitterList.begin(); ppHParticleEmitter != m_particleEmitterList.end(); /*++ppHParticleEmitter*/)
     {
         HParticleEmitter hParticleEmitter = *ppHParticleEmitter;
@@ -695,7 +735,7 @@ Layer::DrawContents( const mat4& matParentWorld, bool shadowPass )
 
         if (FAILED(Particles.Draw( hParticleEmitter, world )))
         {
-            // ParticleEmitter may have deleted itself; remove from our list.
+            // ParticleEmitter may have deleted itself; remove it from our list.
             ppHParticleEmitter = m_particleEmitterList.erase( ppHParticleEmitter );
         }
         else 
@@ -704,9 +744,6 @@ Layer::DrawContents( const mat4& matParentWorld, bool shadowPass )
         }
     }
 
-//    CHR(SpriteMan.EndBatch());
-        
-Exit:
     return rval;
 }
 
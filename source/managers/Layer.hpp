@@ -7,6 +7,8 @@
 #include "IDrawable.hpp"
 #include "GameObject.hpp"
 #include "ParticleEmitter.hpp"
+#include "Culling.hpp"
+#include "Transforms.hpp"
 
 #include <list>
 using std::list;
@@ -62,10 +64,10 @@ public:
     inline bool         IsChildLayer    ( )                                     { return !m_hParentLayer.IsNull(); }
 
 	// IDrawable
-    inline RESULT       SetVisible      ( bool          isVisible           )   { m_isVisible       = isVisible;                return S_OK; }
-    inline RESULT       SetPosition     ( const vec3&   vPos                )   { m_vWorldPosition  = vPos;                     return S_OK; }
-    inline RESULT       SetRotation     ( const vec3&   vRotationDegrees    )   { m_vRotation       = vRotationDegrees;         return S_OK; }
-    inline RESULT       SetScale        ( float         scale               )   { m_fScale          = scale;                    return S_OK; }
+    inline RESULT       SetVisible      ( bool          isVisible           )   { m_isVisible       = isVisible;        Culling::Invalidate(); return S_OK; }
+    inline RESULT       SetPosition     ( const vec3&   vPos                )   { m_vWorldPosition  = vPos;             UpdateTransform(); return S_OK; }
+    inline RESULT       SetRotation     ( const vec3&   vRotationDegrees    )   { m_vRotation       = vRotationDegrees; UpdateTransform(); return S_OK; }
+    inline RESULT       SetScale        ( float         scale               )   { m_fScale          = scale;            UpdateTransform(); return S_OK; }
     inline RESULT       SetOpacity      ( float         opacity             )   { m_fOpacity        = CLAMP(opacity, 0.0, 1.0); return S_OK; }
     RESULT              SetEffect       ( HEffect       hEffect             );
     RESULT              SetColor        ( const Color&  color               )   { m_color           = color;                    return S_OK; }
@@ -87,8 +89,9 @@ public:
 
 
 protected:
-    RESULT              DrawContents    ( const mat4&   matParentWorld, bool shadowPass = false );
-    RESULT              DrawShadowPass  ( const mat4&   matParentWorld );
+    RESULT              DrawContents        ( const mat4&   matParentWorld );
+    RESULT              DrawParticleEmitters( const mat4&   world );
+    inline void         UpdateTransform     ( )     { Transforms::SetLocal( m_transform, m_vWorldPosition, m_vRotation, m_fScale ); Culling::Invalidate(); }
 
     static void         OnDoneShowing(void* context);
     static void         OnDoneHiding (void* context);
@@ -107,6 +110,14 @@ protected:
     AABB            m_bounds;
     Color           m_color;
     bool            m_isShadowEnabled;
+    TransformID     m_transform;            // Scale * Rotation * Translation, and our world matrix; see Transforms.hpp.
+
+    // Eye-space bounds of our contents when last drawn, and whether they were all off-screen.
+    // While the Culling epoch and our parent's transform stay the same, that still holds.
+    AABB            m_contentBounds;
+    bool            m_isContentCulled;
+    UINT32          m_cullEpoch;
+    mat4            m_matCullParentWorld;
     
     typedef list<HSprite>               SpriteList;
     typedef SpriteList::iterator        SpriteListIterator;
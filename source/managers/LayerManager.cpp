@@ -18,6 +18,7 @@
 #include "Util.hpp"
 #include "GameObjectManager.hpp"
 #include "Camera.hpp"
+#include "Profiler.hpp"
 
 
 
@@ -740,6 +741,8 @@ RESULT
 LayerManager::Draw()
 {
     RESULT rval = S_OK;
+
+    PROFILE_SCOPE("LayerMan.Draw");
     ResourceListIterator ppLayer;
 
     //
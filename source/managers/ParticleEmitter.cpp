@@ -12,6 +12,11 @@
 #include "Engine.hpp"
 #include "TextureManager.hpp"
 #include "ParticleManager.hpp"
+#include "Culling.hpp"
+#include "Metrics.hpp"
+#include "QuadList.hpp"
+
+#include <math.h>
 
 
 namespace Z 
@@ -44,6 +49,9 @@ DECLARE_PROPERTY_SET( ParticleEmitter, s_propertyTable );
 
 ParticleEmitter::ParticleEmitter() :
     m_pVertices(NULL),
+    m_pPackedVertices(NULL),
+    m_isQuadList(false),
+    m_isPacked(false),
     m_numActiveParticles(0),
     m_isVisible(true),
     m_isStarted(false),
@@ -107,6 +115,7 @@ ParticleEmitter::~ParticleEmitter()
     ParticleMan.Stop( this );
 
     SAFE_ARRAY_DELETE(m_pVertices);
+    SAFE_ARRAY_DELETE(m_pPackedVertices);
 
     m_activeParticles.clear();
     m_numActiveParticles = 0;
@@ -133,7 +142,10 @@ ParticleEmitter::Clone() const
 
 ParticleEmitter::ParticleEmitter( const ParticleEmitter& rhs ) : 
     Object(),
-    m_pVertices(NULL)
+    m_pVertices(NULL),
+    m_pPackedVertices(NULL),
+    m_isQuadList(false),
+    m_isPacked(false)
 {
     *this = rhs;
 }
@@ -222,6 +234,11 @@ ParticleEmitter::operator=( const ParticleEmitter& rhs )
     m_pVertices                     = new Vertex[m_maxParticles * VERTS_PER_PARTICLE];
 //    memcpy( m_pVertices, rhs.m_pVertices, m_maxParticles*VERTS_PER_PARTICLE*sizeof(Vertex) );
 
+    // Rebuilt by the next ::Update().
+    SAFE_ARRAY_DELETE(m_pPackedVertices);
+    m_isQuadList                    = false;
+    m_isPacked                      = false;
+
 
     // DEEP COPY: m_activeParticles
 //    m_activeParticles               = rhs.m_activeParticles;
@@ -396,6 +413,9 @@ ParticleEmitter::InitParticles()
     SAFE_ARRAY_DELETE(m_pVertices);
     m_pVertices = new Vertex[m_maxParticles * VERTS_PER_PARTICLE];
     DEBUGCHK(m_pVertices != NULL);
+    SAFE_ARRAY_DELETE(m_pPackedVertices);
+    m_isQuadList = false;
+    m_isPacked   = false;
 
 #ifdef USE_POINT_SPRITES
     
@@ -617,8 +637,9 @@ ParticleEmitter::Update( UINT64 elapsedMS )
     {
         m_startTimeMS = elapsedMS;
         
-        // HACK: simulate one standard frame so we always emit some particles, even if the emitter's duration is less than a single frame:
-        m_previousFrameMS = elapsedMS - 33;
+        // Count one step as already elapsed, so we always emit some particles, even if the emitter's duration is less than a step.
+        UINT64 stepMS     = (UINT64)GameTime.GetFixedStep();
+        m_previousFrameMS = elapsedMS - (stepMS ? stepMS : 33);
     }
 
     // How many milliseconds have elapsed since the previous call to Update()?
@@ -655,10 +676,18 @@ ParticleEmitter::Update( UINT64 elapsedMS )
     // Unity does this.
     //
 
+    // The union of every live Particle; the emitter is culled against it in ::Draw().
+    vec3 boundsMin;
+    vec3 boundsMax;
+
 #ifndef USE_POINT_SPRITES
     // Save the particle's texture atlas coordinates; we'll use them in the update loop below.
     TextureInfo texInfo;
     CHR(TextureMan.GetInfo( m_hTexture, &texInfo ));
+
+    // Particles are written as 4-corner quads when QuadList is enabled; ::Draw() follows whatever was written last.
+    m_isQuadList = QuadList::IsEnabled();
+    m_isPacked   = false;
 #endif
 
     //
@@ -781,6 +810,23 @@ ParticleEmitter::Update( UINT64 elapsedMS )
         // Update the size
         pParticle->fParticleSize += pParticle->fParticleSizeDelta;
         pParticle->fParticleSize  = MAX(0, pParticle->fParticleSize);
+
+        {
+        float halfSize = pParticle->fParticleSize * 0.5f;
+        vec3  minPoint( pParticle->vPosition.x - halfSize, pParticle->vPosition.y - halfSize, pParticle->vPosition.z );
+        vec3  maxPoint( pParticle->vPosition.x + halfSize, pParticle->vPosition.y + halfSize, pParticle->vPosition.z );
+        
+        if (0 == i)
+        {
+            boundsMin = minPoint;
+            boundsMax = maxPoint;
+        }
+        else
+        {
+            boundsMin = vec3( MIN( boundsMin.x, minPoint.x ), MIN( boundsMin.y, minPoint.y ), MIN( boundsMin.z, minPoint.z ) );
+            boundsMax = vec3( MAX( boundsMax.x, maxPoint.x ), MAX( boundsMax.y, maxPoint.y ), MAX( boundsMax.z, maxPoint.z ) );
+        }
+        }
                     
 #ifdef USE_POINT_SPRITES        
 
@@ -800,11 +846,41 @@ ParticleEmitter::Update( UINT64 elapsedMS )
         spriteRect.x        += pParticle->vPosition.x - (spriteRect.width/2.0);
         spriteRect.y        += pParticle->vPosition.y - (spriteRect.height/2.0);
 
-        Util::CreateTriangleList( &spriteRect, 1, 1, &m_pVertices[ i * VERTS_PER_PARTICLE ], texInfo.uStart, texInfo.uEnd, texInfo.vStart, texInfo.vEnd, pParticle->color );
+        if (m_isQuadList)
+        {
+            Vertex triangles[ VERTS_PER_PARTICLE ];
+            Util::CreateTriangleList( &spriteRect, 1, 1, triangles, texInfo.uStart, texInfo.uEnd, texInfo.vStart, texInfo.vEnd, pParticle->color );
+            QuadList::FromTriangleList( triangles, 1, &m_pVertices[ i * VERTS_PER_QUAD ] );
+        }
+        else
+        {
+            Util::CreateTriangleList( &spriteRect, 1, 1, &m_pVertices[ i * VERTS_PER_PARTICLE ], texInfo.uStart, texInfo.uEnd, texInfo.vStart, texInfo.vEnd, pParticle->color );
+        }
 
 #endif // USE_POINT_SPRITES
     }
 
+#ifndef USE_POINT_SPRITES
+    if (m_isQuadList && m_numActiveParticles && QuadList::IsPackingEnabled() && QuadList::CanPack( m_pVertices, m_numActiveParticles * VERTS_PER_QUAD ))
+    {
+        if (!m_pPackedVertices)
+        {
+            m_pPackedVertices = new PackedVertex[ m_maxParticles * VERTS_PER_QUAD ];
+            CPREx(m_pPackedVertices, E_OUTOFMEMORY);
+        }
+
+        QuadList::Pack( m_pVertices, m_numActiveParticles * VERTS_PER_QUAD, m_pPackedVertices );
+        m_isPacked = true;
+    }
+#endif
+
+    // Only a change of bounds can bring the emitter on- or off-screen.
+    if (m_numActiveParticles && (boundsMin != m_bounds.GetMin() || boundsMax != m_bounds.GetMax()))
+    {
+        m_bounds = AABB( boundsMin, boundsMax );
+        Culling::Invalidate();
+    }
+
     // Are we done emitting particles?
     if ( timeSinceStartSec >= m_fDurationSec && m_fDurationSec != -1.0 && 0 == m_numActiveParticles )
     {
@@ -834,6 +910,24 @@ ParticleEmitter::Draw( const mat4& matParentWorld )
         return S_OK;
     }
 
+    //
+    // Skip the emitter if none of its Particles can be seen.
+    //
+    {
+    static MetricCounter* s_pEmittersCulledMetric = Metrics::RegisterCounter("Culling.EmittersCulled");
+
+    float halfWidth  = m_bounds.GetWidth()  * 0.5f;
+    float halfHeight = m_bounds.GetHeight() * 0.5f;
+    float halfDepth  = m_bounds.GetDepth()  * 0.5f;
+    float radius     = sqrtf( halfWidth * halfWidth + halfHeight * halfHeight + halfDepth * halfDepth );
+
+    if (!Culling::IsVisible( m_bounds.GetCenter(), radius, matParentWorld ))
+    {
+        s_pEmittersCulledMetric->Increment();
+        return S_OK;
+    }
+    }
+
 
     //
     // TODO: needs to take advantage of batching! For performance, and so that draw order is correct when overlapping Sprites!
@@ -848,7 +942,18 @@ ParticleEmitter::Draw( const mat4& matParentWorld )
 #ifdef USE_POINT_SPRITES    
     CHR(Renderer.DrawPointSprites( m_pVertices, m_numActiveParticles, m_fStartParticleSize /* HACK: until we add point size to Vertex */ ));
 #else
-    CHR(Renderer.DrawTriangleList( m_pVertices, m_numActiveParticles * VERTS_PER_PARTICLE ));
+    if (m_isPacked)
+    {
+        CHR(Renderer.DrawPackedQuadList( m_pPackedVertices, m_numActiveParticles ));
+    }
+    else if (m_isQuadList)
+    {
+        CHR(Renderer.DrawQuadList( m_pVertices, m_numActiveParticles ));
+    }
+    else
+    {
+        CHR(Renderer.DrawTriangleList( m_pVertices, m_numActiveParticles * VERTS_PER_PARTICLE ));
+    }
 #endif
 
 Exit:    
@@ -108,6 +108,7 @@ public:
     inline bool         GetShadow       ( )                                     { return false;             }
 
     inline UINT64       GetDurationMS   ( )                                     { return m_durationMS;      }
+    inline UINT32       GetNumActiveParticles( ) const                          { return m_numActiveParticles; }
     
     virtual IProperty*  GetProperty     ( const string& name ) const;
 
@@ -185,6 +186,9 @@ protected:
     ParticleList        m_activeParticles;
     
     Vertex*             m_pVertices;
+    PackedVertex*       m_pPackedVertices;              // m_pVertices as PackedVertex, if m_isPacked
+    bool                m_isQuadList;                   // m_pVertices holds VERTS_PER_QUAD corners per Particle
+    bool                m_isPacked;
     
     
 //----------------
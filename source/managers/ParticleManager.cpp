@@ -16,6 +16,8 @@
 #include "Platform.hpp"
 #include "Types.hpp"
 #include "Util.hpp"
+#include "Profiler.hpp"
+#include "JobSystem.hpp"
 
 
 
@@ -36,7 +38,10 @@ ParticleManager::Instance()
 }
 
 
-ParticleManager::ParticleManager()
+ParticleManager::ParticleManager() :
+    m_updateTimeMS(0),
+    m_isUpdating(false),
+    m_pActiveParticlesMetric(Metrics::RegisterGauge("ParticleMan.Active"))
 {
     RETAILMSG(ZONE_VERBOSE, "ParticleManager()");
     
@@ -676,9 +681,27 @@ ParticleManager::GetShadow( IN HParticleEmitter hParticleEmitter )
 #pragma mark Update
 RESULT
 ParticleManager::Update( UINT64 elapsedMS )
+{
+    RESULT      rval = S_OK;
+    JobCounter  counter;
+
+    CHR(BeginUpdate( elapsedMS, &counter ));
+    JobSystem::Wait( &counter );
+    CHR(EndUpdate());
+
+Exit:
+    return rval;
+}
+
+
+
+RESULT
+ParticleManager::BeginUpdate( UINT64 elapsedMS, IN JobCounter* pCounter )
 {
     RESULT rval = S_OK;
 
+    PROFILE_SCOPE("ParticleMan.Update");
+
 
     //
     // TODO: if our update frequency is less than 60Hz, we should
@@ -695,6 +718,7 @@ ParticleManager::Update( UINT64 elapsedMS )
 
 
     // Release ParticleEmitters that were marked as done on previous frame.
+    // Done here on the calling thread, since releasing may free GL resources.
     ParticleEmitterListIterator ppParticleEmitter;
     for (ppParticleEmitter = m_pendingReleaseParticleEmittersList.begin(); ppParticleEmitter != m_pendingReleaseParticleEmittersList.end(); ++ppParticleEmitter)
     {
@@ -711,26 +735,71 @@ ParticleManager::Update( UINT64 elapsedMS )
     m_pendingReleaseParticleEmittersList.clear();
 
 
-
-    // Update every running ParticleEmitter.
+    //
+    // Snapshot the running ParticleEmitters and update them in parallel.
+    // Each emitter only touches its own particles, so they don't need to be ordered.
+    //
+    m_updateEmitters.clear();
     for (ppParticleEmitter = m_runningParticleEmittersList.begin(); ppParticleEmitter != m_runningParticleEmittersList.end(); /*++ppParticleEmitter*/)
     {
-        ParticleEmitter* pParticleEmitter = *ppParticleEmitter;
-        if (!pParticleEmitter)
+        if (!*ppParticleEmitter)
         {
             ppParticleEmitter = m_runningParticleEmittersList.erase( ppParticleEmitter );
             continue;
-        } 
-
-//        if (Log::IsZoneEnabled(ZONE_PARTICLES | ZONE_VERBOSE))
-//        {
-//            char str[1024];
-//            sprintf(str, "PE: %s", pParticleEmitter->GetName().c_str());
-//            DebugRender.Text(str, Color::White(), 1.0f, 1.0f);
-//        }
-        
-        
-        if (FAILED(pParticleEmitter->Update( elapsedMS )))
+        }
+
+        m_updateEmitters.push_back( *ppParticleEmitter );
+        ++ppParticleEmitter;
+    }
+
+    m_updateResults.resize( m_updateEmitters.size() );
+    m_updateTimeMS  = elapsedMS;
+    m_isUpdating    = true;
+
+    CHR(JobSystem::ParallelFor( UpdateEmittersJob, this, m_updateEmitters.size(), 1, pCounter ));
+
+Exit:
+    return rval;
+}
+
+
+
+void
+ParticleManager::UpdateEmittersJob( void* pContext, UINT32 begin, UINT32 end )
+{
+    PROFILE_SCOPE("ParticleMan.UpdateEmitters");
+
+    ParticleManager* pManager = (ParticleManager*)pContext;
+
+    for (UINT32 i = begin; i < end; ++i)
+    {
+        pManager->m_updateResults[i] = pManager->m_updateEmitters[i]->Update( pManager->m_updateTimeMS );
+    }
+}
+
+
+
+RESULT
+ParticleManager::EndUpdate( )
+{
+    RESULT rval                 = S_OK;
+    UINT32 numActiveParticles   = 0;
+    UINT32 index                = 0;
+
+    if (!m_isUpdating)
+    {
+        return S_OK;
+    }
+    m_isUpdating = false;
+
+    // Stop the emitters that finished, in list order, now that every update has joined.
+    ParticleEmitterListIterator ppParticleEmitter;
+    for (ppParticleEmitter = m_runningParticleEmittersList.begin(); ppParticleEmitter != m_runningParticleEmittersList.end(); ++index)
+    {
+        ParticleEmitter* pParticleEmitter = *ppParticleEmitter;
+        DEBUGCHK( pParticleEmitter == m_updateEmitters[index] );
+
+        if (FAILED(m_updateResults[index]))
         {
             pParticleEmitter->Stop();
 
@@ -742,11 +811,13 @@ ParticleManager::Update( UINT64 elapsedMS )
         }
         else 
         {
+            numActiveParticles += pParticleEmitter->GetNumActiveParticles();
             ++ppParticleEmitter;
         }
     }
 
-Exit:
+    m_pActiveParticlesMetric->Set( numActiveParticles );
+
     return rval;
 }
 
@@ -803,6 +874,8 @@ RESULT
 ParticleManager::Draw()
 {
     RESULT rval = S_OK;
+
+    PROFILE_SCOPE("ParticleMan.Draw");
     ResourceListIterator ppParticleEmitter;
 
     //
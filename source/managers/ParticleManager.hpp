@@ -6,9 +6,13 @@
 #include "Settings.hpp"
 #include "GameObject.hpp"
 #include "ParticleEmitter.hpp"
+#include "Metrics.hpp"
+#include "JobSystem.hpp"
 
 #include <string>
+#include <vector>
 using std::string;
+using std::vector;
 
 
 namespace Z
@@ -49,6 +53,12 @@ public:
     UINT64          GetDurationMS   ( IN const string&    name             );
 
     RESULT          Update          ( UINT64 elapsedMS );
+
+    // Update() in two halves, so the caller can do unrelated work while the
+    // emitters update on the job workers.  Nothing else may touch ParticleMan
+    // in between.
+    RESULT          BeginUpdate     ( UINT64 elapsedMS, IN JobCounter* pCounter );
+    RESULT          EndUpdate       ( );
     
     RESULT          Draw            ( );
     RESULT          Draw            ( IN HParticleEmitter hParticleEmitter, IN const mat4& matParentWorld = mat4::Identity() );
@@ -100,6 +110,16 @@ protected:
     typedef ParticleEmitterList::iterator   ParticleEmitterListIterator;
     ParticleEmitterList  m_runningParticleEmittersList;
     ParticleEmitterList  m_pendingReleaseParticleEmittersList;
+
+    // Snapshot of m_runningParticleEmittersList for the parallel update.
+    vector<ParticleEmitter*>    m_updateEmitters;
+    vector<RESULT>              m_updateResults;
+    UINT64                      m_updateTimeMS;
+    bool                        m_isUpdating;
+
+    static  void    UpdateEmittersJob   ( void* pContext, UINT32 begin, UINT32 end );
+
+    MetricGauge*        m_pActiveParticlesMetric;
 };
 
 
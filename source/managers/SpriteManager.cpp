@@ -17,6 +17,8 @@
 #include "Types.hpp"
 #include "Image.hpp"
 #include "Util.hpp"
+#include "Profiler.hpp"
+#include "JobSystem.hpp"
 
 
 
@@ -38,7 +40,15 @@ SpriteManager::Instance()
 
 
 SpriteManager::SpriteManager() :
-    m_inSpriteBatch(false)
+    m_pSpriteBatchMap(NULL),
+    m_inSpriteBatch(false),
+    m_areBatchesBuilt(false),
+    m_castsShadow(false),
+    m_pSpriteBatchesMetric(Metrics::RegisterCounter("SpriteMan.Batches")),
+    m_pVerticesBuiltMetric(Metrics::RegisterCounter("SpriteMan.VerticesBuilt")),
+    m_pVerticesReusedMetric(Metrics::RegisterCounter("SpriteMan.VerticesReused")),
+    m_pSpritesSubmittedMetric(Metrics::RegisterCounter("Culling.SpritesSubmitted")),
+    m_pSpritesCulledMetric(Metrics::RegisterCounter("Culling.SpritesCulled"))
 {
     RETAILMSG(ZONE_VERBOSE, "SpriteManager()");
     
@@ -115,45 +125,71 @@ SpriteManager::Shutdown()
     RESULT rval = S_OK;
     
     // Release all SpriteBatches
+    SpriteBatchSetsIterator ppSpriteBatchSet;
+    for (ppSpriteBatchSet = m_spriteBatchSets.begin(); ppSpriteBatchSet != m_spriteBatchSets.end(); ++ppSpriteBatchSet)
+    {
+        FreeBatchMap( &ppSpriteBatchSet->second );
+    }
+    
+    m_spriteBatchSets.clear();
+    m_pSpriteBatchMap = NULL;
+    
+Exit:
+    return rval;
+}
+
+
+
+RESULT
+SpriteManager::FreeBatches( IN const void* pOwner )
+{
+    RESULT rval = S_OK;
+
+    if (m_inSpriteBatch)
+    {
+        RETAILMSG(ZONE_ERROR, "ERROR: SpriteManager::FreeBatches(): can't free batches between BeginBatch() and EndBatch()");
+        rval = E_INVALID_OPERATION;
+        goto Exit;
+    }
+
+    // Every pass for this owner.
+    {
+    SpriteBatchSetsIterator ppSpriteBatchSet = m_spriteBatchSets.lower_bound( SpriteBatchSetKey( pOwner, 0 ) );
+    while (ppSpriteBatchSet != m_spriteBatchSets.end() && ppSpriteBatchSet->first.first == pOwner)
+    {
+        FreeBatchMap( &ppSpriteBatchSet->second );
+        m_spriteBatchSets.erase( ppSpriteBatchSet++ );
+    }
+    }
+
+Exit:
+    return rval;
+}
+
+
+
+void
+SpriteManager::FreeBatchMap( INOUT SpriteBatchMap* pSpriteBatchMap )
+{
     SpriteBatchMapIterator ppSpriteBatch;
-    for (ppSpriteBatch = m_spriteBatchMap.begin(); ppSpriteBatch != m_spriteBatchMap.end(); ++ppSpriteBatch)
+    for (ppSpriteBatch = pSpriteBatchMap->begin(); ppSpriteBatch != pSpriteBatchMap->end(); ++ppSpriteBatch)
     {
         SpriteBatch* pSpriteBatch = ppSpriteBatch->second;
         
         DEBUGCHK( pSpriteBatch );
         
-        pSpriteBatch->numSprites    = 0;
-        pSpriteBatch->numVertices   = 0;
-        
-        // Free the batched sprites
-        BatchedSprites* pBatchedSprites = &pSpriteBatch->sprites;
-        BatchedSpritesIterator ppBatchedSprite;
-        for (ppBatchedSprite = pBatchedSprites->begin(); ppBatchedSprite != pBatchedSprites->end(); ++ppBatchedSprite)
-        {
-            BatchedSprite* pBatchedSprite = *ppBatchedSprite;
-            DEBUGCHK(pBatchedSprite);
-            delete pBatchedSprite;
-        }
-        
-        pSpriteBatch->sprites.clear();
+        RETAILMSG(ZONE_SPRITE | ZONE_VERBOSE, "SpriteManager::FreeBatchMap(): freed SpriteBatch 0x%x", pSpriteBatch);
+
         SAFE_ARRAY_DELETE(pSpriteBatch->pVertices);
-        
-        //SAFE_DELETE(pSpriteBatch);
-        m_spriteBatchMap.erase( ppSpriteBatch );
-        
-        //        RETAILMSG(ZONE_SPRITE | ZONE_VERBOSE, "SpriteManager::BeginBatch(): cleared previous SpriteBatch [%s]", pSpriteBatch->textureName.c_str());
-        RETAILMSG(ZONE_SPRITE | ZONE_VERBOSE, "SpriteManager::BeginBatch(): cleared previous SpriteBatch 0x%x", pSpriteBatch);
+        SAFE_ARRAY_DELETE(pSpriteBatch->pPackedVertices);
+        delete pSpriteBatch;
     }
     
-    DEBUGCHK(m_spriteBatchMap.size() == 0);
-    
-Exit:
-    return rval;
+    pSpriteBatchMap->clear();
 }
 
 
 
-
 RESULT
 SpriteManager::CreateFromFile( IN    const  string&     filename, 
                                INOUT        HSprite*    pHandle,
@@ -714,13 +750,13 @@ Exit:
 #pragma mark Draw
 
 RESULT
-SpriteManager::BeginBatch()
+SpriteManager::BeginBatch( IN const void* pOwner, UINT32 pass )
 {
     RESULT rval = S_OK;
 
     SpriteBatchMapIterator ppSpriteBatch;
 
-    RETAILMSG(ZONE_SPRITE | ZONE_VERBOSE, "SpriteManager::BeginBatch()");
+    RETAILMSG(ZONE_SPRITE | ZONE_VERBOSE, "SpriteManager::BeginBatch( 0x%x, %d )", pOwner, pass);
     
     if (m_inSpriteBatch)
     {
@@ -729,11 +765,14 @@ SpriteManager::BeginBatch()
         goto Exit;
     }
     
-    m_inSpriteBatch  = true;
-    m_zOrderForBatch = 0;
+    m_inSpriteBatch   = true;
+    m_areBatchesBuilt = false;
+    m_castsShadow     = false;
+    m_zOrderForBatch  = 0;
+    m_pSpriteBatchMap = &m_spriteBatchSets[ SpriteBatchSetKey( pOwner, pass ) ];
     
-    // Reset all SpriteBatches
-    for (ppSpriteBatch = m_spriteBatchMap.begin(); ppSpriteBatch != m_spriteBatchMap.end(); /*++ppSpriteBatch*/)
+    // Reset all SpriteBatches; their vertices are kept until EndBatch() decides whether to rebuild them.
+    for (ppSpriteBatch = m_pSpriteBatchMap->begin(); ppSpriteBatch != m_pSpriteBatchMap->end(); /*++ppSpriteBatch*/)
     {
         SpriteBatch* pSpriteBatch = ppSpriteBatch->second;
         
@@ -747,19 +786,7 @@ SpriteManager::BeginBatch()
             
         pSpriteBatch->numSprites    = 0;
         pSpriteBatch->numVertices   = 0;
-
-        // Free the batched sprites
-        BatchedSprites* pBatchedSprites = &pSpriteBatch->sprites;
-        BatchedSpritesIterator ppBatchedSprite;
-        for (ppBatchedSprite = pBatchedSprites->begin(); ppBatchedSprite != pBatchedSprites->end(); ++ppBatchedSprite)
-        {
-            BatchedSprite* pBatchedSprite = *ppBatchedSprite;
-            DEBUGCHK(pBatchedSprite);
-            delete pBatchedSprite;
-        }
-        
         pSpriteBatch->sprites.clear();
-        SAFE_ARRAY_DELETE(pSpriteBatch->pVertices);
         
 #ifdef DEBUG
         DEBUGMSG(ZONE_SPRITE | ZONE_VERBOSE, "SpriteManager::BeginBatch(): cleared SpriteBatch 0x%x Effect \"%s\" texture \"%s\"", 
@@ -773,7 +800,9 @@ SpriteManager::BeginBatch()
             pSpriteBatch->hTexture.IsDangling())
         {
             // See "The C++ Standard Template Library" by Josuttis, pg. 205
-            m_spriteBatchMap.erase( ppSpriteBatch++ );
+            m_pSpriteBatchMap->erase( ppSpriteBatch++ );
+            SAFE_ARRAY_DELETE(pSpriteBatch->pVertices);
+            SAFE_ARRAY_DELETE(pSpriteBatch->pPackedVertices);
             delete pSpriteBatch;
         }
         else 
@@ -789,108 +818,385 @@ Exit:
 
 
 
-RESULT SpriteManager::EndBatch()
+void
+SpriteManager::BuildBatchesJob( void* pContext, UINT32 begin, UINT32 end )
 {
-    RESULT rval = S_OK;
-    SpriteBatchMapIterator ppSpriteBatch;
+    PROFILE_SCOPE("SpriteMan.BuildBatches");
 
-    // TODO: sort SpriteBatches before render?
+    SpriteManager* pManager = (SpriteManager*)pContext;
+
+    for (UINT32 i = begin; i < end; ++i)
+    {
+        pManager->m_buildResults[i] = BuildBatch( pManager->m_batchesToBuild[i] );
+    }
+}
+
+
+
+// Fill pSpriteBatch->pVertices with the transformed quads of every BatchedSprite,
+// as indexed quads if QuadList is enabled, and pack them if they're all flat.
+// Safe to run concurrently on different SpriteBatches.
+RESULT
+SpriteManager::BuildBatch( INOUT SpriteBatch* pSpriteBatch )
+{
+    RESULT rval        = S_OK;
+    UINT32 index       = 0;
+    bool   isQuadList  = QuadList::IsEnabled();
+    UINT32 numVertices = isQuadList ? pSpriteBatch->numSprites * VERTS_PER_QUAD : pSpriteBatch->numVertices;
+
+    if (pSpriteBatch->vertexCapacity < numVertices)
+    {
+        // (Re)allocate the vertex array; it's kept across frames.
+        SAFE_ARRAY_DELETE(pSpriteBatch->pVertices);
+        pSpriteBatch->vertexCapacity = 0;
+
+        pSpriteBatch->pVertices = new Vertex[ numVertices ];
+        if (!pSpriteBatch->pVertices)
+        {
+            RETAILMSG(ZONE_ERROR, "ERROR: SpriteManager::BuildBatch(): out of memory allocating %d vertices", numVertices);
+            rval = E_OUTOFMEMORY;
+            goto Exit;
+        }
+
+        pSpriteBatch->vertexCapacity = numVertices;
+    }
+
+    // Until this build completes, the vertices don't match anything.
+    pSpriteBatch->builtSprites.clear();
+    pSpriteBatch->isQuadList       = isQuadList;
+    pSpriteBatch->isPackingEnabled = QuadList::IsPackingEnabled();
+    pSpriteBatch->isPacked         = false;
     
     //
-    // For each SpriteBatch, submit the vertices.
+    // For every BatchedSprite, add its transformed vertices to the batch vertex array.
     //
-    for (ppSpriteBatch = m_spriteBatchMap.begin(); ppSpriteBatch != m_spriteBatchMap.end(); ++ppSpriteBatch)
     {
-        SpriteBatch*    pSpriteBatch = ppSpriteBatch->second;
-        UINT32          index        = 0;
-        
-        DEBUGCHK( pSpriteBatch );
-        
-        if ( 0 == pSpriteBatch->numSprites )
-            continue;
-            
+    BatchedSprites* pBatchedSprites = &pSpriteBatch->sprites;
+    BatchedSpritesIterator ppBatchedSprite;
+    for (ppBatchedSprite = pBatchedSprites->begin(); ppBatchedSprite != pBatchedSprites->end(); ++ppBatchedSprite)
+    {
+        BatchedSprite*  pBatchedSprite = &*ppBatchedSprite;
+        Sprite*         pSprite        = pBatchedSprite->pSprite;
+        Vertex*         pVertices      = &pSpriteBatch->pVertices[index];
         
-        IGNOREHR(Renderer.PushEffect  ( pSpriteBatch->hEffect     ));
-        IGNOREHR(Renderer.SetTexture  ( 0, pSpriteBatch->hTexture ));
-            
-        if (!pSpriteBatch->pVertices)
+        DEBUGCHK( pSprite );
+
+        Vertex*     pSpriteVertices;
+        UINT32      numSpriteVertices;
+        CHR(pSprite->GetVertices( &pSpriteVertices, &numSpriteVertices ));
+        DEBUGCHK( numSpriteVertices >= VERTS_PER_SPRITE );
+        if (isQuadList)
         {
-            // Allocate a vertex array.
-            pSpriteBatch->pVertices = new Vertex[ pSpriteBatch->numVertices ];
-            if (!pSpriteBatch->pVertices)
-            {
-                RETAILMSG(ZONE_ERROR, "ERROR: SpriteManager::EndBatch(): out of memory allocating %d vertices", pSpriteBatch->numVertices);
-                rval = E_OUTOFMEMORY;
-                goto Exit;
-            }
+            DEBUGCHK( numSpriteVertices == VERTS_PER_SPRITE );
+            QuadList::FromTriangleList( pSpriteVertices, 1, pVertices );
         }
-        
+        else
+        {
+            memcpy( pVertices, pSpriteVertices, sizeof(Vertex) * numSpriteVertices );
+        }
+        UINT32 numBatchVertices = isQuadList ? VERTS_PER_QUAD : numSpriteVertices;
+        index += numBatchVertices;
+
         //
-        // For every BatchedSprite, add its transformed vertices to the batch vertex array.
+        // Transform the quad based on position, scale, rotation.
         //
-        BatchedSprites* pBatchedSprites = &pSpriteBatch->sprites;
-        BatchedSpritesIterator ppBatchedSprite;
-        for (ppBatchedSprite = pBatchedSprites->begin(); ppBatchedSprite != pBatchedSprites->end(); ++ppBatchedSprite)
+        mat4 modelview;
+
+        // Scale and rotate around center point.
+        // Don't use pSprite->GetBounds() - that reflects the current scale and we want the pre-scaled dimensions.
+        // Compute a rect from the vertices instead.
+        Rectangle spriteRect;
+        Util::GetBoundingRect( pSpriteVertices, numSpriteVertices, &spriteRect );
+        vec3 rotationPoint = vec3( spriteRect.width * 0.5f, spriteRect.height * 0.5f, 0.0f);
+        
+        // Not cached - a Sprite may be in several batches - but 2D Sprites skip the 4x4 products.
+        Transforms::Compose ( pBatchedSprite->position, pBatchedSprite->rotation, pBatchedSprite->scale, rotationPoint, &modelview );
+        Transforms::Multiply( modelview, pBatchedSprite->matWorldParent, &modelview );
+        
+        for (int i = 0; i < numBatchVertices; ++i)
         {
-            BatchedSprite*  pBatchedSprite = *ppBatchedSprite;
-            Sprite*         pSprite        = pBatchedSprite->pSprite;
-            Vertex*         pVertices      = &pSpriteBatch->pVertices[index];
-            
-            DEBUGCHK( pSprite );
-
-            Vertex*     pSpriteVertices;
-            UINT32      numSpriteVertices;
-            CHR(pSprite->GetVertices( &pSpriteVertices, &numSpriteVertices ));
-            DEBUGCHK( numSpriteVertices >= VERTS_PER_SPRITE );
-            memcpy( pVertices, pSpriteVertices, sizeof(Vertex) * numSpriteVertices );
-            index += numSpriteVertices;
+            Vertex* pVertex  = &pVertices[i];
+            vec4    position = vec4( pVertex->x, pVertex->y, pVertex->z, 1.0f );
 
             //
-            // Transform the quad based on position, scale, rotation.
+            // Scale/Rotate/Translate the vertex
             //
-            mat4 modelview;
-
-            // Scale and rotate around center point.
-            // Don't use pSprite->GetBounds() - that reflects the current scale and we want the pre-scaled dimensions.
-            // Compute a rect from the vertices instead.
-            Rectangle spriteRect;
-            Util::GetBoundingRect( pSpriteVertices, numSpriteVertices, &spriteRect );
-            vec3 rotationPoint = vec3( spriteRect.width * 0.5f, spriteRect.height * 0.5f, 0.0f);
+            position = modelview * position;
             
-            modelview = mat4::Translate( -rotationPoint.x, -rotationPoint.y, 0.0f );
+            pVertex->x = position.x;
+            pVertex->y = position.y;
+            pVertex->z = position.z;
+
+            // Premultiplied Alpha
+            pVertex->r = (BYTE) (((float)pVertex->r) * pBatchedSprite->opacity);
+            pVertex->g = (BYTE) (((float)pVertex->g) * pBatchedSprite->opacity);
+            pVertex->b = (BYTE) (((float)pVertex->b) * pBatchedSprite->opacity);
+            pVertex->a = (BYTE) (255.0f * pBatchedSprite->opacity);
+        }
+    }
+    }
+
+    //
+    // Flat quads are also kept packed, for drawing without an Effect.
+    //
+    if (isQuadList && pSpriteBatch->isPackingEnabled && QuadList::CanPack( pSpriteBatch->pVertices, index ))
+    {
+        if (pSpriteBatch->packedCapacity < index)
+        {
+            SAFE_ARRAY_DELETE(pSpriteBatch->pPackedVertices);
+            pSpriteBatch->packedCapacity = 0;
+
+            pSpriteBatch->pPackedVertices = new PackedVertex[ index ];
+            CPREx(pSpriteBatch->pPackedVertices, E_OUTOFMEMORY);
+
+            pSpriteBatch->packedCapacity = index;
+        }
+
+        QuadList::Pack( pSpriteBatch->pVertices, index, pSpriteBatch->pPackedVertices );
+        pSpriteBatch->isPacked = true;
+    }
+
+    pSpriteBatch->builtSprites = pSpriteBatch->sprites;
+
+Exit:
+    return rval;
+}
+
+
+
+// True if pSpriteBatch->pVertices already holds exactly what BuildBatch() would produce this frame:
+// the same Sprites, in the same order, with the same vertex data and transforms.  Shadow casting
+// is compared too, since DrawShadows() reads it from builtSprites.
+bool
+SpriteManager::IsBatchUnchanged( IN const SpriteBatch* pSpriteBatch )
+{
+    const BatchedSprites& sprites = pSpriteBatch->sprites;
+    const BatchedSprites& built   = pSpriteBatch->builtSprites;
+
+    if (!pSpriteBatch->pVertices || sprites.size() != built.size())
+    {
+        return false;
+    }
+
+    // Built in a different format than is wanted now.
+    if (pSpriteBatch->isQuadList       != QuadList::IsEnabled() ||
+        pSpriteBatch->isPackingEnabled != QuadList::IsPackingEnabled())
+    {
+        return false;
+    }
+
+    for (UINT32 i = 0; i < sprites.size(); ++i)
+    {
+        const BatchedSprite& a = sprites[i];
+        const BatchedSprite& b = built[i];
+
+        if (a.pSprite     != b.pSprite      ||
+            a.vertexStamp != b.vertexStamp  ||
+            a.opacity     != b.opacity      ||
+            a.scale       != b.scale        ||
+            a.castsShadow != b.castsShadow  ||
+            a.position.x  != b.position.x   || a.position.y != b.position.y   || a.position.z != b.position.z ||
+            a.rotation.x  != b.rotation.x   || a.rotation.y != b.rotation.y   || a.rotation.z != b.rotation.z ||
+            memcmp( a.matWorldParent.Pointer(), b.matWorldParent.Pointer(), sizeof(float) * 16 ))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+
+// Draw numVertices of pSpriteBatch's vertices, starting at firstVertex, in whichever format they were built.
+// Packed vertices are only used if allowPacked; the renderer would have to unpack them for an Effect.
+RESULT
+SpriteManager::SubmitBatch( IN SpriteBatch* pSpriteBatch, UINT32 firstVertex, UINT32 numVertices, bool allowPacked )
+{
+    RESULT rval = S_OK;
+
+    if (!pSpriteBatch->isQuadList)
+    {
+        CHR(Renderer.DrawTriangleList( &pSpriteBatch->pVertices[ firstVertex ], numVertices ));
+    }
+    else if (allowPacked && pSpriteBatch->isPacked)
+    {
+        CHR(Renderer.DrawPackedQuadList( &pSpriteBatch->pPackedVertices[ firstVertex ], numVertices / VERTS_PER_QUAD ));
+    }
+    else
+    {
+        CHR(Renderer.DrawQuadList( &pSpriteBatch->pVertices[ firstVertex ], numVertices / VERTS_PER_QUAD ));
+    }
+
+Exit:
+    return rval;
+}
+
+
+
+RESULT
+SpriteManager::SetShadowCasting( bool castsShadow )
+{
+    m_castsShadow = castsShadow;
     
-            modelview *= mat4::Scale    ( pBatchedSprite->scale );
-            modelview *= mat4::RotateX  ( pBatchedSprite->rotation.x );
-            modelview *= mat4::RotateY  ( pBatchedSprite->rotation.y );
-            modelview *= mat4::RotateZ  ( pBatchedSprite->rotation.z );
+    return S_OK;
+}
 
-            modelview *= mat4::Translate( rotationPoint.x, rotationPoint.y, 0.0f );
 
-            modelview *= mat4::Translate( pBatchedSprite->position.x, pBatchedSprite->position.y, pBatchedSprite->position.z );
-            modelview *= pBatchedSprite->matWorldParent;
-            
-            for (int i = 0; i < numSpriteVertices; ++i)
+
+// Collect the non-empty SpriteBatches of the current set into m_batchesToDraw,
+// and bring their vertices up to date.  Runs once per BeginBatch().
+RESULT
+SpriteManager::BuildBatches()
+{
+    RESULT rval = S_OK;
+
+    SpriteBatchMapIterator ppSpriteBatch;
+
+    if (m_areBatchesBuilt)
+    {
+        goto Exit;
+    }
+    
+    m_areBatchesBuilt = true;
+
+    //
+    // Only SpriteBatches whose contents changed since last frame are re-transformed,
+    // in parallel; batches don't share any state.
+    //
+    m_batchesToDraw.clear();
+    m_batchesToBuild.clear();
+    for (ppSpriteBatch = m_pSpriteBatchMap->begin(); ppSpriteBatch != m_pSpriteBatchMap->end(); ++ppSpriteBatch)
+    {
+        SpriteBatch* pSpriteBatch = ppSpriteBatch->second;
+        DEBUGCHK( pSpriteBatch );
+
+        if ( !pSpriteBatch->numSprites )
+        {
+            continue;
+        }
+
+        m_batchesToDraw.push_back( pSpriteBatch );
+
+        if ( IsBatchUnchanged( pSpriteBatch ) )
+        {
+            m_pVerticesReusedMetric->Add( pSpriteBatch->numVertices );
+        }
+        else
+        {
+            m_batchesToBuild.push_back( pSpriteBatch );
+            m_pVerticesBuiltMetric->Add( pSpriteBatch->numVertices );
+        }
+    }
+
+    m_buildResults.resize( m_batchesToBuild.size() );
+    CHR(JobSystem::ParallelFor( BuildBatchesJob, this, m_batchesToBuild.size() ));
+
+    for (UINT32 n = 0; n < m_buildResults.size(); ++n)
+    {
+        CHR(m_buildResults[n]);
+    }
+
+Exit:
+    return rval;
+}
+
+
+
+RESULT
+SpriteManager::DrawShadows( IN HEffect hShadowEffect )
+{
+    RESULT rval = S_OK;
+
+    PROFILE_SCOPE("SpriteMan.DrawShadows");
+    bool   isEffectPushed = false;
+
+    CBREx(m_inSpriteBatch, E_INVALID_OPERATION);
+    CHR(BuildBatches());
+
+    CHR(Renderer.PushEffect( hShadowEffect ));
+    isEffectPushed = true;
+    CHR(Renderer.SetModelViewMatrix( GameCamera.GetViewMatrix() ));
+
+    //
+    // The shadow shader applies the offset itself, so each batch's vertices are
+    // submitted as-is.  Every run of consecutive shadow-casting Sprites is one draw;
+    // usually that's the whole batch.
+    //
+    for (UINT32 n = 0; n < m_batchesToDraw.size(); ++n)
+    {
+        SpriteBatch*            pSpriteBatch = m_batchesToDraw[n];
+        const BatchedSprites&   sprites      = pSpriteBatch->builtSprites;
+        UINT32                  index        = 0;
+        UINT32                  runStart     = 0;
+        UINT32                  runLength    = 0;
+
+        IGNOREHR(Renderer.SetTexture( 0, pSpriteBatch->hTexture ));
+
+        for (UINT32 i = 0; i <= sprites.size(); ++i)
+        {
+            UINT32 numVertices = 0;
+            if (i < sprites.size())
             {
-                Vertex* pVertex  = &pVertices[i];
-                vec4    position = vec4( pVertex->x, pVertex->y, pVertex->z, 1.0f );
+                numVertices = pSpriteBatch->isQuadList ? VERTS_PER_QUAD : sprites[i].numVertices;
+            }
 
-                //
-                // Scale/Rotate/Translate the vertex
-                //
-                position = modelview * position;
-                
-                pVertex->x = position.x;
-                pVertex->y = position.y;
-                pVertex->z = position.z;
-
-                // Premultiplied Alpha
-                pVertex->r = (BYTE) (((float)pVertex->r) * pBatchedSprite->opacity);
-                pVertex->g = (BYTE) (((float)pVertex->g) * pBatchedSprite->opacity);
-                pVertex->b = (BYTE) (((float)pVertex->b) * pBatchedSprite->opacity);
-                pVertex->a = (BYTE) (255.0f * pBatchedSprite->opacity);
+            if (i < sprites.size() && sprites[i].castsShadow)
+            {
+                if (0 == runLength)
+                {
+                    runStart = index;
+                }
+                runLength += numVertices;
+            }
+            else if (runLength)
+            {
+                // The shadow Effect takes full Vertices.
+                CHR(SubmitBatch( pSpriteBatch, runStart, runLength, false ));
+                m_pSpriteBatchesMetric->Increment();
+                runLength = 0;
             }
+
+            index += numVertices;
         }
+    }
 
+Exit:
+    if (isEffectPushed)
+    {
+        IGNOREHR(Renderer.PopEffect());
+    }
+
+    if (FAILED(rval))
+    {
+        RETAILMSG(ZONE_ERROR, "ERROR: SpriteManager::DrawShadows(): rval = 0x%x", rval);
+    }
+
+    return rval;
+}
+
+
+
+RESULT SpriteManager::EndBatch()
+{
+    RESULT rval = S_OK;
+
+    PROFILE_SCOPE("SpriteMan.EndBatch");
+
+    // TODO: sort SpriteBatches before render?
+    
+    CBREx(m_inSpriteBatch, E_INVALID_OPERATION);
+    CHR(BuildBatches());
+    
+    //
+    // Then submit each SpriteBatch's vertices, in order, from this thread.
+    //
+    for (UINT32 n = 0; n < m_batchesToDraw.size(); ++n)
+    {
+        SpriteBatch* pSpriteBatch = m_batchesToDraw[n];
+        
+        IGNOREHR(Renderer.PushEffect  ( pSpriteBatch->hEffect     ));
+        IGNOREHR(Renderer.SetTexture  ( 0, pSpriteBatch->hTexture ));
 
         //
         // Submit the vertices
@@ -905,7 +1211,8 @@ RESULT SpriteManager::EndBatch()
 #endif
       
         CHR(Renderer.SetModelViewMatrix( GameCamera.GetViewMatrix() ));  
-        CHR(Renderer.DrawTriangleList( pSpriteBatch->pVertices, pSpriteBatch->numVertices ));
+        CHR(SubmitBatch( pSpriteBatch, 0, pSpriteBatch->isQuadList ? pSpriteBatch->numSprites * VERTS_PER_QUAD : pSpriteBatch->numVertices, pSpriteBatch->hEffect.IsNull() ));
+        m_pSpriteBatchesMetric->Increment();
         
         IGNOREHR(Renderer.PopEffect( ));
     } // END draw sprite batch
@@ -921,8 +1228,11 @@ Exit:
 
     Renderer.EnableAlphaTest( false );
 
-    m_inSpriteBatch  = false;
-    m_zOrderForBatch = 0;
+    m_inSpriteBatch   = false;
+    m_areBatchesBuilt = false;
+    m_castsShadow     = false;
+    m_zOrderForBatch  = 0;
+    m_pSpriteBatchMap = NULL;
     
     return rval;
 }
@@ -1031,6 +1341,35 @@ SpriteManager::DrawSprite( IN HSprite hSprite, float x, float y, float z, float
         }
 
         
+        if (m_areBatchesBuilt)
+        {
+            RETAILMSG(ZONE_ERROR, "ERROR: SpriteManager::DrawSprite( %s ): batch already built by DrawShadows()", pSprite->GetName().c_str());
+            rval = E_INVALID_OPERATION;
+            goto Exit;
+        }
+
+
+        //
+        // Drop Sprites that are fully transparent or entirely off-screen before they reach a batch.
+        // The sphere encloses the quad however it's scaled or rotated about its center; the batch's
+        // vertices are submitted with the camera's view matrix as the model-view.
+        //
+        mat4    matWorldParent  = matParentWorld * GameCamera.GetViewMatrix();
+        {
+        float   halfWidth       = pSprite->GetWidth()  * 0.5f;
+        float   halfHeight      = pSprite->GetHeight() * 0.5f;
+        vec3    center          = vec3( x + halfWidth, y + halfHeight, z );
+        float   radius          = fabsf( scale ) * sqrtf( halfWidth * halfWidth + halfHeight * halfHeight );
+
+        if (Util::CompareFloats( opacity, 0.0f ) || 
+            !Culling::IsVisible( center, radius, matWorldParent * GameCamera.GetViewMatrix() ))
+        {
+            m_pSpritesCulledMetric->Increment();
+            goto Exit;
+        }
+        }
+
+        
         //
         // Has a SpriteBatch already been created for this Effect / texture atlas combo?
         // If not, create one.
@@ -1070,8 +1409,8 @@ SpriteManager::DrawSprite( IN HSprite hSprite, float x, float y, float z, float
         key.hEffect   = hSpriteEffect;
         key.textureID = textureInfo.textureID;
         
-        SpriteBatchMapIterator ppSpriteBatchMap = m_spriteBatchMap.find( key );
-        if (ppSpriteBatchMap == m_spriteBatchMap.end())
+        SpriteBatchMapIterator ppSpriteBatchMap = m_pSpriteBatchMap->find( key );
+        if (ppSpriteBatchMap == m_pSpriteBatchMap->end())
         {
             // Haven't encountered this combination of Effect and texture atlas before; allocate a new SpriteBatch for it.
             pSpriteBatch                    = new SpriteBatch();
@@ -1081,9 +1420,15 @@ SpriteManager::DrawSprite( IN HSprite hSprite, float x, float y, float z, float
             pSpriteBatch->numSprites        = 0;
             pSpriteBatch->numVertices       = 0;
             pSpriteBatch->pVertices         = NULL;
+            pSpriteBatch->vertexCapacity    = 0;
+            pSpriteBatch->pPackedVertices   = NULL;
+            pSpriteBatch->packedCapacity    = 0;
+            pSpriteBatch->isQuadList        = false;
+            pSpriteBatch->isPackingEnabled  = false;
+            pSpriteBatch->isPacked          = false;
             pSpriteBatch->zOrder            = key.zOrder;
             
-            m_spriteBatchMap.insert( std::make_pair(key, pSpriteBatch) );
+            m_pSpriteBatchMap->insert( std::make_pair(key, pSpriteBatch) );
             
     #ifdef DEBUG            
             DEBUGMSG(ZONE_SPRITE, "Created SpriteBatch for Effect \"%s\" texture \"%s\"", 
@@ -1099,21 +1444,25 @@ SpriteManager::DrawSprite( IN HSprite hSprite, float x, float y, float z, float
         //
         // Add Sprite to SpriteBatch
         //
-        BatchedSprite* pBatchedSprite   = new BatchedSprite();            // TODO: replace with a FrameAllocator!!
-        pBatchedSprite->pSprite         = pSprite;
-        pBatchedSprite->position        = vec3(x, y, z);
-        pBatchedSprite->opacity         = opacity;
-        pBatchedSprite->scale           = scale;
-        pBatchedSprite->rotation        = vec3(rotateX, rotateY, rotateZ);
-        pBatchedSprite->matWorldParent  = matParentWorld * GameCamera.GetViewMatrix();
-        
-        pSpriteBatch->sprites.push_back( pBatchedSprite );
-        pSpriteBatch->numSprites++;
-
         UINT32  numVertices = 0;
         Vertex* pVertices   = NULL;
         CHR(pSprite->GetVertices(&pVertices, &numVertices));
+
+        BatchedSprite batchedSprite;
+        batchedSprite.pSprite           = pSprite;
+        batchedSprite.vertexStamp       = pSprite->GetVertexStamp();
+        batchedSprite.numVertices       = numVertices;
+        batchedSprite.castsShadow       = m_castsShadow;
+        batchedSprite.position          = vec3(x, y, z);
+        batchedSprite.opacity           = opacity;
+        batchedSprite.scale             = scale;
+        batchedSprite.rotation          = vec3(rotateX, rotateY, rotateZ);
+        batchedSprite.matWorldParent    = matWorldParent;
+        
+        pSpriteBatch->sprites.push_back( batchedSprite );
+        pSpriteBatch->numSprites++;
         pSpriteBatch->numVertices += numVertices;
+        m_pSpritesSubmittedMetric->Increment();
     }
     
 Exit:
@@ -1157,6 +1506,8 @@ static const NamedProperty s_propertyTable[] =
 };
 DECLARE_PROPERTY_SET( Sprite, s_propertyTable );
 
+UINT32 Sprite::s_nextVertexStamp = 0;
+
 
 
 
@@ -1172,7 +1523,9 @@ Sprite::Sprite() :
     m_isVisible(true),
     m_color(Color::White()),
     m_hasShadow(false),
-    m_isBackedByTextureAtlas(false)
+    m_isBackedByTextureAtlas(false),
+    m_vertexStamp(++s_nextVertexStamp),
+    m_transform(Transforms::Create())
 {
     RETAILMSG(ZONE_OBJECT | ZONE_VERBOSE, "Sprite( %4d )", m_ID);
     
@@ -1196,6 +1549,8 @@ Sprite::~Sprite()
     EffectMan.Release ( m_hEffect );
     
     memset(&m_vertices, 0, sizeof(m_vertices));
+
+    Transforms::Destroy( m_transform );
 }
 
 
@@ -1214,6 +1569,8 @@ Sprite::Clone() const
     
     pSpriteClone->m_color = m_color;
     pSpriteClone->m_frame = 0;
+    pSpriteClone->m_vertexStamp = ++s_nextVertexStamp;
+    pSpriteClone->m_transform = Transforms::Create();
     pSpriteClone->m_isBackedByTextureAtlas = m_isBackedByTextureAtlas;
 
     // Take new reference to Effect.
@@ -1315,6 +1672,7 @@ Sprite::Init( const string& name, const Settings* pSettings, const string& setti
 
     CHR(TextureMan.GetInfo( m_hTextures[0], &textureInfo ));
     m_isBackedByTextureAtlas = textureInfo.isBackedByTextureAtlas;
+    m_vertexStamp            = ++s_nextVertexStamp;
     
 
     RETAILMSG(ZONE_SPRITE, "Sprite[%4d]: \"%-32s\" %d x %d frames: %d", m_ID, m_name.c_str(), m_width, m_height, m_numFrames);
@@ -1372,6 +1730,7 @@ Sprite::Init( IN const string& name, IN const HTexture& hTexture, IN const Recta
                                   textureInfo.vStart, 
                                   textureInfo.vEnd,
                                   m_color ));
+    m_vertexStamp = ++s_nextVertexStamp;
     
     RETAILMSG(ZONE_SPRITE, "Sprite[%4d]: \"%-32s\" %d x %d frames: %d", m_ID, m_name.c_str(), m_width, m_height, m_numFrames);
     
@@ -1427,7 +1786,11 @@ Sprite::SetSpriteFrame( UINT8 frame )
 {
     if (frame < m_numFrames)
     {
-        m_frame = frame;
+        if (m_frame != frame)
+        {
+            m_frame       = frame;
+            m_vertexStamp = ++s_nextVertexStamp;
+        }
         return S_OK;
     }
     else
@@ -1448,6 +1811,9 @@ Sprite::SetOpacity( float opacity )
     
     opacity = CLAMP(opacity, 0.0, 1.0);
     m_fOpacity = opacity;
+
+    // Fully transparent Sprites are culled.
+    Culling::Invalidate();
     
 Exit:
     return rval;
@@ -1474,6 +1840,7 @@ Sprite::SetColor( const Color& color )
             m_vertices[frame][i].color = color;
         }
     }
+    m_vertexStamp = ++s_nextVertexStamp;
     
 Exit:
     return rval;
@@ -1511,11 +1878,7 @@ Sprite::UpdateBoundingBox()
     //
     // Transform the quad based on position, scale.
     //
-    modelview  = mat4::Scale    ( m_fScale );
-    modelview *= mat4::RotateX  ( m_vRotation.x );
-    modelview *= mat4::RotateY  ( m_vRotation.y );
-    modelview *= mat4::RotateZ  ( m_vRotation.z );
-    modelview *= mat4::Translate( m_vWorldPosition.x, m_vWorldPosition.y, m_vWorldPosition.z );
+    Transforms::Compose( m_vWorldPosition, m_vRotation, m_fScale, vec3(0,0,0), &modelview );
 
     // apply to min/max
     min = modelview * min;
@@ -1524,6 +1887,9 @@ Sprite::UpdateBoundingBox()
     // Update bounding box
     m_bounds.SetMin( vec3( min.x, min.y, min.z ) );
     m_bounds.SetMax( vec3( max.x, max.y, max.z ) );
+
+    // A Layer that culled us may now have something on-screen.
+    Culling::Invalidate();
 }
 
 
@@ -1550,18 +1916,9 @@ Sprite::Draw( const mat4& matParentWorld )
     Util::GetBoundingRect( &m_vertices[0][0], numVertices, &spriteRect );
     vec3 rotationPoint = vec3( spriteRect.width * 0.5f, spriteRect.height * 0.5f, 0.0f);
     
-    modelview = mat4::Translate( -rotationPoint.x, -rotationPoint.y, 0.0f );
-
-    modelview *= mat4::Scale( m_fScale );
-    modelview *= mat4::RotateX( m_vRotation.x );
-    modelview *= mat4::RotateY( m_vRotation.y );
-    modelview *= mat4::RotateZ( m_vRotation.z );
-
-    modelview *= mat4::Translate( rotationPoint.x, rotationPoint.y, 0.0f );
-
-    modelview *= mat4::Translate( m_vWorldPosition.x, m_vWorldPosition.y, m_vWorldPosition.z );
-
-    modelview *= matParentWorld;
+    // Rebuilt only if something changed since we were last drawn.
+    Transforms::SetLocal( m_transform, m_vWorldPosition, m_vRotation, m_fScale, rotationPoint );
+    modelview = Transforms::GetWorld( m_transform, matParentWorld );
 
     //
     // HACK: duplicate vertices so we can apply pre-multiplied Alpha to them,
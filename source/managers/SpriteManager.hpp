@@ -8,6 +8,10 @@
 #include "TextureManager.hpp"
 #include "EffectManager.hpp"
 #include "IDrawable.hpp"
+#include "Metrics.hpp"
+#include "Culling.hpp"
+#include "QuadList.hpp"
+#include "Transforms.hpp"
 
 
 #include <string>
@@ -63,7 +67,9 @@ public:
                                            INOUT        HSprite*    pHandle = NULL,
                                            IN    const  Color&      color   = Color::White() );
 
-    RESULT              BeginBatch       ( );
+    // Batches are kept per (pOwner, pass) between frames; a batch whose Sprites and
+    // transforms match the previous frame reuses its vertices instead of rebuilding them.
+    RESULT              BeginBatch       ( IN const void* pOwner = NULL, UINT32 pass = 0 );
 
     RESULT              DrawSprite       ( 
                                             IN       HSprite hSprite, 
@@ -94,7 +100,15 @@ public:
                                             IN const mat4&    matParentWorld = mat4::Identity()  
                                           );
     
+    // Sprites batched after this call are (or aren't) drawn again by DrawShadows().
+    RESULT              SetShadowCasting ( bool castsShadow );
+
+    // Between BeginBatch() and EndBatch(): draw the shadow-casting Sprites under hShadowEffect,
+    // from the same vertices EndBatch() then submits.  No more Sprites may be batched afterwards.
+    RESULT              DrawShadows      ( IN HEffect hShadowEffect );
+
     RESULT              EndBatch         ( );
+    RESULT              FreeBatches      ( IN const void* pOwner );
     
     RESULT              SetSpriteFrame   ( IN HSprite hSprite, UINT8 frame );
     
@@ -139,6 +153,9 @@ protected:
     struct BatchedSprite
     {
         Sprite*     pSprite;
+        UINT32      vertexStamp;    // Sprite::GetVertexStamp() when batched
+        UINT32      numVertices;
+        bool        castsShadow;
         float       opacity;
         float       scale;
         vec3        rotation;
@@ -146,7 +163,7 @@ protected:
         mat4        matWorldParent; // TODO: apply to scale/rotation/position directly, save 16 floats!
     };
     
-    typedef     vector<BatchedSprite*>      BatchedSprites;
+    typedef     vector<BatchedSprite>       BatchedSprites;
     typedef     BatchedSprites::iterator    BatchedSpritesIterator;
 
     // A batch of Sprites, which share the same Material and texture atlas.
@@ -160,7 +177,14 @@ protected:
         UINT32          numVertices;
         UINT32          zOrder;
         Vertex*         pVertices;
+        UINT32          vertexCapacity;
+        PackedVertex*   pPackedVertices;    // pVertices again, as PackedVertex, if isPacked.
+        UINT32          packedCapacity;
+        bool            isQuadList;         // pVertices holds VERTS_PER_QUAD corners per Sprite; see QuadList.hpp.
+        bool            isPackingEnabled;   // QuadList::IsPackingEnabled() when built.
+        bool            isPacked;
         BatchedSprites  sprites;
+        BatchedSprites  builtSprites;   // What pVertices currently holds.
     };
     
 
@@ -195,9 +219,35 @@ protected:
     typedef     map<SpriteBatchKey, SpriteBatch*>   SpriteBatchMap;
     typedef     SpriteBatchMap::iterator            SpriteBatchMapIterator;
 
-    SpriteBatchMap  m_spriteBatchMap;
+    // One SpriteBatchMap per (owner, pass); usually one per Layer.
+    typedef     std::pair<const void*, UINT32>          SpriteBatchSetKey;
+    typedef     map<SpriteBatchSetKey, SpriteBatchMap>  SpriteBatchSets;
+    typedef     SpriteBatchSets::iterator               SpriteBatchSetsIterator;
+
+    SpriteBatchSets m_spriteBatchSets;
+    SpriteBatchMap* m_pSpriteBatchMap;      // The set between BeginBatch() and EndBatch().
     bool            m_inSpriteBatch;
+    bool            m_areBatchesBuilt;      // Set by BuildBatches(); the current set is closed to new Sprites.
+    bool            m_castsShadow;
     UINT32          m_zOrderForBatch;
+
+    // Non-empty SpriteBatches for the current EndBatch(); the changed ones are rebuilt in parallel.
+    vector<SpriteBatch*>    m_batchesToDraw;
+    vector<SpriteBatch*>    m_batchesToBuild;
+    vector<RESULT>          m_buildResults;
+
+    RESULT          BuildBatches    ( );
+    static  void    BuildBatchesJob ( void* pContext, UINT32 begin, UINT32 end );
+    static  RESULT  BuildBatch      ( INOUT SpriteBatch* pSpriteBatch );
+    static  bool    IsBatchUnchanged( IN const SpriteBatch* pSpriteBatch );
+    static  RESULT  SubmitBatch     ( IN SpriteBatch* pSpriteBatch, UINT32 firstVertex, UINT32 numVertices, bool allowPacked );
+    static  void    FreeBatchMap    ( INOUT SpriteBatchMap* pSpriteBatchMap );
+
+    MetricCounter*  m_pSpriteBatchesMetric;
+    MetricCounter*  m_pVerticesBuiltMetric;
+    MetricCounter*  m_pVerticesReusedMetric;
+    MetricCounter*  m_pSpritesSubmittedMetric;
+    MetricCounter*  m_pSpritesCulledMetric;
 };
 
 #define SpriteMan ((SpriteManager&)SpriteManager::Instance())
@@ -231,7 +281,7 @@ public:
                                           IN const  Rectangle&  spriteRect,
                                           IN const  Color&      color = Color::White() );
 	// IDrawable
-    inline RESULT       SetVisible      ( bool          isVisible        )      { m_isVisible       = isVisible; return S_OK; }
+    inline RESULT       SetVisible      ( bool          isVisible        )      { m_isVisible       = isVisible;        Culling::Invalidate(); return S_OK; }
     inline RESULT       SetPosition     ( const vec3&   vPos             )      { m_vWorldPosition  = vPos;             UpdateBoundingBox(); return S_OK; }
     inline RESULT       SetRotation     ( const vec3&   vRotationDegrees )      { m_vRotation       = vRotationDegrees; UpdateBoundingBox(); return S_OK; }
     inline RESULT       SetScale        ( float         scale            )      { m_fScale          = scale;            UpdateBoundingBox(); return S_OK; }
@@ -250,6 +300,8 @@ public:
     inline AABB         GetBounds       ( )                                     { return m_bounds;          };
     inline Color        GetColor        ( )                                     { return m_color;           };
     inline bool         GetShadow       ( )                                     { return m_hasShadow;       };
+    inline UINT32       GetWidth        ( )                                     { return m_width;           };
+    inline UINT32       GetHeight       ( )                                     { return m_height;          };
 
 
     RESULT              Draw            ( const mat4&   matParentWorld );
@@ -258,6 +310,7 @@ public:
     UINT32              GetSpriteFrame  ( )    { return m_frame; }
 
     RESULT              GetVertices     ( INOUT Vertex** ppVertices, OUT UINT32* pNumVertices );
+    UINT32              GetVertexStamp  ( )    { return m_vertexStamp; }   // Changes whenever GetVertices() would return different data.
     RESULT              GetTexture      ( INOUT HTexture* phTexture );
 //    RESULT              GetTextureAtlas ( INOUT HTextureAtlas* phTextureAtlas );
     bool                IsBackedByTextureAtlas( )   { return m_isBackedByTextureAtlas; }
@@ -291,6 +344,8 @@ protected:
     
     HTexture            m_hTextures[MAX_SPRITE_FRAMES];
     Vertex              m_vertices[MAX_SPRITE_FRAMES][VERTS_PER_SPRITE];
+    UINT32              m_vertexStamp;
+    TransformID         m_transform;        // For drawing outside a SpriteBatch.
 
 
     
@@ -303,6 +358,7 @@ protected:
     //
     static       PropertySet        s_properties;
 
+    static       UINT32             s_nextVertexStamp;
 };
 
 typedef Handle<Sprite> HSprite;
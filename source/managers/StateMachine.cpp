@@ -12,6 +12,8 @@
 #include "StateMachine.hpp"
 #include "GameObjectManager.hpp"
 
+#include <string.h>
+
 
 
 namespace Z 
@@ -22,9 +24,15 @@ namespace Z
 #define MAX_STATE_STACK_SIZE 10
 
 
+bool StateMachine::s_isDispatchEnabled = false;
+StateDispatchTable::TableMap StateDispatchTable::s_tables;
+os_unfair_lock StateDispatchTable::s_tablesLock = OS_UNFAIR_LOCK_INIT;
+
+
 StateMachine::StateMachine( GameObject & object )
 : m_queue( STATE_MACHINE_QUEUE_NULL ),
-  m_owner( &object )
+  m_owner( &object ),
+  m_dispatch( 0 )
 {
     // NOTE: does not take a reference to the GameObject.
 
@@ -38,7 +46,8 @@ StateMachine::StateMachine( GameObject & object )
 StateMachine::StateMachine( HGameObject &hGameObject )
 : m_queue( STATE_MACHINE_QUEUE_NULL ),
   m_owner( NULL ),
-  m_hOwner(hGameObject)
+  m_hOwner(hGameObject),
+  m_dispatch( 0 )
 {
     // NOTE: does not take a reference to the GameObject.
 
@@ -101,7 +110,8 @@ void StateMachine::Reset( void )
 /*---------------------------------------------------------------------------*
   Name:         Update
 
-  Description:  An update event is sent to the state machine.
+  Description:  An update event is sent to the state machine, unless its
+                dispatch table shows that no state handles it.
 
   Arguments:    None.
 
@@ -111,6 +121,12 @@ void StateMachine::Update( void )
 {
 	if( m_updateEventEnabled )
 	{
+		if( m_dispatch && s_isDispatchEnabled &&
+			StateDispatchTable::HANDLER_NONE == m_dispatch->Find( (int)m_currentState, m_currentSubstate, EVENT_FrameUpdate, 0 ) )
+		{
+			return;
+		}
+
 		Process( EVENT_FrameUpdate, 0 );
 	}
 }
@@ -123,6 +139,8 @@ void StateMachine::Update( void )
 				it is sent to the current state. If not handled, it is then 
 				sent to the global state. Finally, any state changes are
 				propagated.
+				Once the dispatch table knows which of those handles the
+				event, only that one is tried.
 
   Arguments:    event : the event to process
                 msg   : an optional msg to process with the event
@@ -138,19 +156,64 @@ void StateMachine::Process( State_Machine_Event event, MSG_Object * msg )
 			SendCCMsg( msg->GetName(), GetCCReceiver(), msg->GetMsgData() );
 		}
 
-		//Process this event inside the state machine
-		bool handled = false;
-		if( m_currentSubstate >= 0 )
-		{	//Send to current substate
-			handled = States( event, msg, m_currentState, m_currentSubstate );
+#ifndef DEBUG_STATE_MACHINE_MACROS	//The debug macros log unhandled events, so must see them all
+		if( !m_dispatch && s_isDispatchEnabled )
+		{
+			m_dispatch = StateDispatchTable::Get( typeid( *this ) );
 		}
-		if( !handled )
-		{	//Send to current state
-			handled = States( event, msg, m_currentState, -1 );
+#endif
+
+		const int state = static_cast<int>( m_currentState );
+		const int substate = m_currentSubstate;
+		StateDispatchTable::Handler handler = StateDispatchTable::HANDLER_UNKNOWN;
+		if( m_dispatch && s_isDispatchEnabled )
+		{
+			handler = m_dispatch->Find( state, substate, event, msg );
 		}
-		if( !handled )
-		{	//Send to global state
-			handled = States( event, msg, -1, -1 );
+
+		//Process this event inside the state machine
+		switch( handler )
+		{
+			case StateDispatchTable::HANDLER_SUBSTATE:
+				States( event, msg, state, substate );
+				break;
+
+			case StateDispatchTable::HANDLER_STATE:
+				States( event, msg, state, -1 );
+				break;
+
+			case StateDispatchTable::HANDLER_GLOBAL:
+				States( event, msg, -1, -1 );
+				break;
+
+			case StateDispatchTable::HANDLER_NONE:
+				break;
+
+			default:
+			{
+				bool handled = false;
+				handler = StateDispatchTable::HANDLER_NONE;
+				if( substate >= 0 )
+				{	//Send to current substate
+					handled = States( event, msg, state, substate );
+					if( handled ) { handler = StateDispatchTable::HANDLER_SUBSTATE; }
+				}
+				if( !handled )
+				{	//Send to current state
+					handled = States( event, msg, state, -1 );
+					if( handled ) { handler = StateDispatchTable::HANDLER_STATE; }
+				}
+				if( !handled )
+				{	//Send to global state
+					handled = States( event, msg, -1, -1 );
+					if( handled ) { handler = StateDispatchTable::HANDLER_GLOBAL; }
+				}
+
+				if( m_dispatch && s_isDispatchEnabled )
+				{
+					m_dispatch->Set( state, substate, event, msg, handler );
+				}
+			}
 		}
 		
 		PerformStateChanges();
@@ -1440,6 +1503,177 @@ void StateMachineManager::DestroyStateMachineList( StateMachineQueue queue )
 		}
 	}
 }
+
+/*---------------------------------------------------------------------------*
+  Name:         Clear
+
+  Description:  Destroys all state machines, and any pending changes, so that
+                a pooled GameObject can reuse its manager.
+
+  Arguments:    None.
+
+  Returns:      None.
+ *---------------------------------------------------------------------------*/
+void StateMachineManager::Clear( void )
+{
+	DestroyStateMachineList( STATE_MACHINE_QUEUE_ALL );
+
+	for( int i=0; i<STATE_MACHINE_NUM_QUEUES; ++i )
+	{
+		if( m_newStateMachine[i] )
+			delete( m_newStateMachine[i] );
+
+		m_stateMachineChange[i] = NO_STATE_MACHINE_CHANGE;
+		m_newStateMachine[i] = 0;
+	}
+}
+
+
+
+
+
+StateDispatchTable::StateDispatchTable( void )
+: m_lock( OS_UNFAIR_LOCK_INIT )
+{
+	memset( (void*)m_handlers, 0, sizeof(m_handlers) );
+}
+
+/*---------------------------------------------------------------------------*
+  Name:         Get
+
+  Description:  Finds, or creates, the dispatch table shared by every state
+                machine of a class.
+
+  Arguments:    type : the state machine's class
+
+  Returns:      The table.
+ *---------------------------------------------------------------------------*/
+StateDispatchTable * StateDispatchTable::Get( const std::type_info & type )
+{
+	StateDispatchTable * table = 0;
+
+	os_unfair_lock_lock( &s_tablesLock );
+
+	TableMap::iterator existing = s_tables.find( type.name() );
+	if( existing != s_tables.end() )
+	{
+		table = existing->second;
+	}
+	else
+	{
+		table = new StateDispatchTable();
+		s_tables.insert( TableMap::value_type( type.name(), table ) );
+	}
+
+	os_unfair_lock_unlock( &s_tablesLock );
+
+	return( table );
+}
+
+/*---------------------------------------------------------------------------*
+  Name:         Find
+
+  Description:  Looks up what handles an event in a state and substate.
+
+  Arguments:    state    : the current state
+                substate : the current substate, or -1
+                event    : the event
+                msg      : the message, for EVENT_Message and EVENT_CCMessage
+
+  Returns:      The handler, or HANDLER_UNKNOWN if this hasn't been seen yet.
+ *---------------------------------------------------------------------------*/
+StateDispatchTable::Handler StateDispatchTable::Find( int state, int substate, State_Machine_Event event, MSG_Object * msg )
+{
+	int column = GetColumn( event, msg );
+
+	if( column < 0 ||
+		state < 0 || state >= STATE_DISPATCH_MAX_STATES ||
+		substate < -1 || substate >= STATE_DISPATCH_MAX_SUBSTATES )
+	{
+		return( HANDLER_UNKNOWN );
+	}
+
+	const BYTE * handlers = m_handlers[state][substate + 1];
+	if( !handlers )
+	{
+		return( HANDLER_UNKNOWN );
+	}
+
+	return( (Handler)handlers[column] );
+}
+
+/*---------------------------------------------------------------------------*
+  Name:         Set
+
+  Description:  Records what handles an event in a state and substate.
+                States beyond the table's size are never recorded, so they
+				always take the long way through States().
+
+  Arguments:    state    : the current state
+                substate : the current substate, or -1
+                event    : the event
+                msg      : the message, for EVENT_Message and EVENT_CCMessage
+                handler  : the level of States() that handled it
+
+  Returns:      None.
+ *---------------------------------------------------------------------------*/
+void StateDispatchTable::Set( int state, int substate, State_Machine_Event event, MSG_Object * msg, Handler handler )
+{
+	int column = GetColumn( event, msg );
+
+	if( column < 0 ||
+		state < 0 || state >= STATE_DISPATCH_MAX_STATES ||
+		substate < -1 || substate >= STATE_DISPATCH_MAX_SUBSTATES )
+	{
+		return;
+	}
+
+	BYTE * handlers = m_handlers[state][substate + 1];
+	if( !handlers )
+	{
+		os_unfair_lock_lock( &m_lock );
+
+		handlers = m_handlers[state][substate + 1];
+		if( !handlers )
+		{
+			handlers = new BYTE[NUM_COLUMNS];
+			memset( handlers, HANDLER_UNKNOWN, NUM_COLUMNS );
+
+			//Publish the row only once it's cleared
+			OSMemoryBarrier();
+			m_handlers[state][substate + 1] = handlers;
+		}
+
+		os_unfair_lock_unlock( &m_lock );
+	}
+
+	//Every thread that gets here writes the same value
+	handlers[column] = (BYTE)handler;
+}
+
+/*---------------------------------------------------------------------------*
+  Name:         GetColumn
+
+  Description:  Maps an event, and its message name, to a column of the table.
+
+  Arguments:    event : the event
+                msg   : the message, for EVENT_Message and EVENT_CCMessage
+
+  Returns:      The column, or -1 if the event can't be cached.
+ *---------------------------------------------------------------------------*/
+int StateDispatchTable::GetColumn( State_Machine_Event event, MSG_Object * msg )
+{
+	if( EVENT_Message == event || EVENT_CCMessage == event )
+	{
+		if( !msg || msg->GetName() >= MSG_NUM ) {
+			return( -1 );
+		}
+
+		return( NUM_EVENTS + (EVENT_CCMessage == event ? MSG_NUM : 0) + (int)msg->GetName() );
+	}
+
+	return( (int)event );
+}
     
 
 
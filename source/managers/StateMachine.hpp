@@ -13,6 +13,11 @@
 #pragma warning(disable: 4995)
 
 #include <vector>
+#include <map>
+#include <string>
+#include <typeinfo>
+#include <libkern/OSAtomic.h>
+#include <os/lock.h>
 #include "msg.hpp"
 #include "Object.hpp"
 #include "GameObject.hpp"
@@ -111,6 +116,60 @@ class StateMachineManager;
 class GameObject;
 
 
+#pragma mark StateDispatchTable
+
+//
+// Which part of a StateMachine handles each (state, substate, event, message):
+// the substate, the state, the global responses, or nothing.
+//
+// The macros in States() can't list their handlers without running them, but
+// whether a handler matches depends only on those four, so the table is filled
+// in as Process() meets each combination, and shared by every StateMachine of
+// the same class.  After that, Process() calls States() once, at the level that
+// handles the event, or not at all.
+//
+// Find() takes no lock, so StateMachines of one class can be updated on several
+// threads: rows are allocated once, under a lock, and never move.
+//
+#define STATE_DISPATCH_MAX_STATES		64
+#define STATE_DISPATCH_MAX_SUBSTATES	16
+
+class StateDispatchTable
+{
+public:
+	enum Handler {
+		HANDLER_UNKNOWN,
+		HANDLER_SUBSTATE,
+		HANDLER_STATE,
+		HANDLER_GLOBAL,
+		HANDLER_NONE
+	};
+
+	static StateDispatchTable * Get( const std::type_info & type );
+
+	Handler Find( int state, int substate, State_Machine_Event event, MSG_Object * msg );
+	void Set( int state, int substate, State_Machine_Event event, MSG_Object * msg, Handler handler );
+
+private:
+	typedef std::map<std::string, StateDispatchTable*> TableMap;	//StateMachine class name -> table
+
+	enum {
+		NUM_EVENTS = EVENT_Exit + 1,
+		NUM_COLUMNS = NUM_EVENTS + 2 * MSG_NUM						//Events, then EVENT_Message and EVENT_CCMessage by message name
+	};
+
+	StateDispatchTable( void );
+
+	BYTE * volatile m_handlers[STATE_DISPATCH_MAX_STATES][STATE_DISPATCH_MAX_SUBSTATES + 1];	//[state][substate + 1][column], or NULL
+	os_unfair_lock m_lock;
+
+	static TableMap s_tables;
+	static os_unfair_lock s_tablesLock;
+
+	static int GetColumn( State_Machine_Event event, MSG_Object * msg );
+};
+
+
 #pragma mark StateMachine
 
 class StateMachine : virtual public Object
@@ -124,6 +183,10 @@ public:
 
 	void SetStateMachineQueue( StateMachineQueue queue )	{ ASSERTMSG( queue < STATE_MACHINE_NUM_QUEUES, "StateMachine::SetQueue - invalid queue" ); m_queue = queue; }
 
+	//Look up handlers in each class's StateDispatchTable, rather than trying each level of States()
+	static void EnableDispatchTables( bool enabled )	{ s_isDispatchEnabled = enabled; }
+	static bool IsDispatchTableEnabled( void )			{ return( s_isDispatchEnabled ); }
+
 	//Should only be called by GameObject
 	void Update( void );
 	void Reset( void );
@@ -265,6 +328,9 @@ private:
 	OBJECT_ID m_ccMessagesToGameObject;			//A GameObject to CC messages to
 	BroadcastListContainer m_broadcastList;		//List of GameObjects to broadcast to
 	StateListContainer m_stack;					//Stack of past states (used for PopState)
+	StateDispatchTable * m_dispatch;			//Shared by this class; looked up on the first event
+
+	static bool s_isDispatchEnabled;
 
 
 	//Debug info
@@ -292,6 +358,7 @@ public:
 	void SendMsg( MSG_Object msg );
 	void Process( State_Machine_Event event, MSG_Object * msg, StateMachineQueue queue );
 	void DestroyStateMachineList( StateMachineQueue queue );
+	void Clear( void );
 
 	inline StateMachine* GetStateMachine( StateMachineQueue queue )	{ if( m_stateMachineList[queue].empty() ) { return( 0 ); } else { return( m_stateMachineList[queue].back() ); } }
 	inline int GetNumStateMachinesInQueue( StateMachineQueue queue )	{ return( (int)m_stateMachineList[queue].size() ); }
@@ -29,8 +29,10 @@ protected:
 
 class StateMachineFactoryManager
 {
-
+public:
     typedef StateMachine*(*SM_FACTORY_METHOD)( HGameObject hGameObject );
+
+protected:
     typedef struct 
     {
         const char*         name;
@@ -41,7 +43,28 @@ class StateMachineFactoryManager
 public:
     static StateMachine* Create( IN const string& stateMachineName, IN HGameObject hGameObject )
     {
-        StateMachine*            pStateMachine = NULL;
+        StateMachine*       pStateMachine = NULL;
+        SM_FACTORY_METHOD   factoryMethod = Find( stateMachineName );
+        
+        if (factoryMethod)
+        {
+            DEBUGMSG(ZONE_STATEMACHINE | ZONE_VERBOSE, "StateMachineFactoryManager::Create( \"%s\" )", stateMachineName.c_str());
+            
+            pStateMachine = factoryMethod( hGameObject );
+        }
+        
+        if (!pStateMachine)
+        {
+            RETAILMSG(ZONE_ERROR, "StateMachineFactoryManager::Create( \"%s\" ): not found", stateMachineName.c_str());
+        }
+        
+        return pStateMachine;
+    }
+    
+    
+    // For callers that create the same StateMachine often (e.g. prefabs): look it up once.
+    static SM_FACTORY_METHOD Find( IN const string& stateMachineName )
+    {
         StateMachineFactoryItem* pFactory = NULL;
         int                      i = 0;
         
@@ -51,19 +74,11 @@ public:
         
             if (stateMachineName == pFactory->name)
             {
-                DEBUGMSG(ZONE_STATEMACHINE | ZONE_VERBOSE, "StateMachineFactoryManager::Create( \"%s\" )", stateMachineName.c_str());
-                
-                pStateMachine = pFactory->factoryMethod( hGameObject );
-                break;
+                return pFactory->factoryMethod;
             }
         } while (pFactory->factoryMethod != NULL);
         
-        if (!pStateMachine)
-        {
-            RETAILMSG(ZONE_ERROR, "StateMachineFactoryManager::Create( \"%s\" ): not found", stateMachineName.c_str());
-        }
-        
-        return pStateMachine;
+        return NULL;
     }
     
     
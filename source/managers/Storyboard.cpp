@@ -802,15 +802,17 @@ Exit:
 
 
 RESULT
-Storyboard::Start( )
+Storyboard::Start( UINT64 startAtMS )
 {
     RESULT rval = S_OK;
 
-    DEBUGMSG(ZONE_STORYBOARD, "START Storyboard \"%s\"", m_name.c_str());
+    DEBUGMSG(ZONE_STORYBOARD, "START Storyboard \"%s\" at %llu ms", m_name.c_str(), startAtMS);
 
     m_isStarted             = true;
     m_isPaused              = false;
     m_numFinishedAnimations = 0;
+    m_startTimeMS           = GameTime.GetTime();
+    m_startTimeMS          -= MIN(startAtMS, m_startTimeMS);
 
     // Start each Animation
     for (int i = 0; i < m_numAnimations; ++i)
@@ -820,7 +822,7 @@ Storyboard::Start( )
         
         pAnimation->m_hasFinished = false;
         
-        CHR(AnimationMan.Start( pAnimation->m_hAnimation ));
+        CHR(AnimationMan.Start( pAnimation->m_hAnimation, startAtMS ));
     }
     
 Exit:
@@ -829,6 +831,29 @@ Exit:
 
 
 
+UINT64
+Storyboard::GetElapsedMS( )
+{
+    UINT64 elapsedMS;
+
+    if (!m_isStarted)
+    {
+        return 0;
+    }
+
+    elapsedMS = GameTime.GetTime() - m_startTimeMS;
+
+    // Where a repeating storyboard is in its current pass.
+    if (m_autoRepeat && m_durationMS)
+    {
+        elapsedMS %= m_durationMS;
+    }
+
+    return elapsedMS;
+}
+
+
+
 RESULT
 Storyboard::Stop( )
 {
@@ -93,7 +93,7 @@ public:
 
     RESULT          CallbackOnFinished          ( const ICallback& callback );
     
-    RESULT          Start                       ( );
+    RESULT          Start                       ( UINT64 startAtMS = 0 );
     RESULT          Stop                        ( );
     RESULT          Pause                       ( );
     
@@ -111,6 +111,7 @@ public:
     RESULT          SetRelativeToCurrentState   ( bool isRelativeToCurrentState  )  { m_relativeToCurrentState  = isRelativeToCurrentState;  return S_OK; }
 
     UINT64          GetDurationMS               ( )                                 { return m_durationMS;              }
+    UINT64          GetElapsedMS                ( );
     UINT8           GetNumAnimations            ( )                                 { return m_numAnimations;           }
     bool            GetAutoRepeat               ( )                                 { return m_autoRepeat;              }
     bool            GetAutoReverse              ( )                                 { return m_autoReverse;             }
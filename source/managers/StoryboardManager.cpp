@@ -18,6 +18,7 @@
 #include "Util.hpp"
 #include "GameObjectManager.hpp"
 #include "Storyboard.hpp"
+#include "Profiler.hpp"
 
 
 namespace Z
@@ -648,11 +649,11 @@ Exit:
 
 
 RESULT
-StoryboardManager::Start( IN HStoryboard handle )
+StoryboardManager::Start( IN HStoryboard handle, UINT64 startAtMS )
 {
     RESULT rval = S_OK;
     
-    CHR(Start(GetObjectPointer( handle )));
+    CHR(Start(GetObjectPointer( handle ), startAtMS));
     
 Exit:
     return rval;
@@ -687,7 +688,7 @@ Exit:
 
 
 RESULT
-StoryboardManager::Start( IN Storyboard* pStoryboard )
+StoryboardManager::Start( IN Storyboard* pStoryboard, UINT64 startAtMS )
 {
     RESULT rval = S_OK;
     
@@ -709,7 +710,7 @@ StoryboardManager::Start( IN Storyboard* pStoryboard )
     if (!pStoryboard->IsStarted())
     {
         m_runningStoryboardsList.push_front( pStoryboard );
-        pStoryboard->Start();
+        pStoryboard->Start( startAtMS );
     }
 
 ///    pStoryboard->Start();
@@ -866,6 +867,23 @@ Exit:
 
 
 
+UINT64
+StoryboardManager::GetElapsedMS( IN HStoryboard hStoryboard )
+{
+    Storyboard*     pStoryboard;
+    UINT64          elapsed = 0;
+    
+    pStoryboard = GetObjectPointer( hStoryboard );
+    if (pStoryboard)
+    {
+        elapsed = pStoryboard->GetElapsedMS();
+    }
+
+    return elapsed;
+}
+
+
+
 UINT8
 StoryboardManager::GetNumAnimations( IN const string& name )
 {
@@ -940,6 +958,8 @@ StoryboardManager::Update( UINT64 elapsedMS )
 {
     RESULT rval = S_OK;
 
+    PROFILE_SCOPE("StoryboardMan.Update");
+
 
     // Release Storyboards that were marked as done on previous frame.
     StoryboardListIterator ppStoryboard;
@@ -67,11 +67,11 @@ public:
     RESULT          SetDeleteOnFinish           ( IN HStoryboard handle, bool willDeleteOnFinish        );
     RESULT          SetRelativeToCurrentState   ( IN HStoryboard handle, bool isRelativeToCurrentState  );
 
-    RESULT          Start               ( IN HStoryboard handle );
+    RESULT          Start               ( IN HStoryboard handle, UINT64 startAtMS = 0 );  // startAtMS: resume part-way through.
     RESULT          Stop                ( IN HStoryboard handle );
     RESULT          Pause               ( IN HStoryboard handle );
 
-    RESULT          Start               ( IN Storyboard* pStoryboard );
+    RESULT          Start               ( IN Storyboard* pStoryboard, UINT64 startAtMS = 0 );
     RESULT          Stop                ( IN Storyboard* pStoryboard );
     RESULT          Pause               ( IN Storyboard* pStoryboard );
 
@@ -84,6 +84,7 @@ public:
     
     // TODO: replace with struct StoryboardInfo?
     UINT64          GetDurationMS       ( IN HStoryboard handle );
+    UINT64          GetElapsedMS        ( IN HStoryboard handle );
     UINT64          GetDurationMS       ( IN const string& name );
     UINT8           GetNumAnimations    ( IN HStoryboard handle );
     UINT8           GetNumAnimations    ( IN const string& nmae );
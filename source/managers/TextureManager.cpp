@@ -17,6 +17,7 @@
 #include "Types.hpp"
 #include "Image.hpp"
 #include "SpriteManager.hpp"
+#include "RenderQueue.hpp"
 #include "json.h"
 
 #include <OpenGLES/ES1/gl.h>
@@ -27,6 +28,9 @@ namespace Z
 {
 
 
+// Registered once; every Texture adds to it when loaded and subtracts when deleted.
+static MetricGauge* s_pTextureBytesMetric = Metrics::RegisterGauge( "TextureMan.Bytes" );
+
     
 TextureManager& 
 TextureManager::Instance()
@@ -41,7 +45,8 @@ TextureManager::Instance()
 
 
 TextureManager::TextureManager() :
-    m_boundTextureID(0)
+    m_boundTextureID(0),
+    m_pTextureBytesMetric(s_pTextureBytesMetric)
 {
     RETAILMSG(ZONE_VERBOSE, "TextureManager()");
     
@@ -375,6 +380,7 @@ TextureManager::CreateGLESTexture ( IN const BYTE* pBuffer, UINT32 bufferSize, G
     VERIFYGL(glActiveTexture(GL_TEXTURE0));
     VERIFYGL(glGenTextures(1, &textureID));
     VERIFYGL(glBindTexture(GL_TEXTURE_2D, textureID));
+    RenderQueue::InvalidateTextureCache();
     VERIFYGL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE));
     VERIFYGL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE));
     VERIFYGL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR));
@@ -483,6 +489,9 @@ TextureManager::CreateGLESTexture ( IN const BYTE* pBuffer, UINT32 bufferSize, G
     pTextureInfo->vStart                    = 0.0f;
     pTextureInfo->uEnd                      = fScaleTextureWidth;
     pTextureInfo->vEnd                      = fScaleTextureHeight;
+    pTextureInfo->numBytes                  = (UINT32)(((UINT64)bufferSize * textureWidth * textureHeight) / (width * height));
+
+    m_pTextureBytesMetric->Add( pTextureInfo->numBytes );
         
 Exit:
     if (FAILED(rval))
@@ -984,6 +993,7 @@ Texture::~Texture()
     else
     {
         IGNOREGL(glDeleteTextures(1, (const GLuint*)&m_textureInfo.textureID));
+        s_pTextureBytesMetric->Add( -(INT64)m_textureInfo.numBytes );
     }
 }
 
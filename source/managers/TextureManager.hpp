@@ -4,6 +4,7 @@
 #include "Handle.hpp"
 #include "Object.hpp"
 #include "Settings.hpp"
+#include "Metrics.hpp"
 
 #include <string>
 using std::string;
@@ -40,6 +41,7 @@ typedef struct
     float   vEnd;
     
     UINT32  textureID;
+    UINT32  numBytes;       // GPU memory of the GL texture; 0 for sub-textures of a TextureAtlas.
 //    string name;
 //    HTextureAtlas hTextureAtlas;
     bool    isBackedByTextureAtlas;
@@ -81,7 +83,8 @@ protected:
     RESULT CreateTextureAtlas( IN Settings* pSettings, IN const string& settingsPath, INOUT TextureAtlas** ppTextureAtlas );
 
 protected:
-    GLuint  m_boundTextureID;
+    GLuint          m_boundTextureID;
+    MetricGauge*    m_pTextureBytesMetric;
 };
 
 #define TextureMan ((TextureManager&)TextureManager::Instance())
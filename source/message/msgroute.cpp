@@ -12,6 +12,9 @@
 #include "msgroute.hpp"
 #include "StateMachine.hpp"
 #include "GameObjectManager.hpp"
+#include "Profiler.hpp"
+
+#include <algorithm>
 
 
 // TEST TEST: allow queing up duplicate messages to a StateMachine IFF 
@@ -36,10 +39,32 @@ MsgRoute* MsgRoute::s_pMsgRoute = NULL;
   Description:  Constructor
  *---------------------------------------------------------------------------*/
 MsgRoute::MsgRoute( void )
-: m_slicePolicy(SLICE_POLICY_NONE),
-  m_sliceConstraint(0.1f)
+: m_readyHead(SLICE_NONE),
+  m_readyTail(SLICE_NONE),
+  m_numReady(0),
+  m_sliceFrame(0),
+  m_numSliceRequests(0),
+  m_numLateSlices(0),
+  m_numDeferredSlices(0),
+  m_slicePolicy(SLICE_POLICY_NONE),
+  m_sliceConstraint(0.1f),
+  m_pPendingMessagesMetric(Metrics::RegisterGauge("MsgRoute.Pending")),
+  m_pSlicesMetric(Metrics::RegisterCounter("MsgRoute.Slices")),
+  m_pLateSlicesMetric(Metrics::RegisterCounter("MsgRoute.SlicesLate")),
+  m_pDeferredSlicesMetric(Metrics::RegisterCounter("MsgRoute.SlicesDeferred")),
+  m_pSliceRequestsMetric(Metrics::RegisterGauge("MsgRoute.SliceRequests")),
+  m_pSliceMaxWaitMetric(Metrics::RegisterGauge("MsgRoute.SliceMaxWaitFrames")),
+  m_pSliceTimeMetric(Metrics::RegisterHistogram("MsgRoute.SliceTime")),
+  m_isDeferring(false),
+  m_pDeferredCallsMetric(Metrics::RegisterCounter("MsgRoute.DeferredCalls"))
 {
+	for( int i=0; i<SLICE_WHEEL_SLOTS; i++ )
+	{
+		m_wheelHead[i] = SLICE_NONE;
+		m_wheelTail[i] = SLICE_NONE;
+	}
 
+	m_wheelTick = (INT64)(GameTime.GetTimeDouble() / SLICE_WHEEL_RESOLUTION) - 1;
 }
 
 /*---------------------------------------------------------------------------*
@@ -56,15 +81,12 @@ MsgRoute::~MsgRoute( void )
 	}
 
 	m_delayedMessages.clear();
+	m_pPendingMessagesMetric->Set( 0 );
 
-	for( SliceContainer::iterator i=m_sliceMessages.begin(); i!=m_sliceMessages.end(); ++i )
-	{
-		SliceRequest * request = *i;
-		delete( request );
-	}
-
-	m_sliceMessages.clear();
-
+	m_slices.clear();
+	m_freeSlices.clear();
+	m_sliceIndex.clear();
+	m_pSliceRequestsMetric->Set( 0 );
 }
 
 
@@ -94,6 +116,11 @@ void MsgRoute::SendMsg( float delay, MSG_Name name,
                         StateMachineQueue queue, MSG_Data data, 
 						bool timer, bool cc )
 {
+	if( m_isDeferring )
+	{
+		Defer( DeferredCall::DEFERRED_SEND, sender, delay, MSG_Object( 0.0f, name, sender, receiver, rule, scope, queue, data, timer, cc ) );
+		return;
+	}
 
 	if( delay <= 0.0f )
 	{	//Deliver immediately
@@ -154,6 +181,7 @@ void MsgRoute::SendMsg( float delay, MSG_Name name,
 		{
 			m_delayedMessages.insert( insertPosition, msg );
 		}
+		m_pPendingMessagesMetric->Add( 1 );
 	}
 }
 
@@ -197,6 +225,12 @@ bool MsgRoute::VerifyDelayedMessageOrder( void )
  *---------------------------------------------------------------------------*/
 void MsgRoute::SendMsgBroadcast( MSG_Object & msg, GO_TYPE type )
 {
+	if( m_isDeferring )
+	{
+		Defer( DeferredCall::DEFERRED_BROADCAST, msg.GetSender(), 0.0f, msg, type );
+		return;
+	}
+
 	GameObjectList list;
 	GOMan.GetList( type, &list );
 
@@ -214,52 +248,185 @@ void MsgRoute::SendMsgBroadcast( MSG_Object & msg, GO_TYPE type )
 }
 
 /*---------------------------------------------------------------------------*
-  Name:         RegisterOnSliceEventInternal
+  Name:         RegisterOnSliceEvent
 
   Description:  Register the periodic load balanced OnSlice event.
 
-  Arguments:    request  : the slice request (already set up internally)
+  Arguments:    delay : the number of seconds between slices
+                id    : the object id of the state machine
 
   Returns:      None.
  *---------------------------------------------------------------------------*/
-void MsgRoute::RegisterOnSliceEventInternal(SliceRequest & request)
+void MsgRoute::RegisterOnSliceEvent( float delay, OBJECT_ID id )
 {
-	SliceContainer::iterator insertPosition = m_sliceMessages.end();
-
-	float lastDeliveryTime = 0.0f;
+	UINT32 index;
 
-	for( SliceContainer::iterator i=m_sliceMessages.begin(); i!=m_sliceMessages.end(); ++i )
-	{		
-		//Sanity check that list is in order
-		if( (*i)->GetDeliveryTime() < lastDeliveryTime )
-		{
-			ASSERTMSG( 0, "MsgRoute::RegisterOnSliceEventInternal - List not in order" );
-		}
-		lastDeliveryTime = (*i)->GetDeliveryTime();
+	if( m_isDeferring )
+	{
+		Defer( DeferredCall::DEFERRED_REGISTER_SLICE, id, delay, MSG_Object( 0.0f, MSG_NULL, id, id, SCOPE_TO_STATE_MACHINE, 0, 0, MSG_Data(), false, false ) );
+		return;
+	}
 
-		if( (*i)->GetDeliveryTime() > request.GetDeliveryTime() )
-		{
-			insertPosition = i;
-			break;
-		}
+	if( !m_freeSlices.empty() )
+	{
+		index = m_freeSlices.back();
+		m_freeSlices.pop_back();
+	}
+	else
+	{
+		index = (UINT32)m_slices.size();
+		m_slices.push_back( SliceRequest() );
 	}
 
-	if( m_sliceMessages.empty() || request.GetDeliveryTime() <= m_sliceMessages.front()->GetDeliveryTime() )
+	SliceRequest & request = m_slices[index];
+	request.m_delay = delay;
+	request.m_deliveryTime = delay + GameTime.GetTimeDouble();
+	request.m_id = id;
+	request.m_next = SLICE_NONE;
+	request.m_readyFrame = 0;
+	request.m_isActive = true;
+	request.m_isReady = false;
+
+	ScheduleSlice( index );
+	m_sliceIndex.insert( SliceIndex::value_type( id, index ) );
+
+	m_numSliceRequests++;
+	m_pSliceRequestsMetric->Set( m_numSliceRequests );
+}
+
+/*---------------------------------------------------------------------------*
+  Name:         ScheduleSlice
+
+  Description:  Puts a request in the wheel slot for its delivery time.
+                Time complexity O(1).
+
+  Arguments:    index : the request
+
+  Returns:      None.
+ *---------------------------------------------------------------------------*/
+void MsgRoute::ScheduleSlice( UINT32 index )
+{
+	SliceRequest & request = m_slices[index];
+	UINT32 slot = (UINT32)((INT64)(request.m_deliveryTime / SLICE_WHEEL_RESOLUTION) % SLICE_WHEEL_SLOTS);
+
+	request.m_next = SLICE_NONE;
+
+	if( m_wheelTail[slot] == SLICE_NONE )
 	{
-		m_sliceMessages.push_front( &request );
+		m_wheelHead[slot] = index;
 	}
 	else
 	{
-		m_sliceMessages.insert( insertPosition, &request );
+		m_slices[ m_wheelTail[slot] ].m_next = index;
+	}
+	m_wheelTail[slot] = index;
+}
+
+/*---------------------------------------------------------------------------*
+  Name:         SweepSlot
+
+  Description:  Moves every request in a wheel slot that is due by the given
+                time to the back of the ready queue, and frees unregistered
+				ones.  Requests due on a later turn of the wheel stay.
+
+  Arguments:    slot : the wheel slot
+                time : the current game time
+
+  Returns:      None.
+ *---------------------------------------------------------------------------*/
+void MsgRoute::SweepSlot( UINT32 slot, double time )
+{
+	UINT32 previous = SLICE_NONE;
+	UINT32 index = m_wheelHead[slot];
+
+	while( index != SLICE_NONE )
+	{
+		SliceRequest & request = m_slices[index];
+		UINT32 next = request.m_next;
+
+		if( request.m_isActive && request.m_deliveryTime > time )
+		{	//Not yet
+			previous = index;
+			index = next;
+			continue;
+		}
+
+		//Unlink
+		if( previous == SLICE_NONE )
+		{
+			m_wheelHead[slot] = next;
+		}
+		else
+		{
+			m_slices[previous].m_next = next;
+		}
+		if( m_wheelTail[slot] == index )
+		{
+			m_wheelTail[slot] = previous;
+		}
+
+		if( !request.m_isActive )
+		{
+			FreeSlice( index );
+		}
+		else
+		{	//Append to the ready queue
+			request.m_next = SLICE_NONE;
+			request.m_readyFrame = m_sliceFrame;
+			request.m_isReady = true;
+
+			if( m_readyTail == SLICE_NONE )
+			{
+				m_readyHead = index;
+			}
+			else
+			{
+				m_slices[m_readyTail].m_next = index;
+			}
+			m_readyTail = index;
+			m_numReady++;
+		}
+
+		index = next;
 	}
 }
 
+/*---------------------------------------------------------------------------*
+  Name:         FreeSlice
+
+  Description:  Returns a request, no longer in the wheel or the ready queue,
+                to the free list.
+
+  Arguments:    index : the request
+
+  Returns:      None.
+ *---------------------------------------------------------------------------*/
+void MsgRoute::FreeSlice( UINT32 index )
+{
+	m_slices[index].m_isActive = false;
+	m_slices[index].m_isReady = false;
+	m_freeSlices.push_back( index );
+}
+
 void MsgRoute::DumpSliceQueue( void )
 {
 	DEBUGMSG(ZONE_MESSAGE, "DumpSliceQueue\n" );
-	for( SliceContainer::iterator i=m_sliceMessages.begin(); i!=m_sliceMessages.end(); ++i )
-	{		
-		DEBUGMSG(ZONE_INFO, "Slice(id:%d, delivery:%f)\n", (*i)->GetID(), (*i)->GetDeliveryTime() );
+	for( UINT32 i = m_readyHead; i != SLICE_NONE; i = m_slices[i].m_next )
+	{
+		if( m_slices[i].m_isActive )
+		{
+			DEBUGMSG(ZONE_INFO, "Slice(id:%d, delivery:%f, ready)\n", m_slices[i].m_id, m_slices[i].m_deliveryTime );
+		}
+	}
+	for( int slot=0; slot<SLICE_WHEEL_SLOTS; slot++ )
+	{
+		for( UINT32 i = m_wheelHead[slot]; i != SLICE_NONE; i = m_slices[i].m_next )
+		{
+			if( m_slices[i].m_isActive )
+			{
+				DEBUGMSG(ZONE_INFO, "Slice(id:%d, delivery:%f, slot:%d)\n", m_slices[i].m_id, m_slices[i].m_deliveryTime, slot );
+			}
+		}
 	}
 	DEBUGMSG(ZONE_MESSAGE, "\n" );
 }
@@ -267,7 +434,8 @@ void MsgRoute::DumpSliceQueue( void )
 /*---------------------------------------------------------------------------*
   Name:         UnregisterOnSliceEvent
 
-  Description:  Unregister the periodic load balanced OnSlice event.
+  Description:  Unregister the periodic load balanced OnSlice event.  The
+                request is freed when the wheel or ready queue next reaches it.
 
   Arguments:    id  : the object id of the state machine
 
@@ -275,22 +443,36 @@ void MsgRoute::DumpSliceQueue( void )
  *---------------------------------------------------------------------------*/
 void MsgRoute::UnregisterOnSliceEvent( OBJECT_ID id )
 {
-	for( SliceContainer::iterator i = m_sliceMessages.begin(); i != m_sliceMessages.end(); ++i )
-	{		
-		if( id == (*i)->GetID() )
-		{
-			SliceRequest * request = *i;
-			delete( request );
-			m_sliceMessages.erase( i );
-			return;
-		}
+	if( m_isDeferring )
+	{
+		Defer( DeferredCall::DEFERRED_UNREGISTER_SLICE, id, 0.0f, MSG_Object( 0.0f, MSG_NULL, id, id, SCOPE_TO_STATE_MACHINE, 0, 0, MSG_Data(), false, false ) );
+		return;
+	}
+
+	SliceIndex::iterator i = m_sliceIndex.find( id );
+	if( i == m_sliceIndex.end() )
+	{
+		return;
+	}
+
+	SliceRequest & request = m_slices[ i->second ];
+	m_sliceIndex.erase( i );
+
+	request.m_isActive = false;
+	if( request.m_isReady )
+	{
+		m_numReady--;
 	}
+
+	m_numSliceRequests--;
+	m_pSliceRequestsMetric->Set( m_numSliceRequests );
 }
 
 /*---------------------------------------------------------------------------*
   Name:         DeliverSlices
 
-  Description:  Sends slices if the time is right.
+  Description:  Sends slices if the time is right, oldest first, until the
+                slice policy's budget for this frame is spent.
 
   Arguments:    None.
 
@@ -299,35 +481,74 @@ void MsgRoute::UnregisterOnSliceEvent( OBJECT_ID id )
 void MsgRoute::DeliverSlices( void )
 {
 	int sent = 0;
-	int total = (int)m_sliceMessages.size();
-    double timeStart = GameTime.GetTimeDouble();
-    
-	SliceContainer::iterator i = m_sliceMessages.begin();
-	while( i != m_sliceMessages.end() )
+	int total = (int)m_numSliceRequests;
+	UINT32 maxWait = 0;
+	UINT64 startTicks = Profiler::GetTicks();
+	double time = GameTime.GetTimeDouble();
+	INT64 tick = (INT64)(time / SLICE_WHEEL_RESOLUTION);
+
+	m_sliceFrame++;
+
+	//Sweep the slots time has passed over since last frame (each slot once, at most),
+	//and the current one, which is swept again next frame.
+	INT64 first = MAX( m_wheelTick + 1, tick - SLICE_WHEEL_SLOTS + 1 );
+	for( INT64 t = first; t <= tick; t++ )
+	{
+		SweepSlot( (UINT32)(t % SLICE_WHEEL_SLOTS), time );
+	}
+	m_wheelTick = tick - 1;
+
+	while( m_readyHead != SLICE_NONE )
 	{
 		ASSERTMSG( m_slicePolicy != SLICE_POLICY_NONE, "MsgRoute::DeliverSlices - Slice policy not set" );
 
-		if( (*i)->GetDeliveryTime() <= GameTime.GetTimeDouble() )
-		{	//Deliver and reschedule
-			sent++;
-			SliceRequest * request = *i;
-			RouteSlice( *request );
-			i = m_sliceMessages.erase( i );
-			request->ResetDeliveryTime();
-			RegisterOnSliceEventInternal( *request );
+		UINT32 index = m_readyHead;
+		m_readyHead = m_slices[index].m_next;
+		if( m_readyHead == SLICE_NONE )
+		{
+			m_readyTail = SLICE_NONE;
+		}
+
+		if( !m_slices[index].m_isActive )
+		{	//Unregistered while waiting
+			FreeSlice( index );
+			continue;
+		}
+
+		m_slices[index].m_isReady = false;
+		m_numReady--;
+
+		UINT32 wait = m_sliceFrame - m_slices[index].m_readyFrame;
+		if( wait > 0 )
+		{
+			m_numLateSlices++;
+			m_pLateSlicesMetric->Increment();
+		}
+		maxWait = MAX( maxWait, wait );
+
+		//Deliver and reschedule.  The receiver may register or unregister slices,
+		//so don't hold on to the request across the call.
+		sent++;
+		RouteSlice( m_slices[index].m_id );
+
+		SliceRequest & request = m_slices[index];
+		if( request.m_isActive )
+		{
+			request.m_deliveryTime = request.m_delay + GameTime.GetTimeDouble();
+			ScheduleSlice( index );
 		}
 		else
-		{	//All messages beyond this one are not ready to fire, since the list is sorted
-			return;
+		{
+			FreeSlice( index );
 		}
 
 		//Decide whether to stop sending for this frame
 		if( m_slicePolicy == SLICE_POLICY_CONSTRAIN_BY_TIME )
 		{
-			double curtime = GameTime.GetTimeDouble();
-			if( curtime - timeStart > m_sliceConstraint )
+			double elapsed = Profiler::TicksToMicroseconds( Profiler::GetTicks() - startTicks ) / 1000000.0;
+			if( elapsed > m_sliceConstraint )
 			{
-				return;
+				break;
 			}
 		}
 		else if( m_slicePolicy == SLICE_POLICY_CONSTRAIN_BY_PROPORTION )
@@ -335,17 +556,24 @@ void MsgRoute::DeliverSlices( void )
 			float proportionSent = (float)sent / (float) total;
 			if( proportionSent >= m_sliceConstraint )
 			{
-				return;
+				break;
 			}
 		}
 		else if( m_slicePolicy == SLICE_POLICY_CONSTRAIN_BY_COUNT )
 		{
 			if( sent >= m_sliceConstraint )
 			{
-				return;
+				break;
 			}
 		}
 	}
+
+	//Whatever is still ready goes first next frame
+	m_numDeferredSlices += m_numReady;
+	m_pDeferredSlicesMetric->Add( m_numReady );
+	m_pSlicesMetric->Add( sent );
+	m_pSliceMaxWaitMetric->Set( maxWait );
+	m_pSliceTimeMetric->Record( Profiler::TicksToMicroseconds( Profiler::GetTicks() - startTicks ) / 1000.0 );
 }
 
 /*---------------------------------------------------------------------------*
@@ -353,14 +581,14 @@ void MsgRoute::DeliverSlices( void )
 
   Description:  Routes the slice to the receiver.
 
-  Arguments:    request : the slice request to route
+  Arguments:    id : the object that requested the slice
 
   Returns:      None.
  *---------------------------------------------------------------------------*/
-void MsgRoute::RouteSlice( SliceRequest & request )
+void MsgRoute::RouteSlice( OBJECT_ID id )
 {
     GameObject* pGameObject = NULL;
-    GOMan.GetGameObjectPointer( request.GetID(), &pGameObject );
+    GOMan.GetGameObjectPointer( id, &pGameObject );
     
 	if( pGameObject != 0 && pGameObject->GetStateMachineManager() )
 	{
@@ -388,6 +616,7 @@ void MsgRoute::DeliverDelayedMessages( void )
 			RouteMsg( *msg );
 			delete( msg );
 			i = m_delayedMessages.erase( i );
+			m_pPendingMessagesMetric->Add( -1 );
 		}
 		else
 		{	//All messages beyond this one are not ready to fire, since the list is sorted
@@ -457,6 +686,12 @@ void MsgRoute::RouteMsg( MSG_Object & msg )
  *---------------------------------------------------------------------------*/
 void MsgRoute::RemoveMsg( MSG_Name name, OBJECT_ID receiver, OBJECT_ID sender, bool timer )
 {
+	if( m_isDeferring )
+	{
+		Defer( DeferredCall::DEFERRED_REMOVE, sender, 0.0f, MSG_Object( 0.0f, name, sender, receiver, SCOPE_TO_STATE_MACHINE, 0, 0, MSG_Data(), timer, false ) );
+		return;
+	}
+
 	MessageContainer::iterator i = m_delayedMessages.begin();
 	while( i != m_delayedMessages.end() )
 	{
@@ -469,6 +704,7 @@ void MsgRoute::RemoveMsg( MSG_Name name, OBJECT_ID receiver, OBJECT_ID sender, b
 		{
 			delete( msg );
 			i = m_delayedMessages.erase( i );
+			m_pPendingMessagesMetric->Add( -1 );
 		}
 		else
 		{
@@ -491,6 +727,12 @@ void MsgRoute::RemoveMsg( MSG_Name name, OBJECT_ID receiver, OBJECT_ID sender, b
  *---------------------------------------------------------------------------*/
 void MsgRoute::PurgeScopedMsg( OBJECT_ID receiver )
 {
+	if( m_isDeferring )
+	{
+		Defer( DeferredCall::DEFERRED_PURGE, receiver, 0.0f, MSG_Object( 0.0f, MSG_NULL, receiver, receiver, SCOPE_TO_STATE_MACHINE, 0, 0, MSG_Data(), false, false ) );
+		return;
+	}
+
 	MessageContainer::iterator i = m_delayedMessages.begin();
 	while( i != m_delayedMessages.end() )
 	{
@@ -501,6 +743,7 @@ void MsgRoute::PurgeScopedMsg( OBJECT_ID receiver )
 		{
 			delete( msg );
 			i = m_delayedMessages.erase( i );
+			m_pPendingMessagesMetric->Add( -1 );
 		}
 		else
 		{
@@ -510,5 +753,157 @@ void MsgRoute::PurgeScopedMsg( OBJECT_ID receiver )
 }
 
 
+/*---------------------------------------------------------------------------*
+  Name:         GetDelayedMsgs
+
+  Description:  Copies the delayed messages still waiting for a receiver, 
+                soonest first. Delivery times are absolute (GameTime).
+
+  Arguments:    receiver : the receiver ID of the messages
+                pMsgs    : where to copy them
+				maxMsgs  : room in pMsgs
+
+  Returns:      The number copied.
+ *---------------------------------------------------------------------------*/
+UINT32 MsgRoute::GetDelayedMsgs( OBJECT_ID receiver, OUT MSG_Object * pMsgs, UINT32 maxMsgs )
+{
+	UINT32 numMsgs = 0;
+
+	MessageContainer::iterator i = m_delayedMessages.begin();
+	while( i != m_delayedMessages.end() && numMsgs < maxMsgs )
+	{
+		MSG_Object * msg = *i;
+		if( msg->GetReceiver() == receiver &&
+			!msg->IsDelivered() )
+		{
+			pMsgs[ numMsgs++ ] = *msg;
+		}
+		++i;
+	}
+
+	return( numMsgs );
+}
+
+
+/*---------------------------------------------------------------------------*
+  Name:         BeginDeferring
+
+  Description:  From now until DeliverDeferred(), calls that route messages,
+                remove them, or (un)register slices are recorded in the
+				calling thread's outbox rather than carried out. Lets
+				GameObjects be updated on several threads at once.
+
+  Arguments:    None.
+
+  Returns:      None.
+ *---------------------------------------------------------------------------*/
+void MsgRoute::BeginDeferring( void )
+{
+	ASSERTMSG( !m_isDeferring, "MsgRoute::BeginDeferring - already deferring" );
+
+	m_isDeferring = true;
+}
+
+/*---------------------------------------------------------------------------*
+  Name:         DeliverDeferred
+
+  Description:  Stops deferring, merges the outboxes by the ID of the object
+                that made each call, and carries the calls out in that
+				order. Each object's calls stay in the order it made them,
+				so the result doesn't depend on how the objects were split
+				between threads. Call only once every thread is done.
+
+  Arguments:    None.
+
+  Returns:      None.
+ *---------------------------------------------------------------------------*/
+void MsgRoute::DeliverDeferred( void )
+{
+	PROFILE_SCOPE( "MsgRoute::DeliverDeferred" );
+
+	m_isDeferring = false;
+
+	m_deferred.clear();
+	for( int thread=0; thread<JOB_MAX_WORKERS + 1; ++thread )
+	{
+		m_deferred.insert( m_deferred.end(), m_outboxes[thread].begin(), m_outboxes[thread].end() );
+		m_outboxes[thread].clear();
+	}
+
+	std::stable_sort( m_deferred.begin(), m_deferred.end(), DeferredCallLess );
+	m_pDeferredCallsMetric->Add( m_deferred.size() );
+
+	for( DeferredContainer::iterator i=m_deferred.begin(); i!=m_deferred.end(); ++i )
+	{
+		MSG_Object & msg = i->m_msg;
+
+		switch( i->m_kind )
+		{
+			case DeferredCall::DEFERRED_SEND:
+				SendMsg( i->m_delay, msg.GetName(), msg.GetReceiver(), msg.GetSender(), msg.GetScopeRule(), msg.GetScope(),
+				         (StateMachineQueue)msg.GetQueue(), msg.GetMsgData(), msg.IsTimer(), msg.IsCC() );
+				break;
+
+			case DeferredCall::DEFERRED_BROADCAST:
+				SendMsgBroadcast( msg, i->m_type );
+				break;
+
+			case DeferredCall::DEFERRED_REMOVE:
+				RemoveMsg( msg.GetName(), msg.GetReceiver(), msg.GetSender(), msg.IsTimer() );
+				break;
+
+			case DeferredCall::DEFERRED_PURGE:
+				PurgeScopedMsg( msg.GetReceiver() );
+				break;
+
+			case DeferredCall::DEFERRED_REGISTER_SLICE:
+				RegisterOnSliceEvent( i->m_delay, msg.GetReceiver() );
+				break;
+
+			case DeferredCall::DEFERRED_UNREGISTER_SLICE:
+				UnregisterOnSliceEvent( msg.GetReceiver() );
+				break;
+		}
+	}
+
+	m_deferred.clear();
+}
+
+/*---------------------------------------------------------------------------*
+  Name:         Defer
+
+  Description:  Records a call in the calling thread's outbox.
+
+  Arguments:    kind  : the call
+                key   : the object that made it, to merge by
+				delay : the delay, for sends and slices
+				msg   : the call's other arguments
+				type  : the object type, for broadcasts
+
+  Returns:      None.
+ *---------------------------------------------------------------------------*/
+void MsgRoute::Defer( DeferredCall::Kind kind, OBJECT_ID key, float delay, IN const MSG_Object & msg, GO_TYPE type )
+{
+	DeferredCall call;
+	call.m_kind = kind;
+	call.m_key = key;
+	call.m_delay = delay;
+	call.m_msg = msg;
+	call.m_type = type;
+
+	m_outboxes[ JobSystem::GetThreadIndex() ].push_back( call );
+}
+
+/*---------------------------------------------------------------------------*
+  Name:         DeferredCallLess
+
+  Description:  Orders deferred calls by the object that made them.
+ *---------------------------------------------------------------------------*/
+bool MsgRoute::DeferredCallLess( IN const DeferredCall & a, IN const DeferredCall & b )
+{
+	return( a.m_key < b.m_key );
+}
+
+
 
 } // END namespace Z
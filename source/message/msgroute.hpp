@@ -14,7 +14,11 @@
 #include "Time.hpp"
 #include "GameObject.hpp"
 #include "StateMachine.hpp"
+#include "Metrics.hpp"
+#include "JobSystem.hpp"
 #include <list>
+#include <vector>
+#include <map>
 
 
 namespace Z
@@ -33,26 +37,57 @@ enum SlicePolicy
 	SLICE_POLICY_CONSTRAIN_BY_COUNT				//All slices for this frame must not exceed X slice requests
 };
 
-class SliceRequest
+//Slice requests are kept in a timing wheel: SLICE_WHEEL_SLOTS buckets, each
+//SLICE_WHEEL_RESOLUTION seconds wide, hashed by delivery time.  Scheduling a slice
+//is O(1), and each frame only sweeps the buckets that time has passed over.
+//
+//Due slices move to a FIFO ready queue, which is served from the front until the
+//slice policy's budget for the frame is spent.  Whatever is left is deferred, and
+//served next frame ahead of anything that becomes due later; so with N slices ready
+//and B served per frame, none waits more than N/B frames.  A slice served in a later
+//frame than it became due in counts as late.
+#define SLICE_WHEEL_SLOTS		256
+#define SLICE_WHEEL_RESOLUTION	0.01		//Seconds per wheel slot
+#define SLICE_NONE				0xFFFFFFFF
+
+struct SliceRequest
 {
-public:
-
-	SliceRequest( float delay, OBJECT_ID id )		{ m_delay = delay; m_deliveryTime = delay + GameTime.GetTimeDouble(); m_id = id; }
-	~SliceRequest( void ) {}
-
-	float GetDeliveryTime( void )		{ return( m_deliveryTime ); }
-	void ResetDeliveryTime( void )		{ m_deliveryTime = m_delay + GameTime.GetTimeDouble(); }
-	OBJECT_ID GetID( void )				{ return( m_id ); }
-
-protected:
-
 	float m_delay;				//Delay between slices
-	float m_deliveryTime;		//Delivery time (requested, since it might be slightly postponed)
+	double m_deliveryTime;		//Delivery time (requested, since it might be slightly postponed)
 	OBJECT_ID m_id;				//Object that requested slice
+	UINT32 m_next;				//Next request in the same wheel slot, or in the ready queue
+	UINT32 m_readyFrame;		//The DeliverSlices() call in which it became due
+	bool m_isActive;			//Cleared by UnregisterOnSliceEvent(); freed when next reached
+	bool m_isReady;				//In the ready queue
+};
+
+//While deferring (GameObjectManager's parallel update), each call that would route
+//a message or change MsgRoute's lists is recorded in the calling thread's outbox
+//instead.  DeliverDeferred() merges the outboxes by sender, keeping each sender's
+//calls in the order it made them, and replays them; so the result is the same
+//whichever thread updated which GameObject.
+struct DeferredCall
+{
+	enum Kind {
+		DEFERRED_SEND,
+		DEFERRED_BROADCAST,
+		DEFERRED_REMOVE,
+		DEFERRED_PURGE,
+		DEFERRED_REGISTER_SLICE,
+		DEFERRED_UNREGISTER_SLICE
+	};
+
+	Kind m_kind;
+	OBJECT_ID m_key;			//Merge order: the object that made the call
+	float m_delay;
+	MSG_Object m_msg;			//The call's other arguments
+	GO_TYPE m_type;				//For broadcasts
 };
 
 typedef std::list<MSG_Object*> MessageContainer;
-typedef std::list<SliceRequest*> SliceContainer;
+typedef std::vector<DeferredCall> DeferredContainer;
+typedef std::vector<SliceRequest> SliceContainer;
+typedef std::multimap<OBJECT_ID, UINT32> SliceIndex;
 
 
 
@@ -84,13 +119,28 @@ public:
 
 	//Slice management
 	inline void SetSlicePolicy( SlicePolicy policy, float constraint )		{ m_slicePolicy = policy; m_sliceConstraint = constraint; }
-	inline void RegisterOnSliceEvent(float delay, OBJECT_ID id)				{ RegisterOnSliceEventInternal( *new SliceRequest( delay, id ) ); }
+	inline SlicePolicy GetSlicePolicy( void )								{ return( m_slicePolicy ); }
+	inline float GetSliceConstraint( void )									{ return( m_sliceConstraint ); }
+	void RegisterOnSliceEvent( float delay, OBJECT_ID id );
 	void UnregisterOnSliceEvent( OBJECT_ID id );
+
+	//Slice statistics, since startup
+	inline UINT32 GetNumSliceRequests( void )								{ return( m_numSliceRequests ); }
+	inline UINT64 GetNumLateSlices( void )									{ return( m_numLateSlices ); }
+	inline UINT64 GetNumDeferredSlices( void )								{ return( m_numDeferredSlices ); }
 	
 	//Removing delayed messages
 	void RemoveMsg( MSG_Name name, OBJECT_ID receiver, OBJECT_ID sender, bool timer );
 	void PurgeScopedMsg( OBJECT_ID receiver );
 
+	//Copies of the undelivered delayed messages to a receiver, in delivery order (e.g. to save them)
+	UINT32 GetDelayedMsgs( OBJECT_ID receiver, OUT MSG_Object * pMsgs, UINT32 maxMsgs );
+
+	//Deferred calls; see DeferredCall
+	void BeginDeferring( void );
+	void DeliverDeferred( void );
+	inline bool IsDeferring( void )											{ return( m_isDeferring ); }
+
 	//For testing (unit tests)
 	bool VerifyDelayedMessageOrder( void );
 	void DumpSliceQueue( void );
@@ -104,16 +154,46 @@ protected:
 private:
 
 	MessageContainer m_delayedMessages;
-	SliceContainer m_sliceMessages;
+
+	SliceContainer m_slices;						//Every request; the wheel and ready queue link them by index
+	std::vector<UINT32> m_freeSlices;
+	SliceIndex m_sliceIndex;						//Active requests by object
+	UINT32 m_wheelHead[ SLICE_WHEEL_SLOTS ];
+	UINT32 m_wheelTail[ SLICE_WHEEL_SLOTS ];
+	INT64 m_wheelTick;								//Slots for ticks up to this one have been swept
+	UINT32 m_readyHead;
+	UINT32 m_readyTail;
+	UINT32 m_numReady;
+	UINT32 m_sliceFrame;
+	UINT32 m_numSliceRequests;
+	UINT64 m_numLateSlices;
+	UINT64 m_numDeferredSlices;
 
 	SlicePolicy m_slicePolicy;
 	float m_sliceConstraint;
 
+	MetricGauge* m_pPendingMessagesMetric;
+	MetricCounter* m_pSlicesMetric;
+	MetricCounter* m_pLateSlicesMetric;
+	MetricCounter* m_pDeferredSlicesMetric;
+	MetricGauge* m_pSliceRequestsMetric;
+	MetricGauge* m_pSliceMaxWaitMetric;
+	MetricHistogram* m_pSliceTimeMetric;
+
+	volatile bool m_isDeferring;
+	DeferredContainer m_outboxes[ JOB_MAX_WORKERS + 1 ];	//By JobSystem thread index
+	DeferredContainer m_deferred;							//Merged
+	MetricCounter* m_pDeferredCallsMetric;
+
 
 	void RouteMsg( MSG_Object & msg );
 	
-	void RouteSlice( SliceRequest & request );
-	void RegisterOnSliceEventInternal(SliceRequest & request);
+	void RouteSlice( OBJECT_ID id );
+	void ScheduleSlice( UINT32 index );
+	void SweepSlot( UINT32 slot, double time );
+	void FreeSlice( UINT32 index );
+	void Defer( DeferredCall::Kind kind, OBJECT_ID key, float delay, IN const MSG_Object & msg, GO_TYPE type = GO_TYPE_ANY );
+	static bool DeferredCallLess( IN const DeferredCall & a, IN const DeferredCall & b );
 
 };
 
@@ -59,6 +59,11 @@ public:
     static  bool        IsWidescreen                ( );
     
     static  void        LogAnalyticsEvent           ( IN const string& event  /* TODO: dictionary of attributes */ );
+
+    // Ask for time to finish work if the app is sent to the background meanwhile.
+    // Any thread; 0 if none was granted.  End every task begun.
+    static  UINT32      BeginBackgroundTask         ( );
+    static  void        EndBackgroundTask           ( IN UINT32 taskID );
     
 protected:
     //
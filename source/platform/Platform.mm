@@ -679,6 +679,35 @@ Platform::LogAnalyticsEvent( IN const string& event /* TODO: dictionary of attri
 
 
 
+UINT32
+Platform::BeginBackgroundTask()
+{
+    __block UIBackgroundTaskIdentifier taskID = UIBackgroundTaskInvalid;
+
+    taskID = [[UIApplication sharedApplication] beginBackgroundTaskWithExpirationHandler:^{
+        // Out of time; iOS kills apps that don't end their tasks.
+        RETAILMSG(ZONE_WARN, "WARNING: background task %lu expired", (unsigned long)taskID);
+        [[UIApplication sharedApplication] endBackgroundTask:taskID];
+    }];
+
+    return (UINT32)taskID;
+}
+
+
+
+void
+Platform::EndBackgroundTask( IN UINT32 taskID )
+{
+    if (UIBackgroundTaskInvalid == (UIBackgroundTaskIdentifier)taskID)
+    {
+        return;
+    }
+
+    [[UIApplication sharedApplication] endBackgroundTask:(UIBackgroundTaskIdentifier)taskID];
+}
+
+
+
 bool
 Platform::IsWidescreen()
 {
@@ -192,6 +192,12 @@ typedef MapPositionList::iterator   MapPositionListIterator;
 #endif // __APPLE__
 
 
+// Fails to compile unless expr is true, e.g. to pin the size of a struct
+// that is handed to GL or written to disk.  UINT32 is 8 bytes on arm64; use
+// the <stdint.h> types in such structs.
+#define STATIC_ASSERT(expr, name)   typedef char STATIC_ASSERT_##name[ (expr) ? 1 : -1 ]
+
+
 const int MAX_PATH = 2048;
 const int MAX_NAME = 64;
 
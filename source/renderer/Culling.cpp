@@ -0,0 +1,119 @@
+/*
+ *  Culling.cpp
+ *  Critters
+ *
+ *  Rejects Sprites and ParticleEmitters that can't be seen
+ *  before they reach a SpriteBatch.
+ *
+ */
+
+#include "Culling.hpp"
+#include "Engine.hpp"
+#include "Camera.hpp"
+
+#include <math.h>
+
+
+namespace Z
+{
+
+
+
+//
+// Static Data
+//
+bool            Culling::s_isEnabled        = false;
+volatile int32_t Culling::s_epoch           = 0;
+
+bool            Culling::s_isCollecting     = false;
+bool            Culling::s_hasBounds        = false;
+vec3            Culling::s_boundsMin;
+vec3            Culling::s_boundsMax;
+
+
+
+//
+// Class Methods
+//
+bool
+Culling::IsVisible( const vec3& center, float radius, const mat4& matModelView )
+{
+    vec4  eyeCenter = matModelView * vec4( center.x, center.y, center.z, 1.0f );
+
+    // Scale the radius by the longest axis of the transform, so rotation and
+    // non-uniform scale only ever make the sphere bigger.
+    float scaleX    = matModelView.x.x * matModelView.x.x + matModelView.x.y * matModelView.x.y + matModelView.x.z * matModelView.x.z;
+    float scaleY    = matModelView.y.x * matModelView.y.x + matModelView.y.y * matModelView.y.y + matModelView.y.z * matModelView.y.z;
+    float scaleZ    = matModelView.z.x * matModelView.z.x + matModelView.z.y * matModelView.z.y + matModelView.z.z * matModelView.z.z;
+    float eyeRadius = radius * sqrtf( MAX( scaleX, MAX( scaleY, scaleZ ) ) );
+
+    if (s_isCollecting)
+    {
+        vec3 eyeMin( eyeCenter.x - eyeRadius, eyeCenter.y - eyeRadius, eyeCenter.z - eyeRadius );
+        vec3 eyeMax( eyeCenter.x + eyeRadius, eyeCenter.y + eyeRadius, eyeCenter.z + eyeRadius );
+
+        if (!s_hasBounds)
+        {
+            s_boundsMin = eyeMin;
+            s_boundsMax = eyeMax;
+            s_hasBounds = true;
+        }
+        else
+        {
+            s_boundsMin = vec3( MIN( s_boundsMin.x, eyeMin.x ), MIN( s_boundsMin.y, eyeMin.y ), MIN( s_boundsMin.z, eyeMin.z ) );
+            s_boundsMax = vec3( MAX( s_boundsMax.x, eyeMax.x ), MAX( s_boundsMax.y, eyeMax.y ), MAX( s_boundsMax.z, eyeMax.z ) );
+        }
+    }
+
+    if (!s_isEnabled)
+    {
+        return true;
+    }
+
+    return GameCamera.IsVisible( vec3( eyeCenter.x, eyeCenter.y, eyeCenter.z ), eyeRadius );
+}
+
+
+
+bool
+Culling::IsVisible( const AABB& eyeBounds )
+{
+    if (!s_isEnabled)
+    {
+        return true;
+    }
+
+    float halfWidth  = eyeBounds.GetWidth()  * 0.5f;
+    float halfHeight = eyeBounds.GetHeight() * 0.5f;
+    float halfDepth  = eyeBounds.GetDepth()  * 0.5f;
+
+    return GameCamera.IsVisible( eyeBounds.GetCenter(), sqrtf( halfWidth * halfWidth + halfHeight * halfHeight + halfDepth * halfDepth ) );
+}
+
+
+
+void
+Culling::BeginBounds()
+{
+    s_isCollecting = true;
+    s_hasBounds    = false;
+}
+
+
+
+bool
+Culling::EndBounds( OUT AABB* pBounds )
+{
+    s_isCollecting = false;
+
+    if (s_hasBounds && pBounds)
+    {
+        *pBounds = AABB( s_boundsMin, s_boundsMax );
+    }
+
+    return s_hasBounds;
+}
+
+
+
+} // END namespace Z
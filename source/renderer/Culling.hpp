@@ -0,0 +1,68 @@
+#pragma once
+
+#include "Types.hpp"
+#include "Matrix.hpp"
+
+#include <libkern/OSAtomic.h>
+
+
+namespace Z
+{
+
+
+//
+// Visibility culling, ahead of sprite batching.
+//
+// Sprites and ParticleEmitters test a bounding sphere against GameCamera's view
+// volume before they're batched or drawn; whatever is off-screen is dropped there.
+// The eye-space bounds of every test are also collected, so that a Layer knows the
+// aggregate bounds of its contents after drawing them.
+//
+// A Layer whose contents were entirely off-screen skips them - the whole subtree -
+// on later frames, for as long as nothing could have moved.  Anything that moves,
+// resizes, shows or adds drawable content calls Culling::Invalidate() to end that.
+//
+// Off by default; enable with Settings.bEnableCulling = "1".
+//
+
+class Culling
+{
+public:
+    static  void    Enable          ( bool enabled )        { s_isEnabled = enabled; Invalidate(); }
+    static  bool    IsEnabled       ( )                     { return s_isEnabled; }
+
+    // An atomic increment: cheap enough for inline setters, and safe to call from
+    // any thread, e.g. a GameObject updated on a JobSystem worker.
+    static  void    Invalidate      ( )                     { OSAtomicIncrement32Barrier( &s_epoch ); }
+    static  UINT32  GetEpoch        ( )                     { return (UINT32)s_epoch; }
+
+    // True unless the sphere (center, radius), in model space, is entirely outside
+    // the view volume once transformed by matModelView.
+    static  bool    IsVisible       ( const vec3& center, float radius, const mat4& matModelView );
+
+    // The same test for bounds already in eye space, e.g. from EndBounds().
+    static  bool    IsVisible       ( const AABB& eyeBounds );
+
+    // Collect the eye-space bounds of everything tested by IsVisible() in between.
+    // EndBounds() returns false if nothing was tested.
+    static  void    BeginBounds     ( );
+    static  bool    EndBounds       ( OUT AABB* pBounds );
+
+protected:
+    static  bool            s_isEnabled;
+    static  volatile int32_t s_epoch;
+
+    static  bool            s_isCollecting;
+    static  bool            s_hasBounds;
+    static  vec3            s_boundsMin;
+    static  vec3            s_boundsMax;
+
+private:
+    Culling();
+    Culling( const Culling& rhs );
+    Culling& operator=( const Culling& rhs );
+};
+
+
+
+} // END namespace Z
@@ -2,6 +2,9 @@
 #include "BlurEffect.hpp"
 #include "RenderTarget.hpp"
 #include "Matrix.hpp"
+#include "Profiler.hpp"
+#include "ScratchSurfacePool.hpp"
+#include "Metrics.hpp"
 
 
 namespace Z
@@ -58,6 +61,10 @@ float                   BlurEffect::s_FilterWeights[]               =
 
 const float            BlurEffect::DEFAULT_BLUR_RADIUS        = 20.0;
 const float            BlurEffect::MAX_BLUR_RADIUS            = 20.0;
+const float            BlurEffect::BLUR_RADIUS_STEP           = 0.5;
+
+static MetricCounter*  s_pOffscreenPassesMetric               = Metrics::RegisterCounter( "Effects.OffscreenPasses" );
+static MetricCounter*  s_pBlurCacheHitsMetric                 = Metrics::RegisterCounter( "Effects.BlurCacheHits"   );
 
 
 
@@ -69,11 +76,10 @@ const float            BlurEffect::MAX_BLUR_RADIUS            = 20.0;
 BlurEffect::BlurEffect() :
     m_fPreviousDownsamplingFactor(-99.0),
     m_fDownsamplingFactor(1.0),
-    m_fPreviousBlurRadius(-99.0),
     m_fBlurRadius(DEFAULT_BLUR_RADIUS),
     m_FrameCount(0),
-    m_pPreviousVertexArray(NULL),
     m_pOffScreenFrameBuffer(NULL),
+    m_isCacheValid(false),
     m_cUnpaddedBlurVertices(4),
     m_cPaddedBlurVertices(4),
     m_cBlurredVertices(4),
@@ -107,7 +113,11 @@ BlurEffect::~BlurEffect()
 {
     RETAILMSG(ZONE_OBJECT | ZONE_VERBOSE, "\t~BlurEffect( %4d )", m_ID);
 
-    SAFE_RELEASE(m_pOffScreenFrameBuffer);
+    if (m_pOffScreenFrameBuffer)
+    {
+        IGNOREHR(ScratchSurfacePool::Release( m_pOffScreenFrameBuffer ));
+    }
+    ScratchSurfacePool::Forget( this );
 
     SAFE_ARRAY_DELETE(m_pUnpaddedBlurVertices);
     SAFE_ARRAY_DELETE(m_pPaddedBlurVertices);
@@ -132,7 +142,8 @@ BlurEffect::Clone() const
 
 BlurEffect::BlurEffect( const BlurEffect& rhs ) : 
     OpenGLESEffect(),
-    m_pOffScreenFrameBuffer(NULL)
+    m_pOffScreenFrameBuffer(NULL),
+    m_isCacheValid(false)
 {
     RETAILMSG(ZONE_OBJECT | ZONE_VERBOSE, "BlurEffect( %4d ) (copy ctor)", m_ID);
 
@@ -162,7 +173,6 @@ BlurEffect::operator=( const BlurEffect& rhs )
 
     // SHALLOW COPY:
     m_fBlurRadius                   = rhs.m_fBlurRadius;
-    m_fPreviousBlurRadius           = rhs.m_fPreviousBlurRadius;
     m_fDownsamplingFactor           = rhs.m_fDownsamplingFactor;
     m_fPreviousDownsamplingFactor   = rhs.m_fPreviousDownsamplingFactor;
     m_fBlurEdgePadding              = rhs.m_fBlurEdgePadding;
@@ -171,7 +181,6 @@ BlurEffect::operator=( const BlurEffect& rhs )
     m_fWidth                        = rhs.m_fWidth;
     m_fHeight                       = rhs.m_fHeight;
     m_FrameCount                    = rhs.m_FrameCount;
-    m_pPreviousVertexArray          = rhs.m_pPreviousVertexArray;
     m_cPaddedBlurVertices           = rhs.m_cPaddedBlurVertices;
     m_cUnpaddedBlurVertices         = rhs.m_cUnpaddedBlurVertices;
     m_cBlurredVertices              = rhs.m_cBlurredVertices;
@@ -185,12 +194,9 @@ BlurEffect::operator=( const BlurEffect& rhs )
     memcpy(m_HorizontalFilterOffsets, rhs.m_HorizontalFilterOffsets, sizeof(m_HorizontalFilterOffsets));
     memcpy(m_VerticalFilterOffsets,   rhs.m_VerticalFilterOffsets,   sizeof(m_VerticalFilterOffsets));
 
-    // DEEP COPY: RenderTarget
-    if (rhs.m_pOffScreenFrameBuffer)
-    {
-        SAFE_DELETE(m_pOffScreenFrameBuffer);
-        m_pOffScreenFrameBuffer = RenderTarget::Create( rhs.m_pOffScreenFrameBuffer->GetWidth(), rhs.m_pOffScreenFrameBuffer->GetHeight(), 1, rhs.m_pOffScreenFrameBuffer->GetNumTextures() );
-    }
+    // NOT COPIED: scratch surfaces are only borrowed for the length of a Draw(),
+    // and the cached result lives in rhs's surfaces, not ours.
+    m_isCacheValid                  = false;
 
     // DEEP COPY: vertices
     if (rhs.m_pPaddedBlurVertices)
@@ -247,8 +253,14 @@ BlurEffect::Draw( Vertex *pVertices, UINT32 numVertices, PRIMITIVE_TYPE primitiv
     DEBUGMSG(ZONE_SHADER, "BlurEffect[%d]::DrawTriangleStrip()", m_ID);
 
     RESULT     rval          = S_OK;
+
+    PROFILE_SCOPE("BlurEffect::Draw");
     Rectangle  sourceRect;
     Rectangle  textureRect;
+    Rectangle  scratchRect;
+    BlurCacheKey key;
+    bool       contentsKept  = false;
+    bool       isCacheHit    = false;
     Util::GetBoundingRect( pVertices, numVertices, &sourceRect  );
     Util::GetTextureMapping( pVertices, numVertices, &textureRect );
     
@@ -257,141 +269,152 @@ BlurEffect::Draw( Vertex *pVertices, UINT32 numVertices, PRIMITIVE_TYPE primitiv
     float vStart = textureRect.y;
     float vEnd   = textureRect.y + textureRect.height;
     
+    float blurRadius = QuantizeRadius( m_fBlurRadius );
 
     // Skip the (expensive) blur effect if Radius = 0.0.
-    if (Util::CompareFloats( m_fBlurRadius, 0.0 ))
+    if (Util::CompareFloats( blurRadius, 0.0 ))
     {
         return OpenGLESEffect::Draw( pVertices, numVertices, primitiveType );
     }
 
     //
-    // TODO: cache and re-draw the blurred result if the vertices are identical
-    // to previous draw call.  e.g. texture is same and bounding box is same?
+    // Borrow scratch surfaces from the shared pool.  If they come back untouched
+    // and we're asked to blur exactly what we blurred last time, texture A still
+    // holds the result and we can skip straight to presenting it.
     //
+    key.textureID       = m_sourceTextureID;
+    key.contentVersion  = m_sourceContentVersion;
+    key.textureRect     = textureRect;
+    key.width           = sourceRect.width;
+    key.height          = sourceRect.height;
+    key.radius          = blurRadius;
+    key.color           = (UINT32)m_globalColor;
+
+    CHR(InitScratchSurfaces( sourceRect, blurRadius, uStart, uEnd, vStart, vEnd, &contentsKept ));
+    scratchRect = m_pOffScreenFrameBuffer->GetTextureRect();
+
+    isCacheHit     = contentsKept && m_isCacheValid && IsSameBlur( key, m_cacheKey );
+    m_isCacheValid = false;
 
-    // Recreate offscreen scratch surfaces whenever the blur radius has changed,
-    // or when the vertex array being drawn has changed,
-    // or when the Effect's frame has changed.
-    if ( m_frameChanged ||
-         (m_pPreviousVertexArray != pVertices) ||
-         (fabs(m_fPreviousBlurRadius - m_fBlurRadius) > 1.0f) )
+    if (isCacheHit)
     {
-        CHR(InitScratchSurfaces( sourceRect, m_fBlurRadius, uStart, uEnd, vStart, vEnd ));
-        CHR(InitBlurFilter( m_fBlurRadius ));
-        m_fPreviousBlurRadius = m_fBlurRadius;
-        
-        m_frameChanged = false;
+        s_pBlurCacheHitsMetric->Increment();
     }
-    m_pPreviousVertexArray = pVertices;
-
+    else
+    {
+        CHR(InitBlurFilter( blurRadius ));
 
-    // Save the original window viewport.
-    GLint oldViewport[4];
-    VERIFYGL(glGetIntegerv(GL_VIEWPORT, oldViewport));
+        // Save the original window viewport.
+        GLint oldViewport[4];
+        VERIFYGL(glGetIntegerv(GL_VIEWPORT, oldViewport));
 
-    // Begin rendering to the off-screen texture.
-    CHR(m_pOffScreenFrameBuffer->Enable());
-    VERIFYGL(glViewport(0, 0, m_pOffScreenFrameBuffer->GetWidth(), m_pOffScreenFrameBuffer->GetHeight()));
+        // Begin rendering to the off-screen texture.
+        CHR(m_pOffScreenFrameBuffer->Enable());
+        VERIFYGL(glViewport(0, 0, m_pOffScreenFrameBuffer->GetWidth(), m_pOffScreenFrameBuffer->GetHeight()));
 
 
 #ifdef SOFT_EDGES    
-    //
-    // PASS 1: render original image into texture A (adding a border).
-    //
-    {
-        CHR(m_pOffScreenFrameBuffer->SetRenderTexture( m_TextureA ));
-
-        // Assign values to shader parameters.
-        VERIFYGL(glUseProgram(s_defaultShaderProgram));
-        VERIFYGL(glUniformMatrix4fv(s_uDefaultProjectionMatrix, 1, GL_FALSE, (GLfloat*)m_projectionMatrixOffscreen.Pointer()));
-        VERIFYGL(glUniformMatrix4fv(s_uDefaultModelViewMatrix,  1, GL_FALSE, (GLfloat*)m_modelViewMatrixOffscreen.Pointer()));
-        VERIFYGL(glUniform1i(s_uDefaultTexture, 0));
-        VERIFYGL(glUniform4f(s_uDefaultGlobalColor, m_globalColor.floats.r, m_globalColor.floats.g, m_globalColor.floats.b, m_globalColor.floats.a));
+        //
+        // PASS 1: render original image into texture A (adding a border).
+        //
+        {
+            CHR(m_pOffScreenFrameBuffer->SetRenderTexture( m_TextureA ));
+            s_pOffscreenPassesMetric->Increment();
+
+            // Assign values to shader parameters.
+            VERIFYGL(glUseProgram(s_defaultShaderProgram));
+            VERIFYGL(glUniformMatrix4fv(s_uDefaultProjectionMatrix, 1, GL_FALSE, (GLfloat*)m_projectionMatrixOffscreen.Pointer()));
+            VERIFYGL(glUniformMatrix4fv(s_uDefaultModelViewMatrix,  1, GL_FALSE, (GLfloat*)m_modelViewMatrixOffscreen.Pointer()));
+            VERIFYGL(glUniform1i(s_uDefaultTexture, 0));
+            VERIFYGL(glUniform4f(s_uDefaultGlobalColor, m_globalColor.floats.r, m_globalColor.floats.g, m_globalColor.floats.b, m_globalColor.floats.a));
+
+            // Set original texture as the source.
+            VERIFYGL(glActiveTexture(GL_TEXTURE0));
+            VERIFYGL(glBindTexture(GL_TEXTURE_2D, m_sourceTextureID));
 
-        // Set original texture as the source.
-        VERIFYGL(glActiveTexture(GL_TEXTURE0));
-        VERIFYGL(glBindTexture(GL_TEXTURE_2D, m_sourceTextureID));
-
-        // Draw to texture A.
-        // This will leave a border around the source image, allowing
-        // for blurred edges in the next passes.
-        VERIFYGL(glVertexAttribPointer(ATTRIBUTE_VERTEX_POSITION,       3, GL_FLOAT,         GL_FALSE, sizeof(Vertex), &m_pUnpaddedBlurVertices->x));
-        VERIFYGL(glVertexAttribPointer(ATTRIBUTE_VERTEX_DIFFUSE,        4, GL_UNSIGNED_BYTE, GL_TRUE,  sizeof(Vertex), &m_pUnpaddedBlurVertices->color));
-        VERIFYGL(glVertexAttribPointer(ATTRIBUTE_VERTEX_TEXTURE_COORD0, 2, GL_FLOAT,         GL_FALSE, sizeof(Vertex), &m_pUnpaddedBlurVertices->texCoord[0]));
-        VERIFYGL(glDrawArrays(GL_TRIANGLE_STRIP, 0, m_cUnpaddedBlurVertices));
-    }
+            // Draw to texture A.
+            // This will leave a border around the source image, allowing
+            // for blurred edges in the next passes.
+            VertexStream::BindVertices( m_pUnpaddedBlurVertices, m_cUnpaddedBlurVertices );
+            VERIFYGL(glDrawArrays(GL_TRIANGLE_STRIP, 0, m_cUnpaddedBlurVertices));
+        }
 #endif
 
 
-    //
-    // PASS 2: render texture A to texture B with horizontal blur.
-    //
-    {
-        CHR(m_pOffScreenFrameBuffer->SetRenderTexture( m_TextureB ));
+        //
+        // PASS 2: render texture A to texture B with horizontal blur.
+        //
+        {
+            CHR(m_pOffScreenFrameBuffer->SetRenderTexture( m_TextureB ));
+            s_pOffscreenPassesMetric->Increment();
 
-        // Assign values to shader parameters.
-        VERIFYGL(glUseProgram(s_BlurShaderProgram));
-        VERIFYGL(glUniformMatrix4fv(s_uProjectionMatrix, 1, GL_FALSE, (GLfloat*)m_projectionMatrixOffscreen.Pointer()));
-        VERIFYGL(glUniformMatrix4fv(s_uModelViewMatrix,  1, GL_FALSE, (GLfloat*)m_modelViewMatrixOffscreen.Pointer()));
-        VERIFYGL(glUniform1i(s_uTexture, 0));
-        VERIFYGL(glUniform4f(s_uGlobalColor, m_globalColor.floats.r, m_globalColor.floats.g, m_globalColor.floats.b, m_globalColor.floats.a));
-        VERIFYGL(glUniform1fv(s_uFilterWeights, MAX_FILTER_WIDTH_HEIGHT, (GLfloat*) &s_FilterWeights));
+            // Assign values to shader parameters.
+            VERIFYGL(glUseProgram(s_BlurShaderProgram));
+            VERIFYGL(glUniformMatrix4fv(s_uProjectionMatrix, 1, GL_FALSE, (GLfloat*)m_projectionMatrixOffscreen.Pointer()));
+            VERIFYGL(glUniformMatrix4fv(s_uModelViewMatrix,  1, GL_FALSE, (GLfloat*)m_modelViewMatrixOffscreen.Pointer()));
+            VERIFYGL(glUniform1i(s_uTexture, 0));
+            VERIFYGL(glUniform4f(s_uGlobalColor, m_globalColor.floats.r, m_globalColor.floats.g, m_globalColor.floats.b, m_globalColor.floats.a));
+            VERIFYGL(glUniform1fv(s_uFilterWeights, MAX_FILTER_WIDTH_HEIGHT, (GLfloat*) &s_FilterWeights));
 
 #ifdef SOFT_EDGES    
-        // Set Texture A as the source.
-        VERIFYGL(glActiveTexture(GL_TEXTURE0));
-        VERIFYGL(glBindTexture(GL_TEXTURE_2D, m_pOffScreenFrameBuffer->GetTextureID(m_TextureA)));
+            // Set Texture A as the source.
+            VERIFYGL(glActiveTexture(GL_TEXTURE0));
+            VERIFYGL(glBindTexture(GL_TEXTURE_2D, m_pOffScreenFrameBuffer->GetTextureID(m_TextureA)));
+            Vertex* pSourceVertices = m_pPaddedBlurVertices;
 #else
-        // Set input texture as the source.
-        VERIFYGL(glActiveTexture(GL_TEXTURE0));
-        VERIFYGL(glBindTexture(GL_TEXTURE_2D, m_sourceTextureID));
+            // Set input texture as the source.
+            // Without padding the unpadded strip covers the whole surface, and carries the source's UVs.
+            VERIFYGL(glActiveTexture(GL_TEXTURE0));
+            VERIFYGL(glBindTexture(GL_TEXTURE_2D, m_sourceTextureID));
+            Vertex* pSourceVertices = m_pUnpaddedBlurVertices;
 #endif
 
-        VERIFYGL(glVertexAttribPointer(ATTRIBUTE_VERTEX_POSITION,       3, GL_FLOAT,         GL_FALSE, sizeof(Vertex), &m_pPaddedBlurVertices->x));
-        VERIFYGL(glVertexAttribPointer(ATTRIBUTE_VERTEX_DIFFUSE,        4, GL_UNSIGNED_BYTE, GL_TRUE,  sizeof(Vertex), &m_pPaddedBlurVertices->color));
-        VERIFYGL(glVertexAttribPointer(ATTRIBUTE_VERTEX_TEXTURE_COORD0, 2, GL_FLOAT,         GL_FALSE, sizeof(Vertex), &m_pPaddedBlurVertices->texCoord[0]));
-
-        // Draw to the texture B with horizontal blur.
-        VERIFYGL(glUniform1f(s_uHorizontalPass, 1));
-        VERIFYGL(glUniform1fv(s_uFilterOffsets, MAX_FILTER_WIDTH_HEIGHT, (GLfloat*) &m_HorizontalFilterOffsets));
-        VERIFYGL(glDrawArrays(GL_TRIANGLE_STRIP, 0, m_cPaddedBlurVertices));
-    }
+            VertexStream::BindVertices( pSourceVertices, m_cPaddedBlurVertices );
 
+            // Draw to the texture B with horizontal blur.
+            VERIFYGL(glUniform1f(s_uHorizontalPass, 1));
+            VERIFYGL(glUniform1fv(s_uFilterOffsets, MAX_FILTER_WIDTH_HEIGHT, (GLfloat*) &m_HorizontalFilterOffsets));
+            VERIFYGL(glDrawArrays(GL_TRIANGLE_STRIP, 0, m_cPaddedBlurVertices));
+        }
 
-    //
-    // PASS 3: render from texture B to texture A with vertical blur.
-    //
-    {
-        CHR(m_pOffScreenFrameBuffer->SetRenderTexture( m_TextureA ));
 
-        // Assign values to shader parameters.
-        VERIFYGL(glUseProgram(s_BlurShaderProgram));
-        VERIFYGL(glUniformMatrix4fv(s_uProjectionMatrix, 1, GL_FALSE, (GLfloat*)m_projectionMatrixOffscreen.Pointer()));
-        VERIFYGL(glUniformMatrix4fv(s_uModelViewMatrix,  1, GL_FALSE, (GLfloat*)m_modelViewMatrixOffscreen.Pointer()));
-        VERIFYGL(glUniform1i(s_uTexture, 0));
-        VERIFYGL(glUniform4f(s_uGlobalColor, m_globalColor.floats.r, m_globalColor.floats.g, m_globalColor.floats.b, m_globalColor.floats.a));
-        VERIFYGL(glUniform1fv(s_uFilterWeights, MAX_FILTER_WIDTH_HEIGHT, (GLfloat*) &s_FilterWeights));
+        //
+        // PASS 3: render from texture B to texture A with vertical blur.
+        //
+        {
+            CHR(m_pOffScreenFrameBuffer->SetRenderTexture( m_TextureA ));
+            s_pOffscreenPassesMetric->Increment();
+
+            // Assign values to shader parameters.
+            VERIFYGL(glUseProgram(s_BlurShaderProgram));
+            VERIFYGL(glUniformMatrix4fv(s_uProjectionMatrix, 1, GL_FALSE, (GLfloat*)m_projectionMatrixOffscreen.Pointer()));
+            VERIFYGL(glUniformMatrix4fv(s_uModelViewMatrix,  1, GL_FALSE, (GLfloat*)m_modelViewMatrixOffscreen.Pointer()));
+            VERIFYGL(glUniform1i(s_uTexture, 0));
+            VERIFYGL(glUniform4f(s_uGlobalColor, m_globalColor.floats.r, m_globalColor.floats.g, m_globalColor.floats.b, m_globalColor.floats.a));
+            VERIFYGL(glUniform1fv(s_uFilterWeights, MAX_FILTER_WIDTH_HEIGHT, (GLfloat*) &s_FilterWeights));
+
+            // Set Texture B as the source.
+            VERIFYGL(glActiveTexture(GL_TEXTURE0));
+            VERIFYGL(glBindTexture(GL_TEXTURE_2D, m_pOffScreenFrameBuffer->GetTextureID(m_TextureB)));
+
+            VertexStream::BindVertices( m_pPaddedBlurVertices, m_cPaddedBlurVertices );
+
+            // Draw to the texture A with vertical blur.
+            VERIFYGL(glUniform1f(s_uHorizontalPass, 0));
+            VERIFYGL(glUniform1fv(s_uFilterOffsets, MAX_FILTER_WIDTH_HEIGHT, (GLfloat*) &m_VerticalFilterOffsets));
+            VERIFYGL(glDrawArrays(GL_TRIANGLE_STRIP, 0, m_cPaddedBlurVertices));
+        }
 
-        // Set Texture B as the source.
-        VERIFYGL(glActiveTexture(GL_TEXTURE0));
-        VERIFYGL(glBindTexture(GL_TEXTURE_2D, m_pOffScreenFrameBuffer->GetTextureID(m_TextureB)));
 
-        VERIFYGL(glVertexAttribPointer(ATTRIBUTE_VERTEX_POSITION,       3, GL_FLOAT,         GL_FALSE, sizeof(Vertex), &m_pPaddedBlurVertices->x));
-        VERIFYGL(glVertexAttribPointer(ATTRIBUTE_VERTEX_DIFFUSE,        4, GL_UNSIGNED_BYTE, GL_TRUE,  sizeof(Vertex), &m_pPaddedBlurVertices->color));
-        VERIFYGL(glVertexAttribPointer(ATTRIBUTE_VERTEX_TEXTURE_COORD0, 2, GL_FLOAT,         GL_FALSE, sizeof(Vertex), &m_pPaddedBlurVertices->texCoord[0]));
+        // Resume rendering to the on-screen window.
+        CHR(m_pOffScreenFrameBuffer->Disable());
+        VERIFYGL(glViewport(oldViewport[0], oldViewport[1], oldViewport[2], oldViewport[3]));
 
-        // Draw to the texture A with vertical blur.
-        VERIFYGL(glUniform1f(s_uHorizontalPass, 0));
-        VERIFYGL(glUniform1fv(s_uFilterOffsets, MAX_FILTER_WIDTH_HEIGHT, (GLfloat*) &m_VerticalFilterOffsets));
-        VERIFYGL(glDrawArrays(GL_TRIANGLE_STRIP, 0, m_cPaddedBlurVertices));
+        m_cacheKey     = key;
+        m_isCacheValid = true;
     }
 
 
-    // Resume rendering to the on-screen window.
-    CHR(m_pOffScreenFrameBuffer->Disable());
-    VERIFYGL(glViewport(oldViewport[0], oldViewport[1], oldViewport[2], oldViewport[3]));
-
-
 #ifdef BLEND_ORIGINAL_WITH_BLURRED
     //
     // PASS 4: render from texture A to display.
@@ -433,7 +456,7 @@ BlurEffect::Draw( Vertex *pVertices, UINT32 numVertices, PRIMITIVE_TYPE primitiv
             blurRect.width  += (float)m_fBlurEdgePadding*2.0f;
             blurRect.height += (float)m_fBlurEdgePadding*2.0f;
 
-            CHR(Util::CreateTriangleStrip( &blurRect, m_pBlurredVertices, 0.0f, 1.0f, 1.0f, 0.0f ));   // reverse Y texture coordinates, because render-to-texture puts (0,0) at bottom of screen, not top.
+            CHR(Util::CreateTriangleStrip( &blurRect, m_pBlurredVertices, 0.0f, scratchRect.width, scratchRect.height, 0.0f ));   // reverse Y texture coordinates, because render-to-texture puts (0,0) at bottom of screen, not top.
 
 
             opacity[0] = blurredOpacity;
@@ -479,10 +502,9 @@ BlurEffect::Draw( Vertex *pVertices, UINT32 numVertices, PRIMITIVE_TYPE primitiv
         blurRect.width  += (float)m_fBlurEdgePadding*2.0f;
         blurRect.height += (float)m_fBlurEdgePadding*2.0f;
 
-
-//        CHR(Util::CreateTriangleStrip( &blurRect, m_pBlurredVertices, 0.0f, 1.0f, 1.0f, 0.0f ));   // reverse Y texture coordinates, because render-to-texture puts (0,0) at bottom of screen, not top.
-
-        CHR(Util::CreateTriangleStrip( &blurRect, m_pBlurredVertices, uStart, uEnd, vStart, vEnd ));   // reverse Y texture coordinates, because render-to-texture puts (0,0) at bottom of screen, not top.
+        // Texture A was drawn in the same orientation as the source; only the part
+        // of the (pooled, possibly larger) surface we rendered to is sampled.
+        CHR(Util::CreateTriangleStrip( &blurRect, m_pBlurredVertices, scratchRect.x, scratchRect.x + scratchRect.width, scratchRect.y, scratchRect.y + scratchRect.height ));
         VERIFYGL(glBindTexture(GL_TEXTURE_2D, m_pOffScreenFrameBuffer->GetTextureID(m_TextureA)));
         CHR(OpenGLESEffect::DrawTriangleStrip( m_pBlurredVertices, m_cBlurredVertices ));
     }
@@ -490,6 +512,13 @@ BlurEffect::Draw( Vertex *pVertices, UINT32 numVertices, PRIMITIVE_TYPE primitiv
 
 
 Exit:
+    // Hand the scratch surfaces back; texture A keeps our result unless someone else borrows them.
+    if (m_pOffScreenFrameBuffer)
+    {
+        IGNOREHR(ScratchSurfacePool::Release( m_pOffScreenFrameBuffer ));
+        m_pOffScreenFrameBuffer = NULL;
+    }
+
     return rval;
 }
 
@@ -511,25 +540,14 @@ BlurEffect::GetRadius()
 
 
 RESULT 
-BlurEffect::InitScratchSurfaces( Rectangle& sourceRect, float blurRadius, float uStart, float uEnd, float vStart, float vEnd )
+BlurEffect::InitScratchSurfaces( Rectangle& sourceRect, float blurRadius, float uStart, float uEnd, float vStart, float vEnd, OUT bool* pContentsKept )
 {
     RESULT rval = S_OK;
 
     m_fDownsamplingFactor = ChooseDownsamplingFactor(blurRadius);
 
-    // Only resize our scratch surfaces when the image downsampling needs to change,
-    // which will only happen when there's been a large change in the blurRadius.
-//    if ( Util::CompareFloats( m_fDownsamplingFactor, m_fPreviousDownsamplingFactor) )
-//    {
-//        return S_OK;
-//    }
-//    else
-//    {
-//        m_fPreviousDownsamplingFactor = m_fDownsamplingFactor;       
-//    }
-
 
-    // Create a FrameBufferObject with two textures to hold the blur results.
+    // Borrow a FrameBufferObject with two textures to hold the blur results.
     //
     // The larger the blur radius, the more we can downsample the source image.
     // Downsampling a) yields extra blur and b) calls the pixel shader for fewer pixels
@@ -561,8 +579,12 @@ BlurEffect::InitScratchSurfaces( Rectangle& sourceRect, float blurRadius, float
         // Larger blurs works best with smaller textures (we get more blur 
         // from the down-sampling, and the shader has fewer pixels to operate on
         // so it executes faster).
-///        m_pOffScreenFrameBuffer = RenderTarget::Create( (UINT32)(m_fPaddedWidth/m_fDownsamplingFactor), (UINT32)(m_fPaddedHeight/m_fDownsamplingFactor), true, 2 );
-        m_pOffScreenFrameBuffer = RenderTarget::Create( (UINT32)(m_fPaddedWidth/m_fDownsamplingFactor), (UINT32)(m_fPaddedHeight/m_fDownsamplingFactor), true, 2, false );
+        //
+        // The surfaces come from a pool shared by every Effect, so an animated
+        // radius or a resized source rarely means allocating a new one.
+        UINT32 scratchWidth  = (UINT32)(m_fPaddedWidth /m_fDownsamplingFactor);
+        UINT32 scratchHeight = (UINT32)(m_fPaddedHeight/m_fDownsamplingFactor);
+        CHR(ScratchSurfacePool::Acquire( scratchWidth, scratchHeight, 2, this, &m_pOffScreenFrameBuffer, pContentsKept ));
     }
 
     // Create an unpadded triangle strip for drawing to m_OffScreenFrameBuffer (where we do the blurring).
@@ -574,12 +596,15 @@ BlurEffect::InitScratchSurfaces( Rectangle& sourceRect, float blurRadius, float
     CHR(Util::CreateTriangleStrip( &unpaddedRect, m_pUnpaddedBlurVertices, uStart, uEnd, vStart, vEnd ));
 
     // Create a padded triangle strip for drawing to m_OffScreenFrameBuffer (where we do the blurring).
+    // It samples only the part of the surface we render to.
     Rectangle paddedRect;
+    Rectangle scratchRect;
+    scratchRect         = m_pOffScreenFrameBuffer->GetTextureRect();
     paddedRect.x        = 0.0f;
     paddedRect.y        = 0.0f;
     paddedRect.width    = (float)m_fPaddedWidth   / (float)m_fDownsamplingFactor;
     paddedRect.height   = (float)m_fPaddedHeight  / (float)m_fDownsamplingFactor;
-    CHR(Util::CreateTriangleStrip( &paddedRect, m_pPaddedBlurVertices ));
+    CHR(Util::CreateTriangleStrip( &paddedRect, m_pPaddedBlurVertices, scratchRect.x, scratchRect.x + scratchRect.width, scratchRect.y, scratchRect.y + scratchRect.height ));
 
     {
         m_modelViewMatrixOffscreen = mat4::Translate(-1.0f*(paddedRect.width/2), 
@@ -607,12 +632,13 @@ BlurEffect::InitBlurFilter( float blurRadius )
     // and current value of BlurRadius.  
     //
     // Texture coordinates are in the range [0.0 .. 1.0], so if surface is 512x512 pixels, 
-    // a pixel is (1.0 / 512) wide in texels.
+    // a pixel is (1.0 / 512) wide in texels.  Pooled surfaces may be larger than the
+    // area we render to, so use the size of the texture, not of the render target.
     //
     // Multiply the texel offset by 1.5 so that samples are taken from between two texels, 
     // which leverages the hardware's built-in bilinear filtering for extra blur.
-    float horizontalTexelSize   = 1.0 / m_pOffScreenFrameBuffer->GetWidth();
-    float verticalTexelSize     = 1.0 / m_pOffScreenFrameBuffer->GetHeight();
+    float horizontalTexelSize   = 1.0 / m_pOffScreenFrameBuffer->GetTextureWidth();
+    float verticalTexelSize     = 1.0 / m_pOffScreenFrameBuffer->GetTextureHeight();
     float verticalOffset        = verticalTexelSize   * (blurRadius/MAX_BLUR_RADIUS) * 1.5;
     float horizontalOffset      = horizontalTexelSize * (blurRadius/MAX_BLUR_RADIUS) * 1.5;
 
@@ -757,6 +783,30 @@ Exit:
 
 
 
+float
+BlurEffect::QuantizeRadius( float blurRadius )
+{
+    // Radii closer than this blur identically, as far as anyone can see;
+    // snapping to it keeps the cache key stable while a storyboard settles.
+    return floorf( blurRadius/BLUR_RADIUS_STEP + 0.5f ) * BLUR_RADIUS_STEP;
+}
+
+
+
+bool
+BlurEffect::IsSameBlur( const BlurCacheKey& a, const BlurCacheKey& b )
+{
+    return a.textureID      == b.textureID       &&
+           a.contentVersion == b.contentVersion  &&
+           a.width          == b.width           &&
+           a.height         == b.height          &&
+           a.radius         == b.radius          &&
+           a.color          == b.color           &&
+           Util::CompareRectangles( a.textureRect, b.textureRect );
+}
+
+
+
 float
 BlurEffect::ChooseDownsamplingFactor( float blurRadius )
 {
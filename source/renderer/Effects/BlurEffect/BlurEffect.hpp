@@ -35,9 +35,21 @@ protected:
     BlurEffect( const BlurEffect& rhs );
     BlurEffect& operator=( const BlurEffect& rhs );
 
-    virtual RESULT InitScratchSurfaces  ( Rectangle& sourceRect, float blurRadius, float uStart = 0.0f, float uEnd = 1.0f, float vStart = 0.0f, float vEnd = 1.0f );
+    virtual RESULT InitScratchSurfaces  ( Rectangle& sourceRect, float blurRadius, float uStart = 0.0f, float uEnd = 1.0f, float vStart = 0.0f, float vEnd = 1.0f, OUT bool* pContentsKept = NULL );
     virtual RESULT InitBlurFilter       ( float blurRadius );
 
+    // Everything that determines what ends up in texture A.
+    struct BlurCacheKey
+    {
+        GLuint      textureID;
+        UINT32      contentVersion;
+        Rectangle   textureRect;
+        float       width;
+        float       height;
+        float       radius;
+        UINT32      color;
+    };
+
 
 //----------------------------------------------------------------------------
 // Object data
@@ -48,7 +60,6 @@ protected:
     UINT32                  m_numFrameVertices;
     
     float                   m_fBlurRadius;
-    float                   m_fPreviousBlurRadius;
 
     float                   m_fDownsamplingFactor;
     float                   m_fPreviousDownsamplingFactor;
@@ -58,10 +69,10 @@ protected:
     float                   m_fWidth;
     float                   m_fHeight;
 
-    Vertex*                 m_pPreviousVertexArray;
-
     UINT32                  m_FrameCount;
-    RenderTarget*           m_pOffScreenFrameBuffer;
+    RenderTarget*           m_pOffScreenFrameBuffer;    // Borrowed from the ScratchSurfacePool during Draw().
+    BlurCacheKey            m_cacheKey;
+    bool                    m_isCacheValid;
     Vertex*                 m_pPaddedBlurVertices;
     UINT32                  m_cPaddedBlurVertices;
     Vertex*                 m_pUnpaddedBlurVertices;
@@ -92,6 +103,8 @@ protected:
     static void   CreateGaussianFilterKernel7x1( IN float filterOffsets[], float offset );
     static void   CreateGaussianFilterKernel3x1( IN float filterOffsets[], float offset );
     static float  ChooseDownsamplingFactor( float blurRadius );
+    static float  QuantizeRadius        ( float blurRadius );
+    static bool   IsSameBlur            ( const BlurCacheKey& a, const BlurCacheKey& b );
 
 
 //----------------
@@ -122,6 +135,7 @@ protected:
 
     static const float          DEFAULT_BLUR_RADIUS;
     static const float          MAX_BLUR_RADIUS;
+    static const float          BLUR_RADIUS_STEP;
 
 
 
@@ -0,0 +1,174 @@
+/*
+ *  Displacement.cpp
+ *  Critters
+ *
+ *  Bulk CPU kernels for the Ripple and Morph vertex shaders.
+ *
+ */
+
+#include "Displacement.hpp"
+#include "Macros.hpp"
+#include "Log.hpp"
+
+#include <math.h>
+
+#if defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
+
+namespace Z
+{
+
+
+
+//
+// Static Data
+//
+bool    Displacement::s_isEnabled   = false;
+
+
+
+//
+// Class Methods
+//
+void
+Displacement::Ripple( IN const Vertex* pIn, UINT32 numVertices, IN const RippleParams& params, OUT Vertex* pOut )
+{
+    DEBUGCHK(pIn && pOut);
+    DEBUGCHK(params.waveLength > 0.0f);
+
+    const float invWaveLength = 1.0f / params.waveLength;
+    const float invRadius     = params.radius > 0.0f ? 1.0f / params.radius : 0.0f;
+
+    for (UINT32 first = 0; first < numVertices; first += 4)
+    {
+        UINT32  count = MIN(numVertices - first, 4);
+        float   dx[4] = { 0 };
+        float   dy[4] = { 0 };
+        float   dist[4];
+
+        for (UINT32 i = 0; i < count; ++i)
+        {
+            dx[i] = pIn[ first + i ].x - params.origin.x;
+            dy[i] = pIn[ first + i ].y - params.origin.y;
+        }
+
+#if defined(__ARM_NEON__)
+        // sqrt(d2) = d2 * rsqrt(d2); two Newton steps on the estimate, and 0 where d2 == 0.
+        {
+        float32x4_t vx       = vld1q_f32( dx );
+        float32x4_t vy       = vld1q_f32( dy );
+        float32x4_t d2       = vmlaq_f32( vmulq_f32( vx, vx ), vy, vy );
+        float32x4_t estimate = vrsqrteq_f32( d2 );
+        estimate             = vmulq_f32( estimate, vrsqrtsq_f32( vmulq_f32( d2, estimate ), estimate ) );
+        estimate             = vmulq_f32( estimate, vrsqrtsq_f32( vmulq_f32( d2, estimate ), estimate ) );
+        float32x4_t d        = vmulq_f32( d2, estimate );
+        d                    = vbslq_f32( vceqq_f32( d2, vdupq_n_f32( 0.0f ) ), vdupq_n_f32( 0.0f ), d );
+        vst1q_f32( dist, d );
+        }
+#else
+        for (UINT32 i = 0; i < 4; ++i)
+        {
+            dist[i] = sqrtf( dx[i]*dx[i] + dy[i]*dy[i] );
+        }
+#endif
+
+        for (UINT32 i = 0; i < count; ++i)
+        {
+            // The distance contribution.
+            float deflection = sinf( dist[i] * invWaveLength - params.time );
+
+            // The travelling wave contribution; never negative.
+            if (params.radius > 0.0f)
+            {
+                deflection *= dist[i] < params.radius ? dist[i] * invRadius : params.radius / dist[i];
+                deflection  = fabsf( deflection );
+            }
+
+            const Vertex& in  = pIn [ first + i ];
+            Vertex&       out = pOut[ first + i ];
+
+            out.x     = in.x;
+            out.y     = in.y;
+            out.z     = in.z + deflection * params.amplitude;
+            out.color = in.color;
+            out.u0    = in.u0;
+            out.v0    = in.v0;
+        }
+    }
+}
+
+
+
+void
+Displacement::Morph( IN const Vertex* pIn, UINT32 numVertices, IN const MorphParams& params, OUT Vertex* pOut )
+{
+    DEBUGCHK(pIn && pOut);
+    DEBUGCHK(params.sourceWidth > 0.0f && params.sourceHeight > 0.0f);
+
+    const float invWidth  = 1.0f / params.sourceWidth;
+    const float invHeight = 1.0f / params.sourceHeight;
+
+    //
+    // The curves only depend on y.  A grid's triangles alternate between the top and
+    // bottom of their row, so remember two rows' worth.
+    //
+    float   rowY[2]  = { 0.0f, 0.0f };
+    vec3    left[2];
+    vec3    right[2];
+    bool    valid[2] = { false, false };
+    UINT32  next     = 0;
+
+    for (UINT32 i = 0; i < numVertices; ++i)
+    {
+        const Vertex& in  = pIn [i];
+        Vertex&       out = pOut[i];
+        UINT32        row;
+
+        if (valid[0] && rowY[0] == in.y)
+        {
+            row = 0;
+        }
+        else if (valid[1] && rowY[1] == in.y)
+        {
+            row = 1;
+        }
+        else
+        {
+            float t = in.y * invHeight;
+
+            row         = next;
+            next        = 1 - next;
+            rowY [row]  = in.y;
+            left [row]  = Bezier( params.curve0, t );
+            right[row]  = Bezier( params.curve1, t );
+            valid[row]  = true;
+        }
+
+        out.x     = left[row].x + (right[row].x - left[row].x) * (in.x * invWidth);
+        out.y     = in.y;
+        out.z     = (left[row].z + right[row].z) * 0.5f;
+        out.color = in.color;
+        out.u0    = in.u0;
+        out.v0    = in.v0;
+    }
+}
+
+
+
+vec3
+Displacement::Bezier( IN const vec3* pPoints, float t )
+{
+    float oneMinusT = 1.0f - t;
+    float b0        = oneMinusT * oneMinusT * oneMinusT;
+    float b1        = 3.0f * oneMinusT * oneMinusT * t;
+    float b2        = 3.0f * oneMinusT * t * t;
+    float b3        = t * t * t;
+
+    return pPoints[0]*b0 + pPoints[1]*b1 + pPoints[2]*b2 + pPoints[3]*b3;
+}
+
+
+
+} // END namespace Z
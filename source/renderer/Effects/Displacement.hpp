@@ -0,0 +1,69 @@
+#pragma once
+
+#include "Types.hpp"
+#include "Vertex.hpp"
+#include "Vector.hpp"
+
+
+namespace Z
+{
+
+
+//
+// CPU versions of the mesh Effects' vertex shaders, for callers that need displaced
+// positions on the CPU (hit-testing a rippling or morphing Sprite, devices or passes
+// without the shader).  Each kernel matches its shader: RippleEffect_vs.glsl and
+// MorphEffect_vs.glsl.
+//
+// Both work in bulk over a grid from TessellationCache.  Ripple computes distances
+// four at a time (NEON where available); Morph evaluates its two Bezier curves once
+// per grid row, not once per vertex.  pOut may equal pIn.
+//
+// Enabled, RippleEffect and MorphEffect displace their grids here every frame and
+// draw them with the default shader instead of their own.  Off by default; enable
+// with Settings.bCPUDisplacement = "1".
+//
+
+struct RippleParams
+{
+    vec2    origin;
+    float   amplitude;
+    float   waveLength;     // Shader's 2 * uHalfWaveLength.
+    float   radius;
+    float   time;           // Speed * seconds, as in uTime.
+};
+
+
+struct MorphParams
+{
+    vec3    curve0[4];
+    vec3    curve1[4];
+    float   sourceWidth;
+    float   sourceHeight;
+};
+
+
+class Displacement
+{
+public:
+    static  void    Enable              ( bool enabled )    { s_isEnabled = enabled; }
+    static  bool    IsEnabled           ( )                 { return s_isEnabled; }
+
+    static  void    Ripple              ( IN const Vertex* pIn, UINT32 numVertices, IN const RippleParams& params, OUT Vertex* pOut );
+    static  void    Morph               ( IN const Vertex* pIn, UINT32 numVertices, IN const MorphParams&  params, OUT Vertex* pOut );
+
+protected:
+    static  vec3    Bezier              ( IN const vec3* pPoints, float t );
+
+protected:
+    static  bool    s_isEnabled;
+
+private:
+    Displacement();
+    Displacement( const Displacement& rhs );
+    Displacement& operator=( const Displacement& rhs );
+};
+
+
+
+} // END namespace Z
@@ -3,6 +3,7 @@
 #include "RenderTarget.hpp"
 #include "Matrix.hpp"
 #include "Time.hpp"
+#include "Profiler.hpp"
 
 
 namespace Z
@@ -160,6 +161,8 @@ DropShadowEffect::Draw( Vertex *pVertices, UINT32 numVertices, PRIMITIVE_TYPE pr
 
     RESULT     rval          = S_OK;
 
+    PROFILE_SCOPE("DropShadowEffect::Draw");
+
 
     // Assign values to shader parameters.
     // TODO: move to BeginPass()?
@@ -173,9 +176,7 @@ DropShadowEffect::Draw( Vertex *pVertices, UINT32 numVertices, PRIMITIVE_TYPE pr
     VERIFYGL(glUniform1f(s_uDirection,      m_fDirectionDegrees));
     
     // Draw the texture mapped onto the rippling mesh.
-    VERIFYGL(glVertexAttribPointer(ATTRIBUTE_VERTEX_POSITION,       3, GL_FLOAT,         GL_FALSE, sizeof(Vertex), &pVertices->x));
-    VERIFYGL(glVertexAttribPointer(ATTRIBUTE_VERTEX_DIFFUSE,        4, GL_UNSIGNED_BYTE, GL_TRUE,  sizeof(Vertex), &pVertices->color));
-    VERIFYGL(glVertexAttribPointer(ATTRIBUTE_VERTEX_TEXTURE_COORD0, 2, GL_FLOAT,         GL_FALSE, sizeof(Vertex), &pVertices->texCoord[0]));
+    VertexStream::BindVertices( pVertices, numVertices );
 
     switch (primitiveType)
     {
@@ -185,6 +186,9 @@ DropShadowEffect::Draw( Vertex *pVertices, UINT32 numVertices, PRIMITIVE_TYPE pr
         case PRIMITIVE_TYPE_TRIANGLE_LIST:
             VERIFYGL(glDrawArrays(GL_TRIANGLES, 0, numVertices));
             break;
+        case PRIMITIVE_TYPE_QUAD_LIST:
+            VERIFYGL(glDrawElements(GL_TRIANGLES, numVertices / VERTS_PER_QUAD * INDICES_PER_QUAD, GL_UNSIGNED_SHORT, VertexStream::BindQuadIndices( numVertices / VERTS_PER_QUAD )));
+            break;
         default:
             // TODO: might it ever be useful to apply Color to a field of point sprites?
             DEBUGCHK(0);
@@ -487,5 +487,27 @@ Exit:
 
 
 
+RESULT
+EffectManager::DrawQuadList( IN HEffect handle, IN Vertex *pVertices, UINT32 numQuads )
+{
+    RESULT rval = S_OK;
+    
+    IEffect* pEffect = GetObjectPointer( handle );
+    if (pEffect)
+    {
+        rval = pEffect->DrawQuadList( pVertices, numQuads );
+    }
+    else
+    {
+        rval = E_BAD_HANDLE;
+    }
+    
+Exit:
+    return rval;
+}
+
+
+
+
 } // END namespace Z
 
@@ -50,6 +50,7 @@ public:
 
     RESULT  DrawTriangleStrip    ( IN HEffect handle, IN Vertex *pVertices, UINT32 numVertices );
     RESULT  DrawTriangleList     ( IN HEffect handle, IN Vertex *pVertices, UINT32 numVertices );
+    RESULT  DrawQuadList         ( IN HEffect handle, IN Vertex *pVertices, UINT32 numQuads    );
 //    RESULT DrawPointSprites     ( IN Vertex *pVertices, UINT32 numVertices, float fScale = 8.0f );
 //    RESULT DrawLines            ( IN Vertex *pVertices, UINT32 numVertices, float fWidth = 1.0f );
 
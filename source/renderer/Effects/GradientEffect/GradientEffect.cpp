@@ -3,6 +3,7 @@
 #include "RenderTarget.hpp"
 #include "Matrix.hpp"
 #include "Time.hpp"
+#include "Profiler.hpp"
 
 
 namespace Z
@@ -180,6 +181,8 @@ GradientEffect::Draw( Vertex *pVertices, UINT32 numVertices, PRIMITIVE_TYPE prim
     DEBUGMSG(ZONE_SHADER, "GradientEffect[%d]::DrawTriangleStrip()", m_ID);
 
     RESULT     rval          = S_OK;
+
+    PROFILE_SCOPE("GradientEffect::Draw");
     Rectangle  sourceRect;
     Rectangle  textureRect;
 
@@ -213,15 +216,14 @@ GradientEffect::Draw( Vertex *pVertices, UINT32 numVertices, PRIMITIVE_TYPE prim
 
 
     // Draw the mesh with gradient applies.
-    VERIFYGL(glVertexAttribPointer(ATTRIBUTE_VERTEX_POSITION,       3, GL_FLOAT,         GL_FALSE, sizeof(Vertex), &m_pGradientVertices->x));
-    VERIFYGL(glVertexAttribPointer(ATTRIBUTE_VERTEX_DIFFUSE,        4, GL_UNSIGNED_BYTE, GL_TRUE,  sizeof(Vertex), &m_pGradientVertices->color));
-    VERIFYGL(glVertexAttribPointer(ATTRIBUTE_VERTEX_TEXTURE_COORD0, 2, GL_FLOAT,         GL_FALSE, sizeof(Vertex), &m_pGradientVertices->texCoord[0]));
+    VertexStream::BindVertices( m_pGradientVertices, m_numGradientVertices );
 
     switch (primitiveType)
     {
         // NOTE: for this effect we ignore the passed-in vertices and draw a triangle list (GL_TRIANGLES) not a triangle strip (GL_TRIANGLE_STRIP).
         case PRIMITIVE_TYPE_TRIANGLE_STRIP:
         case PRIMITIVE_TYPE_TRIANGLE_LIST:
+        case PRIMITIVE_TYPE_QUAD_LIST:
             VERIFYGL(glDrawArrays(GL_TRIANGLES, 0, m_numGradientVertices));
             break;
         default:
@@ -35,6 +35,7 @@ public:
 
     virtual RESULT DrawTriangleStrip    ( IN Vertex *pVertices, UINT32 numVertices )    = 0;
     virtual RESULT DrawTriangleList     ( IN Vertex *pVertices, UINT32 numVertices )    = 0;
+    virtual RESULT DrawQuadList         ( IN Vertex *pVertices, UINT32 numQuads    )    = 0;
     
     virtual HShader GetShader           ( )                                             = 0;
 
@@ -3,6 +3,9 @@
 #include "RenderTarget.hpp"
 #include "Matrix.hpp"
 #include "Time.hpp"
+#include "Profiler.hpp"
+#include "TessellationCache.hpp"
+#include "Displacement.hpp"
 
 
 namespace Z
@@ -129,7 +132,10 @@ MorphEffect::~MorphEffect()
 {
     RETAILMSG(ZONE_OBJECT | ZONE_VERBOSE, "\t~MorphEffect( %4d )", m_ID);
 
-    SAFE_ARRAY_DELETE(m_pMorphedVertices);
+    if (m_pMorphedVertices)
+    {
+        IGNOREHR(TessellationCache::Release( m_pMorphedVertices ));
+    }
 
     // Delete the shaders when the last instance is freed
     if (0 == ATOMIC_DECREMENT( MorphEffect::s_NumInstances ))
@@ -191,12 +197,16 @@ MorphEffect::operator=( const MorphEffect& rhs )
     memcpy(m_curve1, rhs.m_curve1, sizeof(m_curve1));
 
 
-    // DEEP COPY: vertices
-    if (rhs.m_pMorphedVertices)
+    // SHARED: vertices; the grid is read-only, so take another reference to it.
+    if (m_pMorphedVertices)
     {
-        SAFE_ARRAY_DELETE(m_pMorphedVertices);
-        m_pMorphedVertices = new Vertex[ rhs.m_numMorphedVertices ];
-        memcpy(m_pMorphedVertices, rhs.m_pMorphedVertices, sizeof(Vertex)*rhs.m_numMorphedVertices);
+        IGNOREHR(TessellationCache::Release( m_pMorphedVertices ));
+        m_pMorphedVertices = NULL;
+    }
+
+    if (rhs.m_pMorphedVertices && SUCCEEDED(TessellationCache::AddRef( rhs.m_pMorphedVertices )))
+    {
+        m_pMorphedVertices = rhs.m_pMorphedVertices;
     }
 
     
@@ -234,6 +244,8 @@ MorphEffect::Draw( Vertex *pVertices, UINT32 numVertices, PRIMITIVE_TYPE primiti
     DEBUGMSG(ZONE_SHADER, "MorphEffect[%d]::DrawTriangleStrip()", m_ID);
 
     RESULT     rval          = S_OK;
+
+    PROFILE_SCOPE("MorphEffect::Draw");
     Rectangle  sourceRect;
     Rectangle  textureRect;
     Util::GetBoundingRect  ( pVertices, numVertices, &sourceRect  );
@@ -247,6 +259,16 @@ MorphEffect::Draw( Vertex *pVertices, UINT32 numVertices, PRIMITIVE_TYPE primiti
         m_frameChanged = false;
     }
 
+    if (Displacement::IsEnabled())
+    {
+        m_displacedVertices.resize( m_numMorphedVertices );
+        CHR(Displace( m_pMorphedVertices, m_numMorphedVertices, &m_displacedVertices[0] ));
+
+        // Already where the shader would put them.
+        CHR(OpenGLESEffect::Draw( &m_displacedVertices[0], m_numMorphedVertices, PRIMITIVE_TYPE_TRIANGLE_LIST ));
+        goto Exit;
+    }
+
 
     // Assign values to shader parameters.
     // TODO: move to BeginPass()?
@@ -275,15 +297,14 @@ MorphEffect::Draw( Vertex *pVertices, UINT32 numVertices, PRIMITIVE_TYPE primiti
 
 
     // Draw the texture mapped onto the morphing mesh.
-    VERIFYGL(glVertexAttribPointer(ATTRIBUTE_VERTEX_POSITION,       3, GL_FLOAT,         GL_FALSE, sizeof(Vertex), &m_pMorphedVertices->x));
-    VERIFYGL(glVertexAttribPointer(ATTRIBUTE_VERTEX_DIFFUSE,        4, GL_UNSIGNED_BYTE, GL_TRUE,  sizeof(Vertex), &m_pMorphedVertices->color));
-    VERIFYGL(glVertexAttribPointer(ATTRIBUTE_VERTEX_TEXTURE_COORD0, 2, GL_FLOAT,         GL_FALSE, sizeof(Vertex), &m_pMorphedVertices->texCoord[0]));
+    VertexStream::BindVertices( m_pMorphedVertices, m_numMorphedVertices );
 
     switch (primitiveType)
     {
         // NOTE: for this effect we ignore the passed-in vertices and draw a triangle list (GL_TRIANGLES) not a triangle strip (GL_TRIANGLE_STRIP).
         case PRIMITIVE_TYPE_TRIANGLE_STRIP:
         case PRIMITIVE_TYPE_TRIANGLE_LIST:
+        case PRIMITIVE_TYPE_QUAD_LIST:
             VERIFYGL(glDrawArrays(GL_TRIANGLES, 0, m_numMorphedVertices));
             break;
         default:
@@ -447,6 +468,33 @@ MorphEffect::GetCurve1p3()
 
 
 
+RESULT
+MorphEffect::Displace( IN const Vertex* pIn, UINT32 numVertices, OUT Vertex* pOut )
+{
+    RESULT      rval = S_OK;
+    MorphParams params;
+    Rectangle   sourceRect;
+
+    CPREx(pIn,  E_NULL_POINTER);
+    CPREx(pOut, E_NULL_POINTER);
+    CBREx(m_pMorphedVertices != NULL, E_UNEXPECTED);
+
+    // The grid covers exactly the frame Draw() last morphed.
+    Util::GetBoundingRect( m_pMorphedVertices, m_numMorphedVertices, &sourceRect );
+
+    memcpy(params.curve0, m_curve0, sizeof(m_curve0));
+    memcpy(params.curve1, m_curve1, sizeof(m_curve1));
+    params.sourceWidth  = sourceRect.width;
+    params.sourceHeight = sourceRect.height;
+
+    Displacement::Morph( pIn, numVertices, params, pOut );
+
+Exit:
+    return rval;
+}
+
+
+
 
 
 RESULT 
@@ -464,11 +512,15 @@ MorphEffect::InitScratchSurfaces( Rectangle& sourceRect, Rectangle& textureRect
     float vStart    = textureRect.y;
     float vEnd      = textureRect.y + textureRect.height;
     
-    SAFE_ARRAY_DELETE(m_pMorphedVertices);
+    if (m_pMorphedVertices)
+    {
+        IGNOREHR(TessellationCache::Release( m_pMorphedVertices ));
+        m_pMorphedVertices   = NULL;
+        m_numMorphedVertices = 0;
+    }
     
-    CHR(Util::CreateTriangleList( &sourceRect, m_rows, m_columns, &m_pMorphedVertices, &m_numMorphedVertices, uStart, uEnd, vStart, vEnd  ));
-
-    // TODO: create a VBO.
+    // Every instance drawing the same frame shares one grid.
+    CHR(TessellationCache::Acquire( sourceRect, m_rows, m_columns, uStart, uEnd, vStart, vEnd, &m_pMorphedVertices, &m_numMorphedVertices ));
 
 Exit:
     return rval;
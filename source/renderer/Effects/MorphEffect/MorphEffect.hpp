@@ -54,6 +54,10 @@ public:
     
     virtual HShader GetShader               ( );
 
+    // Apply the current morph to pIn on the CPU, as the vertex shader would.
+    // Fails until the first Draw(), which sizes the mesh.
+    virtual RESULT Displace                 ( IN const Vertex* pIn, UINT32 numVertices, OUT Vertex* pOut );
+
     virtual IProperty* GetProperty          ( const string& name ) const;
 
 protected:
@@ -70,8 +74,9 @@ protected:
 // Object data
 //----------------------------------------------------------------------------
 protected:
-    Vertex*         m_pMorphedVertices;
+    const Vertex*   m_pMorphedVertices;     // Shared; see TessellationCache.
     UINT32          m_numMorphedVertices;
+    vector<Vertex>  m_displacedVertices;    // m_pMorphedVertices, displaced on the CPU when Displacement::IsEnabled().
 
 
     UINT8           m_rows;
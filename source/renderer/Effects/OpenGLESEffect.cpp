@@ -7,6 +7,8 @@
  */
 
 #include "OpenGLESEffect.hpp"
+#include "Metrics.hpp"
+#include "TessellationCache.hpp"
 
 
 namespace Z
@@ -34,6 +36,8 @@ GLint       OpenGLESEffect::s_uDefaultProjectionMatrix          = 0;
 GLint       OpenGLESEffect::s_uDefaultTexture                   = 0;
 GLint       OpenGLESEffect::s_uDefaultGlobalColor               = 0;
 
+static MetricCounter* s_pOffscreenPassesMetric                  = Metrics::RegisterCounter( "Effects.OffscreenPasses" );
+
 
 
 //----------------------------------------------------------------------------
@@ -50,8 +54,9 @@ OpenGLESEffect::SetTexture(
 
     RESULT rval = S_OK;
 
-    m_hSourceTexture  = HTexture::NullHandle();
-    m_sourceTextureID = textureID;
+    m_hSourceTexture        = HTexture::NullHandle();
+    m_sourceTextureID       = textureID;
+    m_sourceContentVersion  = 0;
 
     switch (textureUnit)
     {
@@ -90,6 +95,7 @@ OpenGLESEffect::SetTexture(
 
     RESULT rval = S_OK;
 
+    m_sourceContentVersion = 0;
 
     if (m_hSourceTexture != hTexture)
     {
@@ -212,18 +218,20 @@ OpenGLESEffect::BeginFrame( IN const Rectangle& frame )
     
 
     //
-    // Create off-screen render target.
+    // Borrow an off-screen render target for the rest of the frame.
     // All subsequent draw calls will render to its texture.
     // Then in ::EndFrame() we'll present the result while applying the Effect.
     //
-    if (m_frameChanged)
+    if (!m_pRenderTarget)
     {
-        SAFE_RELEASE(m_pRenderTarget);
-        SAFE_ARRAY_DELETE(m_pFrameVertices);
+        CHR(ScratchSurfacePool::Acquire( (UINT32)frame.width, (UINT32)frame.height, 1, this, &m_pRenderTarget ));
+    }
 
-        m_pRenderTarget = RenderTarget::Create( frame.width, frame.height, true, 1 );
-        DEBUGCHK(m_pRenderTarget);
-        m_pRenderTarget->AddRef();
+    // The pooled surface may be larger than the frame, and need not be the same one
+    // as last frame; rebuild the frame vertices whenever its texture rect differs.
+    if (m_frameChanged || !m_pFrameVertices || !Util::CompareRectangles( m_pRenderTarget->GetTextureRect(), m_frameTextureRect ))
+    {
+        SAFE_ARRAY_DELETE(m_pFrameVertices);
 
         // TODO: RenderTarget should return the correct TextureRect w/o us needing to invert Y.
         Rectangle textureRect = m_pRenderTarget->GetTextureRect();
@@ -233,9 +241,13 @@ OpenGLESEffect::BeginFrame( IN const Rectangle& frame )
         float vEnd   = textureRect.y;
 
         CHR(Util::CreateTriangleList(&frame, 1, 1, &m_pFrameVertices, &m_numFrameVertices, uStart, uEnd, vStart, vEnd));
+
+        m_frameTextureRect = textureRect;
+        m_frameChanged     = true;  // Subclasses rebuild whatever they derived from the frame vertices.
     }
 
     CHR(m_pRenderTarget->Enable());
+    s_pOffscreenPassesMetric->Increment();
     
     // TODO: set scissor rect
     // TODO: AVOID this when we can; it really hurts perf.
@@ -270,7 +282,7 @@ OpenGLESEffect::EndFrame( bool present )
     RESULT rval = S_OK;
 
     // Don't use an off-screen render target unless the effect needs it.  VERY expensive.
-    if (!m_needsRenderTarget)
+    if (!m_needsRenderTarget || !m_pRenderTarget)
         return S_OK;
 
 
@@ -279,10 +291,15 @@ OpenGLESEffect::EndFrame( bool present )
     if (present)
     {
         CHR(SetTexture( 0, m_pRenderTarget->GetTextureID() ));
+        m_sourceContentVersion = m_pRenderTarget->GetContentVersion();
         CHR(DrawTriangleList( m_pFrameVertices, m_numFrameVertices ));
     }
 
 Exit:
+    // Hand the surface back; the next post-effect to begin may reuse it.
+    IGNOREHR(ScratchSurfacePool::Release( m_pRenderTarget ));
+    m_pRenderTarget = NULL;
+
     DEBUGMSG(ZONE_SHADER, "OpenGLESEffect::EndFrame( \"%s\" present: %d)", m_name.c_str(), present);
     DEBUGMSG(ZONE_SHADER, "------------------------------------");
     
@@ -305,6 +322,14 @@ OpenGLESEffect::DrawTriangleList( Vertex *pVertices, UINT32 numVertices )
 }
 
 
+// Virtual on purpose: subclasses only need to handle PRIMITIVE_TYPE_QUAD_LIST in their Draw().
+RESULT 
+OpenGLESEffect::DrawQuadList( Vertex *pVertices, UINT32 numQuads )
+{
+    return Draw( pVertices, numQuads * VERTS_PER_QUAD, PRIMITIVE_TYPE_QUAD_LIST );
+}
+
+
 
 
 RESULT 
@@ -333,9 +358,7 @@ OpenGLESEffect::Draw(
 
     // Don't bind texture; assume that caller already did it (useful for Effects that subclass us).
 
-    VERIFYGL(glVertexAttribPointer(ATTRIBUTE_VERTEX_POSITION,       3, GL_FLOAT,         GL_FALSE, sizeof(Vertex), &pVertices->x));
-    VERIFYGL(glVertexAttribPointer(ATTRIBUTE_VERTEX_DIFFUSE,        4, GL_UNSIGNED_BYTE, GL_TRUE,  sizeof(Vertex), &pVertices->color));
-    VERIFYGL(glVertexAttribPointer(ATTRIBUTE_VERTEX_TEXTURE_COORD0, 2, GL_FLOAT,         GL_FALSE, sizeof(Vertex), &pVertices->texCoord[0]));
+    VertexStream::BindVertices( pVertices, numVertices );
 
     switch (primitiveType)
     {
@@ -345,6 +368,9 @@ OpenGLESEffect::Draw(
         case PRIMITIVE_TYPE_TRIANGLE_LIST:
             VERIFYGL(glDrawArrays(GL_TRIANGLES, 0, numVertices));
             break;
+        case PRIMITIVE_TYPE_QUAD_LIST:
+            VERIFYGL(glDrawElements(GL_TRIANGLES, numVertices / VERTS_PER_QUAD * INDICES_PER_QUAD, GL_UNSIGNED_SHORT, VertexStream::BindQuadIndices( numVertices / VERTS_PER_QUAD )));
+            break;
         default:
             DEBUGCHK(0);
     }
@@ -366,6 +392,8 @@ OpenGLESEffect::OpenGLESEffect() :
     m_pFrameVertices(NULL),
     m_numFrameVertices(0),
     m_frameChanged(false),
+    m_sourceTextureID(0),
+    m_sourceContentVersion(0),
     m_globalColor(Color::White())
 {
     RETAILMSG(ZONE_OBJECT | ZONE_VERBOSE, "OpenGLESEffect( %4d )", m_ID);
@@ -382,7 +410,11 @@ OpenGLESEffect::~OpenGLESEffect()
 
     IGNOREHR(TextureMan.Release( m_hSourceTexture ));
 
-    SAFE_RELEASE(m_pRenderTarget);
+    if (m_pRenderTarget)
+    {
+        IGNOREHR(ScratchSurfacePool::Release( m_pRenderTarget ));
+    }
+    ScratchSurfacePool::Forget( this );
 
     // Delete the shaders when the last instance is freed
     if (0 == ATOMIC_DECREMENT( OpenGLESEffect::s_numInstances ))
@@ -407,6 +439,7 @@ OpenGLESEffect::OpenGLESEffect( const OpenGLESEffect& rhs ) :
     m_pRenderTarget(NULL),
     m_pFrameVertices(NULL),
     m_frameChanged(false),
+    m_sourceContentVersion(0),
     m_globalColor(Color::White())
 {
     RETAILMSG(ZONE_OBJECT | ZONE_VERBOSE, "OpenGLESEffect( %4d ) (copy ctor)", m_ID);
@@ -434,10 +467,12 @@ OpenGLESEffect::operator=( const OpenGLESEffect& rhs )
     m_modelViewMatrix       = rhs.m_modelViewMatrix;
     m_projectionMatrix      = rhs.m_projectionMatrix;
     m_sourceTextureID       = rhs.m_sourceTextureID;
+    m_sourceContentVersion  = rhs.m_sourceContentVersion;
     m_numFrameVertices      = rhs.m_numFrameVertices;
     m_hSourceTexture        = rhs.m_hSourceTexture;
     m_frame                 = rhs.m_frame;
     m_frameChanged          = rhs.m_frameChanged;
+    m_frameTextureRect      = rhs.m_frameTextureRect;
     m_globalColor           = rhs.m_globalColor;
     
     
@@ -445,13 +480,10 @@ OpenGLESEffect::operator=( const OpenGLESEffect& rhs )
         IGNOREHR(TextureMan.AddRef( m_hSourceTexture ));
 
 
+    // NOT COPIED: m_pRenderTarget is only borrowed from the ScratchSurfacePool between
+    // BeginFrame() and EndFrame(); the copy will borrow its own.
+
     // DEEP COPY:
-    if (rhs.m_pRenderTarget)
-    {
-        SAFE_RELEASE(m_pRenderTarget);
-        m_pRenderTarget = RenderTarget::Create( rhs.m_pRenderTarget->GetWidth(), rhs.m_pRenderTarget->GetHeight(), rhs.m_pRenderTarget->IsOffscreen(), rhs.m_pRenderTarget->GetNumTextures() );
-    }
-               
     if (rhs.m_pFrameVertices)
     {
         SAFE_ARRAY_DELETE(m_pFrameVertices);
@@ -544,6 +576,10 @@ OpenGLESEffect::Deinit()
     s_defaultShaderProgram  = 0;
     s_defaultShadersLoaded  = false;
 
+    // No Effects left to borrow them.
+    ScratchSurfacePool::Trim();
+    TessellationCache::Trim();
+
 Exit:
     if (FAILED(rval))
     {
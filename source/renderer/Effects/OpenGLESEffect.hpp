@@ -5,6 +5,9 @@
 #include "Util.hpp"
 #include "IEffect.hpp"
 #include "RenderTarget.hpp"
+#include "ScratchSurfacePool.hpp"
+#include "QuadList.hpp"
+#include "VertexStream.hpp"
 #include "ShaderManager.hpp"
 #include "EffectManager.hpp"
 #include "Property.hpp"
@@ -23,7 +26,8 @@ namespace Z
 typedef enum 
 {
     PRIMITIVE_TYPE_TRIANGLE_STRIP = 1,
-    PRIMITIVE_TYPE_TRIANGLE_LIST
+    PRIMITIVE_TYPE_TRIANGLE_LIST,
+    PRIMITIVE_TYPE_QUAD_LIST            // numVertices / VERTS_PER_QUAD indexed quads
 } PRIMITIVE_TYPE;
 
 
@@ -53,6 +57,7 @@ public:
     virtual RESULT Draw                 ( IN Vertex *pVertices, UINT32 numVertices, PRIMITIVE_TYPE type );
     virtual RESULT DrawTriangleStrip    ( IN Vertex *pVertices, UINT32 numVertices                      );
     virtual RESULT DrawTriangleList     ( IN Vertex *pVertices, UINT32 numVertices                      );
+    virtual RESULT DrawQuadList         ( IN Vertex *pVertices, UINT32 numQuads                         );
 
     virtual HShader GetShader           ( );
 
@@ -81,9 +86,9 @@ protected:
 //----------------------------------------------------------------------------
 protected:
     // Effect may optionally be applied post-render,
-    // in which case we create an offscreen RenderTarget
-    // to accumulate all the draw calls, then present it
-    // in ::EndFrame().
+    // in which case we borrow an offscreen RenderTarget
+    // from the ScratchSurfacePool to accumulate all the
+    // draw calls, then present it in ::EndFrame().
     bool                m_isPostEffect;
     bool                m_needsRenderTarget;
     RenderTarget*       m_pRenderTarget;
@@ -91,12 +96,14 @@ protected:
     bool                m_frameChanged;
     Vertex*             m_pFrameVertices;
     UINT32              m_numFrameVertices;
+    Rectangle           m_frameTextureRect;
     
 
     mat4                m_modelViewMatrix;
     mat4                m_projectionMatrix;
     HTexture            m_hSourceTexture;
     GLuint              m_sourceTextureID;
+    UINT32              m_sourceContentVersion;     // Non-zero when drawing our own RenderTarget; other textures don't change.
     Color               m_globalColor;
 
 
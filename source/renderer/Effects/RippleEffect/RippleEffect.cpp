@@ -3,6 +3,9 @@
 #include "RenderTarget.hpp"
 #include "Matrix.hpp"
 #include "Time.hpp"
+#include "Profiler.hpp"
+#include "TessellationCache.hpp"
+#include "Displacement.hpp"
 
 
 namespace Z
@@ -109,7 +112,10 @@ RippleEffect::~RippleEffect()
 {
     RETAILMSG(ZONE_OBJECT | ZONE_VERBOSE, "\t~RippleEffect( %4d )", m_ID);
 
-    SAFE_ARRAY_DELETE(m_pRippledVertices);
+    if (m_pRippledVertices)
+    {
+        IGNOREHR(TessellationCache::Release( m_pRippledVertices ));
+    }
 
     // Delete the shaders when the last instance is freed
     if (0 == ATOMIC_DECREMENT( RippleEffect::s_NumInstances ))
@@ -180,12 +186,16 @@ RippleEffect::operator=( const RippleEffect& rhs )
     m_color                         = rhs.m_color;
     
 
-    // DEEP COPY: vertices
-    if (rhs.m_pRippledVertices)
+    // SHARED: vertices; the grid is read-only, so take another reference to it.
+    if (m_pRippledVertices)
+    {
+        IGNOREHR(TessellationCache::Release( m_pRippledVertices ));
+        m_pRippledVertices = NULL;
+    }
+
+    if (rhs.m_pRippledVertices && SUCCEEDED(TessellationCache::AddRef( rhs.m_pRippledVertices )))
     {
-        SAFE_ARRAY_DELETE(m_pRippledVertices);
-        m_pRippledVertices = new Vertex[ rhs.m_numRippledVertices ];
-        memcpy(m_pRippledVertices, rhs.m_pRippledVertices, sizeof(Vertex)*rhs.m_numRippledVertices);
+        m_pRippledVertices = rhs.m_pRippledVertices;
     }
 
     
@@ -224,6 +234,8 @@ RippleEffect::Draw( Vertex *pVertices, UINT32 numVertices, PRIMITIVE_TYPE primit
     DEBUGMSG(ZONE_SHADER, "RippleEffect[%d]::DrawTriangleStrip()", m_ID);
 
     RESULT     rval          = S_OK;
+
+    PROFILE_SCOPE("RippleEffect::Draw");
     Rectangle  sourceRect;
     Rectangle  textureRect;
     Util::GetBoundingRect  ( pVertices, numVertices, &sourceRect  );
@@ -239,6 +251,16 @@ RippleEffect::Draw( Vertex *pVertices, UINT32 numVertices, PRIMITIVE_TYPE primit
         m_frameChanged = false;
     }
 
+    if (Displacement::IsEnabled())
+    {
+        m_displacedVertices.resize( m_numRippledVertices );
+        CHR(Displace( m_pRippledVertices, m_numRippledVertices, &m_displacedVertices[0] ));
+
+        // Already where the shader would put them.
+        CHR(OpenGLESEffect::Draw( &m_displacedVertices[0], m_numRippledVertices, PRIMITIVE_TYPE_TRIANGLE_LIST ));
+        goto Exit;
+    }
+
     // Assign values to shader parameters.
     // TODO: move to BeginPass()?
     VERIFYGL(glUseProgram(s_RippleShaderProgram));
@@ -247,7 +269,7 @@ RippleEffect::Draw( Vertex *pVertices, UINT32 numVertices, PRIMITIVE_TYPE primit
     VERIFYGL(glUniform1i(s_uTexture,        0));
     VERIFYGL(glUniform4f(s_uGlobalColor,    m_globalColor.floats.r, m_globalColor.floats.g, m_globalColor.floats.b, m_globalColor.floats.a));
     VERIFYGL(glUniform1f(s_uAmplitude,      m_fAmplitude));
-    VERIFYGL(glUniform1f(s_uTime,           m_fSpeed * GameTime.GetTimeDouble()));
+    VERIFYGL(glUniform1f(s_uTime,           m_fSpeed * GameTime.GetDrawTimeDouble()));
     VERIFYGL(glUniform1f(s_uRadius,         m_fRadius));
     VERIFYGL(glUniform1f(s_uHalfWaveLength, m_fWaveLength/2.0f));
     VERIFYGL(glUniform1f(s_uNumWaves,       m_fNumWaves));
@@ -255,15 +277,14 @@ RippleEffect::Draw( Vertex *pVertices, UINT32 numVertices, PRIMITIVE_TYPE primit
     VERIFYGL(glUniform4f(s_uColor,          m_color.floats.r, m_color.floats.g, m_color.floats.b, m_color.floats.a));
     
     // Draw the texture mapped onto the rippling mesh.
-    VERIFYGL(glVertexAttribPointer(ATTRIBUTE_VERTEX_POSITION,       3, GL_FLOAT,         GL_FALSE, sizeof(Vertex), &m_pRippledVertices->x));
-    VERIFYGL(glVertexAttribPointer(ATTRIBUTE_VERTEX_DIFFUSE,        4, GL_UNSIGNED_BYTE, GL_TRUE,  sizeof(Vertex), &m_pRippledVertices->color));
-    VERIFYGL(glVertexAttribPointer(ATTRIBUTE_VERTEX_TEXTURE_COORD0, 2, GL_FLOAT,         GL_FALSE, sizeof(Vertex), &m_pRippledVertices->texCoord[0]));
+    VertexStream::BindVertices( m_pRippledVertices, m_numRippledVertices );
 
     switch (primitiveType)
     {
         // NOTE: for this effect we ignore the passed-in vertices and draw a triangle list (GL_TRIANGLES) not a triangle strip (GL_TRIANGLE_STRIP).
         case PRIMITIVE_TYPE_TRIANGLE_STRIP:
         case PRIMITIVE_TYPE_TRIANGLE_LIST:
+        case PRIMITIVE_TYPE_QUAD_LIST:
             VERIFYGL(glDrawArrays(GL_TRIANGLES, 0, m_numRippledVertices));
             break;
         default:
@@ -430,6 +451,30 @@ RippleEffect::GetOrigin()
 
 
 
+RESULT
+RippleEffect::Displace( IN const Vertex* pIn, UINT32 numVertices, OUT Vertex* pOut )
+{
+    RESULT       rval = S_OK;
+    RippleParams params;
+
+    CPREx(pIn,  E_NULL_POINTER);
+    CPREx(pOut, E_NULL_POINTER);
+
+    // The same values Draw() hands the shader.
+    params.origin     = m_origin;
+    params.amplitude  = m_fAmplitude;
+    params.waveLength = m_fWaveLength;
+    params.radius     = m_fRadius;
+    params.time       = m_fSpeed * GameTime.GetDrawTimeDouble();
+
+    Displacement::Ripple( pIn, numVertices, params, pOut );
+
+Exit:
+    return rval;
+}
+
+
+
 RESULT 
 RippleEffect::InitScratchSurfaces( Rectangle& sourceRect, Rectangle& textureRect )
 {
@@ -455,11 +500,15 @@ RippleEffect::InitScratchSurfaces( Rectangle& sourceRect, Rectangle& textureRect
     float vStart    = textureRect.y;
     float vEnd      = textureRect.y + textureRect.height;
     
-    SAFE_ARRAY_DELETE(m_pRippledVertices);
+    if (m_pRippledVertices)
+    {
+        IGNOREHR(TessellationCache::Release( m_pRippledVertices ));
+        m_pRippledVertices   = NULL;
+        m_numRippledVertices = 0;
+    }
     
-    CHR(Util::CreateTriangleList( &paddedRect, m_rows, m_columns, &m_pRippledVertices, &m_numRippledVertices, uStart, uEnd, vStart, vEnd  ));
-
-    // TODO: create a VBO.
+    // Every instance drawing the same frame shares one grid.
+    CHR(TessellationCache::Acquire( paddedRect, m_rows, m_columns, uStart, uEnd, vStart, vEnd, &m_pRippledVertices, &m_numRippledVertices ));
 
 Exit:
     return rval;
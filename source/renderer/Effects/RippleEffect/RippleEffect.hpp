@@ -47,6 +47,9 @@ public:
     
     virtual HShader GetShader           ( );
     
+    // Apply the current ripple to pIn on the CPU, as the vertex shader would.
+    virtual RESULT Displace             ( IN const Vertex* pIn, UINT32 numVertices, OUT Vertex* pOut );
+
     virtual IProperty* GetProperty      ( const string& name ) const;
 
 protected:
@@ -63,8 +66,9 @@ protected:
 // Object data
 //----------------------------------------------------------------------------
 protected:
-    Vertex*         m_pRippledVertices;
+    const Vertex*   m_pRippledVertices;     // Shared; see TessellationCache.
     UINT32          m_numRippledVertices;
+    vector<Vertex>  m_displacedVertices;    // m_pRippledVertices, displaced on the CPU when Displacement::IsEnabled().
 
     UINT8           m_rows;
     UINT8           m_columns;
@@ -0,0 +1,232 @@
+/*
+ *  TessellationCache.cpp
+ *  Critters
+ *
+ *  Reference-counted tessellated grids, shared by the mesh Effects.
+ *
+ */
+
+#include "TessellationCache.hpp"
+#include "Util.hpp"
+#include "Macros.hpp"
+#include "Log.hpp"
+
+
+namespace Z
+{
+
+
+
+//
+// Static Data
+//
+TessellationCache::GridList TessellationCache::s_grids;
+UINT64                      TessellationCache::s_bytes      = 0;
+UINT32                      TessellationCache::s_releases   = 0;
+
+
+
+//
+// Class Methods
+//
+RESULT
+TessellationCache::Acquire( IN const Rectangle& rect, UINT32 rows, UINT32 columns, float uStart, float uEnd, float vStart, float vEnd,
+                            OUT const Vertex** ppVertices, OUT UINT32* pNumVertices )
+{
+    static MetricCounter* s_pHitsMetric     = Metrics::RegisterCounter( "Effects.GridHits"   );
+    static MetricCounter* s_pBuiltMetric    = Metrics::RegisterCounter( "Effects.GridsBuilt" );
+
+    RESULT  rval        = S_OK;
+    Grid    grid;
+
+    CPREx(ppVertices,   E_NULL_POINTER);
+    CPREx(pNumVertices, E_NULL_POINTER);
+    CBREx(rows && columns, E_INVALID_ARG);
+
+    for (GridList::iterator pItem = s_grids.begin(); pItem != s_grids.end(); ++pItem)
+    {
+        if (pItem->rows    == rows      &&
+            pItem->columns == columns   &&
+            pItem->uStart  == uStart    &&
+            pItem->uEnd    == uEnd      &&
+            pItem->vStart  == vStart    &&
+            pItem->vEnd    == vEnd      &&
+            Util::CompareRectangles( pItem->rect, rect ))
+        {
+            pItem->refCount++;
+            *ppVertices   = pItem->pVertices;
+            *pNumVertices = pItem->numVertices;
+
+            s_pHitsMetric->Increment();
+            goto Exit;
+        }
+    }
+
+    grid.rect         = rect;
+    grid.rows         = rows;
+    grid.columns      = columns;
+    grid.uStart       = uStart;
+    grid.uEnd         = uEnd;
+    grid.vStart       = vStart;
+    grid.vEnd         = vEnd;
+    grid.pVertices    = NULL;
+    grid.numVertices  = 0;
+    grid.refCount     = 1;
+    grid.lastReleased = 0;
+
+    CHR(Util::CreateTriangleList( &rect, rows, columns, &grid.pVertices, &grid.numVertices, uStart, uEnd, vStart, vEnd ));
+
+    s_grids.push_back( grid );
+    s_bytes += grid.numVertices * sizeof(Vertex);
+    s_pBuiltMetric->Increment();
+    UpdateMetrics();
+
+    DEBUGMSG(ZONE_RENDER, "TessellationCache: new %d x %d grid for (%4.2f, %4.2f) %4.2f x %4.2f; %d grids, %lld KB",
+        rows, columns, rect.x, rect.y, rect.width, rect.height, (int)s_grids.size(), (long long)(s_bytes / 1024));
+
+    *ppVertices   = grid.pVertices;
+    *pNumVertices = grid.numVertices;
+
+Exit:
+    return rval;
+}
+
+
+
+RESULT
+TessellationCache::AddRef( IN const Vertex* pVertices )
+{
+    RESULT              rval  = S_OK;
+    GridList::iterator  pItem = Find( pVertices );
+
+    if (pItem == s_grids.end())
+    {
+        RETAILMSG(ZONE_ERROR, "ERROR: TessellationCache::AddRef(): 0x%x is not a cached grid", pVertices);
+        rval = E_INVALID_ARG;
+        goto Exit;
+    }
+
+    pItem->refCount++;
+
+Exit:
+    return rval;
+}
+
+
+
+RESULT
+TessellationCache::Release( IN const Vertex* pVertices )
+{
+    RESULT              rval  = S_OK;
+    GridList::iterator  pItem = Find( pVertices );
+
+    if (pItem == s_grids.end())
+    {
+        RETAILMSG(ZONE_ERROR, "ERROR: TessellationCache::Release(): 0x%x is not a cached grid", pVertices);
+        rval = E_INVALID_ARG;
+        goto Exit;
+    }
+
+    DEBUGCHK(pItem->refCount > 0);
+    if (0 == --pItem->refCount)
+    {
+        pItem->lastReleased = ++s_releases;
+        Evict();
+    }
+
+Exit:
+    return rval;
+}
+
+
+
+void
+TessellationCache::Trim()
+{
+    GridList::iterator pItem = s_grids.begin();
+    while (pItem != s_grids.end())
+    {
+        if (pItem->refCount)
+        {
+            ++pItem;
+            continue;
+        }
+
+        s_bytes -= pItem->numVertices * sizeof(Vertex);
+        SAFE_ARRAY_DELETE(pItem->pVertices);
+        pItem = s_grids.erase( pItem );
+    }
+
+    UpdateMetrics();
+}
+
+
+
+TessellationCache::GridList::iterator
+TessellationCache::Find( IN const Vertex* pVertices )
+{
+    GridList::iterator pItem;
+
+    for (pItem = s_grids.begin(); pItem != s_grids.end(); ++pItem)
+    {
+        if (pItem->pVertices == pVertices)
+        {
+            break;
+        }
+    }
+
+    return pItem;
+}
+
+
+
+void
+TessellationCache::Evict()
+{
+    for (;;)
+    {
+        GridList::iterator  pOldest   = s_grids.end();
+        UINT32              numUnused = 0;
+
+        for (GridList::iterator pItem = s_grids.begin(); pItem != s_grids.end(); ++pItem)
+        {
+            if (pItem->refCount)
+            {
+                continue;
+            }
+
+            numUnused++;
+            if (pOldest == s_grids.end() || pItem->lastReleased < pOldest->lastReleased)
+            {
+                pOldest = pItem;
+            }
+        }
+
+        if (numUnused <= TESSELLATION_CACHE_MAX_UNUSED)
+        {
+            break;
+        }
+
+        s_bytes -= pOldest->numVertices * sizeof(Vertex);
+        SAFE_ARRAY_DELETE(pOldest->pVertices);
+        s_grids.erase( pOldest );
+    }
+
+    UpdateMetrics();
+}
+
+
+
+void
+TessellationCache::UpdateMetrics()
+{
+    static MetricGauge* s_pBytesMetric = Metrics::RegisterGauge( "Effects.GridBytes" );
+    static MetricGauge* s_pGridsMetric = Metrics::RegisterGauge( "Effects.Grids"     );
+
+    s_pBytesMetric->Set( (INT64)s_bytes );
+    s_pGridsMetric->Set( (INT64)s_grids.size() );
+}
+
+
+
+} // END namespace Z
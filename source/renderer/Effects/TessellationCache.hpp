@@ -0,0 +1,87 @@
+#pragma once
+
+#include "Types.hpp"
+#include "Errors.hpp"
+#include "Vertex.hpp"
+#include "Metrics.hpp"
+
+#include <vector>
+using std::vector;
+
+
+namespace Z
+{
+
+
+//
+// Tessellated grids shared by the mesh Effects (Ripple, Morph).
+//
+// Each Effect instance used to build and own its own copy of the grid it draws in
+// place of the caller's quad.  Grids are read-only once built, so every instance
+// with the same frame, tessellation and texture mapping can share one.  Acquire()
+// returns a reference-counted grid, building it on a miss.
+//
+// Unreferenced grids are kept (up to TESSELLATION_CACHE_MAX_UNUSED, oldest dropped
+// first) so that an Effect whose frame changes back and forth, or a Clone() of one,
+// doesn't rebuild.
+//
+// The cache is only touched from the render thread.
+//
+
+#define TESSELLATION_CACHE_MAX_UNUSED   8
+
+
+class TessellationCache
+{
+public:
+    // A triangle list of rows x columns cells over rect, as Util::CreateTriangleList() makes it.
+    static  RESULT  Acquire             ( IN const Rectangle& rect, UINT32 rows, UINT32 columns, float uStart, float uEnd, float vStart, float vEnd,
+                                          OUT const Vertex** ppVertices, OUT UINT32* pNumVertices );
+
+    // Take another reference to a grid returned by Acquire().
+    static  RESULT  AddRef              ( IN const Vertex* pVertices );
+    static  RESULT  Release             ( IN const Vertex* pVertices );
+
+    // Free every grid nobody references.
+    static  void    Trim                ( );
+
+    static  UINT32  GetNumGrids         ( )     { return (UINT32)s_grids.size(); }
+    static  UINT64  GetBytes            ( )     { return s_bytes; }
+
+protected:
+    struct Grid
+    {
+        Rectangle   rect;
+        UINT32      rows;
+        UINT32      columns;
+        float       uStart;
+        float       uEnd;
+        float       vStart;
+        float       vEnd;
+
+        Vertex*     pVertices;
+        UINT32      numVertices;
+        UINT32      refCount;
+        UINT32      lastReleased;   // s_releases when refCount last went to 0.
+    };
+
+    typedef vector<Grid> GridList;
+
+    static  GridList::iterator  Find    ( IN const Vertex* pVertices );
+    static  void    Evict               ( );
+    static  void    UpdateMetrics       ( );
+
+protected:
+    static  GridList        s_grids;
+    static  UINT64          s_bytes;
+    static  UINT32          s_releases;
+
+private:
+    TessellationCache();
+    TessellationCache( const TessellationCache& rhs );
+    TessellationCache& operator=( const TessellationCache& rhs );
+};
+
+
+
+} // END namespace Z
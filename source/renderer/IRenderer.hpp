@@ -76,6 +76,10 @@ public:
     virtual RESULT DrawTriangleList     ( IN Vertex *pVertices, UINT32 numVertices                      )   = 0;
     virtual RESULT DrawLines            ( IN Vertex *pVertices, UINT32 numVertices, float fWidth = 1.0f )   = 0;
     virtual RESULT DrawPointSprites     ( IN Vertex *pVertices, UINT32 numVertices, float fScale = 8.0f )   = 0;    // TODO: deprecate in favor of PointSpriteVertex w/o tex coords.
+
+    // numQuads * VERTS_PER_QUAD corners; see QuadList.hpp.
+    virtual RESULT DrawQuadList         ( IN Vertex       *pVertices, UINT32 numQuads                   )   = 0;
+    virtual RESULT DrawPackedQuadList   ( IN PackedVertex *pVertices, UINT32 numQuads                   )   = 0;
     
 //    virtual RESULT ScreenPointToRenderer( IN const vec2 inPoint, OUT vec2& outPoint ) = 0;
 
@@ -0,0 +1,791 @@
+/*
+ *  NullRenderer.cpp
+ *  Critters
+ *
+ *  An IRenderer that records commands instead of drawing them.
+ *  Used for headless profiling of frame construction and for
+ *  asserting draw-call / state-change counts in tests.
+ *
+ */
+
+#include "NullRenderer.hpp"
+#include "Log.hpp"
+#include "Macros.hpp"
+
+#include <stdio.h>
+#include <string.h>
+
+
+namespace Z
+{
+
+
+
+//
+// Static Data
+//
+NullRenderer*  NullRenderer::s_pInstance = NULL;
+
+static const char* s_commandNames[ RENDER_COMMAND_MAX ] =
+{
+    "None",
+    "BeginFrame",
+    "EndFrame",
+    "SetRenderTarget",
+    "Resize",
+    "Clear",
+    "EnableAlphaTest",
+    "EnableAlphaBlend",
+    "EnableDepthTest",
+    "EnableLighting",
+    "EnableTexturing",
+    "ShowOverdraw",
+    "SetBlendFunctions",
+    "SetGlobalColor",
+    "PushEffect",
+    "PopEffect",
+    "SetTexture",
+    "SetTextureID",
+    "SetModelViewMatrix",
+    "DrawTriangleStrip",
+    "DrawTriangleList",
+    "DrawLines",
+    "DrawPointSprites",
+    "DrawQuadList",
+    "DrawPackedQuadList",
+};
+
+
+
+//
+// Class Methods
+//
+NullRenderer*
+NullRenderer::Create()
+{
+    if (!s_pInstance)
+    {
+        s_pInstance = new NullRenderer();
+        DEBUGCHK(s_pInstance);
+    }
+
+    return s_pInstance;
+}
+
+
+
+const char*
+NullRenderer::GetCommandName( RENDER_COMMAND_TYPE type )
+{
+    if (type >= RENDER_COMMAND_MAX)
+        return "Unknown";
+
+    return s_commandNames[ type ];
+}
+
+
+
+UINT32
+NullRenderer::HashMatrix( const mat4& matrix )
+{
+    // FNV-1a over the raw bytes; good enough to tell matrices apart in a dump.
+    const BYTE* pBytes = (const BYTE*)matrix.Pointer();
+    UINT32      hash   = 2166136261u;
+
+    for (int i = 0; i < sizeof(float) * 16; ++i)
+    {
+        hash ^= pBytes[i];
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
+
+
+//
+// Instance Methods
+//
+NullRenderer::NullRenderer() :
+    m_pRenderContext(NULL),
+    m_pRenderTarget(NULL),
+    m_orientation(OrientationUnknown),
+    m_width(0),
+    m_height(0),
+    m_currentTextureID(0xFFFFFFFF),
+    m_currentModelViewHash(0),
+    m_globalColor(Color::White()),
+    m_alphaTestEnabled(false),
+    m_alphaBlendEnabled(false),
+    m_depthTestEnabled(false),
+    m_lightingEnabled(false),
+    m_texturingEnabled(true),
+    m_srcBlendFunction(0),
+    m_dstBlendFunction(0),
+    m_isRecording(true),
+    m_frameCount(0),
+    m_pDrawCallsMetric(Metrics::RegisterCounter("Renderer.DrawCalls")),
+    m_pVertexBytesMetric(Metrics::RegisterCounter("Renderer.VertexBytes"))
+{
+    RETAILMSG(ZONE_INFO, "Created NullRenderer");
+
+    m_name = "NullRenderer";
+
+    memset(&m_currentStats, 0, sizeof(m_currentStats));
+    memset(&m_frameStats,   0, sizeof(m_frameStats));
+
+    m_currentModelViewHash = HashMatrix( m_currentModelViewMatrix );
+}
+
+
+
+NullRenderer::~NullRenderer()
+{
+    RETAILMSG(ZONE_OBJECT | ZONE_VERBOSE, "\t~NullRenderer( %4d )", m_ID);
+    Deinit();
+
+    if (s_pInstance == this)
+    {
+        s_pInstance = NULL;
+    }
+}
+
+
+
+RESULT
+NullRenderer::Init( UINT32 width, UINT32 height )
+{
+    RESULT rval = S_OK;
+
+    if (!width || !height)
+    {
+        RETAILMSG(ZONE_ERROR, "ERROR: NullRenderer::Init( %lu, %lu ): invalid argument.", width, height);
+        rval = E_INVALID_ARG;
+        goto Exit;
+    }
+
+    DEBUGMSG(ZONE_INFO, "NullRenderer::Init()");
+
+    m_width  = width;
+    m_height = height;
+
+    m_commands.reserve( 4096 );
+
+Exit:
+    return rval;
+}
+
+
+
+RESULT
+NullRenderer::Deinit()
+{
+    DEBUGMSG(ZONE_INFO, "NullRenderer::Deinit()");
+
+    while (m_effectStack.size())
+    {
+        HEffect hEffect = m_effectStack.top();
+        m_effectStack.pop();
+
+        if (!hEffect.IsNull())
+            hEffect.Release();
+    }
+
+    m_hCurrentEffect = HEffect::NullHandle();
+    m_commands.clear();
+
+    SAFE_RELEASE(m_pRenderTarget);
+    SAFE_RELEASE(m_pRenderContext);
+
+    return S_OK;
+}
+
+
+
+RESULT
+NullRenderer::SetRenderContext( IN RenderContext* pContext )
+{
+    // The context is never bound; we only hold the reference so lifetime matches the GL renderers.
+    if (m_pRenderContext != pContext)
+    {
+        SAFE_RELEASE(m_pRenderContext);
+
+        m_pRenderContext = pContext;
+
+        if (m_pRenderContext)
+            m_pRenderContext->AddRef();
+    }
+
+    return S_OK;
+}
+
+
+
+RESULT
+NullRenderer::SetRenderTarget( IN RenderTarget* pTarget )
+{
+    bool redundant = (m_pRenderTarget == pTarget);
+
+    if (!redundant)
+    {
+        SAFE_RELEASE(m_pRenderTarget);
+
+        m_pRenderTarget = pTarget;
+
+        if (m_pRenderTarget)
+            m_pRenderTarget->AddRef();
+    }
+
+    Record( RENDER_COMMAND_SET_RENDER_TARGET, pTarget ? pTarget->GetTextureID() : 0, 0, redundant );
+
+    return S_OK;
+}
+
+
+
+RESULT
+NullRenderer::Resize( UINT32 width, UINT32 height )
+{
+    m_width  = width;
+    m_height = height;
+
+    Record( RENDER_COMMAND_RESIZE, width, height );
+
+    return S_OK;
+}
+
+
+
+RESULT
+NullRenderer::Rotate( Orientation orientation )
+{
+    m_orientation = orientation;
+
+    return S_OK;
+}
+
+
+
+UINT32
+NullRenderer::GetWidth()
+{
+    return m_width;
+}
+
+
+
+UINT32
+NullRenderer::GetHeight()
+{
+    return m_height;
+}
+
+
+
+RESULT
+NullRenderer::Clear( Color color )
+{
+    Record( RENDER_COMMAND_CLEAR, (UINT32)color );
+
+    return S_OK;
+}
+
+
+
+RESULT
+NullRenderer::Clear( float r, float g, float b, float a )
+{
+    return Clear( Color( r, g, b, a ) );
+}
+
+
+
+#pragma mark -
+#pragma mark State
+RESULT
+NullRenderer::EnableAlphaTest( bool enabled )
+{
+    Record( RENDER_COMMAND_ENABLE_ALPHA_TEST, enabled, 0, m_alphaTestEnabled == enabled );
+    m_alphaTestEnabled = enabled;
+
+    return S_OK;
+}
+
+
+
+RESULT
+NullRenderer::EnableAlphaBlend( bool enabled )
+{
+    Record( RENDER_COMMAND_ENABLE_ALPHA_BLEND, enabled, 0, m_alphaBlendEnabled == enabled );
+    m_alphaBlendEnabled = enabled;
+
+    return S_OK;
+}
+
+
+
+RESULT
+NullRenderer::EnableDepthTest( bool enabled )
+{
+    Record( RENDER_COMMAND_ENABLE_DEPTH_TEST, enabled, 0, m_depthTestEnabled == enabled );
+    m_depthTestEnabled = enabled;
+
+    return S_OK;
+}
+
+
+
+RESULT
+NullRenderer::EnableLighting( bool enabled )
+{
+    Record( RENDER_COMMAND_ENABLE_LIGHTING, enabled, 0, m_lightingEnabled == enabled );
+    m_lightingEnabled = enabled;
+
+    return S_OK;
+}
+
+
+
+RESULT
+NullRenderer::EnableTexturing( bool enabled )
+{
+    Record( RENDER_COMMAND_ENABLE_TEXTURING, enabled, 0, m_texturingEnabled == enabled );
+    m_texturingEnabled = enabled;
+
+    return S_OK;
+}
+
+
+
+RESULT
+NullRenderer::ShowOverdraw( bool show )
+{
+    Record( RENDER_COMMAND_SHOW_OVERDRAW, show );
+
+    return S_OK;
+}
+
+
+
+RESULT
+NullRenderer::SetBlendFunctions( UINT32 srcFunction, UINT32 dstFunction )
+{
+    bool redundant = (m_srcBlendFunction == srcFunction && m_dstBlendFunction == dstFunction);
+
+    m_srcBlendFunction = srcFunction;
+    m_dstBlendFunction = dstFunction;
+
+    Record( RENDER_COMMAND_SET_BLEND_FUNCTIONS, srcFunction, dstFunction, redundant );
+
+    return S_OK;
+}
+
+
+
+RESULT
+NullRenderer::SetGlobalColor( Color color )
+{
+    UINT32 rgba = (UINT32)color;
+
+    Record( RENDER_COMMAND_SET_GLOBAL_COLOR, rgba, 0, (UINT32)m_globalColor == rgba );
+    m_globalColor = color;
+
+    return S_OK;
+}
+
+
+
+RESULT
+NullRenderer::BeginFrame()
+{
+    // Each frame starts with an empty command buffer, so a Dump() after
+    // EndFrame() holds exactly one frame.
+    m_commands.clear();
+    memset(&m_currentStats, 0, sizeof(m_currentStats));
+
+    Record( RENDER_COMMAND_BEGIN_FRAME, m_frameCount );
+
+    return S_OK;
+}
+
+
+
+RESULT
+NullRenderer::EndFrame()
+{
+    RESULT rval = S_OK;
+
+    Record( RENDER_COMMAND_END_FRAME, m_frameCount );
+
+    m_frameStats = m_currentStats;
+    m_frameCount++;
+
+    if (m_dumpFilename.length())
+    {
+        CHR(Dump( m_dumpFilename ));
+    }
+
+    DEBUGMSG(ZONE_RENDER | ZONE_VERBOSE, "NullRenderer::EndFrame(): %lu commands %lu draws %lu verts %lu vertex bytes %lu effect changes %lu texture changes",
+             m_frameStats.numCommands, m_frameStats.numDrawCalls, m_frameStats.numVertices, m_frameStats.numVertexBytes,
+             m_frameStats.numEffectChanges, m_frameStats.numTextureChanges);
+
+Exit:
+    return rval;
+}
+
+
+
+void
+NullRenderer::ResetStats()
+{
+    memset(&m_currentStats, 0, sizeof(m_currentStats));
+    memset(&m_frameStats,   0, sizeof(m_frameStats));
+    m_frameCount = 0;
+}
+
+
+
+#pragma mark -
+#pragma mark Effect
+RESULT
+NullRenderer::PushEffect( IN HEffect hEffect )
+{
+    m_effectStack.push( hEffect );
+
+    if (!hEffect.IsNull())
+    {
+        hEffect.AddRef();
+    }
+
+    m_currentStats.numEffectPushes++;
+
+    bool redundant = (hEffect == m_hCurrentEffect);
+    if (!redundant)
+    {
+        m_hCurrentEffect = hEffect;
+        m_currentStats.numEffectChanges++;
+    }
+
+    Record( RENDER_COMMAND_PUSH_EFFECT, (UINT32)hEffect, m_effectStack.size(), redundant );
+
+    return S_OK;
+}
+
+
+
+RESULT
+NullRenderer::PopEffect( INOUT HEffect* phEffect )
+{
+    RESULT  rval = S_OK;
+    HEffect hPreviousEffect;
+    HEffect hNewEffect;
+
+    CBR( m_effectStack.size() > 0 );
+
+    hPreviousEffect = m_effectStack.top();
+    m_effectStack.pop();
+
+    if (phEffect)
+    {
+        *phEffect = hPreviousEffect;
+    }
+
+    if (m_effectStack.size() > 0)
+    {
+        hNewEffect = m_effectStack.top();
+    }
+
+    m_currentStats.numEffectPops++;
+
+    {
+    bool redundant = (hNewEffect == m_hCurrentEffect);
+    if (!redundant)
+    {
+        m_hCurrentEffect = hNewEffect;
+        m_currentStats.numEffectChanges++;
+    }
+
+    Record( RENDER_COMMAND_POP_EFFECT, (UINT32)hPreviousEffect, m_effectStack.size(), redundant );
+    }
+
+    if (!hPreviousEffect.IsNull())
+    {
+        hPreviousEffect.Release();
+    }
+
+Exit:
+    return rval;
+}
+
+
+
+RESULT
+NullRenderer::GetEffect( INOUT HEffect* phEffect )
+{
+    RESULT rval = S_OK;
+
+    CPREx(phEffect, E_NULL_POINTER);
+    *phEffect = m_hCurrentEffect;
+
+Exit:
+    return rval;
+}
+
+
+
+#pragma mark -
+#pragma mark Texture
+RESULT
+NullRenderer::SetTexture( IN UINT8 textureUnit, IN HTexture hTexture )
+{
+    bool redundant = (hTexture == m_hCurrentTexture);
+
+    m_currentStats.numTextureBinds++;
+    if (!redundant)
+    {
+        m_currentStats.numTextureChanges++;
+    }
+
+    m_hCurrentTexture  = hTexture;
+    m_currentTextureID = 0xFFFFFFFF;
+
+    Record( RENDER_COMMAND_SET_TEXTURE, (UINT32)hTexture, 0, redundant, textureUnit );
+
+    return S_OK;
+}
+
+
+
+RESULT
+NullRenderer::SetTexture( IN UINT8 textureUnit, IN UINT32 textureID )
+{
+    bool redundant = (textureID == m_currentTextureID);
+
+    m_currentStats.numTextureBinds++;
+    if (!redundant)
+    {
+        m_currentStats.numTextureChanges++;
+    }
+
+    m_currentTextureID = textureID;
+
+    Record( RENDER_COMMAND_SET_TEXTURE_ID, textureID, 0, redundant, textureUnit );
+
+    return S_OK;
+}
+
+
+
+RESULT
+NullRenderer::GetTexture( INOUT HTexture* phTexture )
+{
+    RESULT rval = S_OK;
+
+    CPREx(phTexture, E_NULL_POINTER);
+    *phTexture = m_hCurrentTexture;
+
+Exit:
+    return rval;
+}
+
+
+
+#pragma mark -
+#pragma mark Matrix
+RESULT
+NullRenderer::SetModelViewMatrix( IN const mat4& matrix )
+{
+    UINT32 hash      = HashMatrix( matrix );
+    bool   redundant = (hash == m_currentModelViewHash);
+
+    if (!redundant)
+    {
+        m_currentStats.numMatrixChanges++;
+    }
+
+    m_currentModelViewMatrix = matrix;
+    m_currentModelViewHash   = hash;
+
+    Record( RENDER_COMMAND_SET_MODELVIEW_MATRIX, hash, 0, redundant );
+
+    return S_OK;
+}
+
+
+
+RESULT
+NullRenderer::GetModelViewMatrix( INOUT mat4* pMatrix )
+{
+    RESULT rval = S_OK;
+
+    CPREx(pMatrix, E_NULL_POINTER);
+    *pMatrix = m_currentModelViewMatrix;
+
+Exit:
+    return rval;
+}
+
+
+
+#pragma mark -
+#pragma mark Drawing
+RESULT
+NullRenderer::DrawTriangleStrip( IN Vertex* pVertices, UINT32 numVertices )
+{
+    return Draw( RENDER_COMMAND_DRAW_TRIANGLE_STRIP, pVertices, numVertices );
+}
+
+
+
+RESULT
+NullRenderer::DrawTriangleList( IN Vertex* pVertices, UINT32 numVertices )
+{
+    return Draw( RENDER_COMMAND_DRAW_TRIANGLE_LIST, pVertices, numVertices );
+}
+
+
+
+RESULT
+NullRenderer::DrawLines( IN Vertex* pVertices, UINT32 numVertices, float fWidth )
+{
+    return Draw( RENDER_COMMAND_DRAW_LINES, pVertices, numVertices );
+}
+
+
+
+RESULT
+NullRenderer::DrawPointSprites( IN Vertex* pVertices, UINT32 numVertices, float fScale )
+{
+    return Draw( RENDER_COMMAND_DRAW_POINT_SPRITES, pVertices, numVertices );
+}
+
+
+
+RESULT
+NullRenderer::DrawQuadList( IN Vertex* pVertices, UINT32 numQuads )
+{
+    return Draw( RENDER_COMMAND_DRAW_QUAD_LIST, pVertices, numQuads * VERTS_PER_QUAD );
+}
+
+
+
+RESULT
+NullRenderer::DrawPackedQuadList( IN PackedVertex* pVertices, UINT32 numQuads )
+{
+    return Draw( RENDER_COMMAND_DRAW_PACKED_QUAD_LIST, pVertices, numQuads * VERTS_PER_QUAD, sizeof(PackedVertex) );
+}
+
+
+
+RESULT
+NullRenderer::Draw( RENDER_COMMAND_TYPE type, IN const void* pVertices, UINT32 numVertices, UINT32 vertexSize )
+{
+    RESULT rval = S_OK;
+
+    CPREx(pVertices, E_NULL_POINTER);
+
+    if (0 == numVertices)
+    {
+        RETAILMSG(ZONE_WARN, "WARNING: NullRenderer::%s(): numVertices == 0", GetCommandName(type));
+        return S_OK;
+    }
+
+    m_currentStats.numDrawCalls++;
+    m_pDrawCallsMetric->Increment();
+    m_currentStats.numVertices += numVertices;
+    m_currentStats.numVertexBytes += numVertices * vertexSize;
+    m_pVertexBytesMetric->Add( numVertices * vertexSize );
+
+    Record( type, numVertices, (UINT32)m_hCurrentEffect );
+
+Exit:
+    return rval;
+}
+
+
+
+#pragma mark -
+#pragma mark Command Buffer
+void
+NullRenderer::Record( RENDER_COMMAND_TYPE type, UINT32 arg0, UINT32 arg1, bool redundant, UINT8 textureUnit )
+{
+    m_currentStats.numCommands++;
+
+    if (redundant)
+    {
+        m_currentStats.numRedundantCommands++;
+    }
+    else if (type >= RENDER_COMMAND_CLEAR && type <= RENDER_COMMAND_SET_GLOBAL_COLOR)
+    {
+        m_currentStats.numStateChanges++;
+    }
+
+    if (!m_isRecording)
+        return;
+
+    RenderCommand command;
+    command.type        = (UINT8)type;
+    command.textureUnit = textureUnit;
+    command.redundant   = redundant ? 1 : 0;
+    command.reserved    = 0;
+    command.arg0        = (uint32_t)arg0;
+    command.arg1        = (uint32_t)arg1;
+
+    m_commands.push_back( command );
+}
+
+
+
+RESULT
+NullRenderer::Dump( IN const string& filename )
+{
+    RESULT  rval  = S_OK;
+    FILE*   pFile = NULL;
+
+    pFile = fopen( filename.c_str(), "w" );
+    if (!pFile)
+    {
+        RETAILMSG(ZONE_ERROR, "ERROR: NullRenderer::Dump( \"%s\" ): can't open file", filename.c_str());
+        rval = E_FILE_NOT_FOUND;
+        goto Exit;
+    }
+
+    // One command per line, no pointers or timestamps, so two dumps can be diffed directly.
+    for (UINT32 i = 0; i < m_commands.size(); ++i)
+    {
+        const RenderCommand& command = m_commands[i];
+
+        fprintf( pFile, "%-20s unit:%d arg0:0x%08x arg1:0x%08x%s\n",
+                 GetCommandName( (RENDER_COMMAND_TYPE)command.type ),
+                 command.textureUnit,
+                 command.arg0,
+                 command.arg1,
+                 command.redundant ? " (redundant)" : "" );
+    }
+
+    fprintf( pFile, "# commands:%lu draws:%lu verts:%lu vertexBytes:%lu pushes:%lu pops:%lu effectChanges:%lu textureBinds:%lu textureChanges:%lu matrixChanges:%lu stateChanges:%lu redundant:%lu\n",
+             m_currentStats.numCommands,
+             m_currentStats.numDrawCalls,
+             m_currentStats.numVertices,
+             m_currentStats.numVertexBytes,
+             m_currentStats.numEffectPushes,
+             m_currentStats.numEffectPops,
+             m_currentStats.numEffectChanges,
+             m_currentStats.numTextureBinds,
+             m_currentStats.numTextureChanges,
+             m_currentStats.numMatrixChanges,
+             m_currentStats.numStateChanges,
+             m_currentStats.numRedundantCommands );
+
+Exit:
+    if (pFile)
+    {
+        fclose( pFile );
+    }
+
+    return rval;
+}
+
+
+
+} // END namespace Z
@@ -0,0 +1,223 @@
+#pragma once
+
+#include "Object.hpp"
+#include "Errors.hpp"
+#include "IRenderer.hpp"
+#include "Metrics.hpp"
+#include "QuadList.hpp"
+
+#include <stack>
+#include <vector>
+using std::stack;
+using std::vector;
+
+
+namespace Z
+{
+
+
+//
+// A renderer that never touches the GPU.
+//
+// Every IRenderer call is recorded into a compact command buffer and tallied, so
+// the CPU side of the frame (LayerMan.Draw, SpriteBatches, fonts, particles) can be
+// profiled and regression-tested on a machine without OpenGL.
+//
+// Enable with Settings.bUseNullRenderer = "1", or create one directly in a test.
+//
+
+
+typedef enum
+{
+    RENDER_COMMAND_NONE = 0,
+    RENDER_COMMAND_BEGIN_FRAME,
+    RENDER_COMMAND_END_FRAME,
+    RENDER_COMMAND_SET_RENDER_TARGET,
+    RENDER_COMMAND_RESIZE,
+    RENDER_COMMAND_CLEAR,
+    RENDER_COMMAND_ENABLE_ALPHA_TEST,
+    RENDER_COMMAND_ENABLE_ALPHA_BLEND,
+    RENDER_COMMAND_ENABLE_DEPTH_TEST,
+    RENDER_COMMAND_ENABLE_LIGHTING,
+    RENDER_COMMAND_ENABLE_TEXTURING,
+    RENDER_COMMAND_SHOW_OVERDRAW,
+    RENDER_COMMAND_SET_BLEND_FUNCTIONS,
+    RENDER_COMMAND_SET_GLOBAL_COLOR,
+    RENDER_COMMAND_PUSH_EFFECT,
+    RENDER_COMMAND_POP_EFFECT,
+    RENDER_COMMAND_SET_TEXTURE,
+    RENDER_COMMAND_SET_TEXTURE_ID,
+    RENDER_COMMAND_SET_MODELVIEW_MATRIX,
+    RENDER_COMMAND_DRAW_TRIANGLE_STRIP,
+    RENDER_COMMAND_DRAW_TRIANGLE_LIST,
+    RENDER_COMMAND_DRAW_LINES,
+    RENDER_COMMAND_DRAW_POINT_SPRITES,
+    RENDER_COMMAND_DRAW_QUAD_LIST,
+    RENDER_COMMAND_DRAW_PACKED_QUAD_LIST,
+
+    RENDER_COMMAND_MAX
+} RENDER_COMMAND_TYPE;
+
+
+// 12 bytes per command; the meaning of arg0/arg1 depends on the type.
+//  DRAW_*:                 arg0 = numVertices,     arg1 = bound Effect handle
+//  PUSH/POP_EFFECT:        arg0 = Effect handle,   arg1 = stack depth after the call
+//  SET_TEXTURE[_ID]:       arg0 = texture handle or GL id
+//  SET_RENDER_TARGET:      arg0 = the target's GL texture id, 0 for the screen
+//  SET_MODELVIEW_MATRIX:   arg0 = hash of the 16 floats
+//  SET_GLOBAL_COLOR/CLEAR: arg0 = packed RGBA
+//  ENABLE_*:               arg0 = 0 or 1
+struct RenderCommand
+{
+    UINT8       type;
+    UINT8       textureUnit;
+    UINT8       redundant;      // 1 if the call did not change any renderer state
+    UINT8       reserved;
+    uint32_t    arg0;           // Not UINT32, which is 8 bytes on arm64.
+    uint32_t    arg1;
+};
+STATIC_ASSERT(sizeof(RenderCommand) == 12, RenderCommand_size);
+
+
+struct RenderStats
+{
+    UINT32  numCommands;
+    UINT32  numDrawCalls;
+    UINT32  numVertices;
+    UINT32  numVertexBytes;
+    UINT32  numEffectPushes;
+    UINT32  numEffectPops;
+    UINT32  numEffectChanges;
+    UINT32  numTextureBinds;
+    UINT32  numTextureChanges;
+    UINT32  numMatrixChanges;
+    UINT32  numStateChanges;
+    UINT32  numRedundantCommands;
+};
+
+
+
+class NullRenderer : virtual public Object, public IRenderer
+{
+public:
+    // Factory method
+    static  NullRenderer* Create();
+    virtual ~NullRenderer();
+
+
+    // IRenderer
+    virtual RESULT Init                 ( UINT32 width, UINT32 height );
+    virtual RESULT Deinit               ( );
+
+    virtual RESULT SetRenderContext     ( IN RenderContext* pContext );
+    virtual RESULT SetRenderTarget      ( IN RenderTarget*  pTarget  );
+
+    virtual RESULT Resize               ( UINT32 width, UINT32 height );
+    virtual RESULT Rotate               ( Orientation orientation );
+    virtual UINT32 GetWidth             ( );
+    virtual UINT32 GetHeight            ( );
+
+    virtual RESULT Clear                ( Color color );
+    virtual RESULT Clear                ( float r, float g, float b, float a );
+
+    virtual RESULT EnableAlphaTest      ( bool enabled );
+    virtual RESULT EnableAlphaBlend     ( bool enabled );
+    virtual RESULT EnableDepthTest      ( bool enabled );
+    virtual RESULT EnableLighting       ( bool enabled );
+    virtual RESULT EnableTexturing      ( bool enabled );
+    virtual RESULT ShowOverdraw         ( bool show    );
+    virtual RESULT SetBlendFunctions    ( UINT32 srcFunction, UINT32 dstFunction );
+    virtual RESULT SetGlobalColor       ( Color color = Color::White() );
+
+    virtual RESULT BeginFrame           ( );
+    virtual RESULT EndFrame             ( );
+
+    virtual RESULT PushEffect           ( IN    HEffect  hEffect             );
+    virtual RESULT PopEffect            ( INOUT HEffect* phEffect = NULL     );
+    virtual RESULT GetEffect            ( INOUT HEffect* phEffect            );
+
+    virtual RESULT SetTexture           ( IN    UINT8     textureUnit, IN UINT32 textureID   );
+    virtual RESULT SetTexture           ( IN    UINT8     textureUnit, IN HTexture hTexture  );
+    virtual RESULT GetTexture           ( INOUT HTexture* phTexture );
+
+    virtual RESULT SetModelViewMatrix   ( IN    const mat4& matrix  );
+    virtual RESULT GetModelViewMatrix   ( INOUT       mat4* pMatrix );
+
+    virtual RESULT DrawTriangleStrip    ( IN Vertex* pVertices, UINT32 numVertices );
+    virtual RESULT DrawTriangleList     ( IN Vertex *pVertices, UINT32 numVertices );
+    virtual RESULT DrawLines            ( IN Vertex *pVertices, UINT32 numVertices, float fWidth );
+    virtual RESULT DrawPointSprites     ( IN Vertex *pVertices, UINT32 numVertices, float fScale );
+    virtual RESULT DrawQuadList         ( IN Vertex       *pVertices, UINT32 numQuads );
+    virtual RESULT DrawPackedQuadList   ( IN PackedVertex *pVertices, UINT32 numQuads );
+
+
+    // Command buffer
+    void                    SetRecording    ( bool enabled )    { m_isRecording = enabled; }
+    bool                    IsRecording     ( ) const           { return m_isRecording;    }
+    UINT32                  GetNumCommands  ( ) const           { return m_commands.size(); }
+    const RenderCommand*    GetCommands     ( ) const           { return m_commands.size() ? &m_commands[0] : NULL; }
+    RESULT                  Dump            ( IN const string& filename );
+    void                    DumpEveryFrame  ( IN const string& filename )   { m_dumpFilename = filename; }
+
+    // Counters for the frame in progress, and for the last completed frame.
+    const RenderStats&      GetCurrentStats ( ) const           { return m_currentStats;   }
+    const RenderStats&      GetFrameStats   ( ) const           { return m_frameStats;     }
+    UINT32                  GetFrameCount   ( ) const           { return m_frameCount;     }
+    void                    ResetStats      ( );
+
+    static const char*      GetCommandName  ( RENDER_COMMAND_TYPE type );
+
+protected:
+    NullRenderer();
+    NullRenderer(const NullRenderer& rhs);
+    const NullRenderer& operator=(const NullRenderer& rhs);
+
+    void    Record  ( RENDER_COMMAND_TYPE type, UINT32 arg0 = 0, UINT32 arg1 = 0, bool redundant = false, UINT8 textureUnit = 0 );
+    RESULT  Draw    ( RENDER_COMMAND_TYPE type, IN const void* pVertices, UINT32 numVertices, UINT32 vertexSize = sizeof(Vertex) );
+
+    static UINT32 HashMatrix( const mat4& matrix );
+
+
+protected:
+    static NullRenderer*    s_pInstance;
+
+    RenderContext*  m_pRenderContext;
+    RenderTarget*   m_pRenderTarget;
+
+    Orientation     m_orientation;
+    UINT32          m_width;
+    UINT32          m_height;
+
+    typedef stack<HEffect> EffectStack;
+    EffectStack     m_effectStack;
+    HEffect         m_hCurrentEffect;
+
+    HTexture        m_hCurrentTexture;
+    UINT32          m_currentTextureID;
+    mat4            m_currentModelViewMatrix;
+    UINT32          m_currentModelViewHash;
+    Color           m_globalColor;
+
+    bool            m_alphaTestEnabled;
+    bool            m_alphaBlendEnabled;
+    bool            m_depthTestEnabled;
+    bool            m_lightingEnabled;
+    bool            m_texturingEnabled;
+    UINT32          m_srcBlendFunction;
+    UINT32          m_dstBlendFunction;
+
+    typedef vector<RenderCommand> RenderCommandList;
+    RenderCommandList   m_commands;
+    bool                m_isRecording;
+    string              m_dumpFilename;
+
+    RenderStats         m_currentStats;
+    RenderStats         m_frameStats;
+    UINT32              m_frameCount;
+    MetricCounter*      m_pDrawCallsMetric;
+    MetricCounter*      m_pVertexBytesMetric;
+};
+
+
+
+} // END namespace Z
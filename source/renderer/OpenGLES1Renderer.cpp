@@ -76,6 +76,8 @@ OpenGLES1Renderer::OpenGLES1Renderer() :
     m_currentDrawCalls(0),
     m_totalDrawCalls(0),
     m_drawsPerSecond(0),
+    m_pDrawCallsMetric(Metrics::RegisterCounter("Renderer.DrawCalls")),
+    m_pVertexBytesMetric(Metrics::RegisterCounter("Renderer.VertexBytes")),
     m_currentAngleDegrees(0),
     m_depthTestEnabled(false),
     m_currentTextureID(0xFFFFFFFF),
@@ -829,6 +831,8 @@ OpenGLES1Renderer::DrawTriangleStrip( IN Vertex *pVertices, UINT32 numVertices )
     //
     VERIFYGL(glDrawArrays(GL_TRIANGLE_STRIP, 0, numVertices));
     m_currentDrawCalls++;
+    m_pDrawCallsMetric->Increment();
+    m_pVertexBytesMetric->Add( numVertices * sizeof(Vertex) );
     
     
 Exit:
@@ -863,6 +867,8 @@ OpenGLES1Renderer::DrawTriangleList( IN Vertex *pVertices, UINT32 numVertices )
     
     VERIFYGL(glDrawArrays(GL_TRIANGLES, 0, numVertices));
     m_currentDrawCalls++;
+    m_pDrawCallsMetric->Increment();
+    m_pVertexBytesMetric->Add( numVertices * sizeof(Vertex) );
     
     
 Exit:
@@ -871,6 +877,73 @@ Exit:
 
 
 
+RESULT
+OpenGLES1Renderer::DrawQuadList( IN Vertex *pVertices, UINT32 numQuads )
+{
+    RESULT rval = S_OK;
+    
+    CPREx(pVertices, E_NULL_POINTER);
+    
+    if (0 == numQuads)
+    {
+        RETAILMSG(ZONE_WARN, "WARNING: OpenGLES1Renderer::DrawQuadList(): numQuads == 0");
+        return S_OK;
+    }    
+    
+    //
+    // Enable vertex fields
+    //
+    VERIFYGL(glEnableClientState(GL_VERTEX_ARRAY));
+    VERIFYGL(glEnableClientState(GL_COLOR_ARRAY));
+    VERIFYGL(glEnableClientState(GL_TEXTURE_COORD_ARRAY));
+    
+    // One draw per QUAD_LIST_MAX_QUADS, so the shared UINT16 indices can address every corner.
+    while (numQuads)
+    {
+        UINT32 count = MIN(numQuads, QUAD_LIST_MAX_QUADS);
+
+        VERIFYGL(glVertexPointer  (3, GL_FLOAT,         sizeof(Vertex), &pVertices->position[0]));
+        VERIFYGL(glColorPointer   (4, GL_UNSIGNED_BYTE, sizeof(Vertex), &pVertices->color));
+        VERIFYGL(glTexCoordPointer(2, GL_FLOAT,         sizeof(Vertex), &pVertices->texCoord[0]));
+    
+        VERIFYGL(glDrawElements(GL_TRIANGLES, count * INDICES_PER_QUAD, GL_UNSIGNED_SHORT, QuadList::GetIndices( count )));
+        m_currentDrawCalls++;
+        m_pDrawCallsMetric->Increment();
+        m_pVertexBytesMetric->Add( count * VERTS_PER_QUAD * sizeof(Vertex) );
+
+        pVertices += count * VERTS_PER_QUAD;
+        numQuads  -= count;
+    }
+    
+Exit:
+    return rval;
+}
+
+
+
+RESULT
+OpenGLES1Renderer::DrawPackedQuadList( IN PackedVertex *pVertices, UINT32 numQuads )
+{
+    RESULT rval = S_OK;
+    
+    CPREx(pVertices, E_NULL_POINTER);
+    
+    if (0 == numQuads)
+    {
+        RETAILMSG(ZONE_WARN, "WARNING: OpenGLES1Renderer::DrawPackedQuadList(): numQuads == 0");
+        return S_OK;
+    }    
+
+    m_unpackedVertices.resize( numQuads * VERTS_PER_QUAD );
+    QuadList::Unpack( pVertices, numQuads * VERTS_PER_QUAD, &m_unpackedVertices[0] );
+    CHR(DrawQuadList( &m_unpackedVertices[0], numQuads ));
+    
+Exit:
+    return rval;
+}
+
+
+
 RESULT 
 OpenGLES1Renderer::DrawPointSprites( IN Vertex *pVertices, UINT32 numVertices, float fScale )
 {
@@ -902,6 +975,8 @@ OpenGLES1Renderer::DrawPointSprites( IN Vertex *pVertices, UINT32 numVertices, f
     //
     VERIFYGL(glDrawArrays(GL_POINTS, 0, numVertices));
     m_currentDrawCalls++;
+    m_pDrawCallsMetric->Increment();
+    m_pVertexBytesMetric->Add( numVertices * sizeof(Vertex) );
     
     
 Exit:
@@ -936,6 +1011,8 @@ OpenGLES1Renderer::DrawLines( IN Vertex *pVertices, UINT32 numVertices, float fW
     VERIFYGL(glLineWidth(fWidth));
     VERIFYGL(glDrawArrays(GL_LINES, 0, numVertices));
     m_currentDrawCalls++;
+    m_pDrawCallsMetric->Increment();
+    m_pVertexBytesMetric->Add( numVertices * sizeof(Vertex) );
     
     
 Exit:
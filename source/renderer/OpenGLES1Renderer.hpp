@@ -3,8 +3,10 @@
 #include "Errors.hpp"
 #include "IRenderer.hpp"
 #include "PerfTimer.hpp"
+#include "Metrics.hpp"
 #include "TextureManager.hpp"
 #include "EffectManager.hpp"
+#include "QuadList.hpp"
 
 
 #include <stack>
@@ -67,6 +69,8 @@ public:
     virtual RESULT DrawTriangleList     ( IN Vertex *pVertices, UINT32 numVertices );
     virtual RESULT DrawLines            ( IN Vertex *pVertices, UINT32 numVertices, float fWidth );
     virtual RESULT DrawPointSprites     ( IN Vertex *pVertices, UINT32 numVertices, float fScale );
+    virtual RESULT DrawQuadList         ( IN Vertex       *pVertices, UINT32 numQuads );
+    virtual RESULT DrawPackedQuadList   ( IN PackedVertex *pVertices, UINT32 numQuads );
 
 protected:
     OpenGLES1Renderer();
@@ -115,6 +119,11 @@ protected:
     UINT32          m_currentDrawCalls;
     UINT32          m_totalDrawCalls;
     float           m_drawsPerSecond;
+    MetricCounter*  m_pDrawCallsMetric;
+    MetricCounter*  m_pVertexBytesMetric;
+
+    // OpenGL ES 1.x has no normalized texture coordinates; PackedVertices are converted here.
+    vector<Vertex>  m_unpackedVertices;
    
     // TEST
     UINT16          m_currentAngleDegrees;
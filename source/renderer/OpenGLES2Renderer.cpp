@@ -19,6 +19,7 @@
 #include "ShaderManager.hpp"
 #include "RenderContext.hpp"
 #include "FontManager.hpp"
+#include "VertexStream.hpp"
 
 
 namespace Z
@@ -72,6 +73,8 @@ OpenGLES2Renderer::OpenGLES2Renderer() :
     m_currentDrawCalls(0),
     m_totalDrawCalls(0),
     m_drawsPerSecond(0),
+    m_pDrawCallsMetric(Metrics::RegisterCounter("Renderer.DrawCalls")),
+    m_pVertexBytesMetric(Metrics::RegisterCounter("Renderer.VertexBytes")),
     m_currentAngleDegrees(0),
     m_depthTestEnabled(false),
     m_defaultShaderProgram(0xFFFFFFFF),
@@ -147,6 +150,9 @@ OpenGLES2Renderer::Init( UINT32 width, UINT32 height )
     VERIFYGL(glEnableVertexAttribArray(ATTRIBUTE_VERTEX_DIFFUSE));
     VERIFYGL(glEnableVertexAttribArray(ATTRIBUTE_VERTEX_TEXTURE_COORD0));
 
+    // Without buffer objects we still draw, from client arrays.
+    IGNOREHR(VertexStream::Init());
+
     CHR(Resize( width, height ));
     
     CHR(Renderer.SetModelViewMatrix( GameCamera.GetViewMatrix() ));
@@ -229,6 +235,7 @@ OpenGLES2Renderer::Deinit()
     m_hCurrentEffect.Release();
     m_hDefaultEffect.Release();
 
+    IGNOREHR(VertexStream::Deinit());
     
     // 
     // Unbind and delete the Frame Buffer Object
@@ -530,6 +537,8 @@ OpenGLES2Renderer::BeginFrame()
 
         firstFrame = false;
     }
+
+    VertexStream::BeginFrame();
         
 Exit:
     return rval;
@@ -914,9 +923,7 @@ OpenGLES2Renderer::DrawTriangleStrip( IN Vertex *pVertices, UINT32 numVertices )
     {
         VERIFYGL(glUseProgram(m_defaultShaderProgram));
         
-        VERIFYGL(glVertexAttribPointer(ATTRIBUTE_VERTEX_POSITION,       3, GL_FLOAT,         GL_FALSE, sizeof(Vertex), &pVertices->position));
-        VERIFYGL(glVertexAttribPointer(ATTRIBUTE_VERTEX_DIFFUSE,        4, GL_UNSIGNED_BYTE, GL_TRUE,  sizeof(Vertex), &pVertices->color));
-        VERIFYGL(glVertexAttribPointer(ATTRIBUTE_VERTEX_TEXTURE_COORD0, 2, GL_FLOAT,         GL_FALSE, sizeof(Vertex), &pVertices->texCoord));
+        VertexStream::BindVertices( pVertices, numVertices );
         
         VERIFYGL(glUniform4f(m_uGlobalColor, m_globalColor.floats.r, m_globalColor.floats.g, m_globalColor.floats.b, m_globalColor.floats.a));
 
@@ -925,6 +932,8 @@ OpenGLES2Renderer::DrawTriangleStrip( IN Vertex *pVertices, UINT32 numVertices )
 
 Exit:
     m_currentDrawCalls++;
+    m_pDrawCallsMetric->Increment();
+    m_pVertexBytesMetric->Add( numVertices * sizeof(Vertex) );
 
     return rval;
 }
@@ -953,9 +962,7 @@ OpenGLES2Renderer::DrawTriangleList( IN Vertex *pVertices, UINT32 numVertices )
     {
         VERIFYGL(glUseProgram(m_defaultShaderProgram));
 
-        VERIFYGL(glVertexAttribPointer(ATTRIBUTE_VERTEX_POSITION,       3, GL_FLOAT,         GL_FALSE, sizeof(Vertex), &pVertices->position));
-        VERIFYGL(glVertexAttribPointer(ATTRIBUTE_VERTEX_DIFFUSE,        4, GL_UNSIGNED_BYTE, GL_TRUE,  sizeof(Vertex), &pVertices->color));
-        VERIFYGL(glVertexAttribPointer(ATTRIBUTE_VERTEX_TEXTURE_COORD0, 2, GL_FLOAT,         GL_FALSE, sizeof(Vertex), &pVertices->texCoord));
+        VertexStream::BindVertices( pVertices, numVertices );
 
         VERIFYGL(glUniform4f(m_uGlobalColor, m_globalColor.floats.r, m_globalColor.floats.g, m_globalColor.floats.b, m_globalColor.floats.a));
 
@@ -964,7 +971,108 @@ OpenGLES2Renderer::DrawTriangleList( IN Vertex *pVertices, UINT32 numVertices )
     
 Exit:
     m_currentDrawCalls++;
+    m_pDrawCallsMetric->Increment();
+    m_pVertexBytesMetric->Add( numVertices * sizeof(Vertex) );
+    
+    return rval;
+}
+
+
+
+RESULT
+OpenGLES2Renderer::DrawQuadList( IN Vertex *pVertices, UINT32 numQuads )
+{
+    RESULT rval = S_OK;
+    
+    CPREx(pVertices, E_NULL_POINTER);
+    
+    if (0 == numQuads)
+    {
+        RETAILMSG(ZONE_WARN, "WARNING: OpenGLES2Renderer::DrawQuadList(): numQuads == 0");
+        return S_OK;
+    }    
     
+    // One draw per QUAD_LIST_MAX_QUADS, so the shared UINT16 indices can address every corner.
+    while (numQuads)
+    {
+        UINT32 count = MIN(numQuads, QUAD_LIST_MAX_QUADS);
+
+        // Draw via the Effect object if set and not a post-process effect.
+        if (!m_hCurrentEffect.IsNull() && !m_currentEffectIsPost)
+        {
+            CHR(EffectMan.DrawQuadList( m_hCurrentEffect, pVertices, count ));
+        }
+        else
+        {
+            VERIFYGL(glUseProgram(m_defaultShaderProgram));
+
+            VertexStream::BindVertices( pVertices, count * VERTS_PER_QUAD );
+
+            VERIFYGL(glUniform4f(m_uGlobalColor, m_globalColor.floats.r, m_globalColor.floats.g, m_globalColor.floats.b, m_globalColor.floats.a));
+
+            VERIFYGL(glDrawElements(GL_TRIANGLES, count * INDICES_PER_QUAD, GL_UNSIGNED_SHORT, VertexStream::BindQuadIndices( count )));
+        }
+
+        m_currentDrawCalls++;
+        m_pDrawCallsMetric->Increment();
+        m_pVertexBytesMetric->Add( count * VERTS_PER_QUAD * sizeof(Vertex) );
+
+        pVertices += count * VERTS_PER_QUAD;
+        numQuads  -= count;
+    }
+    
+Exit:
+    return rval;
+}
+
+
+
+RESULT
+OpenGLES2Renderer::DrawPackedQuadList( IN PackedVertex *pVertices, UINT32 numQuads )
+{
+    RESULT rval = S_OK;
+    
+    CPREx(pVertices, E_NULL_POINTER);
+    
+    if (0 == numQuads)
+    {
+        RETAILMSG(ZONE_WARN, "WARNING: OpenGLES2Renderer::DrawPackedQuadList(): numQuads == 0");
+        return S_OK;
+    }    
+
+    //
+    // Effects bind their own attributes for Vertex; give them what they expect.
+    // The default shader takes 2D positions and normalized UINT16 texture coordinates as-is.
+    //
+    if (!m_hCurrentEffect.IsNull() && !m_currentEffectIsPost)
+    {
+        m_unpackedVertices.resize( numQuads * VERTS_PER_QUAD );
+        QuadList::Unpack( pVertices, numQuads * VERTS_PER_QUAD, &m_unpackedVertices[0] );
+        CHR(DrawQuadList( &m_unpackedVertices[0], numQuads ));
+        goto Exit;
+    }
+
+    while (numQuads)
+    {
+        UINT32 count = MIN(numQuads, QUAD_LIST_MAX_QUADS);
+
+        VERIFYGL(glUseProgram(m_defaultShaderProgram));
+
+        VertexStream::BindPackedVertices( pVertices, count * VERTS_PER_QUAD );
+
+        VERIFYGL(glUniform4f(m_uGlobalColor, m_globalColor.floats.r, m_globalColor.floats.g, m_globalColor.floats.b, m_globalColor.floats.a));
+
+        VERIFYGL(glDrawElements(GL_TRIANGLES, count * INDICES_PER_QUAD, GL_UNSIGNED_SHORT, VertexStream::BindQuadIndices( count )));
+
+        m_currentDrawCalls++;
+        m_pDrawCallsMetric->Increment();
+        m_pVertexBytesMetric->Add( count * VERTS_PER_QUAD * sizeof(PackedVertex) );
+
+        pVertices += count * VERTS_PER_QUAD;
+        numQuads  -= count;
+    }
+    
+Exit:
     return rval;
 }
 
@@ -987,9 +1095,7 @@ OpenGLES2Renderer::DrawPointSprites( IN Vertex *pVertices, UINT32 numVertices, f
     // This is for performance; testing if point sprites are enabled in the fragment shader is way too expensive on iPhone.
     VERIFYGL(glUseProgram(m_pointSpriteShaderProgram));
     
-    VERIFYGL(glVertexAttribPointer(ATTRIBUTE_VERTEX_POSITION,       3, GL_FLOAT,         GL_FALSE, sizeof(Vertex), &pVertices->position));
-    VERIFYGL(glVertexAttribPointer(ATTRIBUTE_VERTEX_DIFFUSE,        4, GL_UNSIGNED_BYTE, GL_TRUE,  sizeof(Vertex), &pVertices->color));
-    VERIFYGL(glVertexAttribPointer(ATTRIBUTE_VERTEX_TEXTURE_COORD0, 2, GL_FLOAT,         GL_FALSE, sizeof(Vertex), &pVertices->texCoord));
+    VertexStream::BindVertices( pVertices, numVertices );
 
     VERIFYGL(glUniformMatrix4fv(m_uPointSpriteProjectionMatrix,     1, GL_FALSE, (GLfloat*)GameCamera.GetProjectionMatrix().Pointer()));
     VERIFYGL(glUniformMatrix4fv(m_uPointSpriteModelViewMatrix,      1, GL_FALSE, (GLfloat*)GameCamera.GetViewMatrix().Pointer()));
@@ -1005,6 +1111,8 @@ OpenGLES2Renderer::DrawPointSprites( IN Vertex *pVertices, UINT32 numVertices, f
     
 Exit:
     m_currentDrawCalls++;
+    m_pDrawCallsMetric->Increment();
+    m_pVertexBytesMetric->Add( numVertices * sizeof(Vertex) );
     
     return rval;
 }
@@ -1028,9 +1136,7 @@ OpenGLES2Renderer::DrawLines( IN Vertex *pVertices, UINT32 numVertices, float fW
     //
     VERIFYGL(glUseProgram(m_defaultShaderProgram));
     
-    VERIFYGL(glVertexAttribPointer(ATTRIBUTE_VERTEX_POSITION,       3, GL_FLOAT,         GL_FALSE, sizeof(Vertex), &pVertices->position));
-    VERIFYGL(glVertexAttribPointer(ATTRIBUTE_VERTEX_DIFFUSE,        4, GL_UNSIGNED_BYTE, GL_TRUE,  sizeof(Vertex), &pVertices->color));
-    VERIFYGL(glVertexAttribPointer(ATTRIBUTE_VERTEX_TEXTURE_COORD0, 2, GL_FLOAT,         GL_FALSE, sizeof(Vertex), &pVertices->texCoord));
+    VertexStream::BindVertices( pVertices, numVertices );
     
     VERIFYGL(glUniform4f(m_uGlobalColor, m_globalColor.floats.r, m_globalColor.floats.g, m_globalColor.floats.b, m_globalColor.floats.a));
 
@@ -1041,6 +1147,8 @@ OpenGLES2Renderer::DrawLines( IN Vertex *pVertices, UINT32 numVertices, float fW
     VERIFYGL(glLineWidth(fWidth));
     VERIFYGL(glDrawArrays(GL_LINES, 0, numVertices));
     m_currentDrawCalls++;
+    m_pDrawCallsMetric->Increment();
+    m_pVertexBytesMetric->Add( numVertices * sizeof(Vertex) );
     
 Exit:
     EnableTexturing( true );
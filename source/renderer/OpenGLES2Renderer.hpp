@@ -3,8 +3,10 @@
 #include "Errors.hpp"
 #include "IRenderer.hpp"
 #include "PerfTimer.hpp"
+#include "Metrics.hpp"
 #include "ShaderManager.hpp"
 #include "TextureManager.hpp"
+#include "QuadList.hpp"
 
 #include <stack>
 using std::stack;
@@ -65,6 +67,8 @@ public:
     virtual RESULT DrawTriangleList     ( IN Vertex *pVertices, UINT32 numVertices );
     virtual RESULT DrawLines            ( IN Vertex *pVertices, UINT32 numVertices, float fWidth );
     virtual RESULT DrawPointSprites     ( IN Vertex *pVertices, UINT32 numVertices, float fScale );
+    virtual RESULT DrawQuadList         ( IN Vertex       *pVertices, UINT32 numQuads );
+    virtual RESULT DrawPackedQuadList   ( IN PackedVertex *pVertices, UINT32 numQuads );
 
    
 protected:
@@ -131,6 +135,11 @@ protected:
     UINT32          m_currentDrawCalls;
     UINT32          m_totalDrawCalls;
     float           m_drawsPerSecond;
+    MetricCounter*  m_pDrawCallsMetric;
+    MetricCounter*  m_pVertexBytesMetric;
+
+    // PackedVertices converted for Effects, which only take Vertex.
+    vector<Vertex>  m_unpackedVertices;
 
     
     // TEST
@@ -0,0 +1,141 @@
+/*
+ *  QuadList.cpp
+ *  Critters
+ *
+ *  Shared index pattern and vertex conversions for indexed quads.
+ *
+ */
+
+#include "QuadList.hpp"
+#include "Macros.hpp"
+#include "Log.hpp"
+
+
+namespace Z
+{
+
+
+
+//
+// Static Data
+//
+bool            QuadList::s_isEnabled           = false;
+bool            QuadList::s_isPackingEnabled    = false;
+vector<UINT16>  QuadList::s_indices;
+
+
+
+//
+// Class Methods
+//
+const UINT16*
+QuadList::GetIndices( UINT32 numQuads )
+{
+    if (numQuads > QUAD_LIST_MAX_QUADS)
+    {
+        RETAILMSG(ZONE_ERROR, "ERROR: QuadList::GetIndices(): %d quads; at most %d per draw", numQuads, QUAD_LIST_MAX_QUADS);
+        DEBUGCHK(0);
+        return NULL;
+    }
+
+    // Grow the pattern as needed; it never changes once written.
+    UINT32 numBuilt = s_indices.size() / INDICES_PER_QUAD;
+    if (numBuilt < numQuads)
+    {
+        s_indices.resize( numQuads * INDICES_PER_QUAD );
+
+        for (UINT32 quad = numBuilt; quad < numQuads; ++quad)
+        {
+            UINT16* pIndex = &s_indices[ quad * INDICES_PER_QUAD ];
+            UINT16  corner = (UINT16)(quad * VERTS_PER_QUAD);
+
+            // The same two triangles Util::CreateTriangleList() emits.
+            pIndex[0] = corner + 0;
+            pIndex[1] = corner + 1;
+            pIndex[2] = corner + 2;
+            pIndex[3] = corner + 2;
+            pIndex[4] = corner + 1;
+            pIndex[5] = corner + 3;
+        }
+    }
+
+    return s_indices.size() ? &s_indices[0] : NULL;
+}
+
+
+
+void
+QuadList::FromTriangleList( IN const Vertex* pTriangles, UINT32 numQuads, OUT Vertex* pQuads )
+{
+    DEBUGCHK(pTriangles && pQuads);
+
+    // Front to back, so converting in place never overwrites a triangle not yet read.
+    for (UINT32 quad = 0; quad < numQuads; ++quad)
+    {
+        const Vertex* pSrc = &pTriangles[ quad * 6 ];
+        Vertex        corners[ VERTS_PER_QUAD ] = { pSrc[0], pSrc[1], pSrc[2], pSrc[5] };
+
+        memcpy( &pQuads[ quad * VERTS_PER_QUAD ], corners, sizeof(corners) );
+    }
+}
+
+
+
+bool
+QuadList::CanPack( IN const Vertex* pVertices, UINT32 numVertices )
+{
+    for (UINT32 i = 0; i < numVertices; ++i)
+    {
+        const Vertex& vertex = pVertices[i];
+
+        if (vertex.z  != 0.0f ||
+            vertex.u0 <  0.0f || vertex.u0 > 1.0f ||
+            vertex.v0 <  0.0f || vertex.v0 > 1.0f)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+
+void
+QuadList::Pack( IN const Vertex* pVertices, UINT32 numVertices, OUT PackedVertex* pPacked )
+{
+    for (UINT32 i = 0; i < numVertices; ++i)
+    {
+        const Vertex& vertex = pVertices[i];
+        PackedVertex& packed = pPacked[i];
+
+        packed.x     = vertex.x;
+        packed.y     = vertex.y;
+        packed.color = vertex.color;
+        packed.u0    = (UINT16)(CLAMP(vertex.u0, 0.0f, 1.0f) * 65535.0f + 0.5f);
+        packed.v0    = (UINT16)(CLAMP(vertex.v0, 0.0f, 1.0f) * 65535.0f + 0.5f);
+    }
+}
+
+
+
+void
+QuadList::Unpack( IN const PackedVertex* pPacked, UINT32 numVertices, OUT Vertex* pVertices )
+{
+    for (UINT32 i = 0; i < numVertices; ++i)
+    {
+        const PackedVertex& packed = pPacked[i];
+        Vertex&             vertex = pVertices[i];
+
+        vertex.x     = packed.x;
+        vertex.y     = packed.y;
+        vertex.z     = 0.0f;
+        vertex.color = packed.color;
+        vertex.u0    = packed.u0 / 65535.0f;
+        vertex.v0    = packed.v0 / 65535.0f;
+    }
+}
+
+
+
+} // END namespace Z
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "Types.hpp"
+#include "Vertex.hpp"
+
+#include <vector>
+using std::vector;
+
+
+namespace Z
+{
+
+
+//
+// Indexed quads, for everything drawn as a pile of rectangles: SpriteBatches, text,
+// and particles.
+//
+// A quad is 4 corners instead of the 6 Vertices of a triangle list, drawn with one
+// shared, static index pattern.  Corners are in the order Util::CreateTriangleList()
+// emits them: (left, bottom), (right, bottom), (left, top), (right, top); so a
+// triangle list quad converts by dropping its 4th and 5th Vertices.
+//
+// Quads may also be sent as PackedVertex (2D position, 16-bit texture coordinates)
+// when they are flat and their texture coordinates lie in [0, 1].
+//
+// Off by default; enable with Settings.bUseQuadVertices = "1", and also
+// Settings.bUsePackedVertices = "1" to pack them.
+//
+
+#define VERTS_PER_QUAD          4
+#define INDICES_PER_QUAD        6
+#define QUAD_LIST_MAX_QUADS     16384       // Every index must fit in a UINT16.
+
+
+class QuadList
+{
+public:
+    static  void    Enable              ( bool enabled, bool packed )   { s_isEnabled = enabled; s_isPackingEnabled = enabled && packed; }
+    static  bool    IsEnabled           ( )                             { return s_isEnabled;        }
+    static  bool    IsPackingEnabled    ( )                             { return s_isPackingEnabled; }
+
+    // Indices for numQuads <= QUAD_LIST_MAX_QUADS quads; render thread only.
+    static  const UINT16*   GetIndices  ( UINT32 numQuads );
+
+    // Copy the corners of numQuads triangle list quads; pQuads may equal pTriangles.
+    static  void    FromTriangleList    ( IN const Vertex* pTriangles, UINT32 numQuads, OUT Vertex* pQuads );
+
+    // True if Pack() would not lose anything: z == 0 and u, v in [0, 1].
+    static  bool    CanPack             ( IN const Vertex* pVertices, UINT32 numVertices );
+    static  void    Pack                ( IN const Vertex* pVertices, UINT32 numVertices, OUT PackedVertex* pPacked );
+    static  void    Unpack              ( IN const PackedVertex* pPacked, UINT32 numVertices, OUT Vertex* pVertices );
+
+protected:
+    static  bool            s_isEnabled;
+    static  bool            s_isPackingEnabled;
+    static  vector<UINT16>  s_indices;
+
+private:
+    QuadList();
+    QuadList( const QuadList& rhs );
+    QuadList& operator=( const QuadList& rhs );
+};
+
+
+
+} // END namespace Z
@@ -0,0 +1,824 @@
+/*
+ *  RenderQueue.cpp
+ *  Critters
+ *
+ *  Drops redundant Effect, texture, matrix and color changes
+ *  before they reach the real renderer.
+ *
+ */
+
+#include "RenderQueue.hpp"
+#include "Log.hpp"
+#include "Macros.hpp"
+#include "Engine.hpp"
+
+#include <string.h>
+
+
+namespace Z
+{
+
+
+
+//
+// Static Data
+//
+volatile UINT32 RenderQueue::s_textureEpoch = 0;
+
+
+
+//
+// Class Methods
+//
+RenderQueue*
+RenderQueue::Create( IN IRenderer* pBackend )
+{
+    RenderQueue* pQueue = NULL;
+
+    if (!pBackend)
+    {
+        RETAILMSG(ZONE_ERROR, "ERROR: RenderQueue::Create(): NULL backend");
+        return NULL;
+    }
+
+    pQueue = new RenderQueue( pBackend );
+    DEBUGCHK(pQueue);
+
+    return pQueue;
+}
+
+
+
+void
+RenderQueue::InvalidateTextureCache()
+{
+    // Render targets and texture uploads bind with raw GL calls; every queue
+    // notices the new epoch at its next draw and re-sends its textures.
+    s_textureEpoch = s_textureEpoch + 1;
+}
+
+
+
+//
+// Instance Methods
+//
+RenderQueue::RenderQueue( IN IRenderer* pBackend ) :
+    m_pBackend(pBackend),
+    m_globalColor(Color::White()),
+    m_sentModelViewValid(false),
+    m_sentGlobalColorValid(false),
+    m_isDirty(true),
+    m_textureEpoch(s_textureEpoch),
+    m_pSkippedMetric(Metrics::RegisterCounter("RenderQueue.StateChangesSkipped"))
+{
+    RETAILMSG(ZONE_INFO, "Created RenderQueue");
+
+    m_name = "RenderQueue";
+
+    m_pBackend->AddRef();
+
+    for (UINT32 i = 0; i < RENDER_QUEUE_TEXTURE_UNITS; ++i)
+    {
+        m_textures[i].textureID     = 0xFFFFFFFF;
+        m_textures[i].isSet         = false;
+        m_sentTextures[i].textureID = 0xFFFFFFFF;
+        m_sentTextures[i].isSet     = false;
+    }
+
+    memset(&m_currentStats, 0, sizeof(m_currentStats));
+    memset(&m_frameStats,   0, sizeof(m_frameStats));
+}
+
+
+
+RenderQueue::~RenderQueue()
+{
+    RETAILMSG(ZONE_OBJECT | ZONE_VERBOSE, "\t~RenderQueue( %4d )", m_ID);
+
+    // Leave the backend as we found it; it may outlive us.
+    UnwindEffects();
+
+    SAFE_RELEASE(m_pBackend);
+}
+
+
+
+RESULT
+RenderQueue::Init( UINT32 width, UINT32 height )
+{
+    DEBUGMSG(ZONE_INFO, "RenderQueue::Init()");
+
+    InvalidateState();
+
+    return m_pBackend->Init( width, height );
+}
+
+
+
+RESULT
+RenderQueue::Deinit()
+{
+    DEBUGMSG(ZONE_INFO, "RenderQueue::Deinit()");
+
+    UnwindEffects();
+
+    return m_pBackend->Deinit();
+}
+
+
+
+void
+RenderQueue::UnwindEffects()
+{
+    // Undo whatever we pushed on the backend; it releases its own references.
+    while (m_backendEffectStack.size())
+    {
+        IGNOREHR(ForwardPop());
+    }
+
+    while (m_effectStack.size())
+    {
+        HEffect hEffect = m_effectStack.back().hEffect;
+        m_effectStack.pop_back();
+
+        if (!hEffect.IsNull())
+            hEffect.Release();
+    }
+
+    for (UINT32 i = 0; i < RENDER_QUEUE_TEXTURE_UNITS; ++i)
+    {
+        m_textures[i].hTexture  = HTexture::NullHandle();
+        m_textures[i].textureID = 0xFFFFFFFF;
+        m_textures[i].isSet     = false;
+    }
+
+    InvalidateState();
+}
+
+
+
+RESULT
+RenderQueue::SetRenderContext( IN RenderContext* pContext )
+{
+    InvalidateState();
+
+    return m_pBackend->SetRenderContext( pContext );
+}
+
+
+
+RESULT
+RenderQueue::SetRenderTarget( IN RenderTarget* pTarget )
+{
+    // Binding a target may bind its texture, and GL state doesn't survive a context switch.
+    InvalidateState();
+
+    return m_pBackend->SetRenderTarget( pTarget );
+}
+
+
+
+RESULT
+RenderQueue::Resize( UINT32 width, UINT32 height )
+{
+    return m_pBackend->Resize( width, height );
+}
+
+
+
+RESULT
+RenderQueue::Rotate( Orientation orientation )
+{
+    return m_pBackend->Rotate( orientation );
+}
+
+
+
+UINT32
+RenderQueue::GetWidth()
+{
+    return m_pBackend->GetWidth();
+}
+
+
+
+UINT32
+RenderQueue::GetHeight()
+{
+    return m_pBackend->GetHeight();
+}
+
+
+
+RESULT
+RenderQueue::Clear( Color color )
+{
+    return m_pBackend->Clear( color );
+}
+
+
+
+RESULT
+RenderQueue::Clear( float r, float g, float b, float a )
+{
+    return m_pBackend->Clear( r, g, b, a );
+}
+
+
+
+#pragma mark -
+#pragma mark State
+RESULT
+RenderQueue::EnableAlphaTest( bool enabled )
+{
+    return m_pBackend->EnableAlphaTest( enabled );
+}
+
+
+
+RESULT
+RenderQueue::EnableAlphaBlend( bool enabled )
+{
+    return m_pBackend->EnableAlphaBlend( enabled );
+}
+
+
+
+RESULT
+RenderQueue::EnableDepthTest( bool enabled )
+{
+    return m_pBackend->EnableDepthTest( enabled );
+}
+
+
+
+RESULT
+RenderQueue::EnableLighting( bool enabled )
+{
+    RESULT rval = S_OK;
+
+    // Sets a uniform on the current shader program, so the Effect must be bound first.
+    CHR(SyncEffects());
+    CHR(m_pBackend->EnableLighting( enabled ));
+
+Exit:
+    return rval;
+}
+
+
+
+RESULT
+RenderQueue::EnableTexturing( bool enabled )
+{
+    RESULT rval = S_OK;
+
+    CHR(SyncEffects());
+    CHR(m_pBackend->EnableTexturing( enabled ));
+
+Exit:
+    return rval;
+}
+
+
+
+RESULT
+RenderQueue::ShowOverdraw( bool show )
+{
+    return m_pBackend->ShowOverdraw( show );
+}
+
+
+
+RESULT
+RenderQueue::SetBlendFunctions( UINT32 srcFunction, UINT32 dstFunction )
+{
+    return m_pBackend->SetBlendFunctions( srcFunction, dstFunction );
+}
+
+
+
+RESULT
+RenderQueue::SetGlobalColor( Color color )
+{
+    m_globalColor = color;
+    m_isDirty     = true;
+
+    m_currentStats.numColorRequests++;
+
+    return S_OK;
+}
+
+
+
+RESULT
+RenderQueue::BeginFrame()
+{
+    memset(&m_currentStats, 0, sizeof(m_currentStats));
+
+    InvalidateState();
+
+    return m_pBackend->BeginFrame();
+}
+
+
+
+RESULT
+RenderQueue::EndFrame()
+{
+    RESULT rval = S_OK;
+
+    // The backend may draw its own overlays (e.g. FPS) through us; count them in this frame.
+    CHR(m_pBackend->EndFrame());
+
+Exit:
+    m_frameStats = m_currentStats;
+
+    {
+    // Unwinding under a post-effect can forward more Effect pops than were requested.
+    INT64 skipped = ((INT64)m_frameStats.numEffectRequests  - m_frameStats.numEffectSwitches) +
+                    ((INT64)m_frameStats.numTextureRequests - m_frameStats.numTextureBinds)   +
+                    ((INT64)m_frameStats.numMatrixRequests  - m_frameStats.numMatrixChanges)  +
+                    ((INT64)m_frameStats.numColorRequests   - m_frameStats.numColorChanges);
+    if (skipped > 0)
+    {
+        m_pSkippedMetric->Add( skipped );
+    }
+    }
+
+    DEBUGMSG(ZONE_RENDER | ZONE_VERBOSE, "RenderQueue::EndFrame(): %d draws, effects %d/%d textures %d/%d matrices %d/%d colors %d/%d",
+             m_frameStats.numDrawCalls,
+             m_frameStats.numEffectSwitches,  m_frameStats.numEffectRequests,
+             m_frameStats.numTextureBinds,    m_frameStats.numTextureRequests,
+             m_frameStats.numMatrixChanges,   m_frameStats.numMatrixRequests,
+             m_frameStats.numColorChanges,    m_frameStats.numColorRequests);
+
+    return rval;
+}
+
+
+
+void
+RenderQueue::ResetStats()
+{
+    memset(&m_currentStats, 0, sizeof(m_currentStats));
+    memset(&m_frameStats,   0, sizeof(m_frameStats));
+}
+
+
+
+#pragma mark -
+#pragma mark Effect
+RESULT
+RenderQueue::PushEffect( IN HEffect hEffect )
+{
+    RESULT      rval = S_OK;
+    EffectEntry entry;
+
+    entry.hEffect = hEffect;
+    entry.isPost  = !hEffect.IsNull() && EffectMan.IsPostEffect( hEffect );
+
+    if (!hEffect.IsNull())
+    {
+        hEffect.AddRef();
+    }
+
+    m_effectStack.push_back( entry );
+    m_isDirty = true;
+
+    m_currentStats.numEffectRequests++;
+
+    // Post-effects redirect rendering when pushed, so they can't wait for the next draw.
+    if (entry.isPost)
+    {
+        CHR(ForwardPush( hEffect, true ));
+    }
+
+Exit:
+    return rval;
+}
+
+
+
+RESULT
+RenderQueue::PopEffect( INOUT HEffect* phEffect )
+{
+    RESULT      rval = S_OK;
+    EffectEntry entry;
+
+    CBR( m_effectStack.size() > 0 );
+
+    entry = m_effectStack.back();
+    m_effectStack.pop_back();
+    m_isDirty = true;
+
+    if (phEffect)
+    {
+        *phEffect = entry.hEffect;
+    }
+
+    m_currentStats.numEffectRequests++;
+
+    if (entry.isPost)
+    {
+        // Unwind anything bound on top of the post-effect, then pop it so it composites now.
+        while (m_backendEffectStack.size() && !m_backendEffectStack.back().isPost)
+        {
+            CHR(ForwardPop());
+        }
+
+        DEBUGCHK(m_backendEffectStack.size() && m_backendEffectStack.back().hEffect == entry.hEffect);
+        CHR(ForwardPop());
+    }
+
+    if (!entry.hEffect.IsNull())
+    {
+        entry.hEffect.Release();
+    }
+
+Exit:
+    return rval;
+}
+
+
+
+RESULT
+RenderQueue::GetEffect( INOUT HEffect* phEffect )
+{
+    RESULT rval = S_OK;
+
+    CPREx(phEffect, E_NULL_POINTER);
+
+    if (m_effectStack.size())
+    {
+        *phEffect = m_effectStack.back().hEffect;
+    }
+    else
+    {
+        *phEffect = HEffect::NullHandle();
+    }
+
+Exit:
+    return rval;
+}
+
+
+
+RESULT
+RenderQueue::ForwardPush( IN HEffect hEffect, bool isPost )
+{
+    RESULT      rval = S_OK;
+    EffectEntry entry;
+
+    entry.hEffect = hEffect;
+    entry.isPost  = isPost;
+
+    CHR(m_pBackend->PushEffect( hEffect ));
+    m_backendEffectStack.push_back( entry );
+
+    m_currentStats.numEffectSwitches++;
+
+Exit:
+    // The backend re-applies its own texture/matrix/color to a new Effect.
+    InvalidateState();
+    return rval;
+}
+
+
+
+RESULT
+RenderQueue::ForwardPop()
+{
+    RESULT rval = S_OK;
+
+    CBR( m_backendEffectStack.size() > 0 );
+
+    m_backendEffectStack.pop_back();
+    CHR(m_pBackend->PopEffect());
+
+    m_currentStats.numEffectSwitches++;
+
+Exit:
+    InvalidateState();
+    return rval;
+}
+
+
+
+RESULT
+RenderQueue::PopStaleEffects()
+{
+    RESULT  rval    = S_OK;
+    HEffect hTarget = m_effectStack.size() ? m_effectStack.back().hEffect : HEffect::NullHandle();
+
+    // Stop at the first post-effect; only PopEffect() may remove those.
+    while (m_backendEffectStack.size()                  &&
+           !m_backendEffectStack.back().isPost          &&
+           m_backendEffectStack.back().hEffect != hTarget)
+    {
+        CHR(ForwardPop());
+    }
+
+Exit:
+    return rval;
+}
+
+
+
+RESULT
+RenderQueue::SyncEffects()
+{
+    RESULT  rval    = S_OK;
+    HEffect hTarget = m_effectStack.size() ? m_effectStack.back().hEffect : HEffect::NullHandle();
+
+    CHR(PopStaleEffects());
+
+    if (m_backendEffectStack.empty())
+    {
+        // An empty backend stack already means "default Effect".
+        if (!hTarget.IsNull())
+        {
+            CHR(ForwardPush( hTarget, false ));
+        }
+    }
+    else if (m_backendEffectStack.back().hEffect != hTarget)
+    {
+        CHR(ForwardPush( hTarget, false ));
+    }
+
+Exit:
+    return rval;
+}
+
+
+
+#pragma mark -
+#pragma mark Texture
+RESULT
+RenderQueue::SetTexture( IN UINT8 textureUnit, IN HTexture hTexture )
+{
+    RESULT rval = S_OK;
+
+    CBREx(textureUnit < RENDER_QUEUE_TEXTURE_UNITS, E_INVALID_ARG);
+
+    m_textures[ textureUnit ].hTexture  = hTexture;
+    m_textures[ textureUnit ].textureID = 0xFFFFFFFF;
+    m_textures[ textureUnit ].isSet     = true;
+    m_isDirty = true;
+
+    m_currentStats.numTextureRequests++;
+
+Exit:
+    return rval;
+}
+
+
+
+RESULT
+RenderQueue::SetTexture( IN UINT8 textureUnit, IN UINT32 textureID )
+{
+    RESULT rval = S_OK;
+
+    CBREx(textureUnit < RENDER_QUEUE_TEXTURE_UNITS, E_INVALID_ARG);
+
+    m_textures[ textureUnit ].hTexture  = HTexture::NullHandle();
+    m_textures[ textureUnit ].textureID = textureID;
+    m_textures[ textureUnit ].isSet     = true;
+    m_isDirty = true;
+
+    m_currentStats.numTextureRequests++;
+
+Exit:
+    return rval;
+}
+
+
+
+RESULT
+RenderQueue::GetTexture( INOUT HTexture* phTexture )
+{
+    RESULT rval = S_OK;
+
+    CPREx(phTexture, E_NULL_POINTER);
+    *phTexture = m_textures[0].hTexture;
+
+Exit:
+    return rval;
+}
+
+
+
+#pragma mark -
+#pragma mark Matrix
+RESULT
+RenderQueue::SetModelViewMatrix( IN const mat4& matrix )
+{
+    m_modelViewMatrix = matrix;
+    m_isDirty         = true;
+
+    m_currentStats.numMatrixRequests++;
+
+    return S_OK;
+}
+
+
+
+RESULT
+RenderQueue::GetModelViewMatrix( INOUT mat4* pMatrix )
+{
+    RESULT rval = S_OK;
+
+    CPREx(pMatrix, E_NULL_POINTER);
+    *pMatrix = m_modelViewMatrix;
+
+Exit:
+    return rval;
+}
+
+
+
+#pragma mark -
+#pragma mark Drawing
+RESULT
+RenderQueue::DrawTriangleStrip( IN Vertex* pVertices, UINT32 numVertices )
+{
+    RESULT rval = S_OK;
+
+    CHR(FlushState());
+    m_currentStats.numDrawCalls++;
+    CHR(m_pBackend->DrawTriangleStrip( pVertices, numVertices ));
+
+Exit:
+    return rval;
+}
+
+
+
+RESULT
+RenderQueue::DrawTriangleList( IN Vertex* pVertices, UINT32 numVertices )
+{
+    RESULT rval = S_OK;
+
+    CHR(FlushState());
+    m_currentStats.numDrawCalls++;
+    CHR(m_pBackend->DrawTriangleList( pVertices, numVertices ));
+
+Exit:
+    return rval;
+}
+
+
+
+RESULT
+RenderQueue::DrawLines( IN Vertex* pVertices, UINT32 numVertices, float fWidth )
+{
+    RESULT rval = S_OK;
+
+    CHR(FlushState());
+    m_currentStats.numDrawCalls++;
+    CHR(m_pBackend->DrawLines( pVertices, numVertices, fWidth ));
+
+Exit:
+    return rval;
+}
+
+
+
+RESULT
+RenderQueue::DrawPointSprites( IN Vertex* pVertices, UINT32 numVertices, float fScale )
+{
+    RESULT rval = S_OK;
+
+    CHR(FlushState());
+    m_currentStats.numDrawCalls++;
+    CHR(m_pBackend->DrawPointSprites( pVertices, numVertices, fScale ));
+
+Exit:
+    return rval;
+}
+
+
+
+RESULT
+RenderQueue::DrawQuadList( IN Vertex* pVertices, UINT32 numQuads )
+{
+    RESULT rval = S_OK;
+
+    CHR(FlushState());
+    m_currentStats.numDrawCalls++;
+    CHR(m_pBackend->DrawQuadList( pVertices, numQuads ));
+
+Exit:
+    return rval;
+}
+
+
+
+RESULT
+RenderQueue::DrawPackedQuadList( IN PackedVertex* pVertices, UINT32 numQuads )
+{
+    RESULT rval = S_OK;
+
+    CHR(FlushState());
+    m_currentStats.numDrawCalls++;
+    CHR(m_pBackend->DrawPackedQuadList( pVertices, numQuads ));
+
+Exit:
+    return rval;
+}
+
+
+
+#pragma mark -
+#pragma mark Deferred State
+void
+RenderQueue::InvalidateState()
+{
+    for (UINT32 i = 0; i < RENDER_QUEUE_TEXTURE_UNITS; ++i)
+    {
+        m_sentTextures[i].isSet = false;
+    }
+
+    m_sentModelViewValid    = false;
+    m_sentGlobalColorValid  = false;
+    m_isDirty               = true;
+}
+
+
+
+RESULT
+RenderQueue::FlushState()
+{
+    RESULT rval = S_OK;
+
+    if (m_textureEpoch != s_textureEpoch)
+    {
+        m_textureEpoch = s_textureEpoch;
+
+        for (UINT32 i = 0; i < RENDER_QUEUE_TEXTURE_UNITS; ++i)
+        {
+            m_sentTextures[i].isSet = false;
+        }
+
+        m_isDirty = true;
+    }
+
+    // Back-to-back draws with no state calls in between skip all the compares.
+    if (!m_isDirty)
+    {
+        return S_OK;
+    }
+
+    // Bind the Effect first; switching it invalidates everything below.
+    CHR(SyncEffects());
+
+    for (UINT8 unit = 0; unit < RENDER_QUEUE_TEXTURE_UNITS; ++unit)
+    {
+        const TextureBinding& wanted = m_textures[ unit ];
+        TextureBinding&       sent   = m_sentTextures[ unit ];
+
+        if (!wanted.isSet)
+            continue;
+
+        if (sent.isSet && sent.textureID == wanted.textureID && sent.hTexture == wanted.hTexture)
+            continue;
+
+        if (wanted.textureID != 0xFFFFFFFF)
+        {
+            CHR(m_pBackend->SetTexture( unit, wanted.textureID ));
+        }
+        else
+        {
+            CHR(m_pBackend->SetTexture( unit, wanted.hTexture ));
+        }
+
+        sent = wanted;
+        m_currentStats.numTextureBinds++;
+    }
+
+    if (!m_sentModelViewValid || memcmp( m_sentModelViewMatrix.Pointer(), m_modelViewMatrix.Pointer(), sizeof(float) * 16 ))
+    {
+        CHR(m_pBackend->SetModelViewMatrix( m_modelViewMatrix ));
+
+        m_sentModelViewMatrix = m_modelViewMatrix;
+        m_sentModelViewValid  = true;
+        m_currentStats.numMatrixChanges++;
+    }
+
+    if (!m_sentGlobalColorValid || memcmp( &m_sentGlobalColor.floats, &m_globalColor.floats, sizeof(m_globalColor.floats) ))
+    {
+        CHR(m_pBackend->SetGlobalColor( m_globalColor ));
+
+        m_sentGlobalColor       = m_globalColor;
+        m_sentGlobalColorValid  = true;
+        m_currentStats.numColorChanges++;
+    }
+
+    m_isDirty = false;
+
+Exit:
+    return rval;
+}
+
+
+
+} // END namespace Z
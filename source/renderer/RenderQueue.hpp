@@ -0,0 +1,172 @@
+#pragma once
+
+#include "Object.hpp"
+#include "Errors.hpp"
+#include "IRenderer.hpp"
+#include "Metrics.hpp"
+
+#include <vector>
+using std::vector;
+
+
+namespace Z
+{
+
+
+//
+// A state-caching layer on top of any IRenderer.
+//
+// Callers keep using the full IRenderer API (Layers push an Effect per Layer,
+// SpriteBatches push their parent Effect again, every Sprite sets its texture and
+// matrix), but nothing reaches the backend until something is drawn.  At each draw
+// the queue compares the logical Effect, textures, model-view matrix and global color
+// with what it last sent, and forwards only the differences.
+//
+// Post-effects (Blur, Ripple, Morph) render offscreen between their push and pop, so
+// those are forwarded immediately.  Anything that may have changed backend state behind
+// our back (a forwarded Effect change, a render target switch, a texture upload) drops
+// the cached values so they are sent again at the next draw.
+//
+// Enable with Settings.bUseRenderQueue = "1".
+//
+
+#define RENDER_QUEUE_TEXTURE_UNITS      2
+
+
+struct RenderQueueStats
+{
+    UINT32  numDrawCalls;
+    UINT32  numEffectRequests;      // PushEffect() + PopEffect() calls made on the queue
+    UINT32  numEffectSwitches;      // pushes + pops forwarded to the backend
+    UINT32  numTextureRequests;
+    UINT32  numTextureBinds;
+    UINT32  numMatrixRequests;
+    UINT32  numMatrixChanges;
+    UINT32  numColorRequests;
+    UINT32  numColorChanges;
+};
+
+
+
+class RenderQueue : virtual public Object, public IRenderer
+{
+public:
+    // Factory method; the queue holds a reference to pBackend until destroyed.
+    static  RenderQueue* Create( IN IRenderer* pBackend );
+    virtual ~RenderQueue();
+
+    IRenderer*  GetBackend  ( ) const   { return m_pBackend; }
+
+    // Call after binding a texture with raw GL, outside of any IRenderer.
+    static  void    InvalidateTextureCache( );
+
+
+    // IRenderer
+    virtual RESULT Init                 ( UINT32 width, UINT32 height );
+    virtual RESULT Deinit               ( );
+
+    virtual RESULT SetRenderContext     ( IN RenderContext* pContext );
+    virtual RESULT SetRenderTarget      ( IN RenderTarget*  pTarget  );
+
+    virtual RESULT Resize               ( UINT32 width, UINT32 height );
+    virtual RESULT Rotate               ( Orientation orientation );
+    virtual UINT32 GetWidth             ( );
+    virtual UINT32 GetHeight            ( );
+
+    virtual RESULT Clear                ( Color color );
+    virtual RESULT Clear                ( float r, float g, float b, float a );
+
+    virtual RESULT EnableAlphaTest      ( bool enabled );
+    virtual RESULT EnableAlphaBlend     ( bool enabled );
+    virtual RESULT EnableDepthTest      ( bool enabled );
+    virtual RESULT EnableLighting       ( bool enabled );
+    virtual RESULT EnableTexturing      ( bool enabled );
+    virtual RESULT ShowOverdraw         ( bool show    );
+    virtual RESULT SetBlendFunctions    ( UINT32 srcFunction, UINT32 dstFunction );
+    virtual RESULT SetGlobalColor       ( Color color = Color::White() );
+
+    virtual RESULT BeginFrame           ( );
+    virtual RESULT EndFrame             ( );
+
+    virtual RESULT PushEffect           ( IN    HEffect  hEffect             );
+    virtual RESULT PopEffect            ( INOUT HEffect* phEffect = NULL     );
+    virtual RESULT GetEffect            ( INOUT HEffect* phEffect            );
+
+    virtual RESULT SetTexture           ( IN    UINT8     textureUnit, IN UINT32 textureID   );
+    virtual RESULT SetTexture           ( IN    UINT8     textureUnit, IN HTexture hTexture  );
+    virtual RESULT GetTexture           ( INOUT HTexture* phTexture );
+
+    virtual RESULT SetModelViewMatrix   ( IN    const mat4& matrix  );
+    virtual RESULT GetModelViewMatrix   ( INOUT       mat4* pMatrix );
+
+    virtual RESULT DrawTriangleStrip    ( IN Vertex* pVertices, UINT32 numVertices );
+    virtual RESULT DrawTriangleList     ( IN Vertex *pVertices, UINT32 numVertices );
+    virtual RESULT DrawLines            ( IN Vertex *pVertices, UINT32 numVertices, float fWidth );
+    virtual RESULT DrawPointSprites     ( IN Vertex *pVertices, UINT32 numVertices, float fScale );
+    virtual RESULT DrawQuadList         ( IN Vertex       *pVertices, UINT32 numQuads );
+    virtual RESULT DrawPackedQuadList   ( IN PackedVertex *pVertices, UINT32 numQuads );
+
+
+    // Counters for the frame in progress, and for the last completed frame.
+    const RenderQueueStats& GetCurrentStats ( ) const   { return m_currentStats;   }
+    const RenderQueueStats& GetFrameStats   ( ) const   { return m_frameStats;     }
+    void                    ResetStats      ( );
+
+protected:
+    RenderQueue( IN IRenderer* pBackend );
+    RenderQueue(const RenderQueue& rhs);
+    const RenderQueue& operator=(const RenderQueue& rhs);
+
+    void    UnwindEffects       ( );
+    RESULT  PopStaleEffects     ( );
+    RESULT  SyncEffects         ( );
+    RESULT  FlushState          ( );
+    void    InvalidateState     ( );
+    RESULT  ForwardPush         ( IN HEffect hEffect, bool isPost );
+    RESULT  ForwardPop          ( );
+
+protected:
+    struct EffectEntry
+    {
+        HEffect     hEffect;
+        bool        isPost;
+    };
+
+    // A texture unit binding: either a managed HTexture, or a raw GL id (textureID != 0xFFFFFFFF).
+    struct TextureBinding
+    {
+        HTexture    hTexture;
+        UINT32      textureID;
+        bool        isSet;
+    };
+
+    typedef vector<EffectEntry> EffectStack;
+
+    IRenderer*          m_pBackend;
+
+    // What the caller asked for.
+    EffectStack         m_effectStack;
+    TextureBinding      m_textures[ RENDER_QUEUE_TEXTURE_UNITS ];
+    mat4                m_modelViewMatrix;
+    Color               m_globalColor;
+
+    // What the backend was last given; isSet/m_sent* false means "unknown, send again."
+    EffectStack         m_backendEffectStack;
+    TextureBinding      m_sentTextures[ RENDER_QUEUE_TEXTURE_UNITS ];
+    mat4                m_sentModelViewMatrix;
+    bool                m_sentModelViewValid;
+    Color               m_sentGlobalColor;
+    bool                m_sentGlobalColorValid;
+    bool                m_isDirty;
+    UINT32              m_textureEpoch;
+
+    RenderQueueStats    m_currentStats;
+    RenderQueueStats    m_frameStats;
+    MetricCounter*      m_pSkippedMetric;
+
+    static volatile UINT32  s_textureEpoch;
+};
+
+
+
+} // END namespace Z
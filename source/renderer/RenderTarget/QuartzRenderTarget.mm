@@ -11,6 +11,7 @@
 #include "Macros.hpp"
 #include "Log.hpp"
 #include "Util.hpp"
+#include "RenderQueue.hpp"
 
 #include <CoreGraphics/CGImage.h>
 #include <UIKit/UIKit.h>
@@ -172,6 +173,7 @@ QuartzRenderTarget::Init( UINT32 width, UINT32 height, bool offscreen, UINT32 nu
     {
         VERIFYGL(glActiveTexture(GL_TEXTURE0));
         VERIFYGL(glBindTexture  (GL_TEXTURE_2D, m_uiTextureIDs[i]));
+        RenderQueue::InvalidateTextureCache();
 //        VERIFYGL(glTexImage2D   (GL_TEXTURE_2D, 0, GL_RGBA, m_textureStride, m_textureHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL));
         VERIFYGL(glTexImage2D   (GL_TEXTURE_2D, 0, GL_RGBA, m_textureWidth, m_textureHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL));
         VERIFYGL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE));
@@ -297,6 +299,7 @@ QuartzRenderTarget::Disable()
     // Copy the bitmap bytes into our currrent texture.
     VERIFYGL(glActiveTexture(GL_TEXTURE0));
     VERIFYGL(glBindTexture(GL_TEXTURE_2D, m_uiCurrentTextureID));
+    RenderQueue::InvalidateTextureCache();
     VERIFYGL(glTexImage2D( GL_TEXTURE_2D, 
                            0, 
                            GL_RGBA,
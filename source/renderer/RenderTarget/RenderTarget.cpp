@@ -11,6 +11,7 @@
 #include "Macros.hpp"
 #include "Log.hpp"
 #include "Util.hpp"
+#include "RenderQueue.hpp"
 
 
 namespace Z
@@ -33,7 +34,8 @@ RenderTarget::RenderTarget() :
     m_textureHeight(0),
     m_fScaleTextureWidth(1.0),
     m_fScaleTextureHeight(1.0),
-    m_maxRenderbufferSize(0)
+    m_maxRenderbufferSize(0),
+    m_contentVersion(0)
 {
     RETAILMSG(ZONE_OBJECT, "RenderTarget::RenderTarget()");
 
@@ -145,6 +147,7 @@ RenderTarget::Init( UINT32 width, UINT32 height, bool offscreen, UINT32 numTextu
         {
             VERIFYGL(glActiveTexture(GL_TEXTURE0));
             VERIFYGL(glBindTexture  (GL_TEXTURE_2D, m_uiTextureIDs[i]));
+            RenderQueue::InvalidateTextureCache();
 
             // TODO: 16-bit option?  Doesn't seem any faster on iPhone, and we lose Alpha (5551 not working!)
             VERIFYGL(glTexImage2D   (GL_TEXTURE_2D, 0, GL_RGBA, m_textureWidth, m_textureHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL));
@@ -271,6 +274,7 @@ RenderTarget::Enable()
     DEBUGCHK(m_uiFramebuffer);
 
     m_enabledForRendering = true;
+    ++m_contentVersion;
 
     // Save off the previous FBO ID
     VERIFYGL(glGetIntegerv(GL_FRAMEBUFFER_BINDING, (GLint*)&m_uiPreviousFramebuffer));
@@ -403,6 +407,7 @@ RenderTarget::SetRenderTexture( UINT32 index )
     }
 
     m_uiCurrentTextureID = m_uiTextureIDs[index];
+    ++m_contentVersion;
 
     // Attach the new texture
     VERIFYGL(glBindFramebuffer(GL_FRAMEBUFFER, m_uiFramebuffer));
@@ -466,4 +471,46 @@ RenderTarget::GetNumTextures() const
 
 
 
+RESULT
+RenderTarget::SetSize( UINT32 width, UINT32 height )
+{
+    if (!width || !height || (GLint)width > m_textureWidth || (GLint)height > m_textureHeight)
+    {
+        RETAILMSG(ZONE_ERROR, "ERROR: RenderTarget[%d]::SetSize( %d, %d ): textures are only %d x %d",
+            m_uiFramebuffer, width, height, m_textureWidth, m_textureHeight);
+
+        return E_INVALID_ARG;
+    }
+
+    m_width               = width;
+    m_height              = height;
+    m_fScaleTextureWidth  = (float)width /(float)m_textureWidth;
+    m_fScaleTextureHeight = (float)height/(float)m_textureHeight;
+
+    return S_OK;
+}
+
+
+UINT32
+RenderTarget::GetTextureWidth() const
+{
+    return m_textureWidth;
+}
+
+
+UINT32
+RenderTarget::GetTextureHeight() const
+{
+    return m_textureHeight;
+}
+
+
+UINT32
+RenderTarget::GetContentVersion() const
+{
+    return m_contentVersion;
+}
+
+
+
 } // END namespace Z
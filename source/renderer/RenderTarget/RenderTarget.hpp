@@ -43,6 +43,16 @@ public:
     Rectangle   GetTextureRect  ( ) const;
     UINT32      GetNumTextures  ( ) const;
 
+    // Render to (and sample from) only the lower-left width x height of the textures,
+    // so that one surface can stand in for any smaller one.  The HTexture wrappers
+    // keep describing the size the target was created with.
+    RESULT      SetSize         ( UINT32 width, UINT32 height );
+    UINT32      GetTextureWidth ( ) const;
+    UINT32      GetTextureHeight( ) const;
+
+    // Changes whenever the target may have been drawn to.
+    UINT32      GetContentVersion( ) const;
+
 protected:
     RenderTarget();
     RESULT      Init            ( UINT32 width, UINT32 height, bool offscreen = true, UINT32 numTextures = 1, bool pow2 = true );
@@ -66,6 +76,7 @@ protected:
     GLint       m_width;
     GLint       m_height;
     GLint       m_oldViewport[4];
+    UINT32      m_contentVersion;
 
     
     // On OpenGL ES 1.w, the render target needs to have power-of-two dimensions.
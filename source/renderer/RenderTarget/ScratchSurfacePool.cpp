@@ -0,0 +1,194 @@
+/*
+ *  ScratchSurfacePool.cpp
+ *  Critters
+ *
+ *  Size-bucketed offscreen RenderTargets, shared by all Effects.
+ *
+ */
+
+#include "ScratchSurfacePool.hpp"
+#include "RenderTarget.hpp"
+#include "Macros.hpp"
+#include "Log.hpp"
+
+
+namespace Z
+{
+
+
+
+//
+// Static Data
+//
+ScratchSurfacePool::SurfaceList ScratchSurfacePool::s_surfaces;
+UINT64                          ScratchSurfacePool::s_bytes     = 0;
+
+
+
+//
+// Class Methods
+//
+RESULT
+ScratchSurfacePool::Acquire( UINT32 width, UINT32 height, UINT32 numTextures, IN const void* pOwner, OUT RenderTarget** ppTarget, OUT bool* pContentsKept )
+{
+    RESULT  rval         = S_OK;
+    UINT32  bucketWidth  = GetBucketSize( width  );
+    UINT32  bucketHeight = GetBucketSize( height );
+    Surface* pSurface    = NULL;
+    bool    contentsKept = false;
+
+    CPREx(ppTarget, E_NULL_POINTER);
+    CBREx(width && height && numTextures, E_INVALID_ARG);
+
+    // Prefer the surface this owner had last; it may still hold what they left in it.
+    for (SurfaceList::iterator pItem = s_surfaces.begin(); pItem != s_surfaces.end(); ++pItem)
+    {
+        if (pItem->isBorrowed                    ||
+            pItem->bucketWidth  != bucketWidth   ||
+            pItem->bucketHeight != bucketHeight  ||
+            pItem->numTextures  != numTextures)
+        {
+            continue;
+        }
+
+        if (pItem->pLastOwner == pOwner)
+        {
+            pSurface     = &(*pItem);
+            contentsKept = true;
+            break;
+        }
+
+        if (!pSurface)
+        {
+            pSurface = &(*pItem);
+        }
+    }
+
+    if (!pSurface)
+    {
+        Surface surface;
+        surface.pTarget      = RenderTarget::Create( bucketWidth, bucketHeight, true, numTextures, false );
+        surface.bucketWidth  = bucketWidth;
+        surface.bucketHeight = bucketHeight;
+        surface.numTextures  = numTextures;
+        surface.pLastOwner   = NULL;
+        surface.isBorrowed   = false;
+        CPREx(surface.pTarget, E_OUTOFMEMORY);
+        surface.pTarget->AddRef();
+
+        s_surfaces.push_back( surface );
+        s_bytes += (UINT64)bucketWidth * bucketHeight * 4 * numTextures;
+        UpdateMetrics();
+
+        RETAILMSG(ZONE_RENDER, "ScratchSurfacePool: new %d x %d x %d surface for %d x %d; %d surfaces, %lld KB",
+            bucketWidth, bucketHeight, numTextures, width, height, (int)s_surfaces.size(), (long long)(s_bytes / 1024));
+
+        pSurface = &s_surfaces.back();
+    }
+
+    // A different size means different texels, even on our own surface.
+    if (contentsKept && (pSurface->pTarget->GetWidth() != width || pSurface->pTarget->GetHeight() != height))
+    {
+        contentsKept = false;
+    }
+
+    CHR(pSurface->pTarget->SetSize( width, height ));
+
+    pSurface->isBorrowed = true;
+    pSurface->pLastOwner = pOwner;
+    *ppTarget            = pSurface->pTarget;
+
+Exit:
+    if (pContentsKept)
+    {
+        *pContentsKept = SUCCEEDED(rval) && contentsKept;
+    }
+
+    return rval;
+}
+
+
+
+RESULT
+ScratchSurfacePool::Release( IN RenderTarget* pTarget )
+{
+    RESULT rval = S_OK;
+
+    CPREx(pTarget, E_NULL_POINTER);
+
+    for (SurfaceList::iterator pItem = s_surfaces.begin(); pItem != s_surfaces.end(); ++pItem)
+    {
+        if (pItem->pTarget == pTarget)
+        {
+            DEBUGCHK(pItem->isBorrowed);
+            pItem->isBorrowed = false;
+            goto Exit;
+        }
+    }
+
+    RETAILMSG(ZONE_ERROR, "ERROR: ScratchSurfacePool::Release(): 0x%x is not a pooled surface", pTarget);
+    rval = E_INVALID_ARG;
+
+Exit:
+    return rval;
+}
+
+
+
+void
+ScratchSurfacePool::Forget( IN const void* pOwner )
+{
+    for (SurfaceList::iterator pItem = s_surfaces.begin(); pItem != s_surfaces.end(); ++pItem)
+    {
+        if (pItem->pLastOwner == pOwner)
+        {
+            pItem->pLastOwner = NULL;
+        }
+    }
+}
+
+
+
+void
+ScratchSurfacePool::Trim()
+{
+    SurfaceList::iterator pItem = s_surfaces.begin();
+    while (pItem != s_surfaces.end())
+    {
+        if (pItem->isBorrowed)
+        {
+            ++pItem;
+            continue;
+        }
+
+        s_bytes -= (UINT64)pItem->bucketWidth * pItem->bucketHeight * 4 * pItem->numTextures;
+        SAFE_RELEASE(pItem->pTarget);
+        pItem = s_surfaces.erase( pItem );
+    }
+
+    UpdateMetrics();
+}
+
+
+
+UINT32
+ScratchSurfacePool::GetBucketSize( UINT32 pixels )
+{
+    return ((pixels + SCRATCH_SURFACE_BUCKET_PIXELS - 1) / SCRATCH_SURFACE_BUCKET_PIXELS) * SCRATCH_SURFACE_BUCKET_PIXELS;
+}
+
+
+
+void
+ScratchSurfacePool::UpdateMetrics()
+{
+    static MetricGauge* s_pBytesMetric    = Metrics::RegisterGauge( "Effects.ScratchBytes"    );
+    static MetricGauge* s_pSurfacesMetric = Metrics::RegisterGauge( "Effects.ScratchSurfaces" );
+
+    s_pBytesMetric->Set( (INT64)s_bytes );
+    s_pSurfacesMetric->Set( (INT64)s_surfaces.size() );
+}
+
+
+
+} // END namespace Z
@@ -0,0 +1,82 @@
+#pragma once
+
+#include "Types.hpp"
+#include "Errors.hpp"
+#include "Metrics.hpp"
+
+#include <vector>
+using std::vector;
+
+
+namespace Z
+{
+
+
+class RenderTarget;
+
+
+//
+// Offscreen scratch surfaces shared by all Effects.
+//
+// Post-effects borrow a frame-sized surface for the span of BeginFrame()/EndFrame(),
+// and BlurEffect borrows its ping-pong pair for the length of one Draw().  Sizes are
+// rounded up to SCRATCH_SURFACE_BUCKET_PIXELS so that small changes (an animated blur
+// radius, a resized Layer) land on a surface we already have, instead of allocating
+// a new FBO and textures.
+//
+// A surface keeps its contents while it sits in the pool.  Acquire() prefers the
+// surface the caller released last, and reports whether anybody else used it since;
+// BlurEffect relies on this to re-present a cached result.
+//
+// The pool is only touched from the render thread.
+//
+
+#define SCRATCH_SURFACE_BUCKET_PIXELS   32
+
+
+class ScratchSurfacePool
+{
+public:
+    // Borrow a surface sized to exactly width x height (see RenderTarget::SetSize()).
+    // *pContentsKept is set if this is the surface pOwner last released, untouched since.
+    static  RESULT  Acquire             ( UINT32 width, UINT32 height, UINT32 numTextures, IN const void* pOwner, OUT RenderTarget** ppTarget, OUT bool* pContentsKept = NULL );
+    static  RESULT  Release             ( IN RenderTarget* pTarget );
+
+    // Call when pOwner is destroyed, so a new object at the same address can't claim its contents.
+    static  void    Forget              ( IN const void* pOwner );
+
+    // Free every surface that isn't borrowed.
+    static  void    Trim                ( );
+
+    static  UINT32  GetNumSurfaces      ( )     { return (UINT32)s_surfaces.size(); }
+    static  UINT64  GetBytes            ( )     { return s_bytes; }
+
+protected:
+    struct Surface
+    {
+        RenderTarget*   pTarget;
+        UINT32          bucketWidth;
+        UINT32          bucketHeight;
+        UINT32          numTextures;
+        const void*     pLastOwner;
+        bool            isBorrowed;
+    };
+
+    typedef vector<Surface> SurfaceList;
+
+    static  UINT32  GetBucketSize       ( UINT32 pixels );
+    static  void    UpdateMetrics       ( );
+
+protected:
+    static  SurfaceList     s_surfaces;
+    static  UINT64          s_bytes;
+
+private:
+    ScratchSurfacePool();
+    ScratchSurfacePool( const ScratchSurfacePool& rhs );
+    ScratchSurfacePool& operator=( const ScratchSurfacePool& rhs );
+};
+
+
+
+} // END namespace Z
@@ -38,6 +38,45 @@ typedef struct
 } Vertex;
 
 
+//
+// Compact vertex for flat, textured quads (Sprites, glyphs, particles): 2D position,
+// and texture coordinates normalized to 16 bits.  16 bytes instead of 24.
+// See QuadList::CanPack() for which Vertices convert without loss.
+// Fixed-width types only: this is the layout handed to GL.
+//
+typedef struct
+{
+    union
+    {
+        struct {
+            float   x;
+            float   y;
+        };
+        float position[2];
+    };
+
+    union {
+        struct {
+            uint8_t r;
+            uint8_t g;
+            uint8_t b;
+            uint8_t a;
+        };
+        uint32_t color;
+    };
+
+    union {
+        struct {
+            uint16_t u0;
+            uint16_t v0;
+        };
+        uint16_t texCoord[2];
+    };
+} PackedVertex;
+
+STATIC_ASSERT(sizeof(PackedVertex) == 16, PackedVertex_size);
+
+
 // TODO: custom vertex formats for lighting, multi-texturing, point sprites, etc.
 
 
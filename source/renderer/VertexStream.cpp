@@ -0,0 +1,281 @@
+/*
+ *  VertexStream.cpp
+ *  Critters
+ *
+ *  Ring of streaming vertex buffers for the GLES2 renderer and Effects.
+ *
+ */
+
+#include "VertexStream.hpp"
+#include "QuadList.hpp"
+#include "ShaderManager.hpp"
+#include "Macros.hpp"
+#include "Log.hpp"
+
+#include <stddef.h>
+
+
+namespace Z
+{
+
+
+
+//
+// Static Data
+//
+bool            VertexStream::s_isEnabled                           = false;
+bool            VertexStream::s_isInitialized                       = false;
+GLuint          VertexStream::s_buffers[ VERTEX_STREAM_BUFFERS ]    = { 0 };
+GLuint          VertexStream::s_indexBuffer                         = 0;
+GLuint          VertexStream::s_boundArrayBuffer                    = 0;
+GLuint          VertexStream::s_boundIndexBuffer                    = 0;
+UINT32          VertexStream::s_current                             = 0;
+UINT32          VertexStream::s_offset                              = 0;
+UINT32          VertexStream::s_bufferBytes                         = VERTEX_STREAM_INITIAL_BYTES;
+bool            VertexStream::s_isOrphaned                          = false;
+bool            VertexStream::s_overflowed                          = false;
+
+MetricCounter*  VertexStream::s_pStreamedBytesMetric                = NULL;
+MetricCounter*  VertexStream::s_pFallbacksMetric                    = NULL;
+MetricCounter*  VertexStream::s_pOrphansMetric                      = NULL;
+MetricGauge*    VertexStream::s_pBufferBytesMetric                  = NULL;
+
+
+
+//
+// Class Methods
+//
+RESULT
+VertexStream::Init()
+{
+    RESULT rval = S_OK;
+
+    DEBUGMSG(ZONE_INFO, "VertexStream::Init()");
+
+    s_pStreamedBytesMetric  = Metrics::RegisterCounter( "Renderer.StreamedBytes"    );
+    s_pFallbacksMetric      = Metrics::RegisterCounter( "Renderer.StreamFallbacks"  );
+    s_pOrphansMetric        = Metrics::RegisterCounter( "Renderer.StreamOrphans"    );
+    s_pBufferBytesMetric    = Metrics::RegisterGauge  ( "Renderer.StreamBufferBytes");
+
+    if (s_isInitialized)
+    {
+        goto Exit;
+    }
+
+    s_bufferBytes = VERTEX_STREAM_INITIAL_BYTES;
+    s_current     = 0;
+    s_offset      = 0;
+    s_isOrphaned  = false;
+    s_overflowed  = false;
+
+    VERIFYGL(glGenBuffers(VERTEX_STREAM_BUFFERS, s_buffers));
+    VERIFYGL(glGenBuffers(1, &s_indexBuffer));
+
+    // Every quad list draws from the same indices; upload the most any draw can use, once.
+    VERIFYGL(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, s_indexBuffer));
+    VERIFYGL(glBufferData(GL_ELEMENT_ARRAY_BUFFER, QUAD_LIST_MAX_QUADS * INDICES_PER_QUAD * sizeof(UINT16), QuadList::GetIndices( QUAD_LIST_MAX_QUADS ), GL_STATIC_DRAW));
+    VERIFYGL(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0));
+
+    s_boundArrayBuffer  = 0;
+    s_boundIndexBuffer  = 0;
+    s_isInitialized     = true;
+
+    s_pBufferBytesMetric->Set( s_bufferBytes );
+
+    RETAILMSG(ZONE_RENDER, "VertexStream: %d x %d KB vertex buffers, %d KB quad indices",
+        VERTEX_STREAM_BUFFERS, s_bufferBytes / 1024, (int)(QUAD_LIST_MAX_QUADS * INDICES_PER_QUAD * sizeof(UINT16) / 1024));
+
+Exit:
+    if (FAILED(rval))
+    {
+        RETAILMSG(ZONE_ERROR, "ERROR: VertexStream::Init() failed; drawing from client arrays");
+    }
+
+    return rval;
+}
+
+
+
+RESULT
+VertexStream::Deinit()
+{
+    RESULT rval = S_OK;
+
+    DEBUGMSG(ZONE_INFO, "VertexStream::Deinit()");
+
+    if (!s_isInitialized)
+    {
+        goto Exit;
+    }
+
+    s_isInitialized = false;
+
+    BindArrayBuffer( 0 );
+    BindIndexBuffer( 0 );
+
+    VERIFYGL(glDeleteBuffers(VERTEX_STREAM_BUFFERS, s_buffers));
+    VERIFYGL(glDeleteBuffers(1, &s_indexBuffer));
+
+    memset(s_buffers, 0, sizeof(s_buffers));
+    s_indexBuffer = 0;
+
+Exit:
+    return rval;
+}
+
+
+
+void
+VertexStream::BeginFrame()
+{
+    if (!IsEnabled())
+    {
+        return;
+    }
+
+    // Last frame ran out of room; give the ring more, so it doesn't keep orphaning mid-frame.
+    if (s_overflowed && s_bufferBytes < VERTEX_STREAM_MAX_BYTES)
+    {
+        s_bufferBytes = MIN(s_bufferBytes * 2, VERTEX_STREAM_MAX_BYTES);
+        s_pBufferBytesMetric->Set( s_bufferBytes );
+
+        RETAILMSG(ZONE_RENDER, "VertexStream: growing to %d KB per buffer", s_bufferBytes / 1024);
+    }
+
+    s_current    = (s_current + 1) % VERTEX_STREAM_BUFFERS;
+    s_offset     = 0;
+    s_isOrphaned = false;
+    s_overflowed = false;
+}
+
+
+
+void
+VertexStream::BindVertices( IN const Vertex* pVertices, UINT32 numVertices )
+{
+    const BYTE* pBase = Write( pVertices, numVertices * sizeof(Vertex) );
+
+    VERIFYGL(glVertexAttribPointer(ATTRIBUTE_VERTEX_POSITION,       3, GL_FLOAT,         GL_FALSE, sizeof(Vertex), pBase + offsetof(Vertex, position)));
+    VERIFYGL(glVertexAttribPointer(ATTRIBUTE_VERTEX_DIFFUSE,        4, GL_UNSIGNED_BYTE, GL_TRUE,  sizeof(Vertex), pBase + offsetof(Vertex, color)));
+    VERIFYGL(glVertexAttribPointer(ATTRIBUTE_VERTEX_TEXTURE_COORD0, 2, GL_FLOAT,         GL_FALSE, sizeof(Vertex), pBase + offsetof(Vertex, texCoord)));
+
+Exit:
+    return;
+}
+
+
+
+void
+VertexStream::BindPackedVertices( IN const PackedVertex* pVertices, UINT32 numVertices )
+{
+    const BYTE* pBase = Write( pVertices, numVertices * sizeof(PackedVertex) );
+
+    VERIFYGL(glVertexAttribPointer(ATTRIBUTE_VERTEX_POSITION,       2, GL_FLOAT,          GL_FALSE, sizeof(PackedVertex), pBase + offsetof(PackedVertex, position)));
+    VERIFYGL(glVertexAttribPointer(ATTRIBUTE_VERTEX_DIFFUSE,        4, GL_UNSIGNED_BYTE,  GL_TRUE,  sizeof(PackedVertex), pBase + offsetof(PackedVertex, color)));
+    VERIFYGL(glVertexAttribPointer(ATTRIBUTE_VERTEX_TEXTURE_COORD0, 2, GL_UNSIGNED_SHORT, GL_TRUE,  sizeof(PackedVertex), pBase + offsetof(PackedVertex, texCoord)));
+
+Exit:
+    return;
+}
+
+
+
+const GLvoid*
+VertexStream::BindQuadIndices( UINT32 numQuads )
+{
+    if (IsEnabled())
+    {
+        BindIndexBuffer( s_indexBuffer );
+        return NULL;
+    }
+
+    BindIndexBuffer( 0 );
+    return QuadList::GetIndices( numQuads );
+}
+
+
+
+const BYTE*
+VertexStream::Write( IN const void* pData, UINT32 numBytes )
+{
+    UINT32 alignedBytes = (numBytes + VERTEX_STREAM_ALIGNMENT - 1) & ~(VERTEX_STREAM_ALIGNMENT - 1);
+    UINT32 offset       = 0;
+
+    if (!IsEnabled() || numBytes > s_bufferBytes)
+    {
+        if (IsEnabled())
+        {
+            // Bigger than a whole buffer; next frame's will be bigger.
+            s_overflowed = true;
+            s_pFallbacksMetric->Increment();
+        }
+
+        BindArrayBuffer( 0 );
+        return (const BYTE*)pData;
+    }
+
+    BindArrayBuffer( s_buffers[ s_current ] );
+
+    // Out of room: orphan again and start over; draws already issued keep the old storage.
+    if (s_isOrphaned && s_offset + alignedBytes > s_bufferBytes)
+    {
+        s_overflowed = true;
+        s_isOrphaned = false;
+        s_offset     = 0;
+    }
+
+    if (!s_isOrphaned)
+    {
+        VERIFYGL(glBufferData(GL_ARRAY_BUFFER, s_bufferBytes, NULL, GL_STREAM_DRAW));
+        s_isOrphaned = true;
+        s_pOrphansMetric->Increment();
+    }
+
+    VERIFYGL(glBufferSubData(GL_ARRAY_BUFFER, s_offset, numBytes, pData));
+
+    offset    = s_offset;
+    s_offset += alignedBytes;
+    s_pStreamedBytesMetric->Add( numBytes );
+
+    return (const BYTE*)NULL + offset;
+
+Exit:
+    // The GL rejected the upload; draw this one from client memory.
+    s_pFallbacksMetric->Increment();
+    BindArrayBuffer( 0 );
+    return (const BYTE*)pData;
+}
+
+
+
+void
+VertexStream::BindArrayBuffer( GLuint buffer )
+{
+    if (buffer != s_boundArrayBuffer)
+    {
+        VERIFYGL(glBindBuffer(GL_ARRAY_BUFFER, buffer));
+        s_boundArrayBuffer = buffer;
+    }
+
+Exit:
+    return;
+}
+
+
+
+void
+VertexStream::BindIndexBuffer( GLuint buffer )
+{
+    if (buffer != s_boundIndexBuffer)
+    {
+        VERIFYGL(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffer));
+        s_boundIndexBuffer = buffer;
+    }
+
+Exit:
+    return;
+}
+
+
+
+} // END namespace Z
@@ -0,0 +1,91 @@
+#pragma once
+
+#include "Types.hpp"
+#include "Errors.hpp"
+#include "Vertex.hpp"
+#include "Metrics.hpp"
+
+#include <OpenGLES/ES2/gl.h>
+
+
+namespace Z
+{
+
+
+//
+// Streams the GLES2 renderer's and Effects' vertices through a small ring of
+// renderer-owned buffer objects, instead of handing the driver client-side arrays
+// it must copy at every draw.
+//
+// Each frame appends to the next buffer in the ring.  The first write of a frame
+// orphans the buffer (glBufferData( NULL )), so we never wait on the GPU for a
+// draw still reading last frame's vertices; later writes go in with glBufferSubData()
+// at increasing offsets.  A frame that runs out of room orphans again and starts
+// over, and the buffer is grown for the next time around.
+//
+// Quad lists draw from one static index buffer holding the QuadList pattern.
+//
+// Off by default, so everything binds client arrays as before; enable with
+// Settings.bUseVertexStream = "1".  Render thread only.
+//
+
+#define VERTEX_STREAM_BUFFERS           3
+#define VERTEX_STREAM_INITIAL_BYTES     (256*1024)
+#define VERTEX_STREAM_MAX_BYTES         (4*1024*1024)
+#define VERTEX_STREAM_ALIGNMENT         16
+
+
+class VertexStream
+{
+public:
+    static  RESULT  Init                ( );
+    static  RESULT  Deinit              ( );
+
+    static  void    Enable              ( bool enabled )    { s_isEnabled = enabled; }
+    static  bool    IsEnabled           ( )                 { return s_isEnabled && s_isInitialized; }
+
+    // Advance the ring; once per frame, before the first draw.
+    static  void    BeginFrame          ( );
+
+    // Copy the vertices into the stream and point the vertex attributes at them.
+    static  void    BindVertices        ( IN const Vertex* pVertices, UINT32 numVertices );
+    static  void    BindPackedVertices  ( IN const PackedVertex* pVertices, UINT32 numVertices );
+
+    // Bind the quad index buffer; returns the indices argument for glDrawElements().
+    static  const GLvoid*   BindQuadIndices ( UINT32 numQuads );
+
+    static  UINT32  GetBufferBytes      ( )                 { return s_bufferBytes; }
+
+protected:
+    // Returns the base to offset attribute pointers from: a buffer offset, or pData itself.
+    static  const BYTE*     Write       ( IN const void* pData, UINT32 numBytes );
+    static  void    BindArrayBuffer     ( GLuint buffer );
+    static  void    BindIndexBuffer     ( GLuint buffer );
+
+protected:
+    static  bool            s_isEnabled;
+    static  bool            s_isInitialized;
+    static  GLuint          s_buffers[ VERTEX_STREAM_BUFFERS ];
+    static  GLuint          s_indexBuffer;
+    static  GLuint          s_boundArrayBuffer;
+    static  GLuint          s_boundIndexBuffer;
+    static  UINT32          s_current;
+    static  UINT32          s_offset;
+    static  UINT32          s_bufferBytes;
+    static  bool            s_isOrphaned;
+    static  bool            s_overflowed;
+
+    static  MetricCounter*  s_pStreamedBytesMetric;
+    static  MetricCounter*  s_pFallbacksMetric;
+    static  MetricCounter*  s_pOrphansMetric;
+    static  MetricGauge*    s_pBufferBytesMetric;
+
+private:
+    VertexStream();
+    VertexStream( const VertexStream& rhs );
+    VertexStream& operator=( const VertexStream& rhs );
+};
+
+
+
+} // END namespace Z
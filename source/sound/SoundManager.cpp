@@ -18,6 +18,7 @@
 #include "Util.hpp"
 #include "GameObjectManager.hpp"
 #include "StoryboardManager.hpp"
+#include "Profiler.hpp"
 
 
 namespace Z
@@ -406,6 +407,8 @@ SoundManager::Update( UINT64 elapsedMS )
 {
     RESULT rval = S_OK;
 
+    PROFILE_SCOPE("SoundMan.Update");
+
 /*
     // Release Sounds that were marked as done on previous frame.
     SoundListIterator ppSound;
@@ -28,6 +28,23 @@
 #include "BlurEffect.hpp"
 #include "RippleEffect.hpp"
 #include "MorphEffect.hpp"
+#include "NullRenderer.hpp"
+#include "RenderQueue.hpp"
+#include "Profiler.hpp"
+#include "PerfTimer.hpp"
+#include "JobSystem.hpp"
+#include "ScratchSurfacePool.hpp"
+#include "QuadList.hpp"
+#include "VertexStream.hpp"
+#include "TessellationCache.hpp"
+#include "Displacement.hpp"
+#include "Transforms.hpp"
+#include "RingBuffer.hpp"
+#include "BoardSearch.hpp"
+#include "GameSnapshot.hpp"
+
+#include <pthread.h>
+#include <sched.h>
 
 #include "json.h"
 
@@ -40,6 +57,7 @@
 #include "unittest3b.h"
 #include "unittest4.h"
 #include "unittest5.h"
+#include "unittest6.h"
 
 
 
@@ -512,6 +530,42 @@ bool TestMetrics()
     RETAILMSG(ZONE_INFO, "METRIC_RAM_HIGH           = %d", *(UINT64*)Metrics::Get(METRIC_RAM_HIGH));
     RETAILMSG(ZONE_INFO, "METRIC_TEXTURE_CHANGES    = %d", *(UINT64*)Metrics::Get(METRIC_TEXTURE_CHANGES));
     
+
+    //
+    // Registered metrics.
+    //
+    {
+    MetricCounter*   pCounter   = Metrics::RegisterCounter  ( "Test.Counter"   );
+    MetricGauge*     pGauge     = Metrics::RegisterGauge    ( "Test.Gauge"     );
+    MetricHistogram* pHistogram = Metrics::RegisterHistogram( "Test.Histogram" );
+
+    INT64 start = pCounter->Get();
+    pCounter->Increment();
+    pCounter->Add( 9 );
+    pGauge->Set( 42 );
+    pGauge->Add( -2 );
+
+    pHistogram->Reset();
+    for (int i = 1; i <= 100; ++i)
+    {
+        pHistogram->Record( i * 0.25 );     // 0.25 .. 25 ms
+    }
+
+    RETAILMSG(ZONE_INFO, "Test.Counter = %lld Test.Gauge = %lld Test.Histogram p50 = %.2f p95 = %.2f p99 = %.2f max = %.2f",
+              pCounter->Get() - start, pGauge->Get(),
+              pHistogram->GetPercentile(50), pHistogram->GetPercentile(95), pHistogram->GetPercentile(99), pHistogram->GetMax());
+
+    if (pCounter->Get() - start != 10                           ||
+        pGauge->Get()           != 40                           ||
+        Metrics::RegisterCounter( "Test.Counter" ) != pCounter  ||
+        pHistogram->GetCount()  != 100                          ||
+        pHistogram->GetPercentile(50) != 12.75                  ||
+        pHistogram->GetPercentile(99) != 25.0)
+    {
+        RETAILMSG(ZONE_ERROR, "ERROR: TestMetrics: unexpected values");
+        rval = false;
+    }
+    }
     
 Exit:
     return rval;
@@ -1629,6 +1683,2814 @@ bool TestRipple()
 }
 
 
+
+bool TestNullRenderer()
+{
+    bool            rval = true;
+    NullRenderer*   pRenderer = NullRenderer::Create();
+    UINT32          textureID = 1;
+    Vertex          vertices[ VERTS_PER_SPRITE ];
+    Rectangle       rect = { 0, 0, 64, 64 };
+    string          path;
+
+    Util::CreateTriangleList( &rect, 1, 1, vertices );
+
+    pRenderer->Init( 320, 480 );
+    pRenderer->BeginFrame();
+    pRenderer->Clear( Color::Black() );
+    pRenderer->PushEffect( HEffect::NullHandle() );
+    pRenderer->SetTexture( 0, textureID );
+    pRenderer->SetTexture( 0, textureID );    // redundant
+    pRenderer->SetModelViewMatrix( mat4::Identity() );
+    pRenderer->DrawTriangleList( vertices, VERTS_PER_SPRITE );
+    pRenderer->DrawTriangleList( vertices, VERTS_PER_SPRITE );
+    pRenderer->PopEffect();
+    pRenderer->EndFrame();
+
+    const RenderStats& stats = pRenderer->GetFrameStats();
+
+    RETAILMSG(ZONE_INFO, "TestNullRenderer: %d commands %d draws %d verts %d binds %d texture changes %d redundant",
+              stats.numCommands, stats.numDrawCalls, stats.numVertices, stats.numTextureBinds, stats.numTextureChanges, stats.numRedundantCommands);
+
+    if (stats.numDrawCalls      != 2                    ||
+        stats.numVertices       != 2 * VERTS_PER_SPRITE ||
+        stats.numEffectPushes   != 1                    ||
+        stats.numEffectPops     != 1                    ||
+        stats.numTextureBinds   != 2                    ||
+        stats.numTextureChanges != 1)
+    {
+        RETAILMSG(ZONE_ERROR, "ERROR: TestNullRenderer: unexpected counts");
+        rval = false;
+    }
+
+    Platform::GetPathToPersistantStorage( &path );
+    pRenderer->Dump( path + "/nullrenderer.txt" );
+
+    // If the engine itself is running on the NullRenderer, record a full frame of the current scene.
+    NullRenderer* pEngineRenderer = dynamic_cast<NullRenderer*>( &Renderer );
+    RenderQueue*  pEngineQueue    = dynamic_cast<RenderQueue*>( &Renderer );
+    if (pEngineQueue)
+    {
+        pEngineRenderer = dynamic_cast<NullRenderer*>( pEngineQueue->GetBackend() );
+    }
+
+    if (pEngineRenderer)
+    {
+        Engine::Render();
+        pEngineRenderer->Dump( path + "/nullrenderer_frame.txt" );
+
+        const RenderStats& frameStats = pEngineRenderer->GetFrameStats();
+        RETAILMSG(ZONE_INFO, "TestNullRenderer: scene: %d draws %d verts %d effect changes %d texture changes %d matrix changes",
+                  frameStats.numDrawCalls, frameStats.numVertices, frameStats.numEffectChanges, frameStats.numTextureChanges, frameStats.numMatrixChanges);
+    }
+    
+    return rval;
+}
+
+
+bool TestProfiler()
+{
+    bool    rval        = true;
+    bool    wasEnabled  = Profiler::IsEnabled();
+    string  path;
+
+    Profiler::Enable( true );
+    Profiler::Reset();
+
+    {
+        PROFILE_SCOPE("TestProfiler.Outer");
+        for (int i = 0; i < 3; ++i)
+        {
+            PROFILE_SCOPE("TestProfiler.Inner");
+            Platform::Sleep( 1 );
+        }
+    }
+
+    // Disabled markers must not record anything.
+    Profiler::Enable( false );
+    {
+        PROFILE_SCOPE("TestProfiler.Disabled");
+    }
+
+    RETAILMSG(ZONE_INFO, "TestProfiler: %d events", Profiler::GetNumEvents());
+
+#ifdef ENABLE_PROFILER
+    if (Profiler::GetNumEvents() != 4)
+    {
+        RETAILMSG(ZONE_ERROR, "ERROR: TestProfiler: expected 4 events");
+        rval = false;
+    }
+#endif
+
+    Platform::GetPathToPersistantStorage( &path );
+    Profiler::ExportChromeTrace( path + "/trace_test.json" );
+
+    Profiler::Enable( wasEnabled );
+
+    return rval;
+}
+
+
+struct TestLogJob
+{
+    int     marker;
+    int     job;
+    int     numMessages;
+};
+
+
+
+static void
+TestLogWriteJob( void* pContext )
+{
+    TestLogJob* pJob = (TestLogJob*)pContext;
+
+    for (int i = 0; i < pJob->numMessages; ++i)
+    {
+        RETAILMSG(ZONE_INFO, "TestLog: %d job %d message %d", pJob->marker, pJob->job, i);
+    }
+}
+
+
+
+bool TestLog()
+{
+    bool        rval            = true;
+    const int   NUM_MESSAGES    = 1000;
+    const int   NUM_JOBS        = 4;
+    const int   LONG_LENGTH     = 900;
+    PerfTimer   timer;
+    ZONE_MASK   savedMask       = Log::GetZoneMask();
+    UINT32      droppedBefore   = Log::GetNumDroppedMessages();
+    UINT32      numDropped      = 0;
+    int         marker          = (int)(Platform::GetTickCount() & 0x7FFFFFFF);
+    int         numFound        = 0;
+    bool        sawBegin        = false;
+    bool        sawEnd          = false;
+    bool        sawLong         = false;
+    int         lastMessage[ NUM_JOBS ];
+    TestLogJob  jobs[ NUM_JOBS ];
+    char        prefix[ 64 ];
+    char        longText[ LONG_LENGTH + 1 ];
+    char        line[ 2048 ];
+    FILE*       pFile           = NULL;
+    JobCounter  counter;
+
+    // Cost of a message in a zone that is compiled in but disabled.
+    Log::DisableZone( ZONE_VERBOSE );
+    timer.Start();
+    for (int i = 0; i < NUM_MESSAGES; ++i)
+    {
+        RETAILMSG(ZONE_VERBOSE, "TestLog: disabled %d %s %f", i, "string", 1.0f);
+    }
+    timer.Stop();
+    double disabledUS = timer.ElapsedMilliseconds() * 1000.0 / NUM_MESSAGES;
+
+    // Cost of an enabled message on the calling thread.
+    Log::EnableZone( ZONE_VERBOSE );
+    timer.Start();
+    for (int i = 0; i < NUM_MESSAGES; ++i)
+    {
+        RETAILMSG(ZONE_VERBOSE, "TestLog: enabled %d %s %f", i, "string", 1.0f);
+    }
+    timer.Stop();
+    double enabledUS = timer.ElapsedMilliseconds() * 1000.0 / NUM_MESSAGES;
+
+    Log::SetZoneMask( savedMask );
+    Log::Flush();
+
+    RETAILMSG(ZONE_INFO, "TestLog: disabled %.3f us/call, enabled %.3f us/call, %u dropped",
+              disabledUS, enabledUS, (unsigned)(Log::GetNumDroppedMessages() - droppedBefore));
+
+    if (Log::GetFilename().empty() || !Log::IsZoneEnabled( ZONE_INFO ))
+    {
+        RETAILMSG(ZONE_WARN, "WARNING: TestLog: no log file, or ZONE_INFO is off; not checking what was written");
+        return rval;
+    }
+
+    //
+    // Messages from several threads reach the file whole, each thread's in the
+    // order it logged them, and each one either written once or counted as dropped.
+    //
+    memset(longText, 'x', LONG_LENGTH);
+    longText[ LONG_LENGTH ] = '\0';
+
+    droppedBefore = Log::GetNumDroppedMessages();
+    RETAILMSG(ZONE_INFO, "TestLog: %d begin", marker);
+    RETAILMSG(ZONE_INFO, "TestLog: %d long %s", marker, longText);
+    Log::Flush();
+
+    for (int i = 0; i < NUM_JOBS; ++i)
+    {
+        jobs[i].marker      = marker;
+        jobs[i].job         = i;
+        jobs[i].numMessages = NUM_MESSAGES;
+        lastMessage[i]      = -1;
+        IGNOREHR(JobSystem::Run( TestLogWriteJob, &jobs[i], &counter ));
+    }
+    JobSystem::Wait( &counter );
+
+    Log::Flush();
+    RETAILMSG(ZONE_INFO, "TestLog: %d end", marker);
+    Log::Flush();
+    numDropped = Log::GetNumDroppedMessages() - droppedBefore;
+
+    pFile = fopen( Log::GetFilename().c_str(), "r" );
+    if (!pFile)
+    {
+        RETAILMSG(ZONE_ERROR, "ERROR: TestLog: can't read \"%s\"", Log::GetFilename().c_str());
+        return false;
+    }
+
+    snprintf( prefix, sizeof(prefix), "TestLog: %d ", marker );
+    while (fgets( line, sizeof(line), pFile ))
+    {
+        const char* pText = strstr( line, prefix );
+        int         job;
+        int         message;
+
+        if (!pText)
+        {
+            continue;
+        }
+        pText += strlen( prefix );
+
+        if (!strncmp( pText, "begin", 5 ))
+        {
+            sawBegin = true;
+        }
+        else if (!strncmp( pText, "end", 3 ))
+        {
+            sawEnd = true;
+        }
+        else if (!strncmp( pText, "long ", 5 ))
+        {
+            sawLong = (LONG_LENGTH == (int)strspn( pText + 5, "x" ));
+        }
+        else if (2 == sscanf( pText, "job %d message %d", &job, &message ) && job >= 0 && job < NUM_JOBS)
+        {
+            if (!sawBegin || sawEnd || message <= lastMessage[job])
+            {
+                RETAILMSG(ZONE_ERROR, "ERROR: TestLog: job %d message %d out of order (previous %d)", job, message, lastMessage[job]);
+                rval = false;
+            }
+            lastMessage[job] = message;
+            numFound++;
+        }
+    }
+    fclose( pFile );
+
+    if (!sawBegin || !sawEnd || !sawLong)
+    {
+        RETAILMSG(ZONE_ERROR, "ERROR: TestLog: begin %d, end %d, %d-char message whole %d", sawBegin, sawEnd, LONG_LENGTH, sawLong);
+        rval = false;
+    }
+
+    // Other threads may have dropped messages meanwhile, so dropped can be more than what's missing.
+    if (numFound > NUM_JOBS * NUM_MESSAGES || numFound + (int)numDropped < NUM_JOBS * NUM_MESSAGES)
+    {
+        RETAILMSG(ZONE_ERROR, "ERROR: TestLog: %d of %d messages written, %u dropped", numFound, NUM_JOBS * NUM_MESSAGES, (unsigned)numDropped);
+        rval = false;
+    }
+
+    RETAILMSG(ZONE_INFO, "TestLog: %d messages from %d jobs: %d written in order, %u dropped",
+              NUM_JOBS * NUM_MESSAGES, NUM_JOBS, numFound, (unsigned)numDropped);
+
+    return rval;
+}
+
+
+
+
+static void
+TestJobSystemEmptyJob( void* pContext )
+{
+}
+
+
+
+static void
+TestJobSystemIncrement( void* pContext )
+{
+    OSAtomicIncrement32Barrier( (volatile int32_t*)pContext );
+}
+
+
+
+static void
+TestJobSystemCheckFirst( void* pContext )
+{
+    // Runs after the first group; every increment must have landed.
+    volatile int32_t* pCount = (volatile int32_t*)pContext;
+    if (*pCount == 64)
+    {
+        OSAtomicIncrement32Barrier( pCount );
+    }
+}
+
+
+
+static void
+TestJobSystemSquareRoots( void* pContext, UINT32 begin, UINT32 end )
+{
+    float* pValues = (float*)pContext;
+    for (UINT32 i = begin; i < end; ++i)
+    {
+        float value = (float)i;
+        for (int n = 0; n < 64; ++n)
+        {
+            value = sqrtf( value + (float)n );
+        }
+        pValues[i] = value;
+    }
+}
+
+
+
+bool TestJobSystem()
+{
+    bool            rval            = true;
+    const UINT32    NUM_JOBS        = 2000;
+    const UINT32    NUM_ELEMENTS    = 200000;
+    PerfTimer       timer;
+    JobCounter      counter;
+    JobCounter      first;
+    JobCounter      second;
+    volatile int32_t count          = 0;
+    float*          pValues         = new float[ NUM_ELEMENTS ];
+    bool            wasInitialized  = JobSystem::IsInitialized();
+
+    IGNOREHR(JobSystem::Init());
+
+    // Spawn overhead: queue and join empty jobs.
+    timer.Start();
+    for (UINT32 i = 0; i < NUM_JOBS; ++i)
+    {
+        IGNOREHR(JobSystem::Run( TestJobSystemEmptyJob, NULL, &counter ));
+    }
+    JobSystem::Wait( &counter );
+    timer.Stop();
+    double spawnUS = timer.ElapsedMilliseconds() * 1000.0 / NUM_JOBS;
+
+    // Dependencies: the second group may not start until the first has finished.
+    for (UINT32 i = 0; i < 64; ++i)
+    {
+        IGNOREHR(JobSystem::Run( TestJobSystemIncrement, (void*)&count, &first ));
+    }
+    IGNOREHR(JobSystem::Run( TestJobSystemCheckFirst, (void*)&count, &second, &first ));
+    JobSystem::Wait( &second );
+
+    if (count != 65)
+    {
+        RETAILMSG(ZONE_ERROR, "ERROR: TestJobSystem: dependency ran early (count = %d)", count);
+        rval = false;
+    }
+
+    // Scaling: the same ParallelFor run serially, then on every worker.
+    timer.Start();
+    TestJobSystemSquareRoots( pValues, 0, NUM_ELEMENTS );
+    timer.Stop();
+    double serialMS = timer.ElapsedMilliseconds();
+
+    timer.Start();
+    IGNOREHR(JobSystem::ParallelFor( TestJobSystemSquareRoots, pValues, NUM_ELEMENTS, 1024 ));
+    timer.Stop();
+    double parallelMS = timer.ElapsedMilliseconds();
+
+    RETAILMSG(ZONE_INFO, "TestJobSystem: %d workers, %.3f us/job spawn+join, ParallelFor %.2f ms vs %.2f ms serial (%.1fx)",
+              JobSystem::GetNumWorkers(), spawnUS, parallelMS, serialMS, parallelMS > 0.0 ? serialMS / parallelMS : 0.0);
+
+    if (!wasInitialized)
+    {
+        IGNOREHR(JobSystem::Shutdown());
+    }
+
+    SAFE_ARRAY_DELETE(pValues);
+
+    return rval;
+}
+
+
+
+bool TestRenderQueue()
+{
+    bool            rval        = true;
+    NullRenderer*   pBackend    = NullRenderer::Create();
+    RenderQueue*    pQueue      = NULL;
+    HEffect         hEffect;
+    HEffect         hCurrent;
+    UINT32          textureID   = 1;
+    Vertex          vertices[ VERTS_PER_SPRITE ];
+    Rectangle       rect        = { 0, 0, 64, 64 };
+
+    Util::CreateTriangleList( &rect, 1, 1, vertices );
+    EffectMan.Get( "DefaultEffect", &hEffect );
+
+    pBackend->AddRef();
+    pBackend->Init( 320, 480 );
+
+    pQueue = RenderQueue::Create( pBackend );
+    pQueue->AddRef();
+
+    // Two Layers of four Sprites, issued the way LayerMan and SpriteMan do:
+    // Layer pushes its Effect, the batch pushes it again, every Sprite re-sets texture and matrix.
+    pQueue->BeginFrame();
+    for (int layer = 0; layer < 2; ++layer)
+    {
+        pQueue->PushEffect( hEffect );
+        pQueue->SetGlobalColor( Color::White() );
+        pQueue->PushEffect( hEffect );
+
+        for (int sprite = 0; sprite < 4; ++sprite)
+        {
+            pQueue->SetTexture( 0, textureID );
+            pQueue->SetModelViewMatrix( layer ? mat4::Translate( (float)sprite, 0, 0 ) : mat4::Identity() );
+            pQueue->DrawTriangleList( vertices, VERTS_PER_SPRITE );
+        }
+
+        pQueue->PopEffect();
+        pQueue->PopEffect();
+    }
+
+    // Logical state is reported even though nothing is bound.
+    pQueue->PushEffect( hEffect );
+    pQueue->GetEffect( &hCurrent );
+    if (hCurrent != hEffect)
+    {
+        RETAILMSG(ZONE_ERROR, "ERROR: TestRenderQueue: GetEffect() doesn't return the pushed Effect");
+        rval = false;
+    }
+    pQueue->PopEffect();
+    pQueue->EndFrame();
+
+    {
+    const RenderQueueStats& stats    = pQueue->GetFrameStats();
+    const RenderStats&      backend  = pBackend->GetFrameStats();
+
+    RETAILMSG(ZONE_INFO, "TestRenderQueue: %d draws, effects %d/%d textures %d/%d matrices %d/%d colors %d/%d",
+              stats.numDrawCalls,
+              stats.numEffectSwitches,  stats.numEffectRequests,
+              stats.numTextureBinds,    stats.numTextureRequests,
+              stats.numMatrixChanges,   stats.numMatrixRequests,
+              stats.numColorChanges,    stats.numColorRequests);
+
+    // Layer 1 at the identity sends its matrix once; layer 2 moves every Sprite.
+    if (stats.numDrawCalls          != 8    ||
+        stats.numEffectRequests     != 10   ||
+        stats.numEffectSwitches     != 1    ||
+        stats.numTextureRequests    != 8    ||
+        stats.numTextureBinds       != 1    ||
+        stats.numMatrixRequests     != 8    ||
+        stats.numMatrixChanges      != 4    ||
+        stats.numColorChanges       != 1)
+    {
+        RETAILMSG(ZONE_ERROR, "ERROR: TestRenderQueue: unexpected queue counts");
+        rval = false;
+    }
+
+    if (backend.numDrawCalls        != 8    ||
+        backend.numEffectPushes     != 1    ||
+        backend.numEffectPops       != 0    ||
+        backend.numTextureBinds     != 1)
+    {
+        RETAILMSG(ZONE_ERROR, "ERROR: TestRenderQueue: unexpected backend counts");
+        rval = false;
+    }
+    }
+
+    // The lazily-bound Effect is popped when the queue goes away, leaving the backend balanced.
+    SAFE_RELEASE(pQueue);
+    if (pBackend->GetCurrentStats().numEffectPops != 1)
+    {
+        RETAILMSG(ZONE_ERROR, "ERROR: TestRenderQueue: backend Effect stack not unwound");
+        rval = false;
+    }
+
+    hEffect.Release();
+    SAFE_RELEASE(pBackend);
+
+    return rval;
+}
+
+
+
+bool TestRetainedSpriteBatches()
+{
+    bool            rval            = true;
+    MetricCounter*  pBuilt          = Metrics::RegisterCounter("SpriteMan.VerticesBuilt");
+    MetricCounter*  pReused         = Metrics::RegisterCounter("SpriteMan.VerticesReused");
+    int             owner           = 0;
+    INT64           built[5];
+    INT64           reused[5];
+    HSprite         hBackground;
+    HSprite         hSprite;
+
+    SpriteMan.Get( "background", &hBackground );
+    SpriteMan.Get( "MarineFace", &hSprite );
+
+    // 0: cold, 1: nothing changed, 2: one Sprite moved, 3: a Sprite recolored, 4: a Sprite removed.
+    for (int frame = 0; frame < 5; ++frame)
+    {
+        INT64 builtBefore  = pBuilt->Get();
+        INT64 reusedBefore = pReused->Get();
+
+        if (frame == 3)
+        {
+            SpriteMan.SetColor( hSprite, Color::Red() );
+        }
+
+        Renderer.BeginFrame();
+        SpriteMan.BeginBatch( &owner );
+        SpriteMan.DrawSprite( hBackground, vec3(0,0,0) );
+        SpriteMan.DrawSprite( hSprite, vec3(0,   0,0) );
+        SpriteMan.DrawSprite( hSprite, vec3(0, 200,0) );
+        if (frame < 4)
+        {
+            SpriteMan.DrawSprite( hSprite, vec3(frame >= 2 ? 100 : 0, 400, 0) );
+        }
+        SpriteMan.EndBatch();
+        Renderer.EndFrame();
+
+        built[frame]  = pBuilt->Get()  - builtBefore;
+        reused[frame] = pReused->Get() - reusedBefore;
+
+        RETAILMSG(ZONE_INFO, "TestRetainedSpriteBatches: frame %d: %lld vertices built, %lld reused", frame, built[frame], reused[frame]);
+    }
+
+    if (built[0] != 4 * VERTS_PER_SPRITE || built[1] != 0 || reused[1] != 4 * VERTS_PER_SPRITE ||
+        built[2] == 0 || built[3] == 0 || built[4] == 0)
+    {
+        RETAILMSG(ZONE_ERROR, "ERROR: TestRetainedSpriteBatches: unexpected rebuild counts");
+        rval = false;
+    }
+
+    SpriteMan.FreeBatches( &owner );
+    SpriteMan.SetColor( hSprite, Color::White() );
+    SpriteMan.Release( hBackground );
+    SpriteMan.Release( hSprite );
+
+    // The current scene: vertices re-transformed per frame now, versus all of them before.
+    for (int frame = 0; frame < 10; ++frame)
+    {
+        INT64 builtBefore  = pBuilt->Get();
+        INT64 reusedBefore = pReused->Get();
+
+        Engine::Render();
+
+        RETAILMSG(ZONE_INFO, "TestRetainedSpriteBatches: scene frame %d: %lld of %lld vertices rebuilt",
+                  frame, pBuilt->Get() - builtBefore, (pBuilt->Get() - builtBefore) + (pReused->Get() - reusedBefore));
+    }
+
+    return rval;
+}
+
+
+
+bool TestSharedShadowPass()
+{
+    bool            rval            = true;
+    MetricCounter*  pBuilt          = Metrics::RegisterCounter("SpriteMan.VerticesBuilt");
+    int             owner           = 0;
+    HSprite         hBackground;
+    HSprite         hSprite;
+    HEffect         hShadowEffect;
+    PerfTimer       timer;
+    double          separateMs;
+    double          sharedMs;
+    INT64           builtBefore;
+
+    SpriteMan.Get( "background", &hBackground );
+    SpriteMan.Get( "MarineFace", &hSprite );
+    EffectMan.Get( "DropShadowEffect", &hShadowEffect );
+
+    // One frame: three of four Sprites cast a shadow, the third doesn't.
+    builtBefore = pBuilt->Get();
+
+    Renderer.BeginFrame();
+    SpriteMan.BeginBatch( &owner );
+    SpriteMan.SetShadowCasting( true );
+    SpriteMan.DrawSprite( hBackground, vec3(0,   0,0) );
+    SpriteMan.DrawSprite( hSprite,     vec3(0,   0,0) );
+    SpriteMan.SetShadowCasting( false );
+    SpriteMan.DrawSprite( hSprite,     vec3(0, 200,0) );
+    SpriteMan.SetShadowCasting( true );
+    SpriteMan.DrawSprite( hSprite,     vec3(0, 400,0) );
+    SpriteMan.DrawShadows( hShadowEffect );
+
+    if (SUCCEEDED(SpriteMan.DrawSprite( hSprite, vec3(0, 600, 0) )))
+    {
+        RETAILMSG(ZONE_ERROR, "ERROR: TestSharedShadowPass: DrawSprite() accepted after DrawShadows()");
+        rval = false;
+    }
+
+    SpriteMan.EndBatch();
+    Renderer.EndFrame();
+
+    if (pBuilt->Get() - builtBefore != 4 * VERTS_PER_SPRITE)
+    {
+        RETAILMSG(ZONE_ERROR, "ERROR: TestSharedShadowPass: %lld vertices built for 4 shadowed Sprites", pBuilt->Get() - builtBefore);
+        rval = false;
+    }
+
+    //
+    // CPU time for a shadowed layer whose Sprites all move every frame:
+    // a separate shadow batch (as Layer used to draw it) versus shared vertices.
+    //
+    timer.Start();
+    for (int frame = 0; frame < 100; ++frame)
+    {
+        Renderer.BeginFrame();
+        Renderer.PushEffect( hShadowEffect );
+        SpriteMan.BeginBatch( &owner, 1 );
+        for (int i = 0; i < 50; ++i)
+        {
+            SpriteMan.DrawSprite( hSprite, vec3((float)frame, (float)(i * 10), 0) );
+        }
+        SpriteMan.EndBatch();
+        Renderer.PopEffect();
+
+        SpriteMan.BeginBatch( &owner );
+        for (int i = 0; i < 50; ++i)
+        {
+            SpriteMan.DrawSprite( hSprite, vec3((float)frame, (float)(i * 10), 0) );
+        }
+        SpriteMan.EndBatch();
+        Renderer.EndFrame();
+    }
+    timer.Stop();
+    separateMs = timer.ElapsedMilliseconds();
+
+    timer.Start();
+    for (int frame = 0; frame < 100; ++frame)
+    {
+        Renderer.BeginFrame();
+        SpriteMan.BeginBatch( &owner );
+        SpriteMan.SetShadowCasting( true );
+        for (int i = 0; i < 50; ++i)
+        {
+            SpriteMan.DrawSprite( hSprite, vec3((float)frame, (float)(i * 10), 0) );
+        }
+        SpriteMan.DrawShadows( hShadowEffect );
+        SpriteMan.EndBatch();
+        Renderer.EndFrame();
+    }
+    timer.Stop();
+    sharedMs = timer.ElapsedMilliseconds();
+
+    RETAILMSG(ZONE_INFO, "TestSharedShadowPass: 50 shadowed Sprites: separate pass %4.4f ms/frame, shared vertices %4.4f ms/frame",
+              separateMs / 100.0, sharedMs / 100.0);
+
+    SpriteMan.FreeBatches( &owner );
+    SpriteMan.Release( hBackground );
+    SpriteMan.Release( hSprite );
+    hShadowEffect.Release();
+
+    return rval;
+}
+
+
+
+bool TestCulling()
+{
+    bool            rval            = true;
+    MetricCounter*  pSubmitted      = Metrics::RegisterCounter("Culling.SpritesSubmitted");
+    MetricCounter*  pCulled         = Metrics::RegisterCounter("Culling.SpritesCulled");
+    MetricCounter*  pLayersCulled   = Metrics::RegisterCounter("Culling.LayersCulled");
+    int             owner           = 0;
+    INT64           submitted;
+    INT64           culled;
+    INT64           layersCulled;
+    HSprite         hSprite;
+    HLayer          hLayer;
+
+    SpriteMan.GetCopy( "MarineFace", &hSprite );
+    LayerMan.CreateLayer( "CullingTestLayer", &hLayer );
+
+    //
+    // Single Sprites: on-screen, far off to the left, and fully transparent.
+    //
+    submitted = pSubmitted->Get();
+    culled    = pCulled->Get();
+
+    Renderer.BeginFrame();
+    SpriteMan.BeginBatch( &owner );
+    SpriteMan.DrawSprite( hSprite, vec3(    0, 0, 0 ) );
+    SpriteMan.DrawSprite( hSprite, vec3(-5000, 0, 0 ) );
+    SpriteMan.DrawSprite( hSprite, vec3(    0, 0, 0 ), 0.0f );
+    SpriteMan.EndBatch();
+    Renderer.EndFrame();
+    SpriteMan.FreeBatches( &owner );
+
+    if (pSubmitted->Get() - submitted != 1 || pCulled->Get() - culled != 2)
+    {
+        RETAILMSG(ZONE_ERROR, "ERROR: TestCulling: %lld submitted, %lld culled; expected 1 and 2", 
+                  pSubmitted->Get() - submitted, pCulled->Get() - culled);
+        rval = false;
+    }
+
+    //
+    // A Layer with nothing on-screen is visited once, then skipped until something moves.
+    //
+    SpriteMan.SetPosition( hSprite, vec3(-5000, 0, 0) );
+    LayerMan.AddToLayer( hLayer, hSprite );
+
+    layersCulled = pLayersCulled->Get();
+    for (int frame = 0; frame < 3; ++frame)
+    {
+        Renderer.BeginFrame();
+        LayerMan.Draw( hLayer );
+        Renderer.EndFrame();
+    }
+
+    if (pLayersCulled->Get() - layersCulled != 2)
+    {
+        RETAILMSG(ZONE_ERROR, "ERROR: TestCulling: off-screen Layer skipped %lld of 3 frames; expected 2", pLayersCulled->Get() - layersCulled);
+        rval = false;
+    }
+
+    SpriteMan.SetPosition( hSprite, vec3(0, 0, 0) );
+
+    layersCulled = pLayersCulled->Get();
+    submitted    = pSubmitted->Get();
+
+    Renderer.BeginFrame();
+    LayerMan.Draw( hLayer );
+    Renderer.EndFrame();
+
+    if (pLayersCulled->Get() != layersCulled || pSubmitted->Get() - submitted != 1)
+    {
+        RETAILMSG(ZONE_ERROR, "ERROR: TestCulling: Layer still culled after its Sprite moved on-screen");
+        rval = false;
+    }
+
+    LayerMan.Release( hLayer );
+    SpriteMan.Release( hSprite );
+
+    return rval;
+}
+
+
+
+bool TestScratchSurfaces()
+{
+    bool            rval            = true;
+    MetricCounter*  pPasses         = Metrics::RegisterCounter("Effects.OffscreenPasses");
+    int             ownerA          = 0;
+    int             ownerB          = 0;
+    RenderTarget*   pFirst          = NULL;
+    RenderTarget*   pSecond         = NULL;
+    bool            contentsKept    = true;
+    UINT32          numSurfaces;
+    INT64           passes;
+    UINT32          frames;
+    HSprite         hSprite;
+    HLayer          hLayer;
+    HEffect         hBlur;
+    HStoryboard     hStoryboard;
+
+    // Start from an empty pool, so the counts below are ours.
+    ScratchSurfacePool::Trim();
+    numSurfaces = ScratchSurfacePool::GetNumSurfaces();
+
+    //
+    // Sizes within a bucket share a surface; an owner gets its contents back
+    // only if nobody else borrowed the surface in between.
+    //
+    ScratchSurfacePool::Acquire( 100, 60, 2, &ownerA, &pFirst, &contentsKept );
+    if (!pFirst || contentsKept || pFirst->GetTextureWidth() != 128 || pFirst->GetTextureHeight() != 64)
+    {
+        RETAILMSG(ZONE_ERROR, "ERROR: TestScratchSurfaces: expected a fresh 128 x 64 surface for 100 x 60");
+        rval = false;
+    }
+    ScratchSurfacePool::Release( pFirst );
+
+    ScratchSurfacePool::Acquire( 110, 50, 2, &ownerA, &pSecond, &contentsKept );
+    if (pSecond != pFirst || contentsKept || pSecond->GetWidth() != 110 || pSecond->GetTextureRect().width != 110.0f/128.0f)
+    {
+        RETAILMSG(ZONE_ERROR, "ERROR: TestScratchSurfaces: 110 x 50 should reuse the 128 x 64 surface, without its contents");
+        rval = false;
+    }
+    ScratchSurfacePool::Release( pSecond );
+
+    ScratchSurfacePool::Acquire( 110, 50, 2, &ownerA, &pSecond, &contentsKept );
+    if (pSecond != pFirst || !contentsKept)
+    {
+        RETAILMSG(ZONE_ERROR, "ERROR: TestScratchSurfaces: same owner and size should get its contents back");
+        rval = false;
+    }
+    ScratchSurfacePool::Release( pSecond );
+
+    ScratchSurfacePool::Acquire( 110, 50, 2, &ownerB, &pSecond, &contentsKept );
+    ScratchSurfacePool::Acquire( 110, 50, 2, &ownerA, &pFirst,  &contentsKept );
+    if (pSecond == pFirst || contentsKept || ScratchSurfacePool::GetNumSurfaces() != numSurfaces + 2)
+    {
+        RETAILMSG(ZONE_ERROR, "ERROR: TestScratchSurfaces: a borrowed surface was handed out twice, or kept its contents for the wrong owner");
+        rval = false;
+    }
+    ScratchSurfacePool::Release( pFirst  );
+    ScratchSurfacePool::Release( pSecond );
+
+    ScratchSurfacePool::Trim();
+    if (ScratchSurfacePool::GetNumSurfaces() != numSurfaces)
+    {
+        RETAILMSG(ZONE_ERROR, "ERROR: TestScratchSurfaces: Trim() left %d surfaces", ScratchSurfacePool::GetNumSurfaces());
+        rval = false;
+    }
+
+
+    //
+    // The menu transition: blur a Layer in, then hold it.
+    // Once the radius stops changing the pool must stop growing.
+    //
+    Sprites.CreateFromFile( "/app/Default@2x.png", &hSprite );
+    LayerMan.CreateLayer( "ScratchSurfaceTestLayer", &hLayer );
+    LayerMan.AddToLayer( hLayer, hSprite );
+    Effects.GetCopy( "BlurEffect", &hBlur );
+    LayerMan.SetEffect( hLayer, hBlur );
+    StoryboardMan.GetCopy( "BlurOut", &hStoryboard );
+    StoryboardMan.BindTo( hStoryboard, hBlur );
+    StoryboardMan.Start( hStoryboard );
+
+    passes = pPasses->Get();
+    frames = 0;
+    UINT64 endTimeMS = GameTime.GetTime() + StoryboardMan.GetDurationMS( hStoryboard ) + 100;
+    for (UINT64 time = GameTime.GetTime(); time < endTimeMS; time = GameTime.GetTime())
+    {
+        StoryboardMan.Update( time );
+
+        Renderer.BeginFrame();
+        LayerMan.Draw( hLayer );
+        Renderer.EndFrame();
+        ++frames;
+    }
+
+    RETAILMSG(ZONE_INFO, "TestScratchSurfaces: blur in: %d frames, %.1f offscreen passes/frame, %d surfaces, %lld KB",
+              frames, frames ? (double)(pPasses->Get() - passes)/frames : 0.0,
+              ScratchSurfacePool::GetNumSurfaces(), (long long)(ScratchSurfacePool::GetBytes()/1024));
+
+    numSurfaces = ScratchSurfacePool::GetNumSurfaces();
+    passes      = pPasses->Get();
+    for (frames = 0; frames < 10; ++frames)
+    {
+        Renderer.BeginFrame();
+        LayerMan.Draw( hLayer );
+        Renderer.EndFrame();
+    }
+
+    RETAILMSG(ZONE_INFO, "TestScratchSurfaces: hold: %.1f offscreen passes/frame, %d surfaces, %lld KB",
+              (double)(pPasses->Get() - passes)/frames,
+              ScratchSurfacePool::GetNumSurfaces(), (long long)(ScratchSurfacePool::GetBytes()/1024));
+
+    if (ScratchSurfacePool::GetNumSurfaces() != numSurfaces)
+    {
+        RETAILMSG(ZONE_ERROR, "ERROR: TestScratchSurfaces: pool grew from %d to %d surfaces at a constant radius",
+                  numSurfaces, ScratchSurfacePool::GetNumSurfaces());
+        rval = false;
+    }
+
+    StoryboardMan.Release( hStoryboard );
+    LayerMan.Release( hLayer );
+    Effects.Release( hBlur );
+    SpriteMan.Release( hSprite );
+
+    return rval;
+}
+
+
+
+bool TestQuadVertices()
+{
+    bool            rval        = true;
+    MetricCounter*  pBytes      = Metrics::RegisterCounter("Renderer.VertexBytes");
+    NullRenderer*   pRenderer   = NullRenderer::Create();
+    bool            wasEnabled  = QuadList::IsEnabled();
+    bool            wasPacking  = QuadList::IsPackingEnabled();
+    const UINT32    numSprites  = 100;
+    Rectangle       rect        = { 10, 20, 64, 32 };
+    Vertex          triangles[ 6 ];
+    Vertex          quad[ VERTS_PER_QUAD ];
+    PackedVertex    packed[ VERTS_PER_QUAD ];
+    Vertex          unpacked[ VERTS_PER_QUAD ];
+    UINT32          bytes[ 3 ];
+    const char*     formats[ 3 ] = { "triangles", "quads", "packed quads" };
+    const UINT16*   pIndices;
+
+    pRenderer->AddRef();
+
+    // An indexed quad must draw exactly the two triangles Util::CreateTriangleList() emits.
+    Util::CreateTriangleList( &rect, 1, 1, triangles, 0.25f, 0.5f, 0.0f, 1.0f );
+    QuadList::FromTriangleList( triangles, 1, quad );
+    pIndices = QuadList::GetIndices( 2 );
+    for (int i = 0; i < INDICES_PER_QUAD; ++i)
+    {
+        if (memcmp( &quad[ pIndices[i] ], &triangles[i], sizeof(Vertex) ) ||
+            pIndices[ INDICES_PER_QUAD + i ] != pIndices[i] + VERTS_PER_QUAD)
+        {
+            RETAILMSG(ZONE_ERROR, "ERROR: TestQuadVertices: index %d doesn't match the triangle list", i);
+            rval = false;
+            break;
+        }
+    }
+
+    // Packing keeps positions and colors exactly, and texture coordinates to 16 bits.
+    QuadList::Pack  ( quad,   VERTS_PER_QUAD, packed   );
+    QuadList::Unpack( packed, VERTS_PER_QUAD, unpacked );
+    for (int i = 0; i < VERTS_PER_QUAD; ++i)
+    {
+        if (!QuadList::CanPack( &quad[i], 1 )                  ||
+            unpacked[i].x     != quad[i].x                     ||
+            unpacked[i].y     != quad[i].y                     ||
+            unpacked[i].color != quad[i].color                 ||
+            fabsf(unpacked[i].u0 - quad[i].u0) > 1.0f/65535.0f ||
+            fabsf(unpacked[i].v0 - quad[i].v0) > 1.0f/65535.0f)
+        {
+            RETAILMSG(ZONE_ERROR, "ERROR: TestQuadVertices: corner %d didn't survive packing", i);
+            rval = false;
+        }
+    }
+
+    triangles[0].z = 1.0f;
+    if (QuadList::CanPack( triangles, 6 ))
+    {
+        RETAILMSG(ZONE_ERROR, "ERROR: TestQuadVertices: a Vertex off the z = 0 plane must not be packed");
+        rval = false;
+    }
+
+    //
+    // The same Sprites in each format; count the bytes sent.
+    //
+    {
+    vector<Vertex>       triangleList( numSprites * 6 );
+    vector<Vertex>       quadList    ( numSprites * VERTS_PER_QUAD );
+    vector<PackedVertex> packedList  ( numSprites * VERTS_PER_QUAD );
+
+    for (UINT32 n = 0; n < numSprites; ++n)
+    {
+        Util::CreateTriangleList( &rect, 1, 1, &triangleList[ n * 6 ] );
+    }
+    QuadList::FromTriangleList( &triangleList[0], numSprites, &quadList[0] );
+    QuadList::Pack( &quadList[0], numSprites * VERTS_PER_QUAD, &packedList[0] );
+
+    pRenderer->Init( 320, 480 );
+    for (int format = 0; format < 3; ++format)
+    {
+        pRenderer->BeginFrame();
+        switch (format)
+        {
+            case 0: pRenderer->DrawTriangleList  ( &triangleList[0], numSprites * 6 ); break;
+            case 1: pRenderer->DrawQuadList      ( &quadList[0],     numSprites     ); break;
+            case 2: pRenderer->DrawPackedQuadList( &packedList[0],   numSprites     ); break;
+        }
+        pRenderer->EndFrame();
+
+        bytes[format] = pRenderer->GetFrameStats().numVertexBytes;
+        RETAILMSG(ZONE_INFO, "TestQuadVertices: %d Sprites as %s: %d bytes", numSprites, formats[format], bytes[format]);
+    }
+    }
+
+    if (bytes[0] != numSprites * 6              * sizeof(Vertex) ||
+        bytes[1] != numSprites * VERTS_PER_QUAD * sizeof(Vertex) ||
+        bytes[2] != numSprites * VERTS_PER_QUAD * sizeof(PackedVertex))
+    {
+        RETAILMSG(ZONE_ERROR, "ERROR: TestQuadVertices: unexpected vertex byte counts");
+        rval = false;
+    }
+
+    // The current scene, before and after.
+    for (int format = 0; format < 3; ++format)
+    {
+        INT64 bytesBefore = pBytes->Get();
+
+        QuadList::Enable( format > 0, format > 1 );
+        Engine::Render();
+
+        RETAILMSG(ZONE_INFO, "TestQuadVertices: scene as %s: %lld vertex bytes per frame", formats[format], pBytes->Get() - bytesBefore);
+    }
+
+    QuadList::Enable( wasEnabled, wasPacking );
+    SAFE_RELEASE(pRenderer);
+
+    return rval;
+}
+
+
+
+bool TestVertexStream()
+{
+    bool            rval            = true;
+    MetricCounter*  pStreamed       = Metrics::RegisterCounter("Renderer.StreamedBytes");
+    MetricCounter*  pFallbacks      = Metrics::RegisterCounter("Renderer.StreamFallbacks");
+    bool            wasEnabled      = VertexStream::IsEnabled();
+    const UINT32    NUM_FRAMES      = 300;
+    PerfTimer       timer;
+    double          frameMs[2];
+    INT64           streamed[2];
+    INT64           fallbacks;
+
+    //
+    // Off, quad indices come from client memory; on, from the index buffer at offset 0.
+    //
+    VertexStream::Enable( false );
+    if (VertexStream::BindQuadIndices( 1 ) != QuadList::GetIndices( 1 ))
+    {
+        RETAILMSG(ZONE_ERROR, "ERROR: TestVertexStream: disabled stream should draw from client indices");
+        rval = false;
+    }
+
+    VertexStream::Enable( true );
+    if (!VertexStream::IsEnabled())
+    {
+        // Not the GLES2 renderer, or no buffer objects; nothing more to compare.
+        RETAILMSG(ZONE_WARN, "WARNING: TestVertexStream: stream not initialized; skipping");
+        VertexStream::Enable( wasEnabled );
+        return rval;
+    }
+
+    if (VertexStream::BindQuadIndices( 1 ) != NULL)
+    {
+        RETAILMSG(ZONE_ERROR, "ERROR: TestVertexStream: enabled stream should draw from the quad index buffer");
+        rval = false;
+    }
+
+    //
+    // The current scene, with and without the stream; CPU time per frame.
+    //
+    fallbacks = pFallbacks->Get();
+    for (int enabled = 0; enabled < 2; ++enabled)
+    {
+        INT64 streamedBefore = pStreamed->Get();
+
+        VertexStream::Enable( enabled != 0 );
+
+        timer.Start();
+        for (UINT32 frame = 0; frame < NUM_FRAMES; ++frame)
+        {
+            Engine::Render();
+        }
+        timer.Stop();
+
+        frameMs[enabled]  = timer.ElapsedMilliseconds() / NUM_FRAMES;
+        streamed[enabled] = (pStreamed->Get() - streamedBefore) / NUM_FRAMES;
+    }
+
+    RETAILMSG(ZONE_INFO, "TestVertexStream: client arrays %2.3f ms/frame; stream %2.3f ms/frame, %lld bytes/frame in %d KB buffers, %lld fallbacks",
+        frameMs[0], frameMs[1], streamed[1], VertexStream::GetBufferBytes() / 1024, pFallbacks->Get() - fallbacks);
+
+    if (streamed[0] != 0)
+    {
+        RETAILMSG(ZONE_ERROR, "ERROR: TestVertexStream: %lld bytes/frame streamed while disabled", streamed[0]);
+        rval = false;
+    }
+
+    if (streamed[1] == 0)
+    {
+        RETAILMSG(ZONE_ERROR, "ERROR: TestVertexStream: nothing streamed while enabled");
+        rval = false;
+    }
+
+    VertexStream::Enable( wasEnabled );
+
+    return rval;
+}
+
+
+
+bool TestTessellationGrids()
+{
+    bool            rval            = true;
+    const UINT32    sizes[]         = { 16, 32, 64, 128 };
+    const UINT32    NUM_ITERATIONS  = 100;
+    Rectangle       rect            = { 0, 0, 320, 480 };
+    PerfTimer       timer;
+    const Vertex*   pGrid           = NULL;
+    const Vertex*   pSame           = NULL;
+    const Vertex*   pOther          = NULL;
+    UINT32          numVertices     = 0;
+    UINT32          numGrids;
+    RippleParams    ripple;
+    MorphParams     morph;
+
+    TessellationCache::Trim();
+    numGrids = TessellationCache::GetNumGrids();
+
+    //
+    // Identical grids are shared; any difference gets its own.
+    //
+    TessellationCache::Acquire( rect, 15, 15, 0, 1, 0, 1, &pGrid,  &numVertices );
+    TessellationCache::Acquire( rect, 15, 15, 0, 1, 0, 1, &pSame,  &numVertices );
+    TessellationCache::Acquire( rect, 15, 16, 0, 1, 0, 1, &pOther, &numVertices );
+
+    if (!pGrid || pSame != pGrid || pOther == pGrid || TessellationCache::GetNumGrids() != numGrids + 2)
+    {
+        RETAILMSG(ZONE_ERROR, "ERROR: TestTessellationGrids: expected one shared 15 x 15 grid and one 15 x 16 grid");
+        rval = false;
+    }
+
+    TessellationCache::Release( pGrid  );
+    TessellationCache::Release( pSame  );
+    TessellationCache::Release( pOther );
+
+    //
+    // The kernels against the shaders' math.
+    //
+    ripple.origin     = vec2( 160, 240 );
+    ripple.amplitude  = 2.0f;
+    ripple.waveLength = 20.0f;
+    ripple.radius     = 100.0f;
+    ripple.time       = 1.5f;
+
+    for (UINT32 i = 0; i < 4; ++i)
+    {
+        morph.curve0[i] = vec3( 0,          i * rect.height / 3.0f, 0 );
+        morph.curve1[i] = vec3( rect.width, i * rect.height / 3.0f, 0 );
+    }
+    morph.sourceWidth  = rect.width;
+    morph.sourceHeight = rect.height;
+
+    {
+    vector<Vertex> displaced( 6 * 15 * 15 );
+
+    TessellationCache::Acquire( rect, 15, 15, 0, 1, 0, 1, &pGrid, &numVertices );
+
+    Displacement::Ripple( pGrid, numVertices, ripple, &displaced[0] );
+    for (UINT32 i = 0; i < numVertices; ++i)
+    {
+        float dx         = pGrid[i].x - ripple.origin.x;
+        float dy         = pGrid[i].y - ripple.origin.y;
+        float dist       = sqrtf( dx*dx + dy*dy );
+        float deflection = sinf( dist / ripple.waveLength - ripple.time );
+
+        deflection *= dist < ripple.radius ? dist / ripple.radius : ripple.radius / dist;
+        deflection  = fabsf( deflection ) * ripple.amplitude;
+
+        if (fabsf( displaced[i].z - deflection ) > 0.001f || displaced[i].x != pGrid[i].x || displaced[i].u0 != pGrid[i].u0)
+        {
+            RETAILMSG(ZONE_ERROR, "ERROR: TestTessellationGrids: ripple vertex %d z = %f, expected %f", i, displaced[i].z, deflection);
+            rval = false;
+            break;
+        }
+    }
+
+    // Straight, vertical curves at either edge leave the grid where it was.
+    Displacement::Morph( pGrid, numVertices, morph, &displaced[0] );
+    for (UINT32 i = 0; i < numVertices; ++i)
+    {
+        if (fabsf( displaced[i].x - pGrid[i].x ) > 0.01f || displaced[i].y != pGrid[i].y)
+        {
+            RETAILMSG(ZONE_ERROR, "ERROR: TestTessellationGrids: morph moved vertex %d from %f to %f", i, pGrid[i].x, displaced[i].x);
+            rval = false;
+            break;
+        }
+    }
+
+    TessellationCache::Release( pGrid );
+    }
+
+    //
+    // Build vs. cached, and the kernels, from 16 x 16 to 128 x 128.
+    //
+    for (UINT32 n = 0; n < ARRAY_SIZE(sizes); ++n)
+    {
+        UINT32          size = sizes[n];
+        vector<Vertex>  displaced( 6 * size * size );
+        Vertex*         pBuilt;
+        double          buildUS;
+        double          cachedUS;
+        double          rippleUS;
+        double          morphUS;
+
+        timer.Start();
+        for (UINT32 i = 0; i < NUM_ITERATIONS; ++i)
+        {
+            Util::CreateTriangleList( &rect, size, size, &pBuilt, &numVertices );
+            SAFE_ARRAY_DELETE(pBuilt);
+        }
+        timer.Stop();
+        buildUS = timer.ElapsedMilliseconds() * 1000.0 / NUM_ITERATIONS;
+
+        TessellationCache::Acquire( rect, size, size, 0, 1, 0, 1, &pGrid, &numVertices );
+        timer.Start();
+        for (UINT32 i = 0; i < NUM_ITERATIONS; ++i)
+        {
+            TessellationCache::Acquire( rect, size, size, 0, 1, 0, 1, &pSame, &numVertices );
+            TessellationCache::Release( pSame );
+        }
+        timer.Stop();
+        cachedUS = timer.ElapsedMilliseconds() * 1000.0 / NUM_ITERATIONS;
+
+        timer.Start();
+        for (UINT32 i = 0; i < NUM_ITERATIONS; ++i)
+        {
+            Displacement::Ripple( pGrid, numVertices, ripple, &displaced[0] );
+        }
+        timer.Stop();
+        rippleUS = timer.ElapsedMilliseconds() * 1000.0 / NUM_ITERATIONS;
+
+        timer.Start();
+        for (UINT32 i = 0; i < NUM_ITERATIONS; ++i)
+        {
+            Displacement::Morph( pGrid, numVertices, morph, &displaced[0] );
+        }
+        timer.Stop();
+        morphUS = timer.ElapsedMilliseconds() * 1000.0 / NUM_ITERATIONS;
+
+        TessellationCache::Release( pGrid );
+
+        RETAILMSG(ZONE_INFO, "TestTessellationGrids: %3d x %3d (%6d vertices): build %8.1f us, cached %6.2f us; ripple %8.1f us, morph %8.1f us",
+            size, size, numVertices, buildUS, cachedUS, rippleUS, morphUS);
+    }
+
+    // Nothing referenced; trimming returns to where we started.
+    TessellationCache::Trim();
+    if (TessellationCache::GetNumGrids() != numGrids)
+    {
+        RETAILMSG(ZONE_ERROR, "ERROR: TestTessellationGrids: %d grids left after Trim(), expected %d", TessellationCache::GetNumGrids(), numGrids);
+        rval = false;
+    }
+
+    return rval;
+}
+
+
+
+bool TestTextBatching()
+{
+    bool            rval        = true;
+    MetricCounter*  pFontDraws  = Metrics::RegisterCounter("Fonts.DrawCalls");
+    MetricCounter*  pDraws      = Metrics::RegisterCounter("Renderer.DrawCalls");
+    MetricCounter*  pRunsBuilt  = Metrics::RegisterCounter("Fonts.RunsBuilt");
+    MetricCounter*  pRunHits    = Metrics::RegisterCounter("Fonts.RunHits");
+    const UINT32    NUM_FRAMES  = 300;
+    const char*     strings[]   = { "L 12", "4096", "TestTextBatching" };
+    bool            wasEnabled  = FontMan.IsBatchingEnabled();
+    INT64           fontDraws;
+    INT64           runsBuilt;
+    INT64           runHits;
+    HFont           hFont;
+    PerfTimer       timer;
+
+    FontMan.Get( "BanzaiBros", &hFont );
+
+    //
+    // Three strings in one Font: three draws on their own, one when batched.
+    //
+    for (int batched = 0; batched < 2; ++batched)
+    {
+        fontDraws = pFontDraws->Get();
+
+        FontMan.EnableBatching( batched != 0 );
+        FontMan.BeginBatch();
+        for (UINT32 i = 0; i < ARRAY_SIZE(strings); ++i)
+        {
+            FontMan.Draw( vec2( 0, 32.0f * i ), strings[i], hFont, Color::White(), 1.0f + i );
+        }
+        FontMan.EndBatch();
+
+        INT64 expected = batched ? 1 : ARRAY_SIZE(strings);
+        if (pFontDraws->Get() - fontDraws != expected)
+        {
+            RETAILMSG(ZONE_ERROR, "ERROR: TestTextBatching: %lld font draws %s, expected %lld",
+                pFontDraws->Get() - fontDraws, batched ? "batched" : "unbatched", expected);
+            rval = false;
+        }
+    }
+
+    //
+    // The same string again, at another scale and color, reuses its glyph run.
+    //
+    runsBuilt = pRunsBuilt->Get();
+    runHits   = pRunHits->Get();
+    FontMan.Draw( vec2( 100, 100 ), strings[0], hFont, Color::LightBlue(), 3.0f, 0.5f );
+
+    if (pRunsBuilt->Get() != runsBuilt || pRunHits->Get() != runHits + 1)
+    {
+        RETAILMSG(ZONE_ERROR, "ERROR: TestTextBatching: redrawing \"%s\" rebuilt its glyph run", strings[0]);
+        rval = false;
+    }
+
+    //
+    // The current scene and HUD, unbatched and batched.
+    //
+    for (int batched = 0; batched < 2; ++batched)
+    {
+        INT64 drawsBefore;
+
+        FontMan.EnableBatching( batched != 0 );
+
+        // Warm up the glyph runs; after that, a steady HUD shouldn't build any.
+        Engine::Render();
+
+        fontDraws   = pFontDraws->Get();
+        drawsBefore = pDraws->Get();
+        runsBuilt   = pRunsBuilt->Get();
+
+        timer.Start();
+        for (UINT32 frame = 0; frame < NUM_FRAMES; ++frame)
+        {
+            Engine::Render();
+        }
+        timer.Stop();
+
+        RETAILMSG(ZONE_INFO, "TestTextBatching: %s: %2.3f ms/frame, %2.2f font draws/frame, %2.2f draws/frame, %2.2f glyph runs built/frame",
+            batched ? "batched" : "unbatched",
+            timer.ElapsedMilliseconds() / NUM_FRAMES,
+            (double)(pFontDraws->Get() - fontDraws) / NUM_FRAMES,
+            (double)(pDraws->Get() - drawsBefore) / NUM_FRAMES,
+            (double)(pRunsBuilt->Get() - runsBuilt) / NUM_FRAMES);
+    }
+
+    FontMan.EnableBatching( wasEnabled );
+
+    return rval;
+}
+
+
+
+bool TestTransforms()
+{
+    bool            rval            = true;
+    MetricCounter*  pMultiplies     = Metrics::RegisterCounter("Transforms.Multiplies");
+    MetricCounter*  pMultiplies2D   = Metrics::RegisterCounter("Transforms.Multiplies2D");
+    MetricCounter*  pWorldHits      = Metrics::RegisterCounter("Transforms.WorldHits");
+    bool            wasEnabled      = Transforms::IsEnabled();
+    const UINT32    NUM_FRAMES      = 300;
+    mat4            parent          = mat4::Scale( 2.0f ) * mat4::Translate( 10, 20, 0 );
+    mat4            expected;
+    mat4            world;
+    INT64           multiplies;
+    INT64           hits;
+    TransformID     id;
+
+    struct
+    {
+        vec3    position;
+        vec3    rotation;
+        float   scale;
+        vec3    pivot;
+    } cases[] =
+    {
+        { vec3(  0,   0, 0), vec3( 0,  0,   0), 1.0f, vec3( 0,  0, 0) },
+        { vec3( 50, 100, 1), vec3( 0,  0,  30), 1.5f, vec3( 0,  0, 0) },
+        { vec3(-20,  40, 0), vec3( 0,  0, 270), 0.5f, vec3(32, 16, 0) },
+        { vec3(  5,   5, 2), vec3(45, 10,  60), 2.0f, vec3(16, 16, 0) },
+    };
+
+    //
+    // Cached, 2D or not, matches the 4x4 products every caller used to build.
+    //
+    Transforms::Enable( true );
+    id = Transforms::Create();
+
+    for (UINT32 i = 0; i < ARRAY_SIZE(cases); ++i)
+    {
+        vec3 p = cases[i].pivot;
+
+        expected  = mat4::Translate( -p.x, -p.y, -p.z );
+        expected *= mat4::Scale    ( cases[i].scale );
+        expected *= mat4::RotateX  ( cases[i].rotation.x );
+        expected *= mat4::RotateY  ( cases[i].rotation.y );
+        expected *= mat4::RotateZ  ( cases[i].rotation.z );
+        expected *= mat4::Translate( p.x, p.y, p.z );
+        expected *= mat4::Translate( cases[i].position.x, cases[i].position.y, cases[i].position.z );
+        expected *= parent;
+
+        Transforms::SetLocal( id, cases[i].position, cases[i].rotation, cases[i].scale, cases[i].pivot );
+        world = Transforms::GetWorld( id, parent );
+
+        for (UINT32 j = 0; j < 16; ++j)
+        {
+            if (fabsf( world.Pointer()[j] - expected.Pointer()[j] ) > 0.001f)
+            {
+                RETAILMSG(ZONE_ERROR, "ERROR: TestTransforms: case %d element %d is %f, expected %f", i, j, world.Pointer()[j], expected.Pointer()[j]);
+                rval = false;
+                break;
+            }
+        }
+    }
+
+    //
+    // Unchanged: no products at all.  A new parent: one, and in 2D.
+    //
+    multiplies  = pMultiplies->Get() + pMultiplies2D->Get();
+    hits        = pWorldHits->Get();
+    Transforms::SetLocal( id, cases[1].position, cases[1].rotation, cases[1].scale, cases[1].pivot );
+    Transforms::GetWorld( id, parent );
+    Transforms::GetWorld( id, parent );
+    Transforms::GetWorld( id, parent );
+
+    if (pMultiplies->Get() + pMultiplies2D->Get() - multiplies != 1 || pWorldHits->Get() - hits != 2)
+    {
+        RETAILMSG(ZONE_ERROR, "ERROR: TestTransforms: %lld products and %lld hits for one change and three draws, expected 1 and 2",
+            pMultiplies->Get() + pMultiplies2D->Get() - multiplies, pWorldHits->Get() - hits);
+        rval = false;
+    }
+
+    multiplies = pMultiplies->Get();
+    Transforms::GetWorld( id, mat4::Translate( 1, 2, 3 ) );
+    if (pMultiplies->Get() != multiplies)
+    {
+        RETAILMSG(ZONE_ERROR, "ERROR: TestTransforms: moving a 2D parent took a 4x4 product");
+        rval = false;
+    }
+
+    Transforms::Destroy( id );
+
+    //
+    // The current scene; products per frame, as before and cached.
+    //
+    for (int enabled = 0; enabled < 2; ++enabled)
+    {
+        INT64       multiplies2D;
+        PerfTimer   timer;
+
+        Transforms::Enable( enabled != 0 );
+        Engine::Render();
+
+        multiplies   = pMultiplies->Get();
+        multiplies2D = pMultiplies2D->Get();
+        hits         = pWorldHits->Get();
+
+        timer.Start();
+        for (UINT32 frame = 0; frame < NUM_FRAMES; ++frame)
+        {
+            Engine::Render();
+        }
+        timer.Stop();
+
+        RETAILMSG(ZONE_INFO, "TestTransforms: %s: %2.3f ms/frame; %2.1f 4x4 and %2.1f 2D products, %2.1f cached worlds per frame; %d nodes",
+            enabled ? "cached" : "uncached",
+            timer.ElapsedMilliseconds() / NUM_FRAMES,
+            (double)(pMultiplies->Get()   - multiplies)   / NUM_FRAMES,
+            (double)(pMultiplies2D->Get() - multiplies2D) / NUM_FRAMES,
+            (double)(pWorldHits->Get()    - hits)         / NUM_FRAMES,
+            Transforms::GetNumNodes());
+    }
+
+    Transforms::Enable( wasEnabled );
+
+    return rval;
+}
+
+
+
+bool TestSliceScheduler()
+{
+    bool            rval            = true;
+    const UINT32    NUM_CONSUMERS   = 10000;
+    const UINT32    PER_FRAME       = 1000;
+    const UINT32    NUM_FRAMES      = 100;
+    SlicePolicy     policy          = MsgRouter.GetSlicePolicy();
+    float           constraint      = MsgRouter.GetSliceConstraint();
+    UINT32          numRequests     = MsgRouter.GetNumSliceRequests();
+    MetricCounter*  pSlices         = Metrics::RegisterCounter("MsgRoute.Slices");
+    MetricGauge*    pMaxWait        = Metrics::RegisterGauge("MsgRoute.SliceMaxWaitFrames");
+    HGameObject*    phGameObjects   = new HGameObject[ NUM_CONSUMERS ];
+    OBJECT_ID*      pIDs            = new OBJECT_ID[ NUM_CONSUMERS ];
+    PerfTimer       timer;
+    char            name[MAX_NAME];
+    double          registerMs;
+    double          unregisterMs;
+    INT64           slices;
+    INT64           maxWait         = 0;
+    UINT64          late;
+    UINT64          deferred;
+
+    //
+    // Slice consumers without state machines; each slice costs only its routing.
+    //
+    for (UINT32 i = 0; i < NUM_CONSUMERS; ++i)
+    {
+        GameObject* pGO = new GameObject( GO_TYPE_UNKNOWN );
+        sprintf(name, "SliceConsumer%d", (int)i);
+        pGO->Init( name );
+        GOMan.Add( pGO, &phGameObjects[i] );
+        pIDs[i] = pGO->GetID();
+    }
+
+    timer.Start();
+    for (UINT32 i = 0; i < NUM_CONSUMERS; ++i)
+    {
+        MsgRouter.RegisterOnSliceEvent( 0.0f, pIDs[i] );
+    }
+    timer.Stop();
+    registerMs = timer.ElapsedMilliseconds();
+
+    //
+    // All due every frame, PER_FRAME served: round-robin, so nobody waits more than NUM_CONSUMERS / PER_FRAME frames.
+    //
+    MsgRouter.SetSlicePolicy( SLICE_POLICY_CONSTRAIN_BY_COUNT, PER_FRAME );
+    slices   = pSlices->Get();
+    late     = MsgRouter.GetNumLateSlices();
+    deferred = MsgRouter.GetNumDeferredSlices();
+
+    timer.Start();
+    for (UINT32 frame = 0; frame < NUM_FRAMES; ++frame)
+    {
+        MsgRouter.DeliverSlices();
+        maxWait = MAX(maxWait, pMaxWait->Get());
+    }
+    timer.Stop();
+
+    RETAILMSG(ZONE_INFO, "TestSliceScheduler: %d consumers, %d per frame: %2.3f ms/frame; %lld late, %lld deferred per frame, longest wait %lld frames",
+        (int)NUM_CONSUMERS, (int)PER_FRAME, timer.ElapsedMilliseconds() / NUM_FRAMES,
+        (long long)((MsgRouter.GetNumLateSlices() - late) / NUM_FRAMES), (long long)((MsgRouter.GetNumDeferredSlices() - deferred) / NUM_FRAMES), (long long)maxWait);
+
+    if (pSlices->Get() - slices != NUM_FRAMES * PER_FRAME)
+    {
+        RETAILMSG(ZONE_ERROR, "ERROR: TestSliceScheduler: %lld slices delivered, expected %d", (long long)(pSlices->Get() - slices), (int)(NUM_FRAMES * PER_FRAME));
+        rval = false;
+    }
+
+    if (maxWait > NUM_CONSUMERS / PER_FRAME)
+    {
+        RETAILMSG(ZONE_ERROR, "ERROR: TestSliceScheduler: a slice waited %lld frames; round-robin allows %d", (long long)maxWait, (int)(NUM_CONSUMERS / PER_FRAME));
+        rval = false;
+    }
+
+    //
+    // A 1 ms budget per frame.
+    //
+    MsgRouter.SetSlicePolicy( SLICE_POLICY_CONSTRAIN_BY_TIME, 0.001f );
+    slices = pSlices->Get();
+
+    timer.Start();
+    for (UINT32 frame = 0; frame < NUM_FRAMES; ++frame)
+    {
+        MsgRouter.DeliverSlices();
+    }
+    timer.Stop();
+
+    RETAILMSG(ZONE_INFO, "TestSliceScheduler: 1 ms budget: %2.3f ms/frame, %lld slices per frame",
+        timer.ElapsedMilliseconds() / NUM_FRAMES, (long long)((pSlices->Get() - slices) / NUM_FRAMES));
+
+    //
+    // Clean up.
+    //
+    timer.Start();
+    for (UINT32 i = 0; i < NUM_CONSUMERS; ++i)
+    {
+        MsgRouter.UnregisterOnSliceEvent( pIDs[i] );
+    }
+    timer.Stop();
+    unregisterMs = timer.ElapsedMilliseconds();
+
+    RETAILMSG(ZONE_INFO, "TestSliceScheduler: register %2.3f ms, unregister %2.3f ms for %d consumers", registerMs, unregisterMs, (int)NUM_CONSUMERS);
+
+    if (MsgRouter.GetNumSliceRequests() != numRequests)
+    {
+        RETAILMSG(ZONE_ERROR, "ERROR: TestSliceScheduler: %d slice requests left, expected %d", (int)MsgRouter.GetNumSliceRequests(), (int)numRequests);
+        rval = false;
+    }
+
+    for (UINT32 i = 0; i < NUM_CONSUMERS; ++i)
+    {
+        GOMan.Release( phGameObjects[i] );
+    }
+
+    SAFE_ARRAY_DELETE(phGameObjects);
+    SAFE_ARRAY_DELETE(pIDs);
+    MsgRouter.SetSlicePolicy( policy, constraint );
+
+    return rval;
+}
+
+
+
+bool TestPrefabPools()
+{
+    bool            rval            = true;
+    const UINT32    NUM_BRICKS      = 72;       // A full board.
+    const UINT32    NUM_WAVES       = 500;      // Each smashes 3 - 9 bricks and drops as many.
+    MetricCounter*  pBuiltMetric    = Metrics::RegisterCounter( "GOMan.PrefabsBuilt" );
+    MetricCounter*  pHitsMetric     = Metrics::RegisterCounter( "GOMan.PoolHits"     );
+    HGameObject     hBricks[ NUM_BRICKS ];
+    UINT32          waveFirst[ NUM_WAVES ];
+    UINT32          waveCount[ NUM_WAVES ];
+    PrefabID        prefab          = PREFAB_NONE;
+    PerfTimer       timer;
+    char            name[MAX_NAME];
+    UINT32          numSpawns       = 0;
+    bool            wasPooling      = GOMan.IsPoolingEnabled();
+    double          legacySpawnMs   = 0.0;
+    double          legacyReleaseMs = 0.0;
+    double          spawnMs         = 0.0;
+    double          releaseMs       = 0.0;
+    INT64           built;
+    INT64           hits;
+
+    for (UINT32 wave = 0; wave < NUM_WAVES; ++wave)
+    {
+        waveFirst[wave] = Platform::Random() % NUM_BRICKS;
+        waveCount[wave] = 3 + Platform::Random() % 7;
+        numSpawns      += waveCount[wave];
+    }
+
+    //
+    // The chain reaction as ColumnState used to build bricks: a unique name, GOMan.Create(), delete on release.
+    //
+    for (UINT32 i = 0; i < NUM_BRICKS; ++i)
+    {
+        sprintf(name, "red_%X", (unsigned int)Platform::Random());
+        GOMan.Create( name, &hBricks[i], "red", "", "", "IdleState", GO_TYPE_SPRITE, vec3(0,0,0), 1.0f, Color::White(), true );
+    }
+
+    for (UINT32 wave = 0; wave < NUM_WAVES; ++wave)
+    {
+        timer.Start();
+        for (UINT32 i = 0; i < waveCount[wave]; ++i)
+        {
+            GOMan.Release( hBricks[ (waveFirst[wave] + i) % NUM_BRICKS ] );
+        }
+        timer.Stop();
+        legacyReleaseMs += timer.ElapsedMilliseconds();
+
+        timer.Start();
+        for (UINT32 i = 0; i < waveCount[wave]; ++i)
+        {
+            sprintf(name, "red_%X", (unsigned int)Platform::Random());
+            GOMan.Create( name, &hBricks[ (waveFirst[wave] + i) % NUM_BRICKS ], "red", "", "", "IdleState", GO_TYPE_SPRITE, vec3(0,0,0), 1.0f, Color::White(), true );
+        }
+        timer.Stop();
+        legacySpawnMs += timer.ElapsedMilliseconds();
+    }
+
+    for (UINT32 i = 0; i < NUM_BRICKS; ++i)
+    {
+        GOMan.Release( hBricks[i] );
+    }
+
+
+    //
+    // The same chain reaction from a prefab.
+    //
+    GOMan.EnablePooling( true );
+
+    if (FAILED(GOMan.CreatePrefab( "TestBrick", &prefab, "red", "", "", "IdleState", GO_TYPE_SPRITE, true, NUM_BRICKS )))
+    {
+        RETAILMSG(ZONE_ERROR, "ERROR: TestPrefabPools: CreatePrefab() failed");
+        rval = false;
+        goto Exit;
+    }
+
+    for (UINT32 i = 0; i < NUM_BRICKS; ++i)
+    {
+        GOMan.Spawn( prefab, &hBricks[i] );
+    }
+
+    built = pBuiltMetric->Get();
+    hits  = pHitsMetric->Get();
+
+    for (UINT32 wave = 0; wave < NUM_WAVES; ++wave)
+    {
+        timer.Start();
+        for (UINT32 i = 0; i < waveCount[wave]; ++i)
+        {
+            GOMan.Release( hBricks[ (waveFirst[wave] + i) % NUM_BRICKS ] );
+        }
+        timer.Stop();
+        releaseMs += timer.ElapsedMilliseconds();
+
+        timer.Start();
+        for (UINT32 i = 0; i < waveCount[wave]; ++i)
+        {
+            GOMan.Spawn( prefab, &hBricks[ (waveFirst[wave] + i) % NUM_BRICKS ] );
+        }
+        timer.Stop();
+        spawnMs += timer.ElapsedMilliseconds();
+    }
+
+    RETAILMSG(ZONE_INFO, "TestPrefabPools: %d bricks; Create(): %2.4f ms/spawn, %2.4f ms/release; Spawn(): %2.4f ms/spawn, %2.4f ms/release; %lld GameObjects built, %lld reused",
+        numSpawns,
+        legacySpawnMs / numSpawns, legacyReleaseMs / numSpawns,
+        spawnMs       / numSpawns, releaseMs       / numSpawns,
+        pBuiltMetric->Get() - built, pHitsMetric->Get() - hits);
+
+    // Every smashed brick went back to the pool, so nothing was built after warm-up.
+    if (pBuiltMetric->Get() != built || pHitsMetric->Get() - hits != numSpawns)
+    {
+        RETAILMSG(ZONE_ERROR, "ERROR: TestPrefabPools: %lld GameObjects built after warm-up, expected 0", pBuiltMetric->Get() - built);
+        rval = false;
+    }
+
+    //
+    // To anyone holding the old handle, a recycled brick is a different GameObject.
+    //
+    {
+    HGameObject hOld  = hBricks[0];
+    OBJECT_ID   oldID = INVALID_OBJECT_ID;
+    OBJECT_ID   newID = INVALID_OBJECT_ID;
+
+    GOMan.GetObjectID( hOld, &oldID );
+    GOMan.Release( hOld );
+    GOMan.Spawn( prefab, &hBricks[0] );
+    GOMan.GetObjectID( hBricks[0], &newID );
+
+    if (hBricks[0] == hOld || newID == oldID || GOMan.ValidHandle( hOld ))
+    {
+        RETAILMSG(ZONE_ERROR, "ERROR: TestPrefabPools: recycled brick kept its handle or ID");
+        rval = false;
+    }
+    }
+
+    for (UINT32 i = 0; i < NUM_BRICKS; ++i)
+    {
+        GOMan.Release( hBricks[i] );
+    }
+
+    if (GOMan.GetNumPooled( prefab ) != MIN(NUM_BRICKS, GAMEOBJECT_POOL_MAX_SIZE))
+    {
+        RETAILMSG(ZONE_ERROR, "ERROR: TestPrefabPools: %d bricks pooled, expected %d", GOMan.GetNumPooled( prefab ), MIN(NUM_BRICKS, GAMEOBJECT_POOL_MAX_SIZE));
+        rval = false;
+    }
+
+Exit:
+    GOMan.EnablePooling( wasPooling );
+
+    return rval;
+}
+
+
+
+bool TestDenseGameObjects()
+{
+    bool            rval            = true;
+    const GO_TYPE   GO_TYPE_TEST    = (GO_TYPE)(GO_TYPE_USER << 8);
+    const UINT32    NUM_FRAMES      = 20;
+    const UINT32    sizes[]         = { 1000, 10000, 100000 };
+    PerfTimer       timer;
+    GameObjectList  list;
+    char            name[MAX_NAME];
+
+    for (UINT32 s = 0; s < ARRAY_SIZE(sizes); ++s)
+    {
+        const UINT32    NUM_OBJECTS = sizes[s];
+        HGameObject*    phObjects   = new HGameObject[ NUM_OBJECTS ];
+        double          updateMs    = 0.0;
+        double          getListMs   = 0.0;
+        double          halfMs      = 0.0;
+
+        // Bare GameObjects; every fourth one has a (stateless) StateMachineManager to update.
+        for (UINT32 i = 0; i < NUM_OBJECTS; ++i)
+        {
+            GameObject* pGO = new GameObject( GO_TYPE_TEST );
+            sprintf(name, "Dense%d", i);
+            pGO->Init( name );
+            if (0 == i % 4)
+            {
+                pGO->CreateStateMachineManager();
+            }
+            GOMan.Add( pGO, &phObjects[i] );
+        }
+
+        for (UINT32 frame = 0; frame < NUM_FRAMES; ++frame)
+        {
+            timer.Start();
+            GOMan.Update( 16, GO_TYPE_TEST );
+            timer.Stop();
+            updateMs += timer.ElapsedMilliseconds();
+
+            list.clear();
+            timer.Start();
+            GOMan.GetList( GO_TYPE_TEST, &list );
+            timer.Stop();
+            getListMs += timer.ElapsedMilliseconds();
+        }
+
+        if (list.size() != NUM_OBJECTS)
+        {
+            RETAILMSG(ZONE_ERROR, "ERROR: TestDenseGameObjects: GetList() found %d, expected %d", (int)list.size(), NUM_OBJECTS);
+            rval = false;
+        }
+
+        //
+        // Remove every other one: the holes stay in the handle slots, but not in the rows,
+        // so the loops should cost half as much.
+        //
+        for (UINT32 i = 0; i < NUM_OBJECTS; i += 2)
+        {
+            GOMan.Release( phObjects[i] );
+        }
+
+        for (UINT32 frame = 0; frame < NUM_FRAMES; ++frame)
+        {
+            timer.Start();
+            GOMan.Update( 16, GO_TYPE_TEST );
+            timer.Stop();
+            halfMs += timer.ElapsedMilliseconds();
+        }
+
+        list.clear();
+        GOMan.GetList( GO_TYPE_TEST, &list );
+        if (list.size() != NUM_OBJECTS / 2)
+        {
+            RETAILMSG(ZONE_ERROR, "ERROR: TestDenseGameObjects: GetList() found %d after removal, expected %d", (int)list.size(), NUM_OBJECTS / 2);
+            rval = false;
+        }
+
+        RETAILMSG(ZONE_INFO, "TestDenseGameObjects: %6d GameObjects: Update() %4.1f ns/object, GetList() %4.1f ns/object; half removed: Update() %2.4f ms/frame vs %2.4f",
+            NUM_OBJECTS,
+            updateMs  * 1000000.0 / (NUM_FRAMES * NUM_OBJECTS),
+            getListMs * 1000000.0 / (NUM_FRAMES * NUM_OBJECTS),
+            halfMs / NUM_FRAMES, updateMs / NUM_FRAMES);
+
+        for (UINT32 i = 1; i < NUM_OBJECTS; i += 2)
+        {
+            GOMan.Release( phObjects[i] );
+        }
+
+        SAFE_ARRAY_DELETE(phObjects);
+    }
+
+    return rval;
+}
+
+
+
+bool TestStateDispatch()
+{
+    bool            rval            = true;
+    const GO_TYPE   GO_TYPE_TEST    = (GO_TYPE)(GO_TYPE_USER << 8);
+    const UINT32    NUM_BRICKS      = 5000;
+    const UINT32    NUM_FRAMES      = 20;
+    bool            wasEnabled      = StateMachine::IsDispatchTableEnabled();
+    HGameObject*    phBricks        = new HGameObject[ NUM_BRICKS ];
+    GameObject**    ppBricks        = new GameObject*[ NUM_BRICKS ];
+    StateMachines::SM_FACTORY_METHOD createIdleState = StateMachines::Find( "IdleState" );
+    MSG_Object      msg( 0.0f, MSG_MoveCritterLeft, 0, 0, SCOPE_TO_STATE_MACHINE, 0, STATE_MACHINE_QUEUE_ALL, 0, false, false );
+    PerfTimer       timer;
+    char            name[MAX_NAME];
+    double          updateMs[2]     = { 0.0, 0.0 };
+    double          messageMs[2]    = { 0.0, 0.0 };
+
+    if (!createIdleState)
+    {
+        RETAILMSG(ZONE_ERROR, "ERROR: TestStateDispatch: no IdleState factory");
+        rval = false;
+        goto Exit;
+    }
+
+    // Bricks parked in IdleState, which handles neither frame updates nor critter messages.
+    for (UINT32 i = 0; i < NUM_BRICKS; ++i)
+    {
+        ppBricks[i] = new GameObject( GO_TYPE_TEST );
+        sprintf(name, "DispatchBrick%d", i);
+        ppBricks[i]->Init( name );
+        GOMan.Add( ppBricks[i], &phBricks[i] );
+        ppBricks[i]->CreateStateMachineManager();
+        ppBricks[i]->GetStateMachineManager()->PushStateMachine( *createIdleState( phBricks[i] ), STATE_MACHINE_QUEUE_0, true );
+    }
+
+    //
+    // Each level of States() in turn, then the dispatch table.
+    //
+    for (UINT32 enabled = 0; enabled < 2; ++enabled)
+    {
+        StateMachine::EnableDispatchTables( enabled ? true : false );
+
+        for (UINT32 frame = 0; frame < NUM_FRAMES; ++frame)
+        {
+            timer.Start();
+            GOMan.Update( 16, GO_TYPE_TEST );
+            timer.Stop();
+            updateMs[enabled] += timer.ElapsedMilliseconds();
+
+            timer.Start();
+            for (UINT32 i = 0; i < NUM_BRICKS; ++i)
+            {
+                ppBricks[i]->GetStateMachineManager()->SendMsg( msg );
+            }
+            timer.Stop();
+            messageMs[enabled] += timer.ElapsedMilliseconds();
+        }
+    }
+
+    RETAILMSG(ZONE_INFO, "TestStateDispatch: %d bricks; States(): Update() %2.4f ms/frame, SendMsg() %2.4f ms/frame; dispatch table: Update() %2.4f ms/frame, SendMsg() %2.4f ms/frame",
+        NUM_BRICKS,
+        updateMs[0] / NUM_FRAMES, messageMs[0] / NUM_FRAMES,
+        updateMs[1] / NUM_FRAMES, messageMs[1] / NUM_FRAMES);
+
+    // Skipping the unhandled events mustn't have changed anything.
+    for (UINT32 i = 0; i < NUM_BRICKS; ++i)
+    {
+        StateMachine* pStateMachine = ppBricks[i]->GetStateMachineManager()->GetStateMachine( STATE_MACHINE_QUEUE_0 );
+
+        if (!pStateMachine || 1 /* STATE_Idle */ != pStateMachine->GetState())
+        {
+            RETAILMSG(ZONE_ERROR, "ERROR: TestStateDispatch: brick %d left STATE_Idle", i);
+            rval = false;
+            break;
+        }
+    }
+
+    for (UINT32 i = 0; i < NUM_BRICKS; ++i)
+    {
+        GOMan.Release( phBricks[i] );
+    }
+
+Exit:
+    StateMachine::EnableDispatchTables( wasEnabled );
+    SAFE_ARRAY_DELETE(phBricks);
+    SAFE_ARRAY_DELETE(ppBricks);
+
+    return rval;
+}
+
+
+
+bool TestParallelUpdate()
+{
+    bool            rval            = true;
+    const GO_TYPE   GO_TYPE_TEST    = (GO_TYPE)(GO_TYPE_USER << 8);
+    const UINT32    NUM_OBJECTS     = 10000;
+    const UINT32    NUM_FRAMES      = 60;
+    bool            wasEnabled      = GOMan.IsParallelUpdateEnabled();
+    HGameObject*    phObjects       = new HGameObject[ NUM_OBJECTS ];
+    GameObject**    ppObjects       = new GameObject*[ NUM_OBJECTS ];
+    UINT32*         pDigests[2]     = { new UINT32[ NUM_OBJECTS ], new UINT32[ NUM_OBJECTS ] };
+    double          updateMs[2]     = { 0.0, 0.0 };
+    PerfTimer       timer;
+    char            name[MAX_NAME];
+
+    //
+    // The same 10k busy, chatty GameObjects on the calling thread, then on every worker.
+    //
+    for (UINT32 mode = 0; mode < 2; ++mode)
+    {
+        GOMan.EnableParallelUpdate( mode ? true : false );
+
+        for (UINT32 i = 0; i < NUM_OBJECTS; ++i)
+        {
+            ppObjects[i] = new GameObject( GO_TYPE_TEST );
+            sprintf(name, "Parallel%d", i);
+            ppObjects[i]->Init( name );
+            GOMan.Add( ppObjects[i], &phObjects[i] );
+            ppObjects[i]->CreateStateMachineManager();
+            ppObjects[i]->SetParallelUpdate( true );
+        }
+
+        for (UINT32 i = 0; i < NUM_OBJECTS; ++i)
+        {
+            StateMachine* pStateMachine = new UnitTest6( phObjects[i], i,
+                                                         ppObjects[ (i + 1) % NUM_OBJECTS ]->GetID(),
+                                                         ppObjects[ (i + 7) % NUM_OBJECTS ]->GetID() );
+            ppObjects[i]->GetStateMachineManager()->PushStateMachine( *pStateMachine, STATE_MACHINE_QUEUE_0, true );
+        }
+
+        for (UINT32 frame = 0; frame < NUM_FRAMES; ++frame)
+        {
+            timer.Start();
+            GOMan.Update( 16, GO_TYPE_TEST );
+            timer.Stop();
+            updateMs[mode] += timer.ElapsedMilliseconds();
+        }
+
+        for (UINT32 i = 0; i < NUM_OBJECTS; ++i)
+        {
+            UnitTest6* pStateMachine = (UnitTest6*)ppObjects[i]->GetStateMachineManager()->GetStateMachine( STATE_MACHINE_QUEUE_0 );
+
+            pDigests[mode][i] = pStateMachine->GetDigest() ^ (UINT32)pStateMachine->GetState();
+            GOMan.Release( phObjects[i] );
+        }
+    }
+
+    RETAILMSG(ZONE_INFO, "TestParallelUpdate: %d GameObjects: %2.4f ms/frame on one thread, %2.4f ms/frame on %d workers + caller (%.1fx)",
+        NUM_OBJECTS,
+        updateMs[0] / NUM_FRAMES, updateMs[1] / NUM_FRAMES, JobSystem::GetNumWorkers(),
+        updateMs[1] > 0.0 ? updateMs[0] / updateMs[1] : 0.0);
+
+    // Every GameObject must have seen exactly the same frames and messages, in the same order.
+    for (UINT32 i = 0; i < NUM_OBJECTS; ++i)
+    {
+        if (pDigests[0][i] != pDigests[1][i])
+        {
+            RETAILMSG(ZONE_ERROR, "ERROR: TestParallelUpdate: GameObject %d: 0x%x in parallel, 0x%x serially", i, pDigests[1][i], pDigests[0][i]);
+            rval = false;
+            break;
+        }
+    }
+
+    GOMan.EnableParallelUpdate( wasEnabled );
+    SAFE_ARRAY_DELETE(phObjects);
+    SAFE_ARRAY_DELETE(ppObjects);
+    SAFE_ARRAY_DELETE(pDigests[0]);
+    SAFE_ARRAY_DELETE(pDigests[1]);
+
+    return rval;
+}
+
+
+
+bool TestFixedTimestep()
+{
+    bool            rval            = true;
+    const GO_TYPE   GO_TYPE_TEST    = (GO_TYPE)(GO_TYPE_USER << 8);
+    const UINT32    NUM_OBJECTS     = 2000;
+    const UINT32    NUM_FRAMES      = 600;      // 10 seconds at 60 Hz.
+    const UINT32    STEP_MS         = 33;       // 30 Hz.
+    const UINT32    MAX_STEPS       = 4;
+    const float     SPEED           = 0.05f;    // Units per ms.
+    bool            wasInterpolating = Transforms::IsInterpolationEnabled();
+    HGameObject*    phObjects       = new HGameObject[ NUM_OBJECTS ];
+    GameObject**    ppObjects       = new GameObject*[ NUM_OBJECTS ];
+    TransformID*    pNodes          = new TransformID[ NUM_OBJECTS ];
+    double          updateMs[2]     = { 0.0, 0.0 };
+    UINT32          numUpdates[2]   = { 0, 0 };
+    double          sumDeltas[2]    = { 0.0, 0.0 };
+    double          sumSquares[2]   = { 0.0, 0.0 };
+    double          variance[2];
+    UINT32          numDropped      = 0;
+    PerfTimer       timer;
+    char            name[MAX_NAME];
+
+    //
+    // The same busy GameObjects, and moving nodes, updated once per 60 Hz frame, then
+    // stepped at 30 Hz and drawn in between.
+    //
+    for (UINT32 mode = 0; mode < 2 && rval; ++mode)
+    {
+        Time    clock;
+        UINT64  simTime;
+
+        clock.SetFixedStep( mode ? STEP_MS : 0 );
+        Transforms::EnableInterpolation( mode ? true : false );
+        simTime = mode ? clock.GetTime() : 0;
+
+        for (UINT32 i = 0; i < NUM_OBJECTS; ++i)
+        {
+            ppObjects[i] = new GameObject( GO_TYPE_TEST );
+            sprintf(name, "FixedStep%d", i);
+            ppObjects[i]->Init( name );
+            GOMan.Add( ppObjects[i], &phObjects[i] );
+            ppObjects[i]->CreateStateMachineManager();
+
+            pNodes[i] = Transforms::Create();
+        }
+
+        for (UINT32 i = 0; i < NUM_OBJECTS; ++i)
+        {
+            StateMachine* pStateMachine = new UnitTest6( phObjects[i], i,
+                                                         ppObjects[ (i + 1) % NUM_OBJECTS ]->GetID(),
+                                                         ppObjects[ (i + 7) % NUM_OBJECTS ]->GetID() );
+            ppObjects[i]->GetStateMachineManager()->PushStateMachine( *pStateMachine, STATE_MACHINE_QUEUE_0, true );
+        }
+
+        for (UINT32 frame = 0; frame < NUM_FRAMES && rval; ++frame)
+        {
+            // 60 Hz give or take a millisecond, with a 250 ms hitch every 5 seconds.
+            UINT32 frameMS  = (299 == frame % 300) ? 250 : ((frame % 3) ? 17 : 16);
+            UINT32 numSteps = 1;
+
+            timer.Start();
+
+            if (mode)
+            {
+                UINT32 dropped;
+
+                numSteps    = clock.Accumulate( frameMS );
+                dropped     = clock.DropSteps( MAX_STEPS );
+                numSteps   -= dropped;
+                numDropped += dropped;
+            }
+
+            for (UINT32 step = 0; step < numSteps; ++step)
+            {
+                UINT32 deltaMS = mode ? STEP_MS : frameMS;
+
+                if (mode)
+                {
+                    Transforms::BeginStep();
+                    clock.Step();
+                }
+
+                simTime += deltaMS;
+                GOMan.Update( simTime, GO_TYPE_TEST );
+
+                for (UINT32 i = 0; i < NUM_OBJECTS; ++i)
+                {
+                    Transforms::SetLocal( pNodes[i], vec3( simTime * SPEED, (float)i, 0.0f ), vec3(0,0,0), 1.0f );
+                }
+
+                numUpdates[mode]++;
+                sumDeltas [mode] += deltaMS;
+                sumSquares[mode] += (double)deltaMS * deltaMS;
+            }
+
+            Transforms::SetInterpolation( clock.GetAlpha() );
+
+            // What Draw() would ask for.
+            for (UINT32 i = 0; i < NUM_OBJECTS; ++i)
+            {
+                Transforms::GetLocal( pNodes[i] );
+            }
+
+            timer.Stop();
+            updateMs[mode] += timer.ElapsedMilliseconds();
+
+            if (numSteps > MAX_STEPS)
+            {
+                RETAILMSG(ZONE_ERROR, "ERROR: TestFixedTimestep: frame %d took %d steps", frame, numSteps);
+                rval = false;
+            }
+
+            if (mode && clock.GetTime() != simTime)
+            {
+                RETAILMSG(ZONE_ERROR, "ERROR: TestFixedTimestep: frame %d: clock at %llu ms, stepped to %llu ms", frame, clock.GetTime(), simTime);
+                rval = false;
+            }
+
+            // Drawn in between the last two steps.
+            if (mode && numUpdates[mode] > 1)
+            {
+                float expected  = ((float)(simTime - STEP_MS) + clock.GetAlpha() * STEP_MS) * SPEED;
+                float drawn     = Transforms::GetLocal( pNodes[0] ).w.x;
+
+                if (fabsf( drawn - expected ) > 0.01f)
+                {
+                    RETAILMSG(ZONE_ERROR, "ERROR: TestFixedTimestep: frame %d drawn at %2.4f, not %2.4f", frame, drawn, expected);
+                    rval = false;
+                }
+            }
+        }
+
+        for (UINT32 i = 0; i < NUM_OBJECTS; ++i)
+        {
+            GOMan.Release( phObjects[i] );
+            Transforms::Destroy( pNodes[i] );
+        }
+    }
+
+    for (UINT32 mode = 0; mode < 2; ++mode)
+    {
+        double mean     = numUpdates[mode] ? sumDeltas[mode] / numUpdates[mode] : 0.0;
+        variance[mode]  = numUpdates[mode] ? sumSquares[mode] / numUpdates[mode] - mean * mean : 0.0;
+    }
+
+    RETAILMSG(ZONE_INFO, "TestFixedTimestep: %d frames at 60 Hz: per frame: %d updates, %2.4f ms/frame, step variance %2.2f ms^2; 30 Hz steps: %d steps (%d dropped), %2.4f ms/frame, step variance %2.2f ms^2; %.0f%% CPU saved",
+        NUM_FRAMES,
+        numUpdates[0], updateMs[0] / NUM_FRAMES, variance[0],
+        numUpdates[1], numDropped, updateMs[1] / NUM_FRAMES, variance[1],
+        updateMs[0] > 0.0 ? 100.0 * (1.0 - updateMs[1] / updateMs[0]) : 0.0);
+
+    // The hitches must have been capped, and the rest stepped at 30 Hz.
+    if (rval && (0 == numDropped || numUpdates[1] >= numUpdates[0]))
+    {
+        RETAILMSG(ZONE_ERROR, "ERROR: TestFixedTimestep: %d steps, %d dropped, for %d frames", numUpdates[1], numDropped, numUpdates[0]);
+        rval = false;
+    }
+
+    Transforms::EnableInterpolation( wasInterpolating );
+    SAFE_ARRAY_DELETE(phObjects);
+    SAFE_ARRAY_DELETE(ppObjects);
+    SAFE_ARRAY_DELETE(pNodes);
+
+    return rval;
+}
+
+
+
+bool TestTouchDispatch()
+{
+    bool            rval            = true;
+    const UINT32    NUM_BRICKS      = 600;      // A 20 x 30 wall of overlapping bricks.
+    const UINT32    NUM_TAPS        = 200;
+    const MSG_Name  MESSAGES[3]     = { MSG_TouchBegin, MSG_TouchUpdate, MSG_TouchEnd };
+    MetricCounter*  pDeliveries     = Metrics::RegisterCounter( "Touch.Deliveries"  );
+    MetricCounter*  pBuilds         = Metrics::RegisterCounter( "Touch.IndexBuilds" );
+    bool            wasEnabled      = TouchScreen.IsHitIndexEnabled();
+    HGameObject*    phBricks        = new HGameObject[ NUM_BRICKS ];
+    UINT32*         pTargets        = new UINT32[ NUM_TAPS ];
+    INT64           delivered[2][3] = { { 0, 0, 0 }, { 0, 0, 0 } };
+    double          dispatchMs[2]   = { 0.0, 0.0 };
+    UINT32          numHits         = 0;
+    INT64           builds          = 0;
+    float           screenScale     = Platform::GetScreenScaleFactor();
+    float           worldScale      = GlobalSettings.GetFloat("/Settings.fWorldScaleFactor", 1.0f);
+    Rectangle       screenRect;
+    PerfTimer       timer;
+    char            name[MAX_NAME];
+
+    Platform::GetScreenRect( &screenRect );
+    IGNOREHR(TouchScreen.Init());
+
+    for (UINT32 i = 0; i < NUM_BRICKS; ++i)
+    {
+        sprintf(name, "TouchBrick%d", i);
+        GOMan.Create( name, &phBricks[i], "red", "", "", "IdleState", GO_TYPE_SPRITE, vec3( (i % 20) * 32.0f, (i / 20) * 32.0f, 0.0f ) );
+
+        for (UINT32 m = 0; m < 3; ++m)
+        {
+            TouchScreen.AddHitListener( phBricks[i], MESSAGES[m] );
+        }
+    }
+
+    for (UINT32 tap = 0; tap < NUM_TAPS; ++tap)
+    {
+        pTargets[tap] = Platform::Random() % NUM_BRICKS;
+    }
+
+    //
+    // The same taps, each on the middle of a brick, sent to every brick, then through the grid.
+    //
+    for (UINT32 mode = 0; mode < 2 && rval; ++mode)
+    {
+        TouchScreen.EnableHitIndex( mode ? true : false );
+        builds = pBuilds->Get();
+
+        for (UINT32 tap = 0; tap < NUM_TAPS && rval; ++tap)
+        {
+            vec3        center  = GOMan.GetBounds( phBricks[ pTargets[tap] ] ).GetCenter();
+            TouchEvent  event;
+            INT64       before;
+            UINT32      expected = 0;
+
+            memset(&event, 0, sizeof(event));
+            event.id = tap;
+
+            for (UINT32 m = 0; m < 3; ++m)
+            {
+                // ZEngine to device coordinates; SendToListeners() converts them back in place.
+                event.type      = (TOUCH_EVENT_TYPE)(TOUCH_EVENT_BEGIN + m);
+                event.point.x   = center.x * worldScale / screenScale;
+                event.point.y   = (screenRect.height - center.y * worldScale) / screenScale;
+                before          = pDeliveries->Get();
+
+                timer.Start();
+                switch (event.type)
+                {
+                    case TOUCH_EVENT_BEGIN:     TouchScreen.BeginTouch ( &event );  break;
+                    case TOUCH_EVENT_UPDATE:    TouchScreen.UpdateTouch( &event );  break;
+                    default:                    TouchScreen.EndTouch   ( &event );  break;
+                }
+                TouchScreen.ProcessEvents();
+                timer.Stop();
+
+                dispatchMs[mode]    += timer.ElapsedMilliseconds();
+                delivered[mode][m]  += pDeliveries->Get() - before;
+
+                if (TOUCH_EVENT_BEGIN != event.type || !mode)
+                {
+                    continue;
+                }
+
+                // Every brick whose grown bounds hold the touch, as the brick states test.
+                for (UINT32 i = 0; i < NUM_BRICKS; ++i)
+                {
+                    AABB bounds = GOMan.GetBounds( phBricks[i] );
+                    bounds *= TOUCH_HIT_SLOP;
+
+                    if (bounds.Intersects( event.point ))
+                    {
+                        expected++;
+                    }
+                }
+
+                numHits += expected;
+            }
+        }
+
+        builds = pBuilds->Get() - builds;
+    }
+
+    RETAILMSG(ZONE_INFO, "TestTouchDispatch: %d bricks, %d taps: every brick: %lld deliveries, %2.4f ms/tap; hit grid: %lld deliveries, %2.4f ms/tap, %lld index builds",
+        NUM_BRICKS, NUM_TAPS,
+        delivered[0][0] + delivered[0][1] + delivered[0][2], dispatchMs[0] / NUM_TAPS,
+        delivered[1][0] + delivered[1][1] + delivered[1][2], dispatchMs[1] / NUM_TAPS, builds);
+
+    //
+    // Without the grid every brick hears every touch.  With it, only the bricks under
+    // each MSG_TouchBegin hear it, and the rest of that touch - plus whatever else
+    // listens for every touch.
+    //
+    for (UINT32 m = 0; m < 3; ++m)
+    {
+        INT64 others = delivered[0][m] - (INT64)NUM_BRICKS * NUM_TAPS;
+
+        if (others < 0 || delivered[1][m] != (INT64)numHits + others)
+        {
+            RETAILMSG(ZONE_ERROR, "ERROR: TestTouchDispatch: message %d: %lld deliveries through the grid, expected %lld",
+                MESSAGES[m], delivered[1][m], (INT64)numHits + others);
+            rval = false;
+        }
+    }
+
+    for (UINT32 i = 0; i < NUM_BRICKS; ++i)
+    {
+        for (UINT32 m = 0; m < 3; ++m)
+        {
+            TouchScreen.RemoveListener( phBricks[i], MESSAGES[m] );
+        }
+        GOMan.Release( phBricks[i] );
+    }
+
+    TouchScreen.EnableHitIndex( wasEnabled );
+    SAFE_ARRAY_DELETE(phBricks);
+    SAFE_ARRAY_DELETE(pTargets);
+
+    return rval;
+}
+
+
+
+struct TestInputQueueContext
+{
+    RingBuffer<UINT32, 256>*    pRing;
+    UINT32                      numItems;
+    UINT32                      numGestures;
+    UINT32                      numUpdates;         // MSG_TouchUpdates per gesture.
+    volatile int32_t            numRetries;
+    volatile int32_t            isDone;
+};
+
+
+
+static void*
+TestInputQueueRingProducer( void* pContext )
+{
+    TestInputQueueContext* pTest = (TestInputQueueContext*)pContext;
+
+    for (UINT32 i = 1; i <= pTest->numItems; ++i)
+    {
+        while (!pTest->pRing->Push( i ))
+        {
+            OSAtomicIncrement32( &pTest->numRetries );
+            sched_yield();
+        }
+    }
+
+    OSAtomicIncrement32Barrier( &pTest->isDone );
+    return NULL;
+}
+
+
+
+static void*
+TestInputQueueTouchProducer( void* pContext )
+{
+    TestInputQueueContext* pTest = (TestInputQueueContext*)pContext;
+    TouchEvent             event;
+    RESULT                 rval;
+
+    memset(&event, 0, sizeof(event));
+
+    // Two fingers at a time, interleaved, as the OS sends them.
+    for (UINT32 gesture = 0; gesture < pTest->numGestures; gesture += 2)
+    {
+        for (UINT32 step = 0; step < pTest->numUpdates + 2; ++step)
+        {
+            for (UINT32 finger = 0; finger < 2; ++finger)
+            {
+                event.id        = gesture + finger;
+                event.type      = (0 == step) ? TOUCH_EVENT_BEGIN : (pTest->numUpdates + 1 == step) ? TOUCH_EVENT_END : TOUCH_EVENT_UPDATE;
+                event.point.x   = (float)(step * 4);
+                event.point.y   = (float)(finger * 100);
+
+                do
+                {
+                    event.timestamp = 0;
+
+                    switch (event.type)
+                    {
+                        case TOUCH_EVENT_BEGIN:     rval = TouchScreen.BeginTouch ( &event );   break;
+                        case TOUCH_EVENT_UPDATE:    rval = TouchScreen.UpdateTouch( &event );   break;
+                        default:                    rval = TouchScreen.EndTouch   ( &event );   break;
+                    }
+
+                    if (E_OUTOFMEMORY == rval)
+                    {
+                        OSAtomicIncrement32( &pTest->numRetries );
+                        sched_yield();
+                    }
+                } while (E_OUTOFMEMORY == rval);
+            }
+        }
+    }
+
+    OSAtomicIncrement32Barrier( &pTest->isDone );
+    return NULL;
+}
+
+
+
+bool TestInputQueue()
+{
+    bool                    rval            = true;
+    const UINT32            NUM_ITEMS       = 1000000;
+    const UINT32            NUM_GESTURES    = 2000;
+    const UINT32            NUM_UPDATES     = 30;
+    const INT64             NUM_TOUCHES     = (INT64)NUM_GESTURES * (NUM_UPDATES + 2);
+    MetricCounter*          pEvents         = Metrics::RegisterCounter( "Touch.Events"    );
+    MetricCounter*          pCoalesced      = Metrics::RegisterCounter( "Touch.Coalesced" );
+    RingBuffer<UINT32, 256>* pRing          = new RingBuffer<UINT32, 256>();
+    bool                    wasEnabled      = TouchScreen.IsQueueEnabled();
+    INT64                   eventsBefore    = 0;
+    INT64                   coalescedBefore = 0;
+    INT64                   events          = 0;
+    INT64                   coalesced       = 0;
+    UINT32                  expected        = 1;
+    UINT32                  item            = 0;
+    UINT32                  numProcessCalls = 0;
+    double                  ringMS          = 0.0;
+    double                  touchMS         = 0.0;
+    bool                    isDone          = false;
+    TestInputQueueContext   context;
+    PerfTimer               timer;
+    pthread_t               thread;
+
+    memset(&context, 0, sizeof(context));
+    context.pRing       = pRing;
+    context.numItems    = NUM_ITEMS;
+    context.numGestures = NUM_GESTURES;
+    context.numUpdates  = NUM_UPDATES;
+
+    //
+    // The bare queue: every item, in order, exactly once.
+    //
+    timer.Start();
+    if (pthread_create( &thread, NULL, TestInputQueueRingProducer, &context ))
+    {
+        RETAILMSG(ZONE_ERROR, "ERROR: TestInputQueue: pthread_create() failed");
+        rval = false;
+        goto Exit;
+    }
+
+    while (expected <= NUM_ITEMS)
+    {
+        if (!pRing->Pop( &item ))
+        {
+            continue;
+        }
+
+        if (item != expected && rval)
+        {
+            RETAILMSG(ZONE_ERROR, "ERROR: TestInputQueue: popped %d, expected %d", item, expected);
+            rval = false;
+        }
+        expected++;
+    }
+
+    pthread_join( thread, NULL );
+    timer.Stop();
+    ringMS = timer.ElapsedMilliseconds();
+
+    if (!pRing->IsEmpty())
+    {
+        RETAILMSG(ZONE_ERROR, "ERROR: TestInputQueue: %d items left over", pRing->GetCount());
+        rval = false;
+    }
+
+    RETAILMSG(ZONE_INFO, "TestInputQueue: %d items in %2.2f ms (%2.2f M items/s), %d producer retries",
+        NUM_ITEMS, ringMS, ringMS > 0.0 ? NUM_ITEMS / (ringMS * 1000.0) : 0.0, context.numRetries);
+
+    //
+    // Touches injected on another thread and delivered on this one: each is either
+    // delivered, or coalesced into a later MSG_TouchUpdate from the same finger.
+    //
+    TouchScreen.EnableQueue( true );
+    IGNOREHR(TouchScreen.ProcessEvents());
+
+    eventsBefore        = pEvents->Get();
+    coalescedBefore     = pCoalesced->Get();
+    context.numRetries  = 0;
+    context.isDone      = 0;
+
+    timer.Start();
+    if (pthread_create( &thread, NULL, TestInputQueueTouchProducer, &context ))
+    {
+        RETAILMSG(ZONE_ERROR, "ERROR: TestInputQueue: pthread_create() failed");
+        rval = false;
+        goto Exit;
+    }
+
+    // Once the producer is done the queue holds no more than one ProcessEvents() drains.
+    do
+    {
+        isDone = (0 != context.isDone);
+        OSMemoryBarrier();
+
+        IGNOREHR(TouchScreen.ProcessEvents());
+        numProcessCalls++;
+    } while (!isDone);
+
+    pthread_join( thread, NULL );
+    timer.Stop();
+    touchMS = timer.ElapsedMilliseconds();
+
+    events      = pEvents->Get()    - eventsBefore;
+    coalesced   = pCoalesced->Get() - coalescedBefore;
+
+    RETAILMSG(ZONE_INFO, "TestInputQueue: %lld touches in %2.2f ms, %d ProcessEvents(): %lld delivered, %lld coalesced, %d producer retries",
+        NUM_TOUCHES, touchMS, numProcessCalls, events, coalesced, context.numRetries);
+
+    if (events + coalesced != NUM_TOUCHES)
+    {
+        RETAILMSG(ZONE_ERROR, "ERROR: TestInputQueue: %lld delivered + %lld coalesced, expected %lld", events, coalesced, NUM_TOUCHES);
+        rval = false;
+    }
+
+    // Begins and ends are never coalesced; updates should be, with the producer this far ahead.
+    if (events < (INT64)NUM_GESTURES * 2 || (0 == coalesced && context.numRetries))
+    {
+        RETAILMSG(ZONE_ERROR, "ERROR: TestInputQueue: %lld delivered, %lld coalesced", events, coalesced);
+        rval = false;
+    }
+
+Exit:
+    TouchScreen.EnableQueue( wasEnabled );
+    SAFE_DELETE(pRing);
+
+    return rval;
+}
+
+
+
+//
+// Plays numColumns columns with BoardSearch, the same columns every time.
+// Returns the number played before the game ended.
+//
+static UINT32
+TestBoardSearchAutoplay( bool isParallel, UINT32 numColumns, OUT BoardMove* pMoves, OUT UINT32* pPoints )
+{
+    const UINT32        SPAWN_ROW   = GAME_GRID_NUM_ROWS - NUM_BRICKS_PER_COLUMN;
+    Board               board;
+    BoardSearchParams   params;
+    BoardOutcome        outcome;
+    BYTE                column [ NUM_BRICKS_PER_COLUMN ];
+    BYTE                rotated[ NUM_BRICKS_PER_COLUMN ];
+    UINT32              random      = 12345;
+    UINT32              n;
+
+    board.Init( GAME_GRID_NUM_COLUMNS, GAME_GRID_NUM_ROWS );
+    params.isParallel = isParallel;
+    *pPoints = 0;
+
+    for (n = 0; n < numColumns; ++n)
+    {
+        for (UINT32 i = 0; i < NUM_BRICKS_PER_COLUMN; ++i)
+        {
+            random      = random * 1103515245 + 12345;
+            column[i]   = Board::CellFromType( g_brickTypes[ (random >> 16) % params.numBrickTypes ].goType );
+        }
+
+        params.seed = n;
+        if (FAILED(BoardSearch::FindBestMove( board, column, BOARD_SPAWN_COLUMN, SPAWN_ROW, params, &pMoves[n] )))
+        {
+            break;
+        }
+
+        Board::Rotate( column, pMoves[n].numRotations, rotated );
+        board.Place( rotated, pMoves[n].x, SPAWN_ROW, params.scoring, &outcome );
+        *pPoints += outcome.points;
+
+        if (outcome.isGameOver)
+        {
+            n++;
+            break;
+        }
+    }
+
+    return n;
+}
+
+
+
+bool TestBoardSearch()
+{
+    bool                rval            = true;
+    const UINT32        NUM_COLUMNS     = 200;
+    const UINT32        SPAWN_ROW       = GAME_GRID_NUM_ROWS - NUM_BRICKS_PER_COLUMN;
+    const BYTE          RED             = Board::CellFromType( GO_TYPE_RED_BRICK   );
+    const BYTE          GREEN           = Board::CellFromType( GO_TYPE_GREEN_BRICK );
+    const BYTE          BLUE            = Board::CellFromType( GO_TYPE_BLUE_BRICK  );
+    BoardMove*          pSerialMoves    = new BoardMove[ NUM_COLUMNS ];
+    BoardMove*          pParallelMoves  = new BoardMove[ NUM_COLUMNS ];
+    bool                wasInitialized  = JobSystem::IsInitialized();
+    Board               board;
+    Board               played;
+    BoardScoring        scoring         = { 1.0f, 1.0f };
+    BoardOutcome        outcome;
+    BYTE                column[ NUM_BRICKS_PER_COLUMN ] = { BLUE, GREEN, RED };
+    UINT32              numSerial       = 0;
+    UINT32              numParallel     = 0;
+    UINT32              serialPoints    = 0;
+    UINT32              parallelPoints  = 0;
+    INT64               serialPositions = 0;
+    INT64               parallelPositions = 0;
+    double              serialMS        = 0.0;
+    double              parallelMS      = 0.0;
+    PerfTimer           timer;
+
+    IGNOREHR(JobSystem::Init());
+
+    //
+    // The rules: a red dropped beside two reds clears them, 11 rows down.
+    //
+    board.Init( GAME_GRID_NUM_COLUMNS, GAME_GRID_NUM_ROWS );
+    board.SetCell( 0, 0, RED );
+    board.SetCell( 1, 0, RED );
+
+    played = board;
+    played.Place( column, 2, SPAWN_ROW, scoring, &outcome );
+
+    if (outcome.points     != 140 || outcome.dropLength != SPAWN_ROW ||
+        outcome.numCleared != 3   || outcome.numLines   != 1         || outcome.numChains != 1 || outcome.isGameOver ||
+        played.GetCell( 0, 0 ) || played.GetCell( 2, 0 ) != GREEN || played.GetCell( 2, 1 ) != BLUE)
+    {
+        RETAILMSG(ZONE_ERROR, "ERROR: TestBoardSearch: placed for %d points, %d cleared, %d lines, %d chains",
+            outcome.points, outcome.numCleared, outcome.numLines, outcome.numChains);
+        rval = false;
+    }
+
+    //
+    // Headless autoplay, serially and on every worker: the same moves, and how many positions a second.
+    //
+    serialPositions = BoardSearch::GetNumPositions();
+    timer.Start();
+    numSerial = TestBoardSearchAutoplay( false, NUM_COLUMNS, pSerialMoves, &serialPoints );
+    timer.Stop();
+    serialMS        = timer.ElapsedMilliseconds();
+    serialPositions = BoardSearch::GetNumPositions() - serialPositions;
+
+    parallelPositions = BoardSearch::GetNumPositions();
+    timer.Start();
+    numParallel = TestBoardSearchAutoplay( true, NUM_COLUMNS, pParallelMoves, &parallelPoints );
+    timer.Stop();
+    parallelMS        = timer.ElapsedMilliseconds();
+    parallelPositions = BoardSearch::GetNumPositions() - parallelPositions;
+
+    if (numSerial != numParallel || serialPoints != parallelPoints || serialPositions != parallelPositions)
+    {
+        RETAILMSG(ZONE_ERROR, "ERROR: TestBoardSearch: serial played %d columns for %d points, parallel %d for %d",
+            numSerial, serialPoints, numParallel, parallelPoints);
+        rval = false;
+    }
+
+    for (UINT32 i = 0; i < MIN(numSerial, numParallel); ++i)
+    {
+        if (pSerialMoves[i].x != pParallelMoves[i].x || pSerialMoves[i].numRotations != pParallelMoves[i].numRotations)
+        {
+            RETAILMSG(ZONE_ERROR, "ERROR: TestBoardSearch: column %d: serial x %d rotated %d, parallel x %d rotated %d",
+                i, pSerialMoves[i].x, pSerialMoves[i].numRotations, pParallelMoves[i].x, pParallelMoves[i].numRotations);
+            rval = false;
+            break;
+        }
+    }
+
+    RETAILMSG(ZONE_INFO, "TestBoardSearch: %d columns for %d points; %lld positions, %.2f ms serial (%.0f/s), %.2f ms on %d workers (%.0f/s)",
+        numSerial, serialPoints, serialPositions,
+        serialMS,   serialMS   > 0.0 ? serialPositions   * 1000.0 / serialMS   : 0.0,
+        parallelMS, JobSystem::GetNumWorkers(),
+        parallelMS > 0.0 ? parallelPositions * 1000.0 / parallelMS : 0.0);
+
+    if (!wasInitialized)
+    {
+        IGNOREHR(JobSystem::Shutdown());
+    }
+
+    SAFE_ARRAY_DELETE(pSerialMoves);
+    SAFE_ARRAY_DELETE(pParallelMoves);
+
+    return rval;
+}
+
+
+
+bool TestGameSnapshot()
+{
+    bool                rval            = true;
+    const UINT32        FULL_SIZE       = sizeof(GameSnapshotData);
+    MetricCounter*      pBytesWritten   = Metrics::RegisterCounter( "Snapshot.BytesWritten" );
+    GameSnapshotData*   pSaved          = new GameSnapshotData;
+    GameSnapshotData*   pSnapshot       = new GameSnapshotData;
+    GameSnapshotData*   pLoaded         = new GameSnapshotData;
+    bool                hadSaved        = false;
+    INT64               fullBytes       = 0;
+    INT64               changedBytes    = 0;
+    double              fullMS          = 0.0;
+    double              changedMS       = 0.0;
+    double              loadMS          = 0.0;
+    PerfTimer           timer;
+
+    // Put the player's saved game, if any, back when we're done.
+    hadSaved = SUCCEEDED(GameSnapshot::TakePending( pSaved ));
+    IGNOREHR(GameSnapshot::Discard());
+
+    memset(pSnapshot, 0, FULL_SIZE);
+    pSnapshot->level            = 3;
+    pSnapshot->totalScore       = 12345;
+    pSnapshot->scoreToLevelUp   = 20000;
+    pSnapshot->gameTimeMS       = 95000;
+    pSnapshot->state            = 5;
+    pSnapshot->width            = GAME_GRID_NUM_COLUMNS;
+    pSnapshot->height           = GAME_GRID_NUM_ROWS + 1;
+    for (UINT32 i = 0; i < pSnapshot->width * 4; ++i)
+    {
+        pSnapshot->cells[i] = (BYTE)(BOARD_CELL_BRICK + i % 7);
+    }
+    pSnapshot->hasColumn        = 1;
+    pSnapshot->column[0]        = BOARD_CELL_BRICK;
+    pSnapshot->column[1]        = BOARD_CELL_BRICK + 1;
+    pSnapshot->column[2]        = BOARD_CELL_RADIAL_BOMB;
+    pSnapshot->numStoryboards   = 2;
+    pSnapshot->storyboards[1].isStarted = 1;
+    pSnapshot->storyboards[1].elapsedMS = 250;
+    pSnapshot->numMessageNames  = MSG_NUM;
+    pSnapshot->numMessages      = 1;
+    pSnapshot->messages[0].name = MSG_Firework;
+    pSnapshot->messages[0].delay = 1.5f;
+
+    //
+    // The first write is all of it.
+    //
+    fullBytes = pBytesWritten->Get();
+    timer.Start();
+    if (FAILED(GameSnapshot::Save( *pSnapshot )))
+    {
+        RETAILMSG(ZONE_ERROR, "ERROR: TestGameSnapshot: Save() failed");
+        rval = false;
+        goto Exit;
+    }
+    GameSnapshot::Wait();
+    timer.Stop();
+    fullMS      = timer.ElapsedMilliseconds();
+    fullBytes   = pBytesWritten->Get() - fullBytes;
+
+    if (fullBytes != FULL_SIZE)
+    {
+        RETAILMSG(ZONE_ERROR, "ERROR: TestGameSnapshot: first write was %lld bytes, expected %d", (long long)fullBytes, (int)FULL_SIZE);
+        rval = false;
+    }
+
+    //
+    // The next, only the blocks that changed, and the header.
+    //
+    pSnapshot->totalScore      += 500;
+    pSnapshot->cells[ pSnapshot->width * 4 ] = BOARD_CELL_VERTICAL_BOMB;
+
+    changedBytes = pBytesWritten->Get();
+    timer.Start();
+    IGNOREHR(GameSnapshot::Save( *pSnapshot ));
+    GameSnapshot::Wait();
+    timer.Stop();
+    changedMS       = timer.ElapsedMilliseconds();
+    changedBytes    = pBytesWritten->Get() - changedBytes;
+
+    if (changedBytes <= (INT64)GAME_SNAPSHOT_HEADER_SIZE || changedBytes > (INT64)(GAME_SNAPSHOT_HEADER_SIZE + 3*GAME_SNAPSHOT_BLOCK_SIZE))
+    {
+        RETAILMSG(ZONE_ERROR, "ERROR: TestGameSnapshot: changing two fields wrote %lld bytes", (long long)changedBytes);
+        rval = false;
+    }
+
+    //
+    // What's read back is what was saved last.
+    //
+    timer.Start();
+    if (FAILED(GameSnapshot::Load()) || FAILED(GameSnapshot::TakePending( pLoaded )))
+    {
+        RETAILMSG(ZONE_ERROR, "ERROR: TestGameSnapshot: can't load the snapshot just saved");
+        rval = false;
+        goto Exit;
+    }
+    timer.Stop();
+    loadMS = timer.ElapsedMilliseconds();
+    GameSnapshot::EndResume();
+
+    if (memcmp((BYTE*)pLoaded + GAME_SNAPSHOT_HEADER_SIZE, (BYTE*)pSnapshot + GAME_SNAPSHOT_HEADER_SIZE, FULL_SIZE - GAME_SNAPSHOT_HEADER_SIZE) ||
+        pLoaded->version != GAME_SNAPSHOT_VERSION || pLoaded->size != FULL_SIZE)
+    {
+        RETAILMSG(ZONE_ERROR, "ERROR: TestGameSnapshot: loaded snapshot differs: score %u, expected %u", pLoaded->totalScore, pSnapshot->totalScore);
+        rval = false;
+    }
+
+    //
+    // Nothing to resume once it's discarded.
+    //
+    IGNOREHR(GameSnapshot::Discard());
+    if (SUCCEEDED(GameSnapshot::Load()) || GameSnapshot::IsPending())
+    {
+        RETAILMSG(ZONE_ERROR, "ERROR: TestGameSnapshot: loaded a discarded snapshot");
+        rval = false;
+    }
+
+    RETAILMSG(ZONE_INFO, "TestGameSnapshot: %d bytes; full write %lld bytes in %2.3f ms, incremental %lld bytes in %2.3f ms; load %2.3f ms",
+        (int)FULL_SIZE, (long long)fullBytes, fullMS, (long long)changedBytes, changedMS, loadMS);
+
+Exit:
+    if (hadSaved)
+    {
+        IGNOREHR(GameSnapshot::Save( *pSaved ));
+        GameSnapshot::Wait();
+        IGNOREHR(GameSnapshot::Load());
+    }
+
+    SAFE_DELETE(pSaved);
+    SAFE_DELETE(pSnapshot);
+    SAFE_DELETE(pLoaded);
+
+    return rval;
+}
+
+
+
 } // END namespace Z
 
 
@@ -40,6 +40,30 @@ bool TestTexturePacker();
 bool TestParticles();
 bool TestEasing();
 bool TestRipple();
+bool TestNullRenderer();
+bool TestProfiler();
+bool TestLog();
+bool TestJobSystem();
+bool TestRenderQueue();
+bool TestRetainedSpriteBatches();
+bool TestSharedShadowPass();
+bool TestCulling();
+bool TestScratchSurfaces();
+bool TestQuadVertices();
+bool TestVertexStream();
+bool TestTessellationGrids();
+bool TestTextBatching();
+bool TestTransforms();
+bool TestSliceScheduler();
+bool TestPrefabPools();
+bool TestDenseGameObjects();
+bool TestStateDispatch();
+bool TestParallelUpdate();
+bool TestFixedTimestep();
+bool TestTouchDispatch();
+bool TestInputQueue();
+bool TestBoardSearch();
+bool TestGameSnapshot();
 
 
 } // END namespace Z
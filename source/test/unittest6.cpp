@@ -0,0 +1,91 @@
+/* Copyright Steve Rabin, 2007. 
+ * All rights reserved worldwide.
+ *
+ * This software is provided "as is" without express or implied
+ * warranties. You may freely copy and compile this source into
+ * applications you distribute provided that the copyright text
+ * below is included in the resulting source code, for example:
+ * "Portions Copyright Steve Rabin, 2007"
+ */
+
+#include "unittest6.h"
+#include "GameObjectManager.hpp"
+
+
+namespace Z
+{
+
+
+
+//Add new states here
+enum StateName {
+	STATE_Initialize,	//Note: the first enum is the starting state
+	STATE_Working,
+	STATE_Resting
+};
+
+//Add new substates here
+enum SubstateName {
+	//empty
+};
+
+//unittest6 covers:
+//GameObjectManager's parallel update: OnFrameUpdate on a worker thread,
+//SendMsg and ChangeState from there, and OnMsg in the order the
+//deferred messages are merged.
+//
+
+bool UnitTest6::States( State_Machine_Event event, MSG_Object * msg, int state, int substate )
+{
+BeginStateMachine
+
+	//Global message responses
+	OnMsg( MSG_UnitTestPing )
+		Mix( static_cast<unsigned int>( msg->GetIntData() ) );
+	
+
+	///////////////////////////////////////////////////////////////
+	DeclareState( STATE_Initialize )
+
+		OnEnter
+			ChangeState( STATE_Working );
+
+
+	///////////////////////////////////////////////////////////////
+	DeclareState( STATE_Working )
+
+		OnFrameUpdate
+			//Some busy work, so there's something to spread across threads
+			unsigned int value = m_digest ^ m_frame;
+			for( int i=0; i<256; ++i ) {
+				value = value * 1664525 + 1013904223;
+			}
+			Mix( value );
+			m_frame++;
+
+			if( 0 == m_frame % 4 ) {
+				SendMsg( MSG_UnitTestPing, m_neighbor1, (m_index << 16) ^ (int)(m_digest & 0xFFFF) );
+				SendMsg( MSG_UnitTestPing, m_neighbor2, (m_index << 16) ^ (int)(m_digest >> 16) );
+			}
+			if( 0 == m_frame % 16 ) {
+				ChangeState( STATE_Resting );
+			}
+
+
+	///////////////////////////////////////////////////////////////
+	DeclareState( STATE_Resting )
+
+		OnEnter
+			Mix( m_frame );
+
+		OnFrameUpdate
+			ChangeState( STATE_Working );
+
+EndStateMachine
+}
+
+
+
+} // END namespace Z
+
+
@@ -0,0 +1,52 @@
+/* Copyright Steve Rabin, 2005. 
+ * All rights reserved worldwide.
+ *
+ * This software is provided "as is" without express or implied
+ * warranties. You may freely copy and compile this source into
+ * applications you distribute provided that the copyright text
+ * below is included in the resulting source code, for example:
+ * "Portions Copyright Steve Rabin, 2005"
+ */
+
+#pragma once
+
+#include "StateMachine.hpp"
+
+
+namespace Z
+{
+
+
+
+class UnitTest6 : public StateMachine
+{
+public:
+
+	UnitTest6( HGameObject &hGameObject, int index, OBJECT_ID neighbor1, OBJECT_ID neighbor2 )
+		: StateMachine( hGameObject ), m_index( index ), m_neighbor1( neighbor1 ), m_neighbor2( neighbor2 ), m_frame( 0 ), m_digest( 0 ) {}
+	~UnitTest6( void ) {}
+
+	//Everything this state machine has seen, in the order it saw it
+	unsigned int GetDigest( void )		{ return( m_digest ); }
+
+
+private:
+
+	virtual bool States( State_Machine_Event event, MSG_Object * msg, int state, int substate );
+
+	void Mix( unsigned int value )		{ m_digest = m_digest * 31 + value; }
+
+	//Put state variables here
+	int m_index;
+	OBJECT_ID m_neighbor1;
+	OBJECT_ID m_neighbor2;
+	unsigned int m_frame;
+	unsigned int m_digest;
+
+};
+
+
+
+} // END namespace Z
+
+